@@ -0,0 +1,93 @@
+// Analog input filtering: oversampled bursts, a median window against
+// spikes and an EMA, then a calibration curve to percent. Set by the
+// sketch's "Analog Filtering" settings; raw reads are recorded through
+// log_ring.h, which comes first.
+#pragma once
+
+// Calibration curve point: ADC reading → percent, interpolated linearly between points
+struct CalPoint {
+  uint16_t raw;
+  uint8_t percent;
+};
+
+// Default LDR curve matches the old map(0..1023 → 0..100); add points to bend it
+const CalPoint ldrCurve[] = { {0, 0}, {1023, 100} };
+
+// One filtered analog input. Values are raw ADC counts in Q4 fixed point.
+struct AnalogChannel {
+  uint8_t pin;
+  const CalPoint *curve;
+  uint8_t curvePoints;
+  uint32_t burstSum = 0;
+  uint8_t burstCount = 0;
+  uint16_t window[ADC_MEDIAN_N] = {};
+  uint8_t windowPos = 0;
+  uint8_t windowFill = 0;
+  int32_t emaQ4 = 0;
+  bool ready = false;
+};
+
+AnalogChannel ldrChannel = { LDR_PIN, ldrCurve, sizeof(ldrCurve) / sizeof(ldrCurve[0]) };
+
+// ---------------- Prototypes ----------------
+// Plain C++ needs these; the Arduino IDE generates them only for .ino files
+void sampleAnalogChannel(AnalogChannel &ch);
+int analogChannelPercent(AnalogChannel &ch);
+
+// ---------------- Analog Filtering ----------------
+// Call once per loop() pass; takes at most one ADC reading
+void sampleAnalogChannel(AnalogChannel &ch) {
+  int raw = analogRead(ch.pin);
+  RECORD(LOG_REC_ADC, ch.pin, raw);
+  ch.burstSum += raw;
+  if(++ch.burstCount < ADC_BURST_SAMPLES) return;
+
+  // Oversampled burst average, keeping 4 fractional bits
+  uint16_t averageQ4 = (ch.burstSum << 4) / ADC_BURST_SAMPLES;
+  ch.burstSum = 0;
+  ch.burstCount = 0;
+
+  ch.window[ch.windowPos] = averageQ4;
+  ch.windowPos = (ch.windowPos + 1) % ADC_MEDIAN_N;
+  if(ch.windowFill < ADC_MEDIAN_N) ch.windowFill++;
+
+  // Median of the window (insertion sort of at most 5 values)
+  uint16_t sorted[ADC_MEDIAN_N];
+  for(uint8_t i = 0; i < ch.windowFill; i++) {
+    uint16_t v = ch.window[i];
+    uint8_t j = i;
+    while(j > 0 && sorted[j - 1] > v) {
+      sorted[j] = sorted[j - 1];
+      j--;
+    }
+    sorted[j] = v;
+  }
+  int32_t median = sorted[ch.windowFill / 2];
+
+  if(!ch.ready) {
+    ch.emaQ4 = median;
+    ch.ready = true;
+  } else {
+    ch.emaQ4 += (median - ch.emaQ4) >> ADC_EMA_SHIFT;
+  }
+}
+
+// Filtered reading mapped through the channel's calibration curve
+int analogChannelPercent(AnalogChannel &ch) {
+  if(!ch.ready) {
+    // No filtered value yet right after boot - seed from a single reading
+    ch.emaQ4 = (int32_t)analogRead(ch.pin) << 4;
+    ch.ready = true;
+  }
+  int raw = (ch.emaQ4 + 8) >> 4;
+
+  const CalPoint *c = ch.curve;
+  if(raw <= c[0].raw) return c[0].percent;
+  for(uint8_t i = 1; i < ch.curvePoints; i++) {
+    if(raw <= c[i].raw) {
+      return c[i - 1].percent +
+             (long)(raw - c[i - 1].raw) * (c[i].percent - c[i - 1].percent) / (c[i].raw - c[i - 1].raw);
+    }
+  }
+  return c[ch.curvePoints - 1].percent;
+}
\ No newline at end of file
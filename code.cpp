@@ -1,4 +1,7 @@
 #include <DHT.h>
+#ifdef __AVR__
+#include <avr/sleep.h>
+#endif
 
 // Define DHT sensor
 #define DHTPIN 7         // DHT11 data pin connected to digital pin 7
@@ -16,6 +19,59 @@ const int EN2 = 10;
 const int IN3 = 4;
 const int IN4 = 5;
 
+// Cooperative scheduler: a small timer wheel replaces delay() in loop()
+#define SCHED_MAX_TASKS     2
+#define SCHED_WHEEL_SLOTS   16      // 1 ms slots, power of two
+#define SCHED_LATE_MS       20      // a run starting later than this missed its deadline
+#define SCHED_MAX_IDLE_MS   1000    // longest single idle sleep
+#define STATS_PERIOD_MS     60000UL // scheduler report on Serial
+#define MOTOR2_ON_C         30.0    // Motor 2 runs above this temperature
+
+// Adaptive sampling: readAndControl() reads again after SAMPLE_MIN_MS while
+// the temperature moves fast or is close to MOTOR2_ON_C, and stretches the
+// interval towards SAMPLE_MAX_MS, by at most half per reading, while it is
+// flat and far from it
+#define SAMPLE_MIN_MS       2000    // the DHT library returns its cached reading inside 2 s
+#define SAMPLE_MAX_MS       30000
+#define SAMPLE_FAST_RATE    1.0     // °C per minute that calls for SAMPLE_MIN_MS
+#define SAMPLE_NEAR_C       1.5     // °C from MOTOR2_ON_C, falling off linearly
+
+// ---------------- Input Recording ----------------
+// With RECORD_INPUTS set, each DHT reading also goes out on Serial as a binary
+// record, mixed in with the text: sync byte, id, length, payload, 8-bit sum,
+// as in the ESP sketches' log records. host/replay.cpp reads LOG_FORMATS below
+// to feed a capture back through readAndControl(); host/logdecode.cpp shows it
+// as text. The level column is only there to match their tables.
+#ifndef RECORD_INPUTS
+#define RECORD_INPUTS 0
+#endif
+#define RECORD_SYNC   0xA5
+#define LOG_NAN       -32768    // %C argument for a failed reading
+
+#define LOG_FORMATS(X) \
+  X(LOG_REC_DHT, 0, "Input: DHT %C°C")
+
+#define LOG_ID_OF(id, level, text) id,
+enum LogId : uint8_t { LOG_FORMATS(LOG_ID_OF) LOG_FORMAT_COUNT };
+
+int8_t readTask = -1;
+uint32_t readIntervalMs = SAMPLE_MIN_MS;    // current time between readings
+uint32_t lastReadMs = 0;
+float lastReadC = NAN;                      // NAN until the first good reading
+
+// ---------------- Prototypes ----------------
+// Plain C++ needs these; the Arduino IDE generates them only for .ino files
+void readAndControl();
+uint32_t nextReadInterval(float temperatureC);
+void printSchedulerStats();
+void recordPutVarint(uint8_t *buf, uint8_t &len, int64_t value);
+void recordInput(uint8_t id, int32_t value);
+void schedulerIdle(uint32_t ms);
+
+// The timer wheel, shared with the ESP sketches. It is sized by the SCHED_*
+// settings above, so it comes after them.
+#include "scheduler.h"
+
 void setup() {
   Serial.begin(9600);
   dht.begin();
@@ -33,10 +89,23 @@ void setup() {
   digitalWrite(IN1, HIGH);
   digitalWrite(IN2, LOW);
   analogWrite(EN1, 200);  // Adjust speed (0–255)
+
+  schedulerBegin();
+  readTask = scheduleEvery("read", SAMPLE_MIN_MS, 0, readAndControl);
+  scheduleEvery("stats", STATS_PERIOD_MS, STATS_PERIOD_MS, printSchedulerStats);
 }
 
 void loop() {
+  schedulerIdle(runScheduler());
+}
+
+void readAndControl() {
   float temperatureC = dht.readTemperature();  // Read temperature in °C
+#if RECORD_INPUTS
+  recordInput(LOG_REC_DHT, isnan(temperatureC) ? LOG_NAN : (int32_t)lround(temperatureC * 100));
+#endif
+  readIntervalMs = nextReadInterval(temperatureC);
+  setTaskPeriod(readTask, readIntervalMs);
 
   if (isnan(temperatureC)) {
     Serial.println("Failed to read from DHT sensor!");
@@ -47,7 +116,7 @@ void loop() {
   Serial.print(temperatureC);
   Serial.println(" °C");
 
-  if (temperatureC > 30.0) {
+  if (temperatureC > MOTOR2_ON_C) {
     // Start Motor 2
     digitalWrite(IN3, HIGH);
     digitalWrite(IN4, LOW);
@@ -58,6 +127,79 @@ void loop() {
     digitalWrite(IN4, LOW);
     analogWrite(EN2, 0);
   }
+}
+
+// Time until the next reading: SAMPLE_MIN_MS after a failed read, otherwise
+// the shorter of what the rate of change and the distance to MOTOR2_ON_C
+// call for
+uint32_t nextReadInterval(float temperatureC) {
+  uint32_t now = millis();
+  float urgency = 1.0;    // 1 = SAMPLE_MIN_MS, 0 = SAMPLE_MAX_MS
+  if(!isnan(temperatureC)) {
+    float near = 1.0 - fabs(temperatureC - MOTOR2_ON_C) / SAMPLE_NEAR_C;
+    urgency = near > 0 ? near : 0;
+    if(!isnan(lastReadC)) {
+      float rate = fabs(temperatureC - lastReadC) * 60000.0 / (now - lastReadMs ? now - lastReadMs : 1);
+      if(rate / SAMPLE_FAST_RATE > urgency) urgency = rate / SAMPLE_FAST_RATE;
+    }
+    lastReadC = temperatureC;
+    lastReadMs = now;
+  }
+  if(urgency > 1) urgency = 1;
+
+  uint32_t interval = SAMPLE_MAX_MS - (uint32_t)((SAMPLE_MAX_MS - SAMPLE_MIN_MS) * urgency);
+  uint32_t longest = readIntervalMs + readIntervalMs / 2;
+  return interval < longest ? interval : longest;
+}
+
+void printSchedulerStats() {
+  for(int8_t id = 0; id < SCHED_MAX_TASKS; id++) {
+    const Task &t = tasks[id];
+    if(!t.active) continue;
+    Serial.print("Task ");
+    Serial.print(t.name);
+    Serial.print(": runs ");
+    Serial.print(t.runs);
+    Serial.print(", missed ");
+    Serial.print(t.misses);
+    Serial.print(", jitter max ");
+    Serial.print(t.jitterMaxUs);
+    Serial.println(" us");
+  }
+}
+
+void recordPutVarint(uint8_t *buf, uint8_t &len, int64_t value) {
+  uint64_t v = ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+  while(v >= 0x80) {
+    buf[len++] = (uint8_t)v | 0x80;
+    v >>= 7;
+  }
+  buf[len++] = (uint8_t)v;
+}
+
+// One input record: millis() stamp and one integer argument. Written straight
+// to Serial; at most one reading every 2 s never fills the TX buffer.
+void recordInput(uint8_t id, int32_t value) {
+  uint8_t payload[10], len = 0;
+  recordPutVarint(payload, len, millis());
+  recordPutVarint(payload, len, value);
+  uint8_t sum = id + len;
+  for(uint8_t i = 0; i < len; i++) sum += payload[i];
+  Serial.write(RECORD_SYNC);
+  Serial.write(id);
+  Serial.write(len);
+  Serial.write(payload, len);
+  Serial.write(sum);
+}
 
-  delay(1000);  // Delay between readings
+// Nothing is due for ms milliseconds. On the Uno, idle sleep stops the CPU
+// clock; the millis() timer interrupt wakes it about once a millisecond.
+void schedulerIdle(uint32_t ms) {
+#ifdef __AVR__
+  unsigned long start = millis();
+  set_sleep_mode(SLEEP_MODE_IDLE);
+  while(millis() - start < ms) sleep_mode();
+#else
+  delay(ms);
+#endif
 }
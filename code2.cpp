@@ -11,6 +11,33 @@
 
 #define LSPEED 60
 #define RSPEED 60
+
+// Input recording: with RECORD_INPUTS set, every change of the two IR levels
+// goes out on Serial as a binary record (sync byte, id, length, payload, 8-bit
+// sum, as in the ESP sketches' log records) for host/replay.cpp, which reads
+// LOG_FORMATS below. The level column is only there to match their tables.
+// At 9600 baud the 64-byte TX buffer holds about 8 records; faster edge
+// bursts than that make loop() wait.
+#ifndef RECORD_INPUTS
+#define RECORD_INPUTS 0
+#endif
+#define RECORD_SYNC 0xA5
+
+#define LOG_FORMATS(X) \
+  X(LOG_REC_IR, 0, "Input: IR left %u right %u")
+
+#define LOG_ID_OF(id, level, text) id,
+enum LogId : uint8_t { LOG_FORMATS(LOG_ID_OF) LOG_FORMAT_COUNT };
+
+// Plain C++ needs these; the Arduino IDE generates them only for .ino files
+void forward();
+void backward();
+void left();
+void right();
+void stop();
+void recordPutVarint(uint8_t *buf, uint8_t &len, int64_t value);
+void recordIr(int l, int r);
+
 void setup()
 {
   // put your setup code here, to run once:
@@ -30,6 +57,9 @@ void loop()
   // put your main code here, to run repeatedly:
   int l = digitalRead(LIR);
   int r = digitalRead(RIR);
+#if RECORD_INPUTS
+  recordIr(l, r);
+#endif
   if (l == HIGH && r == HIGH)
   {
     forward();
@@ -92,4 +122,38 @@ void stop()
   digitalWrite(RM2, LOW);
   analogWrite(ENA, 0);
   analogWrite(ENB, 0);
-}
\ No newline at end of file
+}
+
+void recordPutVarint(uint8_t *buf, uint8_t &len, int64_t value)
+{
+  uint64_t v = ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+  while (v >= 0x80)
+  {
+    buf[len++] = (uint8_t)v | 0x80;
+    v >>= 7;
+  }
+  buf[len++] = (uint8_t)v;
+}
+
+// One LOG_REC_IR record with the millis() stamp, only when a level changed
+void recordIr(int l, int r)
+{
+  static int lastL = -1, lastR = -1;
+  if (l == lastL && r == lastR)
+    return;
+  lastL = l;
+  lastR = r;
+
+  uint8_t payload[9], len = 0;
+  recordPutVarint(payload, len, millis());
+  recordPutVarint(payload, len, l);
+  recordPutVarint(payload, len, r);
+  uint8_t sum = LOG_REC_IR + len;
+  for (uint8_t i = 0; i < len; i++)
+    sum += payload[i];
+  Serial.write(RECORD_SYNC);
+  Serial.write(LOG_REC_IR);
+  Serial.write(len);
+  Serial.write(payload, len);
+  Serial.write(sum);
+}
@@ -13,6 +13,30 @@ int IN4 = 5;   // Right motor backward
 int IR_left = 2;   // Left sensor
 int IR_right = 3;  // Right sensor
 
+// Input recording: with RECORD_INPUTS set, every change of the two IR levels
+// goes out on Serial (115200 baud) as a binary record: sync byte, id, length,
+// payload, 8-bit sum, as in the ESP sketches' log records. host/replay.cpp
+// reads LOG_FORMATS below to feed a capture back through loop(). The level
+// column is only there to match their tables.
+#ifndef RECORD_INPUTS
+#define RECORD_INPUTS 0
+#endif
+#define RECORD_SYNC 0xA5
+
+#define LOG_FORMATS(X) \
+  X(LOG_REC_IR, 0, "Input: IR left %u right %u")
+
+#define LOG_ID_OF(id, level, text) id,
+enum LogId : uint8_t { LOG_FORMATS(LOG_ID_OF) LOG_FORMAT_COUNT };
+
+// Plain C++ needs these; the Arduino IDE generates them only for .ino files
+void forward();
+void turnLeft();
+void turnRight();
+void stopMotors();
+void recordPutVarint(uint8_t *buf, uint8_t &len, int64_t value);
+void recordIr(int left, int right);
+
 void setup() {
   // Motor pins
   pinMode(ENA, OUTPUT);
@@ -27,11 +51,18 @@ void setup() {
   pinMode(IR_right, INPUT);
 
   stopMotors(); // Start with motors stopped
+
+#if RECORD_INPUTS
+  Serial.begin(115200);
+#endif
 }
 
 void loop() {
   int left = digitalRead(IR_left);
   int right = digitalRead(IR_right);
+#if RECORD_INPUTS
+  recordIr(left, right);
+#endif
 
   if (left == 0 && right == 0) {
     // Both sensors on black -> Stop
@@ -86,4 +117,34 @@ void stopMotors() {
   digitalWrite(IN4, LOW);
   analogWrite(ENA, 0);
   analogWrite(ENB, 0);
-}
\ No newline at end of file
+}
+
+// ====== Input recording ======
+void recordPutVarint(uint8_t *buf, uint8_t &len, int64_t value) {
+  uint64_t v = ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+  while (v >= 0x80) {
+    buf[len++] = (uint8_t)v | 0x80;
+    v >>= 7;
+  }
+  buf[len++] = (uint8_t)v;
+}
+
+// One LOG_REC_IR record with the millis() stamp, only when a level changed
+void recordIr(int left, int right) {
+  static int lastLeft = -1, lastRight = -1;
+  if (left == lastLeft && right == lastRight) return;
+  lastLeft = left;
+  lastRight = right;
+
+  uint8_t payload[9], len = 0;
+  recordPutVarint(payload, len, millis());
+  recordPutVarint(payload, len, left);
+  recordPutVarint(payload, len, right);
+  uint8_t sum = LOG_REC_IR + len;
+  for (uint8_t i = 0; i < len; i++) sum += payload[i];
+  Serial.write(RECORD_SYNC);
+  Serial.write(LOG_REC_IR);
+  Serial.write(len);
+  Serial.write(payload, len);
+  Serial.write(sum);
+}
@@ -7,6 +7,149 @@
 #define WLAN_SSID       "YOUR_WIFI_SSID"
 #define WLAN_PASS       "YOUR_WIFI_PASSWORD"
 
+// ---------------- Fast WiFi Boot ----------------
+#define WIFI_QUICK_TIMEOUT_MS  5000   // give up on the cached BSSID/channel/IP after 5 s
+#define WIFI_CACHE_RTC_BLOCK   0      // RTC user memory offset (4-byte blocks)
+
+// ---------------- Low-Power Mode ----------------
+// Set to 1 for battery sensor-only nodes: wake, read, publish, deep-sleep.
+// Needs D0 (GPIO16) jumpered to RST for wake-up, so the LED driver (IN3) is unused.
+// host/replay.cpp measures wake-to-sleep time and energy per sample of a build
+// with -DLOW_POWER_MODE=1.
+#ifndef LOW_POWER_MODE
+#define LOW_POWER_MODE          0
+#endif
+#define SLEEP_STATE_RTC_BLOCK   8       // RTC user memory offset, after the WiFi cache
+#define SLEEP_MIN_S             60      // fastest sampling when values move quickly
+#define SLEEP_MAX_S             900     // slowest sampling when values are flat
+#define SLEEP_TEMP_STEP         50      // aim for ~0.5°C change per sample (centidegrees)
+#define SLEEP_HUM_STEP          300     // aim for ~3% humidity change per sample (centipercent)
+#define SLEEP_LIGHT_STEP        10      // aim for ~10% light change per sample
+#define DHT_POWERUP_MS          1500    // DHT11 needs ~1 s after power-up
+#define LOW_POWER_CONNECT_MS    8000    // give up on WiFi/MQTT for this wake after 8 s
+
+// Energy model used for the per-sample report (NodeMCU board figures)
+#define ENERGY_AWAKE_MA         80      // average draw with the radio on
+#define ENERGY_SLEEP_UA         20      // deep-sleep draw
+#define ENERGY_SUPPLY_MV        3300
+
+// ---------------- Metrics ----------------
+#define METRICS_BUCKETS       20        // log2 histogram: le=1,2,4..262144 us, then +Inf
+#define METRICS_PUBLISH_MS    60000UL   // one record on the metrics feed per minute
+
+// ---------------- Scheduler ----------------
+#define SCHED_MAX_TASKS       8         // periodic tasks plus room for one-shots
+#define SCHED_WHEEL_SLOTS     64        // 1 ms slots, power of two
+#define SCHED_LATE_MS         20        // a run starting later than this missed its deadline
+#define SCHED_MAX_IDLE_MS     50        // longest single idle sleep
+#define MQTT_POLL_MS          50        // incoming command check period
+#define MQTT_READ_TIMEOUT_MS  10        // readSubscription() wait per check
+#define MQTT_RETRY_MS         5000      // wait after a failed connect
+#define WIFI_POLL_MS          100
+
+// ---------------- Adaptive Sampling ----------------
+// readSensors() picks the time to its next run from what it has just read:
+// SAMPLE_MIN_MS while the temperature moves fast, or temperature or light sit
+// near the point where automatic mode would switch, up to SAMPLE_MAX_MS while
+// they are flat and far from it. A shorter interval applies at once; a longer
+// one grows by at most SAMPLE_STRETCH_PCT per read. The LDR is filtered every
+// ADC_SAMPLE_INTERVAL_MS anyway, so a light change of SAMPLE_LIGHT_WAKE pulls
+// the next read in rather than waiting out a long interval.
+#define SAMPLE_MIN_MS          2000     // DHT11: the library returns its cached reading inside 2 s
+#define SAMPLE_MAX_MS          30000
+#define SAMPLE_STRETCH_PCT     50
+#define SAMPLE_FAST_RATE       100      // centidegrees per minute that call for SAMPLE_MIN_MS
+#define SAMPLE_NEAR_TEMP       100      // centidegrees from the switching point (one DHT11 step)
+#define SAMPLE_NEAR_LIGHT      5        // percent from the switching point
+#define SAMPLE_LIGHT_WAKE      5        // percent
+
+// ---------------- Publishing ----------------
+// Publishing is decoupled from sampling: a feed goes out only when it has
+// moved by its deadband since the value last sent, or PUBLISH_HEARTBEAT_MS
+// has passed without one. Each point spends a token from a bucket holding
+// PUBLISH_BURST that refills at PUBLISH_POINTS_PER_MIN, so no minute sees more
+// than 26 sensor points plus the metrics record, against Adafruit IO's 30.
+// A change that finds the bucket empty is sent by a later read.
+#define PUBLISH_POINTS_PER_MIN 20
+#define PUBLISH_BURST          6        // two rounds of all three feeds
+#define PUBLISH_HEARTBEAT_MS   300000UL
+#define PUBLISH_DEADBAND_TEMP  50       // centidegrees: every DHT11 step, not DHT22 jitter
+#define PUBLISH_DEADBAND_HUM   100      // centipercent
+#define PUBLISH_DEADBAND_LIGHT 2        // percent
+
+// ---------------- Logging ----------------
+// Runtime messages are queued as binary records (format id plus arguments)
+// in a RAM ring and sent to Serial while the scheduler idles, so logging
+// never waits on the UART. The text is only in LOG_FORMATS below, which
+// host/logdecode.cpp reads from this file to turn a capture back into text.
+#define LOG_LEVEL_ERROR  1
+#define LOG_LEVEL_WARN   2
+#define LOG_LEVEL_INFO   3
+#define LOG_LEVEL_DEBUG  4
+#ifndef LOG_LEVEL
+#define LOG_LEVEL        LOG_LEVEL_INFO   // records above this level are compiled out
+#endif
+#define LOG_RING_BYTES   1024
+#define LOG_MAX_ARGS     8
+#define LOG_MAX_STRING   23               // longer string arguments are cut
+#define LOG_SYNC         0xA5             // first byte of every record
+#ifndef RECORD_INPUTS
+#define RECORD_INPUTS    0                // 1: also log every raw input, see LOG_REC_* below
+#endif
+
+// Format ids are positions in this table: append only, so older captures
+// still decode. %C is a centi value (2345 = 23.45, LOG_NAN = nan) and %B a
+// bool printed as ON/OFF. The LOG_REC_* rows are the raw inputs that
+// RECORD_INPUTS adds for host/replay.cpp: each DHT reading, each analogRead(),
+// and each MQTT message by feed name.
+#define LOG_FORMATS(X) \
+  X(LOG_DROPPED,         LOG_LEVEL_WARN,  "Log: %u records dropped") \
+  X(LOG_NO_TASK_ROOM,    LOG_LEVEL_ERROR, "Scheduler: no room for %s") \
+  X(LOG_BOOT,            LOG_LEVEL_INFO,  "Boot: %s at %u ms") \
+  X(LOG_WIFI_QUICK,      LOG_LEVEL_INFO,  "WiFi: quick join with cached BSSID/channel/IP") \
+  X(LOG_WIFI_FULL,       LOG_LEVEL_INFO,  "WiFi: full scan and DHCP") \
+  X(LOG_WIFI_CONNECTED,  LOG_LEVEL_INFO,  "WiFi Connected after %u ms (boot +%u ms), IP Address: %s") \
+  X(LOG_WIFI_FALLBACK,   LOG_LEVEL_WARN,  "WiFi: quick join failed, falling back to full scan") \
+  X(LOG_CONFIG_LOADED,   LOG_LEVEL_INFO,  "Config: slot %d loaded in %u us") \
+  X(LOG_CONFIG_DEFAULTS, LOG_LEVEL_INFO,  "Config: defaults (%u us)") \
+  X(LOG_CONFIG_APPLIED,  LOG_LEVEL_INFO,  "Config: applied, saved as #%u") \
+  X(LOG_MODE,            LOG_LEVEL_INFO,  "Mode changed to: %s") \
+  X(LOG_PUMP_ON,         LOG_LEVEL_INFO,  "Pump: ON (Full speed)") \
+  X(LOG_PUMP_OFF,        LOG_LEVEL_INFO,  "Pump: OFF") \
+  X(LOG_LED_ON,          LOG_LEVEL_INFO,  "LED: ON (Full brightness)") \
+  X(LOG_LED_OFF,         LOG_LEVEL_INFO,  "LED: OFF") \
+  X(LOG_SENSORS,         LOG_LEVEL_INFO,  "Temp: %C°C, Hum: %C%%, Light: %d%%, Mode: %s, Suppressed pump: %u/%u, LED: %u/%u") \
+  X(LOG_CONFIG_ACCEPTED, LOG_LEVEL_INFO,  "Config accepted: %s") \
+  X(LOG_CONFIG_REJECTED, LOG_LEVEL_WARN,  "Config rejected: %s") \
+  X(LOG_MQTT_CONNECTED,  LOG_LEVEL_INFO,  "MQTT Connected!") \
+  X(LOG_MQTT_FAILED,     LOG_LEVEL_WARN,  "MQTT connect failed (%d), retrying in 5 seconds") \
+  X(LOG_WAKE,            LOG_LEVEL_INFO,  "Wake %u: %s, wake-to-sleep %u ms, next sleep %u s") \
+  X(LOG_ENERGY,          LOG_LEVEL_INFO,  "Energy/sample: %u mJ awake + %u mJ asleep, average %u uA") \
+  X(LOG_REC_DHT,         LOG_LEVEL_DEBUG, "Input: DHT %C°C %C%%") \
+  X(LOG_REC_ADC,         LOG_LEVEL_DEBUG, "Input: ADC pin %u = %u") \
+  X(LOG_REC_MQTT,        LOG_LEVEL_DEBUG, "Input: MQTT %s = %s")
+
+// ---------------- Tracing ----------------
+// Always-on timeline of begin/end/instant events with micros() timestamps in
+// a fixed ring; a 'T' on Serial dumps it, and
+// host/trace2json.cpp converts the dump for chrome://tracing or Perfetto
+#define TRACE_EVENTS       512    // 8 bytes each, power of two; ~6 s at the
+                                  // ~80 events/s the 10 ms MQTT reads leave
+#define TRACE_MIN_SPAN_US  250    // shorter spans with nothing inside are not kept
+#define CONSOLE_POLL_MS    100    // Serial command check period
+
+// Fixed event names; handler URIs and task names follow them in the dump
+#define TRACE_NAMES(X) \
+  X(TRACE_LOOP,         "loop") \
+  X(TRACE_MQTT_CONNECT, "mqtt connect") \
+  X(TRACE_MQTT_READ,    "mqtt read") \
+  X(TRACE_PUBLISH,      "publish") \
+  X(TRACE_DHT,          "dht read") \
+  X(TRACE_PUMP,         "pump") \
+  X(TRACE_LIGHT,        "light") \
+  X(TRACE_WIFI,         "wifi") \
+  X(TRACE_CONFIG_SAVE,  "config save")
+
 // ---------------- Adafruit IO ----------------
 #define AIO_SERVER      "io.adafruit.com"
 #define AIO_SERVERPORT  1883
@@ -20,7 +163,39 @@ DHT dht(DHTPIN, DHTTYPE);
 
 #define LDR_PIN A0
 #define LIGHT_THRESHOLD 50    // light below 50% → turn ON LED
-#define TEMP_THRESHOLD 30.0   // temperature above 30°C → turn ON pump
+#define TEMP_THRESHOLD 3000   // temperature above 30°C → turn ON pump (centidegrees)
+
+// ---------------- Analog Filtering ----------------
+#define ADC_SAMPLE_INTERVAL_MS  20  // spacing between ADC reads (tight analogRead loops upset WiFi)
+#define ADC_BURST_SAMPLES       8   // reads averaged into one oversampled value
+#define ADC_MEDIAN_N            5   // spike rejection: median of the last 5 burst averages
+#define ADC_EMA_SHIFT           2   // EMA alpha = 1/4, time constant ~4 burst averages
+
+// ---------------- Automatic Mode Tuning ----------------
+#define TEMP_HYSTERESIS   100       // pump turns OFF again only below 29°C
+#define LIGHT_HYSTERESIS  5         // LED turns OFF again only at 55% or above
+#define PUMP_MIN_ON_MS    60000UL   // pump stays ON at least 1 minute
+#define PUMP_MIN_OFF_MS   60000UL   // pump stays OFF at least 1 minute
+#define LIGHT_MIN_ON_MS   30000UL   // LED stays ON at least 30 seconds
+#define LIGHT_MIN_OFF_MS  30000UL   // LED stays OFF at least 30 seconds
+#define PUMP_MAX_SWITCHES_PER_HOUR   12
+#define LIGHT_MAX_SWITCHES_PER_HOUR  12
+
+// ---------------- Runtime Config ----------------
+// TEMP_THRESHOLD, LIGHT_THRESHOLD and the PWM levels below are factory
+// defaults; the live values are in `config`, changeable over the config feed and kept
+// in a flash log of CRC-checked slots (see loadConfig/saveConfig)
+#define PUMP_SPEED_PWM      1000    // pump speed when ON (of 1023)
+#define LED_BRIGHTNESS      1000    // LED brightness when ON (of 1023)
+#define CONFIG_TEMP_MIN     1000    // accepted tempThreshold range, centidegrees
+#define CONFIG_TEMP_MAX     5000    //   (DHT11 measures 0-50°C)
+#define CONFIG_SLOT_COUNT   (SPI_FLASH_SEC_SIZE / sizeof(ConfigSlot))
+
+// The sector the EEPROM library would use; the sketch does not use EEPROM
+#ifndef CONFIG_FLASH_SECTOR
+extern "C" uint32_t _EEPROM_start;
+#define CONFIG_FLASH_SECTOR (((uint32_t)&_EEPROM_start - 0x40200000) / SPI_FLASH_SEC_SIZE)
+#endif
 
 // ---------------- L298N Pins ----------------
 // Pump Motor (Motor A) - Uses PWM for speed control
@@ -41,22 +216,133 @@ Adafruit_MQTT_Client mqtt(&client, AIO_SERVER, AIO_SERVERPORT, AIO_USERNAME, AIO
 Adafruit_MQTT_Subscribe modeFeed        = Adafruit_MQTT_Subscribe(&mqtt, AIO_USERNAME "/feeds/mode");
 Adafruit_MQTT_Subscribe pumpControlFeed = Adafruit_MQTT_Subscribe(&mqtt, AIO_USERNAME "/feeds/pumpControl");
 Adafruit_MQTT_Subscribe lightControlFeed= Adafruit_MQTT_Subscribe(&mqtt, AIO_USERNAME "/feeds/lightControl");
+Adafruit_MQTT_Subscribe configFeed      = Adafruit_MQTT_Subscribe(&mqtt, AIO_USERNAME "/feeds/config");
 
 // Publishes (NodeMCU → App) - ONLY SENSOR DATA
 Adafruit_MQTT_Publish tempPub      = Adafruit_MQTT_Publish(&mqtt, AIO_USERNAME "/feeds/temperature");
 Adafruit_MQTT_Publish humPub       = Adafruit_MQTT_Publish(&mqtt, AIO_USERNAME "/feeds/humidity");
 Adafruit_MQTT_Publish lightPub     = Adafruit_MQTT_Publish(&mqtt, AIO_USERNAME "/feeds/lightPercent");
+Adafruit_MQTT_Publish metricsPub   = Adafruit_MQTT_Publish(&mqtt, AIO_USERNAME "/feeds/metrics");
 
 // ---------------- Variables ----------------
 String mode = "automatic";  // START IN AUTOMATIC MODE
 bool pumpState = false;
 bool lightState = false;
-int pumpSpeedPWM = 1000;    // Pump speed at maximum (1000/1023)
-int ledBrightness = 1000;   // LED brightness at maximum when ON (1000/1023)
+
+unsigned long firstActuationMs = 0; // boot → first control pass
+unsigned long firstPublishMs = 0;   // boot → first MQTT publish
+
+// Sensor reading in centi-units (2345 = 23.45°C or 23.45%).
+// valid=false replaces the NaN the DHT library returns on a failed read.
+struct Reading {
+  int16_t centi;
+  bool valid;
+};
+
+// State carried across deep sleep in RTC memory (low-power mode)
+struct SleepState {
+  uint32_t crc;
+  uint32_t wakeCount;
+  uint32_t intervalS;
+  int16_t lastTemp;
+  int16_t lastHum;
+  uint8_t lastLight;
+  uint8_t lastValid;
+  uint16_t lastAwakeMs;
+};
+
+// Latest sensor values, shared by publishing and automatic mode
+Reading temperature = { 0, false };
+Reading humidity = { 0, false };
+int lightPercent = 0;
+uint32_t sampleIntervalMs = SAMPLE_MIN_MS;   // current time between DHT reads
+uint32_t sampleLastMs = 0;                   // millis() of the last one
+Reading sampleLastTemp = { 0, false };       // and its temperature
+
+// Last value sent on a feed, for the deadband and heartbeat
+struct FeedSent {
+  int32_t value;
+  uint32_t atMs;
+  bool valid;
+};
+
+FeedSent tempSent, humSent, lightSent;
+uint8_t publishTokens = PUBLISH_BURST;
+uint32_t publishRefillMs = 0;    // millis() the next token is counted from
+
+// Duration histogram; recording is one bucket increment, no allocation.
+// buckets[b] counts durations of at most 2^b us, the last one everything longer.
+struct Histogram {
+  uint32_t buckets[METRICS_BUCKETS];
+  uint32_t count;
+  uint64_t sumUs;
+};
+
+Histogram loopHist, mqttPollHist, dhtReadHist;
+uint32_t dhtFailures = 0;       // sensor cycles with a failed temperature or humidity read
+uint32_t mqttReconnects = 0;    // successful connects after the first
+uint32_t mqttConnectFailures = 0;
+uint32_t pumpSwitches = 0;
+uint32_t lightSwitches = 0;
+
+uint32_t idleMs = 0;                // time handed to schedulerIdle()
+
+int8_t mqttTask = -1;
+int8_t sensorTask = -1;
+
+// ---------------- Prototypes ----------------
+// Plain C++ needs these; the Arduino IDE generates them only for .ino files
+void pollMqtt();
+void sampleLdr();
+void pollConsole();
+void readSensors();
+void metricsTask();
+void schedulerIdle(uint32_t ms);
+uint16_t sampleNearness(int32_t distance, int32_t band);
+uint32_t nextSampleInterval();
+void pullSampleIn();
+bool takePublishToken();
+bool publishFeed(Adafruit_MQTT_Publish &pub, FeedSent &sent, int32_t value, int32_t deadband, const char *text);
+void applyAutomaticMode();
+void setPump(bool state);
+void setLight(bool state);
+void MQTT_connect();
+void observe(Histogram &h, uint32_t us);
+uint8_t histogramPercentile(const Histogram &h, uint8_t pct);
+void publishMetrics();
+uint32_t nextSleepInterval(const SleepState &st);
+void runLowPowerCycle();
+bool stageConfigText(const String &text);
+void markBootMilestone(unsigned long &slot, const char *what);
+Reading toReading(float value);
+
+// ---------------- Shared Code ----------------
+// Kept in headers beside the sketches and shared with them. They expand the
+// settings and tables above and call into this sketch, so they are included
+// after its prototypes.
+#include "crc32.h"
+#include "log_ring.h"
+#include "trace_ring.h"
+#include "fixed_point.h"
+#include "analog_filter.h"
+#include "scheduler.h"
+#include "wifi_boot.h"
+#include "switch_guard.h"
+#include "config_log.h"
 
 void setup() {
   Serial.begin(115200);
   dht.begin();
+  loadConfig();
+
+#if LOW_POWER_MODE
+  // Hold the driver enables low; D0 is wired to RST, so it is never driven
+  pinMode(ENA, OUTPUT);
+  pinMode(ENB, OUTPUT);
+  digitalWrite(ENA, LOW);
+  digitalWrite(ENB, LOW);
+  runLowPowerCycle();   // ends in deep sleep, never returns
+#endif
 
   // Initialize all motor control pins
   pinMode(ENA, OUTPUT);
@@ -82,42 +368,47 @@ void setup() {
   Serial.println("OUT3/4: 12V LED Bulb");
   Serial.println("Publishing: Temperature, Humidity, Light% only");
 
-  // Connect to WiFi
-  WiFi.begin(WLAN_SSID, WLAN_PASS);
-  Serial.print("Connecting to WiFi");
-  unsigned long startTime = millis();
-  while (WiFi.status() != WL_CONNECTED && millis() - startTime < 15000) {
-    delay(500);
-    Serial.print(".");
-  }
-  
-  if (WiFi.status() != WL_CONNECTED) {
-    Serial.println("\nFailed to connect to WiFi!");
-  } else {
-    Serial.println("\nWiFi Connected!");
-    Serial.print("IP Address: ");
-    Serial.println(WiFi.localIP());
-  }
+  // Start joining WiFi; control runs right away and wifiPoll() finishes the join
+  wifiBeginFast();
 
   // Subscribe to MQTT feeds
   mqtt.subscribe(&modeFeed);
   mqtt.subscribe(&pumpControlFeed);
   mqtt.subscribe(&lightControlFeed);
+  mqtt.subscribe(&configFeed);
+
+  schedulerBegin();
+  mqttTask = scheduleEvery("mqtt", MQTT_POLL_MS, 0, pollMqtt);
+  scheduleEvery("wifi", WIFI_POLL_MS, 0, wifiPoll);
+  scheduleEvery("adc", ADC_SAMPLE_INTERVAL_MS, 0, sampleLdr);
+  scheduleEvery("console", CONSOLE_POLL_MS, 0, pollConsole);
+  sensorTask = scheduleEvery("sensors", SAMPLE_MIN_MS, 0, readSensors);
+  scheduleEvery("metrics", METRICS_PUBLISH_MS, METRICS_PUBLISH_MS, metricsTask);
 }
 
 void loop() {
-  MQTT_connect();
-  yield();
+  unsigned long loopStartUs = micros();
+  traceBegin(TRACE_LOOP);
+  uint32_t idleForMs = runScheduler();
+  traceEnd(TRACE_LOOP);
+  observe(loopHist, micros() - loopStartUs);
+  schedulerIdle(idleForMs);
+}
 
-  // Handle incoming MQTT messages
+// ---------------- Tasks ----------------
+// Connects when needed, then handles incoming MQTT messages
+void pollMqtt() {
+  MQTT_connect();
+  unsigned long pollStartUs = micros();
+  traceBegin(TRACE_MQTT_READ);
   Adafruit_MQTT_Subscribe *sub;
-  while ((sub = mqtt.readSubscription(100))) {
+  while (mqtt.connected() && (sub = mqtt.readSubscription(MQTT_READ_TIMEOUT_MS))) {
+    RECORD(LOG_REC_MQTT, strrchr(sub->topic, '/') + 1, (const char *)sub->lastread);
     if(sub == &modeFeed) {
       String newMode = String((char *)modeFeed.lastread);
       if (newMode == "automatic" || newMode == "manual") {
         mode = newMode;
-        Serial.print("Mode changed to: ");
-        Serial.println(mode);
+        LOG(LOG_MODE, mode);
         
         // Apply automatic logic immediately when switching to auto mode
         if (mode == "automatic") {
@@ -125,6 +416,13 @@ void loop() {
         }
       }
     }
+
+    // Settings change in any mode; applied at the top of the next pass
+    if(sub == &configFeed) {
+      String text = String((char *)configFeed.lastread);
+      if(stageConfigText(text)) LOG(LOG_CONFIG_ACCEPTED, text);
+      else LOG(LOG_CONFIG_REJECTED, text);
+    }
     
     // Only process manual controls if in manual mode
     if(mode == "manual") {
@@ -138,62 +436,206 @@ void loop() {
       }
     }
   }
+  traceEnd(TRACE_MQTT_READ);
+  observe(mqttPollHist, micros() - pollStartUs);
+}
+
+void sampleLdr() {
+  sampleAnalogChannel(ldrChannel);
+  if(abs(analogChannelPercent(ldrChannel) - lightPercent) >= SAMPLE_LIGHT_WAKE) pullSampleIn();
+}
+
+// Serial commands, one byte each: 'T' dumps the trace ring. The dump goes
+// out in one piece after the queued log records, about 0.3 s at 115200 baud.
+void pollConsole() {
+  while(Serial.available() > 0) {
+    if(Serial.read() == 'T') {
+      logFlush();
+      traceWrite(traceSerialSink);
+    }
+  }
+}
+
+void readSensors() {
+  unsigned long dhtStartUs = micros();
+  traceBegin(TRACE_DHT);
+  temperature = toReading(dht.readTemperature());
+  humidity = toReading(dht.readHumidity());
+  traceEnd(TRACE_DHT);
+  observe(dhtReadHist, micros() - dhtStartUs);
+  if(!temperature.valid || !humidity.valid) dhtFailures++;
+  RECORD(LOG_REC_DHT, temperature.valid ? temperature.centi : LOG_NAN, humidity.valid ? humidity.centi : LOG_NAN);
+  lightPercent = analogChannelPercent(ldrChannel);
+
+  // Sensor data goes out regardless of mode (once MQTT is up), on change
+  if(mqtt.connected()) {
+    char tempText[8], humText[8], lightText[8];
+    bool sent = false;
+    traceBegin(TRACE_PUBLISH);
+    if(temperature.valid) {
+      sent |= publishFeed(tempPub, tempSent, temperature.centi, PUBLISH_DEADBAND_TEMP,
+                          formatCenti(tempText, temperature.centi));
+    }
+    if(humidity.valid) {
+      sent |= publishFeed(humPub, humSent, humidity.centi, PUBLISH_DEADBAND_HUM,
+                          formatCenti(humText, humidity.centi));
+    }
+    snprintf(lightText, sizeof(lightText), "%d", lightPercent);
+    sent |= publishFeed(lightPub, lightSent, lightPercent, PUBLISH_DEADBAND_LIGHT, lightText);
+    if(sent) markBootMilestone(firstPublishMs, "first MQTT publish");
+    traceEnd(TRACE_PUBLISH);
+  }
+
+  LOG(LOG_SENSORS, temperature.valid ? temperature.centi : LOG_NAN, humidity.valid ? humidity.centi : LOG_NAN,
+      lightPercent, mode, pumpGuard.suppressedDwell, pumpGuard.suppressedRate,
+      lightGuard.suppressedDwell, lightGuard.suppressedRate);
+
+  // Apply automatic mode logic
+  if(mode == "automatic"){
+    applyAutomaticMode();
+  }
+  markBootMilestone(firstActuationMs, "first control pass");
 
-  // Read sensors and apply automatic logic every 5 seconds
-  static unsigned long lastSensorTime = 0;
-  if(millis() - lastSensorTime > 5000){
-    lastSensorTime = millis();
+  sampleIntervalMs = nextSampleInterval();
+  setTaskPeriod(sensorTask, sampleIntervalMs);
+}
 
-    float temp = dht.readTemperature();
-    float hum = dht.readHumidity();
-    int ldrRaw = analogRead(LDR_PIN);
-    int lightPercent = map(ldrRaw, 0, 1023, 0, 100);
+void metricsTask() {
+  if(mqtt.connected()) publishMetrics();
+}
 
-    // ALWAYS PUBLISH SENSOR DATA regardless of mode
-    if(!isnan(temp)) tempPub.publish(temp);
-    if(!isnan(hum)) humPub.publish(hum);
-    lightPub.publish(lightPercent);
+// Nothing is due for ms milliseconds: queued log records go to the UART,
+// then delay() hands the CPU to the SDK, which idles it (and lets the modem
+// sleep between beacons) until then.
+void schedulerIdle(uint32_t ms) {
+  logDrain();
+  delay(ms);
+  idleMs += ms;
+}
 
-    Serial.printf("Temp: %.1f°C, Hum: %.1f%%, Light: %d%%", temp, hum, lightPercent);
-    Serial.printf(", Mode: %s\n", mode.c_str());
+// ---------------- Adaptive Sampling ----------------
+// Permille of the way from SAMPLE_MAX_MS down to SAMPLE_MIN_MS for a reading
+// distance away from where it would switch an output: all of it within band,
+// none from twice that
+uint16_t sampleNearness(int32_t distance, int32_t band) {
+  if(distance < 0) distance = -distance;
+  if(distance <= band) return 1000;
+  return distance >= 2 * band ? 0 : 1000 - (distance - band) * 1000 / band;
+}
 
-    // Apply automatic mode logic
-    if(mode == "automatic"){
-      applyAutomaticMode();
+// Time until the next DHT read, from the readings readSensors() has just
+// taken. The switching points are the configured thresholds; outputs driven
+// by uploaded rules only get the rate term.
+uint32_t nextSampleInterval() {
+  uint32_t now = millis();
+  uint16_t urgency = 0;
+  if(!temperature.valid) {
+    urgency = 1000;     // a failed read is retried as soon as the DHT allows
+  } else if(sampleLastTemp.valid) {
+    uint32_t elapsed = now - sampleLastMs;
+    uint32_t rate = (uint32_t)abs(temperature.centi - sampleLastTemp.centi) * 60000 / (elapsed ? elapsed : 1);
+    urgency = rate >= SAMPLE_FAST_RATE ? 1000 : rate * 1000 / SAMPLE_FAST_RATE;
+  }
+  if(mode == "automatic") {
+    uint16_t near;
+    if(temperature.valid) {
+      near = sampleNearness(temperature.centi - (pumpState ? config.tempThreshold - TEMP_HYSTERESIS : config.tempThreshold),
+                            SAMPLE_NEAR_TEMP);
+      if(near > urgency) urgency = near;
     }
+    near = sampleNearness(lightPercent - (lightState ? config.lightThreshold + LIGHT_HYSTERESIS : config.lightThreshold),
+                          SAMPLE_NEAR_LIGHT);
+    if(near > urgency) urgency = near;
+  }
+  sampleLastMs = now;
+  sampleLastTemp = temperature;
+
+  uint32_t interval = SAMPLE_MAX_MS - (uint32_t)(SAMPLE_MAX_MS - SAMPLE_MIN_MS) * urgency / 1000;
+  uint32_t longest = sampleIntervalMs + sampleIntervalMs * SAMPLE_STRETCH_PCT / 100;
+  return interval < longest ? interval : longest;
+}
+
+// Brings the next readSensors() run forward to the earliest the DHT allows;
+// nothing to do once it is due, which it can be in this very pass
+void pullSampleIn() {
+  uint32_t now = millis();
+  uint32_t earliest = sampleLastMs + SAMPLE_MIN_MS;
+  if(sensorTask < 0 || (int32_t)(now - tasks[sensorTask].dueMs) >= 0) return;
+  if((int32_t)(tasks[sensorTask].dueMs - earliest) <= 0) return;
+  int32_t wait = earliest - now;
+  rescheduleTask(sensorTask, wait > 0 ? wait : 0);
+}
+
+// ---------------- Publishing ----------------
+// Takes one point from the rate budget, refilling it for the time since the
+// last call first
+bool takePublishToken() {
+  const uint32_t tokenMs = 60000UL / PUBLISH_POINTS_PER_MIN;
+  uint32_t now = millis();
+  uint32_t earned = (now - publishRefillMs) / tokenMs;
+  if(publishTokens + earned >= PUBLISH_BURST) {
+    publishTokens = PUBLISH_BURST;
+    publishRefillMs = now;      // a full bucket banks nothing
+  } else {
+    publishTokens += earned;
+    publishRefillMs += earned * tokenMs;
   }
+  if(publishTokens == 0) return false;
+  publishTokens--;
+  return true;
+}
+
+// Sends text on pub if value has left the deadband around the last value
+// sent, or the heartbeat is due, and the budget allows. A failed publish
+// still spends its token.
+bool publishFeed(Adafruit_MQTT_Publish &pub, FeedSent &sent, int32_t value, int32_t deadband, const char *text) {
+  bool due = !sent.valid || millis() - sent.atMs >= PUBLISH_HEARTBEAT_MS || abs(value - sent.value) >= deadband;
+  if(!due || !takePublishToken() || !pub.publish(text)) return false;
+  sent.value = value;
+  sent.atMs = millis();
+  sent.valid = true;
+  return true;
 }
 
 // ---------------- Functions ----------------
 void applyAutomaticMode() {
-  float temp = dht.readTemperature();
-  int ldrRaw = analogRead(LDR_PIN);
-  int lightPercent = map(ldrRaw, 0, 1023, 0, 100);
+  bool newPumpState = pumpState;
+  bool newLightState = lightState;
+
+  // Light control - turn ON LED if dark, OFF again only once clearly bright
+  if(lightPercent < config.lightThreshold){ 
+    newLightState = true; 
+  } else if(lightPercent >= config.lightThreshold + LIGHT_HYSTERESIS){ 
+    newLightState = false; 
+  }
 
-  // Light control - turn ON LED if dark
-  if(lightPercent < LIGHT_THRESHOLD){ 
-    setLight(true); 
-  } else { 
-    setLight(false); 
+  // Pump control - turn ON pump if hot, OFF again only once clearly cooler
+  if(temperature.valid && temperature.centi > config.tempThreshold){ 
+    newPumpState = true; 
+  } else if(!temperature.valid || temperature.centi < config.tempThreshold - TEMP_HYSTERESIS){ 
+    newPumpState = false; 
   }
 
-  // Pump control - turn ON pump if hot
-  if(!isnan(temp) && temp > TEMP_THRESHOLD){ 
-    setPump(true); 
-  } else { 
-    setPump(false); 
+  if(newLightState != lightState && guardAllowsSwitch(lightGuard, lightState)){
+    setLight(newLightState);
+  }
+  if(newPumpState != pumpState && guardAllowsSwitch(pumpGuard, pumpState)){
+    setPump(newPumpState);
   }
 }
 
 void setPump(bool state){
   if (pumpState != state) {
     pumpState = state;
+    guardNoteSwitch(pumpGuard);
+    pumpSwitches++;
+    traceInstant(TRACE_PUMP, state);
     if(state){
-      analogWrite(ENA, pumpSpeedPWM); // Pump at full speed
-      Serial.println("Pump: ON (Full speed)");
+      analogWrite(ENA, config.pumpSpeedPWM); // Pump at full speed
+      LOG(LOG_PUMP_ON);
     } else {
       analogWrite(ENA, 0);
-      Serial.println("Pump: OFF");
+      LOG(LOG_PUMP_OFF);
     }
     // NO STATE PUBLISHING
   }
@@ -202,12 +644,15 @@ void setPump(bool state){
 void setLight(bool state){
   if (lightState != state) {
     lightState = state;
+    guardNoteSwitch(lightGuard);
+    lightSwitches++;
+    traceInstant(TRACE_LIGHT, state);
     if(state){
-      analogWrite(ENB, ledBrightness); // LED at full brightness
-      Serial.println("LED: ON (Full brightness)");
+      analogWrite(ENB, config.ledBrightness); // LED at full brightness
+      LOG(LOG_LED_ON);
     } else {
       analogWrite(ENB, 0);
-      Serial.println("LED: OFF");
+      LOG(LOG_LED_OFF);
     }
     // NO STATE PUBLISHING
   }
@@ -216,13 +661,192 @@ void setLight(bool state){
 void MQTT_connect() {
   int8_t ret;
   if(mqtt.connected()) return;
-  
-  Serial.print("Connecting to MQTT... ");
-  while((ret = mqtt.connect()) != 0){
-    Serial.println(mqtt.connectErrorString(ret));
-    Serial.println("Retrying in 5 seconds...");
+  if(WiFi.status() != WL_CONNECTED) return;
+
+  traceBegin(TRACE_MQTT_CONNECT);
+  ret = mqtt.connect();
+  traceEnd(TRACE_MQTT_CONNECT);
+  if(ret != 0){
+    mqttConnectFailures++;
+    LOG(LOG_MQTT_FAILED, ret);
     mqtt.disconnect();
-    delay(5000);
+    // Back off without blocking the control loop
+    rescheduleTask(mqttTask, MQTT_RETRY_MS);
+    return;
   }
-  Serial.println("MQTT Connected!");
-}
\ No newline at end of file
+  LOG(LOG_MQTT_CONNECTED);
+  static bool everConnected = false;
+  if(everConnected) mqttReconnects++;
+  everConnected = true;
+}
+
+// ---------------- Metrics ----------------
+void observe(Histogram &h, uint32_t us) {
+  uint8_t b = us <= 1 ? 0 : 32 - __builtin_clz(us - 1);
+  if(b >= METRICS_BUCKETS) b = METRICS_BUCKETS - 1;
+  h.buckets[b]++;
+  h.count++;
+  h.sumUs += us;
+}
+
+// Bucket index of the pct-th percentile: b means at most 2^b us,
+// METRICS_BUCKETS - 1 means longer than every finite bucket
+uint8_t histogramPercentile(const Histogram &h, uint8_t pct) {
+  uint32_t rank = ((uint64_t)h.count * pct + 99) / 100;
+  uint32_t cumulative = 0;
+  for(uint8_t b = 0; b + 1 < METRICS_BUCKETS; b++) {
+    cumulative += h.buckets[b];
+    if(cumulative >= rank) return b;
+  }
+  return METRICS_BUCKETS - 1;
+}
+
+// One CSV record on the metrics feed. Fields: format version (2), uptime s,
+// loop passes, loop p50 and p99, mean loop us, MQTT poll p99, DHT read p50,
+// DHT failures, MQTT reconnects, MQTT connect failures, pump and LED switches,
+// free heap, largest free block, task deadline misses, worst task jitter us.
+// Percentiles are histogramPercentile() bucket indexes, which keeps the record
+// inside the library's 150-byte packet buffer.
+// Histograms restart after each record; the counters run since boot.
+void publishMetrics() {
+  uint32_t misses = 0, jitterMaxUs = 0;
+  for(int8_t id = 0; id < SCHED_MAX_TASKS; id++) {
+    if(!tasks[id].active) continue;
+    misses += tasks[id].misses;
+    if(tasks[id].jitterMaxUs > jitterMaxUs) jitterMaxUs = tasks[id].jitterMaxUs;
+  }
+
+  char record[160];
+  snprintf(record, sizeof(record), "2,%lu,%lu,%u,%u,%lu,%u,%u,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu",
+           millis() / 1000, (unsigned long)loopHist.count,
+           histogramPercentile(loopHist, 50), histogramPercentile(loopHist, 99),
+           (unsigned long)(loopHist.count ? loopHist.sumUs / loopHist.count : 0),
+           histogramPercentile(mqttPollHist, 99), histogramPercentile(dhtReadHist, 50),
+           (unsigned long)dhtFailures, (unsigned long)mqttReconnects, (unsigned long)mqttConnectFailures,
+           (unsigned long)pumpSwitches, (unsigned long)lightSwitches,
+           (unsigned long)ESP.getFreeHeap(), (unsigned long)ESP.getMaxFreeBlockSize(),
+           (unsigned long)misses, (unsigned long)jitterMaxUs);
+  traceBegin(TRACE_PUBLISH);
+  metricsPub.publish(record);
+  traceEnd(TRACE_PUBLISH);
+  memset(&loopHist, 0, sizeof(loopHist));
+  memset(&mqttPollHist, 0, sizeof(mqttPollHist));
+  memset(&dhtReadHist, 0, sizeof(dhtReadHist));
+}
+
+// ---------------- Low-Power Mode ----------------
+#if LOW_POWER_MODE
+// Next sleep length: aim for one *_STEP of change per sample on the fastest
+// moving input, changing by at most 2x per wake and clamped to the bounds
+uint32_t nextSleepInterval(const SleepState &st) {
+  uint32_t interval = st.intervalS;
+  if(!(st.lastValid && temperature.valid && humidity.valid)) return SLEEP_MIN_S;
+
+  uint32_t target = interval * 2;
+  uint32_t dTemp = abs(temperature.centi - st.lastTemp);
+  uint32_t dHum = abs(humidity.centi - st.lastHum);
+  uint32_t dLight = abs(lightPercent - st.lastLight);
+  if(dTemp > 0) target = min(target, interval * SLEEP_TEMP_STEP / dTemp);
+  if(dHum > 0) target = min(target, interval * SLEEP_HUM_STEP / dHum);
+  if(dLight > 0) target = min(target, interval * SLEEP_LIGHT_STEP / dLight);
+
+  target = max(target, interval / 2);
+  return constrain(target, (uint32_t)SLEEP_MIN_S, (uint32_t)SLEEP_MAX_S);
+}
+
+void runLowPowerCycle() {
+  SleepState st;
+  ESP.rtcUserMemoryRead(SLEEP_STATE_RTC_BLOCK, (uint32_t *)&st, sizeof(st));
+  if(st.crc != crc32((const uint8_t *)&st + sizeof(st.crc), sizeof(st) - sizeof(st.crc))) {
+    memset(&st, 0, sizeof(st));
+    st.intervalS = SLEEP_MIN_S;
+  }
+  st.wakeCount++;
+
+  // Radio joins while the DHT settles; the LDR filter fills in the meantime
+  wifiBeginFast();
+  while(millis() < DHT_POWERUP_MS) {
+    wifiPoll();
+    sampleAnalogChannel(ldrChannel);
+    delay(ADC_SAMPLE_INTERVAL_MS);
+  }
+  temperature = toReading(dht.readTemperature());
+  humidity = toReading(dht.readHumidity());
+  lightPercent = analogChannelPercent(ldrChannel);
+
+  // Publish all feeds in one connection burst
+  bool published = false;
+  while(WiFi.status() != WL_CONNECTED && millis() < LOW_POWER_CONNECT_MS) {
+    wifiPoll();
+    delay(10);
+  }
+  wifiPoll();
+  if(WiFi.status() == WL_CONNECTED && mqtt.connect() == 0) {
+    char tempText[8], humText[8];
+    if(temperature.valid) tempPub.publish(formatCenti(tempText, temperature.centi));
+    if(humidity.valid) humPub.publish(formatCenti(humText, humidity.centi));
+    published = lightPub.publish((int32_t)lightPercent);
+    mqtt.disconnect();
+  }
+
+  uint32_t nextS = nextSleepInterval(st);
+  unsigned long awakeMs = millis();
+  st.intervalS = nextS;
+  st.lastTemp = temperature.centi;
+  st.lastHum = humidity.centi;
+  st.lastLight = lightPercent;
+  st.lastValid = temperature.valid && humidity.valid;
+  st.lastAwakeMs = awakeMs > 65535 ? 65535 : awakeMs;
+  st.crc = crc32((const uint8_t *)&st + sizeof(st.crc), sizeof(st) - sizeof(st.crc));
+  ESP.rtcUserMemoryWrite(SLEEP_STATE_RTC_BLOCK, (uint32_t *)&st, sizeof(st));
+
+  // Energy per sample: awake burst plus the sleep that follows it
+  uint64_t awakeUj = (uint64_t)ENERGY_AWAKE_MA * ENERGY_SUPPLY_MV * awakeMs / 1000;
+  uint64_t sleepUj = (uint64_t)ENERGY_SLEEP_UA * ENERGY_SUPPLY_MV * nextS / 1000;
+  uint32_t avgUa = ((uint64_t)ENERGY_AWAKE_MA * 1000 * awakeMs + (uint64_t)ENERGY_SLEEP_UA * nextS * 1000) /
+                   (awakeMs + nextS * 1000);
+  LOG(LOG_WAKE, st.wakeCount, published ? "published" : "publish failed", awakeMs, nextS);
+  LOG(LOG_ENERGY, awakeUj / 1000, sleepUj / 1000, avgUa);
+
+  logFlush();
+  ESP.deepSleep((uint64_t)nextS * 1000000ULL, WAKE_RF_DEFAULT);
+}
+#endif
+
+// ---------------- Runtime Config ----------------
+// Config feed message: "name=value" pairs separated by commas,
+// e.g. "tempThreshold=31,lightThreshold=40". All or nothing.
+bool stageConfigText(const String &text) {
+  Config c = configPending ? pendingConfig : config;
+  int start = 0;
+  while(start < (int)text.length()) {
+    int end = text.indexOf(',', start);
+    if(end < 0) end = text.length();
+    String item = text.substring(start, end);
+    int eq = item.indexOf('=');
+    if(eq < 0 || !setConfigValue(c, std::string_view(item.c_str(), eq), item.c_str() + eq + 1)) return false;
+    start = end + 1;
+  }
+  if(!validConfig(c)) return false;
+  if(!configPending) scheduleOnce("config", 0, applyPendingConfig);
+  pendingConfig = c;
+  configPending = true;
+  return true;
+}
+
+// ---------------- Boot Milestones ----------------
+// Records boot → milestone time once, for time-to-first-actuation/publish
+void markBootMilestone(unsigned long &slot, const char *what) {
+  if(slot != 0) return;
+  slot = millis();
+  LOG(LOG_BOOT, what, slot);
+}
+
+// ---------------- Fixed-Point Helpers ----------------
+// The DHT library only reports float; convert once here and stay integer after
+Reading toReading(float value) {
+  Reading r;
+  r.valid = !isnan(value);
+  r.centi = r.valid ? (int16_t)lroundf(value * 100) : 0;
+  return r;
+}
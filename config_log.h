@@ -0,0 +1,154 @@
+// Runtime config: the settings record, its flash log of CRC-checked slots,
+// parsing from "name=value" arguments, and the swap-in between tasks. The
+// factory defaults and ranges are the sketch's "Runtime Config" settings;
+// needs crc32.h, fixed_point.h, log_ring.h and trace_ring.h first.
+#pragma once
+
+#include <string_view>
+
+// Tunable settings, swapped in as a whole by applyPendingConfig()
+struct Config {
+  int16_t tempThreshold;    // centidegrees
+  uint8_t lightThreshold;   // percent
+  uint8_t reserved;
+  uint16_t pumpSpeedPWM;
+  uint16_t ledBrightness;
+};
+
+// One entry of the config log. Erased flash reads 0xFF, so seq 0xFFFFFFFF
+// marks a free slot; slots are written in order, newest last.
+struct ConfigSlot {
+  uint32_t seq;
+  Config config;
+  uint32_t crc;   // over seq and config
+};
+
+Config config = { TEMP_THRESHOLD, LIGHT_THRESHOLD, 0, PUMP_SPEED_PWM, LED_BRIGHTNESS };
+Config pendingConfig;
+bool configPending = false;
+uint32_t configSeq = 0;        // seq of the newest slot
+uint16_t configNextSlot = 0;   // first free slot in the sector
+
+// ---------------- Prototypes ----------------
+// Plain C++ needs these; the Arduino IDE generates them only for .ino files
+uint32_t configSlotAddress(uint16_t slot);
+uint32_t configSlotCrc(const ConfigSlot &s);
+bool configSlotUsed(uint16_t slot);
+bool validConfig(const Config &c);
+void loadConfig();
+void saveConfig();
+bool setConfigValue(Config &c, std::string_view name, const char *value);
+void applyPendingConfig();
+String configJson(const Config &c);
+
+// ---------------- Runtime Config ----------------
+uint32_t configSlotAddress(uint16_t slot) {
+  return CONFIG_FLASH_SECTOR * SPI_FLASH_SEC_SIZE + slot * sizeof(ConfigSlot);
+}
+
+uint32_t configSlotCrc(const ConfigSlot &s) {
+  return crc32((const uint8_t *)&s, offsetof(ConfigSlot, crc));
+}
+
+bool configSlotUsed(uint16_t slot) {
+  uint32_t seq = 0xFFFFFFFF;
+  ESP.flashRead(configSlotAddress(slot), &seq, sizeof(seq));
+  return seq != 0xFFFFFFFF;
+}
+
+bool validConfig(const Config &c) {
+  return c.tempThreshold >= CONFIG_TEMP_MIN && c.tempThreshold <= CONFIG_TEMP_MAX &&
+         c.lightThreshold + LIGHT_HYSTERESIS <= 100 &&
+         c.pumpSpeedPWM <= 1023 && c.ledBrightness <= 1023;
+}
+
+// Slots fill in order, so a binary search finds the end of the log in 8
+// four-byte reads instead of a sector scan. A write torn by a reset fails
+// its CRC and the slot before it is used instead.
+void loadConfig() {
+  unsigned long start = micros();
+  uint16_t lo = 0, hi = CONFIG_SLOT_COUNT;
+  while(lo < hi) {
+    uint16_t mid = (lo + hi) / 2;
+    if(configSlotUsed(mid)) lo = mid + 1;
+    else hi = mid;
+  }
+  configNextSlot = lo;
+
+  ConfigSlot s;
+  for(int slot = (int)lo - 1; slot >= 0; slot--) {
+    ESP.flashRead(configSlotAddress(slot), (uint32_t *)&s, sizeof(s));
+    if(s.crc == configSlotCrc(s) && validConfig(s.config)) {
+      config = s.config;
+      configSeq = s.seq;
+      LOG(LOG_CONFIG_LOADED, slot, micros() - start);
+      return;
+    }
+  }
+  // Nothing valid: the sector may hold someone else's data, so erase it
+  // before the first save rather than writing over it
+  if(lo > 0) configNextSlot = CONFIG_SLOT_COUNT;
+  LOG(LOG_CONFIG_DEFAULTS, micros() - start);
+}
+
+// Appends one slot; the sector is erased only once every CONFIG_SLOT_COUNT saves
+void saveConfig() {
+  traceBegin(TRACE_CONFIG_SAVE);
+  if(configNextSlot >= CONFIG_SLOT_COUNT) {
+    ESP.flashEraseSector(CONFIG_FLASH_SECTOR);
+    configNextSlot = 0;
+  }
+  ConfigSlot s;
+  s.seq = ++configSeq;
+  s.config = config;
+  s.crc = configSlotCrc(s);
+  ESP.flashWrite(configSlotAddress(configNextSlot), (uint32_t *)&s, sizeof(s));
+  configNextSlot++;
+  traceEnd(TRACE_CONFIG_SAVE);
+}
+
+// Sets one named value in c; false for unknown names or malformed values
+bool setConfigValue(Config &c, std::string_view name, const char *value) {
+  long v;
+  if(name == "tempThreshold") {
+    int16_t centi;
+    if(!parseCenti(value, centi)) return false;
+    c.tempThreshold = centi;
+  } else if(name == "lightThreshold") {
+    if(!parseUnsigned(value, 100, v)) return false;
+    c.lightThreshold = v;
+  } else if(name == "pumpSpeedPWM") {
+    if(!parseUnsigned(value, 1023, v)) return false;
+    c.pumpSpeedPWM = v;
+  } else if(name == "ledBrightness") {
+    if(!parseUnsigned(value, 1023, v)) return false;
+    c.ledBrightness = v;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+// One-shot task queued when settings are staged: each task sees either the
+// old or the new settings, never a mix. Running actuators pick up their new
+// PWM level right away.
+void applyPendingConfig() {
+  if(!configPending) return;
+  configPending = false;
+  config = pendingConfig;
+  if(pumpState) analogWrite(ENA, config.pumpSpeedPWM);
+  if(lightState) analogWrite(ENB, config.ledBrightness);
+  saveConfig();
+  LOG(LOG_CONFIG_APPLIED, configSeq);
+}
+
+String configJson(const Config &c) {
+  char tempText[8];
+  String json = "{";
+  json += "\"tempThreshold\":" + String(formatCenti(tempText, c.tempThreshold)) + ",";
+  json += "\"lightThreshold\":" + String(c.lightThreshold) + ",";
+  json += "\"pumpSpeedPWM\":" + String(c.pumpSpeedPWM) + ",";
+  json += "\"ledBrightness\":" + String(c.ledBrightness);
+  json += "}";
+  return json;
+}
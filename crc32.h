@@ -0,0 +1,19 @@
+// CRC-32 (IEEE, as zlib), bitwise without a table. Guards the WiFi cache in
+// RTC memory and the config and rules logs in flash, and makes ETags.
+#pragma once
+
+// ---------------- Prototypes ----------------
+// Plain C++ needs these; the Arduino IDE generates them only for .ino files
+uint32_t crc32(const uint8_t *data, size_t len);
+
+// ---------------- CRC-32 ----------------
+uint32_t crc32(const uint8_t *data, size_t len) {
+  uint32_t crc = 0xFFFFFFFF;
+  while(len--) {
+    crc ^= *data++;
+    for(uint8_t i = 0; i < 8; i++) {
+      crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+    }
+  }
+  return ~crc;
+}
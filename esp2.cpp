@@ -1,10 +1,14 @@
 #include <ESP8266WiFi.h>
 #include <WiFiClient.h>
-#include <ESP8266WebServer.h>
+#include <string_view>
 
 // WiFi credentials
-const char* ssid = "YourWiFiSSID";
-const char* password = "YourWiFiPassword";
+#define WLAN_SSID "YourWiFiSSID"
+#define WLAN_PASS "YourWiFiPassword"
+
+// Fast WiFi boot
+#define WIFI_QUICK_TIMEOUT_MS  5000   // give up on the cached BSSID/channel/IP after 5 s
+#define WIFI_CACHE_RTC_BLOCK   0      // RTC user memory offset (4-byte blocks)
 
 // Motor control pins
 #define IN1 D1  // Right motor forward
@@ -17,7 +21,43 @@ const char* password = "YourWiFiPassword";
 // Motor speed (0-255)
 int motorSpeed = 200;
 
-ESP8266WebServer server(80);
+// Web server. The request line is parsed in place in one fixed buffer, the
+// route is found through a perfect hash computed at compile time, and
+// handlers read arguments as string views into that buffer, so serving a
+// request allocates nothing. A body is read into the same buffer after the head;
+// form fields in it are arguments too. One that does not fit is refused with
+// 413 and the connection closed.
+#define HTTP_PORT              80
+#define HTTP_REQUEST_BYTES    512   // request line, the headers that fit and the body
+#define HTTP_MAX_ARGS         4     // query arguments beyond this are ignored
+#define HTTP_READ_TIMEOUT_MS  2000  // the request head and body must arrive within this
+#define HTTP_HEAD_BYTES       160   // response head; a body that fits after it goes out in the same write
+#define HTTP_ROUTE_SLOTS      16    // perfect-hash table size, power of two
+#define HTTP_MAX_CONNS        4     // open connections, kept-alive ones included
+#define HTTP_IDLE_TIMEOUT_MS  5000  // a kept-alive connection with no new request is closed after this
+
+// The web server gets a bounded share of the CPU. Once it has used
+// HTTP_WINDOW_BUDGET_US of the current HTTP_WINDOW_MS, LOAD_SHED requests are
+// answered 503 with Retry-After until the window turns; the driving commands
+// are LOAD_KEEP and always served, so a burst of page loads cannot hold up a stop.
+#define HTTP_WINDOW_MS        1000
+#define HTTP_WINDOW_BUDGET_US 300000  // 30% of the CPU
+#define HTTP_RETRY_AFTER_S    1
+
+// Path, method, load class, handler
+#define HTTP_ROUTES(X) \
+    X("/",         METHOD_GET, LOAD_SHED, handleRoot) \
+    X("/forward",  METHOD_GET, LOAD_KEEP, handleForward) \
+    X("/backward", METHOD_GET, LOAD_KEEP, handleBackward) \
+    X("/left",     METHOD_GET, LOAD_KEEP, handleLeft) \
+    X("/right",    METHOD_GET, LOAD_KEEP, handleRight) \
+    X("/stop",     METHOD_GET, LOAD_KEEP, handleStop) \
+    X("/speed",    METHOD_GET, LOAD_KEEP, handleSpeed)
+
+#define ROUTE_ONE(path, method, load, fn) + 1
+#define HTTP_ROUTE_COUNT (0 HTTP_ROUTES(ROUTE_ONE))
+
+bool httpShedReported = false;      // this window's shedding is on Serial
 
 // HTML page for car control
 const char* htmlPage = R"rawliteral(
@@ -112,6 +152,29 @@ const char* htmlPage = R"rawliteral(
 </html>
 )rawliteral";
 
+// ---------------- Prototypes ----------------
+// Plain C++ needs these; the Arduino IDE generates them only for .ino files
+void handleRoot();
+void handleForward();
+void handleBackward();
+void handleLeft();
+void handleRight();
+void handleStop();
+void handleSpeed();
+void pollHttp();
+void moveForward();
+void moveBackward();
+void turnLeft();
+void turnRight();
+void stopMotors();
+
+// Fast WiFi boot and the web server, shared with esp1.cpp and esp3.cpp. They
+// expand the settings and HTTP_ROUTES above and call the handlers, so they
+// come after the prototypes.
+#include "crc32.h"
+#include "wifi_boot.h"
+#include "http_server.h"
+
 void setup() {
     Serial.begin(115200);
     
@@ -126,77 +189,81 @@ void setup() {
     // Stop motors initially
     stopMotors();
     
-    // Connect to WiFi
-    WiFi.begin(ssid, password);
-    Serial.print("Connecting to WiFi");
+    // Start joining WiFi; the motors are already safe and wifiPoll() finishes the join
+    wifiBeginFast();
     
-    while (WiFi.status() != WL_CONNECTED) {
-        delay(500);
-        Serial.print(".");
-    }
-    
-    Serial.println("");
-    Serial.println("WiFi connected");
-    Serial.print("IP address: ");
-    Serial.println(WiFi.localIP());
-    
-    // Define server routes
-    server.on("/", HTTP_GET, handleRoot);
-    server.on("/forward", HTTP_GET, handleForward);
-    server.on("/backward", HTTP_GET, handleBackward);
-    server.on("/left", HTTP_GET, handleLeft);
-    server.on("/right", HTTP_GET, handleRight);
-    server.on("/stop", HTTP_GET, handleStop);
-    server.on("/speed", HTTP_GET, handleSpeed);
-    
-    // Start server
+    // Start server; the routes are in HTTP_ROUTES
     server.begin();
+    server.setNoDelay(true);
     Serial.println("HTTP server started");
 }
 
 void loop() {
-    server.handleClient();
+    wifiPoll();
+    pollHttp();
 }
 
 void handleRoot() {
     String page = htmlPage;
     page.replace("%SPEED%", String(map(motorSpeed, 0, 255, 0, 100)));
     page.replace("%IPADDRESS%", WiFi.localIP().toString());
-    server.send(200, "text/html", page);
+    httpSend(200, "text/html", page);
 }
 
 void handleForward() {
     moveForward();
-    server.send(200, "text/plain", "Moving Forward");
+    httpSend(200, "text/plain", "Moving Forward");
 }
 
 void handleBackward() {
     moveBackward();
-    server.send(200, "text/plain", "Moving Backward");
+    httpSend(200, "text/plain", "Moving Backward");
 }
 
 void handleLeft() {
     turnLeft();
-    server.send(200, "text/plain", "Turning Left");
+    httpSend(200, "text/plain", "Turning Left");
 }
 
 void handleRight() {
     turnRight();
-    server.send(200, "text/plain", "Turning Right");
+    httpSend(200, "text/plain", "Turning Right");
 }
 
 void handleStop() {
     stopMotors();
-    server.send(200, "text/plain", "Stopped");
+    httpSend(200, "text/plain", "Stopped");
 }
 
 void handleSpeed() {
-    if (server.hasArg("value")) {
-        int speedPercent = server.arg("value").toInt();
+    if (httpHasArg("value")) {
+        int speedPercent = httpArgInt("value");
         motorSpeed = map(speedPercent, 0, 100, 0, 255);
         analogWrite(ENA, motorSpeed);
         analogWrite(ENB, motorSpeed);
-        server.send(200, "text/plain", "Speed set to " + String(speedPercent) + "%");
+        char text[32];
+        snprintf(text, sizeof(text), "Speed set to %d%%", speedPercent);
+        httpSend(200, "text/plain", text);
+    } else {
+        httpSend(400, "text/plain", "Missing value");
+    }
+}
+
+// Runs the web server once, timed against the HTTP budget window; shedding
+// is reported on Serial once per window
+void pollHttp() {
+    if(millis() - httpWindowStart >= HTTP_WINDOW_MS) {
+        httpWindowStart = millis();
+        httpWindowUsedUs = 0;
+        httpShedReported = false;
+    }
+    uint32_t shed = httpShed;
+    unsigned long startUs = micros();
+    httpHandleClient();
+    httpWindowUsedUs += micros() - startUs;
+    if(httpShed != shed && !httpShedReported) {
+        Serial.printf("HTTP: over budget, %lu requests shed since boot\n", (unsigned long)httpShed);
+        httpShedReported = true;
     }
 }
 
@@ -1,11 +1,16 @@
 #include <ESP8266WiFi.h>
-#include <ESP8266WebServer.h>
 #include "DHT.h"
 
+#include <string_view>
+
 // ---------------- WiFi ----------------
 #define WLAN_SSID       "YOUR_WIFI_SSID"
 #define WLAN_PASS       "YOUR_WIFI_PASSWORD"
 
+// ---------------- Fast WiFi Boot ----------------
+#define WIFI_QUICK_TIMEOUT_MS  5000   // give up on the cached BSSID/channel/IP after 5 s
+#define WIFI_CACHE_RTC_BLOCK   0      // RTC user memory offset (4-byte blocks)
+
 // ---------------- Sensors ----------------
 #define DHTPIN D1        // GPIO5
 #define DHTTYPE DHT11
@@ -13,7 +18,180 @@ DHT dht(DHTPIN, DHTTYPE);
 
 #define LDR_PIN A0
 #define LIGHT_THRESHOLD 50    // light below 50% → turn ON LED
-#define TEMP_THRESHOLD 32.0   // temperature above 32°C → turn ON pump
+#define TEMP_THRESHOLD 3200   // temperature above 32°C → turn ON pump (centidegrees)
+
+// ---------------- Analog Filtering ----------------
+#define ADC_SAMPLE_INTERVAL_MS  20  // spacing between ADC reads (tight analogRead loops upset WiFi)
+#define ADC_BURST_SAMPLES       8   // reads averaged into one oversampled value
+#define ADC_MEDIAN_N            5   // spike rejection: median of the last 5 burst averages
+#define ADC_EMA_SHIFT           2   // EMA alpha = 1/4, time constant ~4 burst averages
+
+// ---------------- Automatic Mode Tuning ----------------
+#define TEMP_HYSTERESIS   100       // pump turns OFF again only below 31°C
+#define LIGHT_HYSTERESIS  5         // LED turns OFF again only at 55% or above
+#define PUMP_MIN_ON_MS    60000UL   // pump stays ON at least 1 minute
+#define PUMP_MIN_OFF_MS   60000UL   // pump stays OFF at least 1 minute
+#define LIGHT_MIN_ON_MS   30000UL   // LED stays ON at least 30 seconds
+#define LIGHT_MIN_OFF_MS  30000UL   // LED stays OFF at least 30 seconds
+#define PUMP_MAX_SWITCHES_PER_HOUR   12
+#define LIGHT_MAX_SWITCHES_PER_HOUR  12
+
+// ---------------- Versioned State ----------------
+#define LONG_POLL_MAX_CLIENTS  4    // held /getSensorData?since=N&wait=S requests
+#define LONG_POLL_MAX_WAIT_S   25   // stay below typical browser/proxy idle timeouts
+#define CONTROL_KEYS_KEPT      8    // idempotency keys of the last applied /control requests
+
+// ---------------- Metrics ----------------
+#define METRICS_BUCKETS       20    // log2 histogram: le=1,2,4..262144 us, then +Inf
+
+// ---------------- Scheduler ----------------
+#define SCHED_MAX_TASKS     8       // periodic tasks plus room for one-shots
+#define SCHED_WHEEL_SLOTS   64      // 1 ms slots, power of two
+#define SCHED_LATE_MS       20      // a run starting later than this missed its deadline
+#define SCHED_MAX_IDLE_MS   50      // longest single idle sleep
+#define SCHED_JITTER_SUM    1       // for the mean jitter in /metrics
+#define HTTP_POLL_MS        5       // handleClient() period while idle
+#define HTTP_MAX_PER_POLL   8       // requests served back to back in one run
+#define WIFI_POLL_MS        100
+
+// ---------------- Loop Budgets ----------------
+// HTTP gets bounded time so that sensor reads and actuator updates keep their
+// schedule through a burst of requests. A pollHttp() run stops after
+// HTTP_PASS_BUDGET_US, or as soon as another task is due, and leaves the rest
+// for the next pass. Once HTTP has used HTTP_WINDOW_BUDGET_US of the current
+// HTTP_WINDOW_MS, requests for LOAD_SHED routes are answered 503 with
+// Retry-After until the window turns.
+#define HTTP_PASS_BUDGET_US    4000     // well inside SCHED_LATE_MS
+#define HTTP_WINDOW_MS         1000
+#define HTTP_WINDOW_BUDGET_US  300000   // 30% of the CPU
+#define HTTP_RETRY_AFTER_S     1
+
+// ---------------- Adaptive Sampling ----------------
+// readSensors() picks the time to its next run from what it has just read:
+// SAMPLE_MIN_MS while the temperature moves fast, or temperature or light sit
+// near the point where automatic mode would switch, up to SAMPLE_MAX_MS while
+// they are flat and far from it. A shorter interval applies at once; a longer
+// one grows by at most SAMPLE_STRETCH_PCT per read. The LDR is filtered every
+// ADC_SAMPLE_INTERVAL_MS anyway, so a light change of SAMPLE_LIGHT_WAKE pulls
+// the next read in rather than waiting out a long interval.
+#define SAMPLE_MIN_MS          2000     // DHT11: the library returns its cached reading inside 2 s
+#define SAMPLE_MAX_MS          30000
+#define SAMPLE_STRETCH_PCT     50
+#define SAMPLE_FAST_RATE       100      // centidegrees per minute that call for SAMPLE_MIN_MS
+#define SAMPLE_NEAR_TEMP       100      // centidegrees from the switching point (one DHT11 step)
+#define SAMPLE_NEAR_LIGHT      5        // percent from the switching point
+#define SAMPLE_LIGHT_WAKE      5        // percent
+
+// ---------------- Logging ----------------
+// Runtime messages are queued as binary records (format id plus arguments)
+// in a RAM ring and sent to Serial while the scheduler idles, so logging
+// never waits on the UART. The text is only in LOG_FORMATS below, which
+// host/logdecode.cpp reads from this file to turn a capture back into text.
+#define LOG_LEVEL_ERROR  1
+#define LOG_LEVEL_WARN   2
+#define LOG_LEVEL_INFO   3
+#define LOG_LEVEL_DEBUG  4
+#ifndef LOG_LEVEL
+#define LOG_LEVEL        LOG_LEVEL_INFO   // records above this level are compiled out
+#endif
+#define LOG_RING_BYTES   1024
+#define LOG_MAX_ARGS     8
+#define LOG_MAX_STRING   23               // longer string arguments are cut
+#define LOG_SYNC         0xA5             // first byte of every record
+#ifndef RECORD_INPUTS
+#define RECORD_INPUTS    0                // 1: also log every raw input, see LOG_REC_* below
+#endif
+
+// Format ids are positions in this table: append only, so older captures
+// still decode. %C is a centi value (2345 = 23.45, LOG_NAN = nan) and %B a
+// bool printed as ON/OFF. The LOG_REC_* rows are the raw inputs that
+// RECORD_INPUTS adds for host/replay.cpp: each DHT reading, each analogRead(),
+// and each HTTP request (its arguments, then method and URI).
+#define LOG_FORMATS(X) \
+  X(LOG_DROPPED,         LOG_LEVEL_WARN,  "Log: %u records dropped") \
+  X(LOG_NO_TASK_ROOM,    LOG_LEVEL_ERROR, "Scheduler: no room for %s") \
+  X(LOG_BOOT,            LOG_LEVEL_INFO,  "Boot: %s at %u ms") \
+  X(LOG_WIFI_QUICK,      LOG_LEVEL_INFO,  "WiFi: quick join with cached BSSID/channel/IP") \
+  X(LOG_WIFI_FULL,       LOG_LEVEL_INFO,  "WiFi: full scan and DHCP") \
+  X(LOG_WIFI_CONNECTED,  LOG_LEVEL_INFO,  "WiFi Connected after %u ms (boot +%u ms), IP Address: %s") \
+  X(LOG_WIFI_FALLBACK,   LOG_LEVEL_WARN,  "WiFi: quick join failed, falling back to full scan") \
+  X(LOG_CONFIG_LOADED,   LOG_LEVEL_INFO,  "Config: slot %d loaded in %u us") \
+  X(LOG_CONFIG_DEFAULTS, LOG_LEVEL_INFO,  "Config: defaults (%u us)") \
+  X(LOG_CONFIG_APPLIED,  LOG_LEVEL_INFO,  "Config: applied, saved as #%u") \
+  X(LOG_MODE,            LOG_LEVEL_INFO,  "Mode changed to: %s") \
+  X(LOG_PUMP_ON,         LOG_LEVEL_INFO,  "Pump: ON (Full speed)") \
+  X(LOG_PUMP_OFF,        LOG_LEVEL_INFO,  "Pump: OFF") \
+  X(LOG_LED_ON,          LOG_LEVEL_INFO,  "LED: ON (Full brightness)") \
+  X(LOG_LED_OFF,         LOG_LEVEL_INFO,  "LED: OFF") \
+  X(LOG_SENSORS,         LOG_LEVEL_INFO,  "Temp: %C°C, Hum: %C%%, Light: %d%%, Mode: %s, Pump: %B, LED: %B") \
+  X(LOG_REC_DHT,         LOG_LEVEL_DEBUG, "Input: DHT %C°C %C%%") \
+  X(LOG_REC_ADC,         LOG_LEVEL_DEBUG, "Input: ADC pin %u = %u") \
+  X(LOG_REC_ARG,         LOG_LEVEL_DEBUG, "Input: arg %s = %s") \
+  X(LOG_REC_REQUEST,     LOG_LEVEL_DEBUG, "Input: request %u %s") \
+  X(LOG_RULES_LOADED,    LOG_LEVEL_INFO,  "Rules: slot %d loaded, %u bytes of code") \
+  X(LOG_RULES_APPLIED,   LOG_LEVEL_INFO,  "Rules: applied, saved as #%u, %u bytes of code")
+
+// ---------------- Tracing ----------------
+// Always-on timeline of begin/end/instant events with micros() timestamps in
+// a fixed ring; GET /trace or a 'T' on Serial dumps it, and
+// host/trace2json.cpp converts the dump for chrome://tracing or Perfetto
+#define TRACE_EVENTS       256    // 8 bytes each, power of two
+#define TRACE_MIN_SPAN_US  250    // shorter spans with nothing inside are not kept
+#define CONSOLE_POLL_MS    100    // Serial command check period
+
+// Fixed event names; handler URIs and task names follow them in the dump
+#define TRACE_NAMES(X) \
+  X(TRACE_LOOP,        "loop") \
+  X(TRACE_HTTP_CLIENT, "handleClient") \
+  X(TRACE_DHT,         "dht read") \
+  X(TRACE_PUMP,        "pump") \
+  X(TRACE_LIGHT,       "light") \
+  X(TRACE_WIFI,        "wifi") \
+  X(TRACE_CONFIG_SAVE, "config save")
+
+// ---------------- Sensor History ----------------
+// Fixed RAM budget: raw samples for the last few minutes, then min/max/avg
+// buckets for the last hour (1 minute each) and the last day (15 minutes each)
+#define HISTORY_RAW_SAMPLES      150   // 5 to 75 minutes, with the sampling interval
+#define HISTORY_HOUR_BUCKETS     60
+#define HISTORY_DAY_BUCKETS      96
+#define HISTORY_BUDGET_BYTES     6144
+
+// ---------------- Runtime Config ----------------
+// TEMP_THRESHOLD, LIGHT_THRESHOLD and the PWM levels below are factory
+// defaults; the live values are in `config`, changeable at /config and kept
+// in a flash log of CRC-checked slots (see loadConfig/saveConfig)
+#define PUMP_SPEED_PWM      1000    // pump speed when ON (of 1023)
+#define LED_BRIGHTNESS      1000    // LED brightness when ON (of 1023)
+#define CONFIG_TEMP_MIN     1000    // accepted tempThreshold range, centidegrees
+#define CONFIG_TEMP_MAX     5000    //   (DHT11 measures 0-50°C)
+#define CONFIG_SLOT_COUNT   (SPI_FLASH_SEC_SIZE / sizeof(ConfigSlot))
+
+// The sector the EEPROM library would use; the sketch does not use EEPROM
+#ifndef CONFIG_FLASH_SECTOR
+extern "C" uint32_t _EEPROM_start;
+#define CONFIG_FLASH_SECTOR (((uint32_t)&_EEPROM_start - 0x40200000) / SPI_FLASH_SEC_SIZE)
+#endif
+
+// ---------------- Automation Rules ----------------
+// Optional rules for automatic mode, uploaded as text to /rules, e.g.
+//   pump = temp > 31 && hum < 60 for 2m; light = light < 45
+// and compiled to bytecode on upload (see compileRules). A target without a
+// rule keeps the threshold logic above. The interpreter runs once per sensor
+// cycle on a fixed stack and allocates nothing; its time per run is the
+// rule_eval_duration_microseconds histogram in /metrics.
+#define RULES_SOURCE_BYTES  192     // rule text, kept beside the code for GET /rules
+#define RULES_CODE_BYTES    96
+#define RULES_STACK         8       // deepest expression; the compiler rejects deeper ones
+#define RULES_MAX_NESTING   8       // parentheses and '!' inside one another
+#define RULE_UNKNOWN        INT32_MIN   // a failed reading: every comparison with it is false
+#define RULES_SLOT_COUNT    (SPI_FLASH_SEC_SIZE / sizeof(RuleSlot))
+
+// The sector below the EEPROM one. Builds with a filesystem have its last
+// sector there and must define RULES_FLASH_SECTOR elsewhere.
+#ifndef RULES_FLASH_SECTOR
+#define RULES_FLASH_SECTOR  (CONFIG_FLASH_SECTOR - 1)
+#endif
 
 // ---------------- L298N Pins ----------------
 // Pump Motor (Motor A) - Uses PWM for speed control
@@ -27,23 +205,216 @@ DHT dht(DHTPIN, DHTTYPE);
 #define IN4 D8           // GPIO15 (LED direction)
 
 // ---------------- Web Server ----------------
-ESP8266WebServer server(80);
+// The request line is parsed in place in one fixed buffer, the route is
+// found through a perfect hash computed at compile time (see buildRouteTable)
+// and handlers read arguments as string views into that buffer, so routing a
+// request allocates nothing. A body is read into the same buffer after the head;
+// form fields in it are arguments too. One that does not fit is refused with
+// 413 and the connection closed.
+#define HTTP_PORT              80
+#define HTTP_REQUEST_BYTES    512   // request line, the headers that fit and the body
+#define HTTP_MAX_ARGS         8     // query arguments beyond this are ignored
+#define HTTP_READ_TIMEOUT_MS  2000  // the request head and body must arrive within this
+#define HTTP_HEAD_BYTES       384   // response head; a body that fits after it goes out in the same write
+#define HTTP_ROUTE_SLOTS      16    // perfect-hash table size, power of two
+#define HTTP_MAX_CONNS        4     // open connections, kept-alive ones and held long-polls included
+#define HTTP_IDLE_TIMEOUT_MS  5000  // a kept-alive connection with no new request is closed after this
+
+// Path, method, load class (see Loop Budgets), handler. The position is the
+// handler's number in /metrics and /trace.
+#define HTTP_ROUTES(X) \
+  X("/",              METHOD_ANY, LOAD_SHED, handleRoot) \
+  X("/setMode",       METHOD_ANY, LOAD_KEEP, handleSetMode) \
+  X("/setPump",       METHOD_ANY, LOAD_KEEP, handleSetPump) \
+  X("/setLight",      METHOD_ANY, LOAD_KEEP, handleSetLight) \
+  X("/getSensorData", METHOD_ANY, LOAD_SHED, handleGetSensorData) \
+  X("/history",       METHOD_ANY, LOAD_SHED, handleHistory) \
+  X("/config",        METHOD_ANY, LOAD_KEEP, handleConfig) \
+  X("/metrics",       METHOD_ANY, LOAD_SHED, handleMetrics) \
+  X("/trace",         METHOD_ANY, LOAD_SHED, handleTrace) \
+  X("/control",       METHOD_ANY, LOAD_KEEP, handleControl) \
+  X("/rules",         METHOD_ANY, LOAD_KEEP, handleRules)
+
+#define ROUTE_ONE(path, method, load, fn) + 1
+#define HTTP_ROUTE_COUNT (0 HTTP_ROUTES(ROUTE_ONE))
 
 // ---------------- Variables ----------------
 String mode = "off";  // START WITH EVERYTHING OFF
 bool pumpState = false;
 bool lightState = false;
-int pumpSpeedPWM = 1000;    // Pump speed at maximum (1000/1023)
-int ledBrightness = 1000;   // LED brightness at maximum when ON (1000/1023)
+
+unsigned long firstActuationMs = 0; // boot → first control pass
+unsigned long firstPublishMs = 0;   // boot → first sensor data delivered
+
+// Sensor reading in centi-units (2345 = 23.45°C or 23.45%).
+// valid=false replaces the NaN the DHT library returns on a failed read.
+struct Reading {
+  int16_t centi;
+  bool valid;
+};
+
+// Monotonic state version, bumped whenever the /getSensorData JSON would change.
+// The JSON is cached and only rebuilt by refreshState().
+uint32_t stateVersion = 0;
+uint32_t stateCrc = 0;
+String stateJson;
+
+// A /getSensorData request held open until the state changes or the wait expires
+struct HeldPoll {
+  int8_t conn;                  // in httpConns
+  uint32_t since;
+  unsigned long deadline;
+  bool active;
+};
+
+HeldPoll heldPolls[LONG_POLL_MAX_CLIENTS];
+
+// CRC-32 of the keys of the last applied /control requests, a ring
+uint32_t controlKeys[CONTROL_KEYS_KEPT];
+uint8_t controlKeyCount = 0;
+uint8_t controlKeyNext = 0;
+uint32_t controlRetries = 0;    // keyed requests answered without applying them again
+
+// Duration histogram; recording is one bucket increment, no allocation.
+// buckets[b] counts durations of at most 2^b us, the last one everything longer.
+struct Histogram {
+  uint32_t buckets[METRICS_BUCKETS];
+  uint32_t count;
+  uint64_t sumUs;
+};
+
+Histogram loopHist, handleClientHist, dhtReadHist, ruleEvalHist;
+Histogram handlerHist[HTTP_ROUTE_COUNT];     // by route, in HTTP_ROUTES order
+uint32_t httpRequests = 0;      // handler calls, counted by httpDispatch()
+uint32_t dhtFailures = 0;       // sensor cycles with a failed temperature or humidity read
+uint32_t pumpSwitches = 0;
+uint32_t lightSwitches = 0;
+
+int8_t httpTask = -1;
+int8_t sensorTask = -1;
+uint32_t idleMs = 0;                // time handed to schedulerIdle()
+
+// One raw history sample; time is stored as a delta to stay compact
+struct HistorySample {
+  uint16_t dtDs;     // deciseconds since the previous sample
+  int16_t temp;      // centidegrees
+  int16_t hum;       // centipercent
+  uint8_t light;     // percent
+  uint8_t flags;     // HIST_* bits
+};
+
+#define HIST_DHT_OK  0x01
+#define HIST_PUMP    0x02
+#define HIST_LED     0x04
+
+// Closed min/max/avg bucket; dhtSamples == 0 means no valid DHT reading
+struct HistoryBucket {
+  uint32_t startS;
+  uint16_t samples;
+  uint16_t dhtSamples;
+  int16_t tMin, tMax, tAvg;
+  int16_t hMin, hMax, hAvg;
+  uint8_t lMin, lMax, lAvg;
+};
+
+// Bucket still being filled
+struct HistoryAccumulator {
+  uint32_t startS;
+  uint16_t samples;
+  uint16_t dhtSamples;
+  int16_t tMin, tMax, hMin, hMax;
+  int32_t tSum, hSum;
+  uint8_t lMin, lMax;
+  uint32_t lSum;
+};
+
+HistorySample historyRaw[HISTORY_RAW_SAMPLES];
+HistoryBucket historyHour[HISTORY_HOUR_BUCKETS];
+HistoryBucket historyDay[HISTORY_DAY_BUCKETS];
+uint16_t historyRawHead = 0, historyRawCount = 0;     // head = next slot to write
+uint16_t historyHourHead = 0, historyHourCount = 0;
+uint16_t historyDayHead = 0, historyDayCount = 0;
+uint32_t historyNewestDs = 0;                         // uptime of the newest raw sample
+HistoryAccumulator hourAcc, dayAcc;
+
+static_assert(sizeof(historyRaw) + sizeof(historyHour) + sizeof(historyDay) +
+              2 * sizeof(HistoryAccumulator) <= HISTORY_BUDGET_BYTES,
+              "sensor history exceeds HISTORY_BUDGET_BYTES");
 
 // Sensor values
-float temperature = 0.0;
-float humidity = 0.0;
+Reading temperature = { 0, false };
+Reading humidity = { 0, false };
 int lightPercent = 0;
+uint32_t sampleIntervalMs = SAMPLE_MIN_MS;   // current time between DHT reads
+uint32_t sampleLastMs = 0;                   // millis() of the last one
+Reading sampleLastTemp = { 0, false };       // and its temperature
+
+// ---------------- Prototypes ----------------
+// Plain C++ needs these; the Arduino IDE generates them only for .ino files
+void pollHttp();
+void sampleLdr();
+void pollConsole();
+void readSensors();
+void schedulerIdle(uint32_t ms);
+void handleRoot();
+void handleControl();
+void handleSetMode();
+void handleSetPump();
+void handleSetLight();
+void serveControl(std::string_view newMode, std::string_view pumpCmd, std::string_view lightCmd);
+bool controlKeyApplied(uint32_t keyCrc);
+int applyControl(std::string_view newMode, std::string_view pumpCmd, std::string_view lightCmd);
+void refreshState();
+void serviceHeldPolls();
+void releaseHeldPoll(int8_t conn);
+void handleGetSensorData();
+uint32_t uptimeDeciseconds();
+void accumulateSample(HistoryAccumulator &acc, uint32_t startS, const HistorySample &s);
+void accumulateBucket(HistoryAccumulator &acc, uint32_t startS, const HistoryBucket &b);
+HistoryBucket closeBucket(HistoryAccumulator &acc);
+void recordHistory(const Reading &temp, const Reading &hum, int light, bool pump, bool led);
+void historyWrite(const char *row);
+void historyWriteBytes(const char *data, size_t len);
+void handleHistory();
+void observe(Histogram &h, uint32_t us);
+void recordRequest();
+const char *formatUint64(char *buf, uint64_t value);
+void writeHistogram(const char *name, const char *labels, const Histogram &h);
+void handleMetrics();
+uint16_t sampleNearness(int32_t distance, int32_t band);
+uint32_t nextSampleInterval();
+void pullSampleIn();
+void applyAutomaticMode();
+void setPump(bool state);
+void setLight(bool state);
+void handleRules();
+void handleConfig();
+void markBootMilestone(unsigned long &slot, const char *what);
+void traceHttpSink(const uint8_t *data, size_t len);
+void handleTrace();
+Reading toReading(float value);
+
+// ---------------- Shared Code ----------------
+// Kept in headers beside the sketches and shared with them. They expand the
+// settings and tables above and call into this sketch, so they are included
+// after its prototypes.
+#include "crc32.h"
+#include "log_ring.h"
+#include "trace_ring.h"
+#include "fixed_point.h"
+#include "analog_filter.h"
+#include "scheduler.h"
+#include "wifi_boot.h"
+#include "switch_guard.h"
+#include "config_log.h"
+#include "http_server.h"
+#include "rules.h"
 
 void setup() {
   Serial.begin(115200);
   dht.begin();
+  loadConfig();
+  loadRules();
 
   // Initialize all motor control pins
   pinMode(ENA, OUTPUT);
@@ -68,64 +439,118 @@ void setup() {
   Serial.println("OUT1/2: Water Pump Motor");
   Serial.println("OUT3/4: 12V LED Bulb");
 
-  // Connect to WiFi
-  WiFi.begin(WLAN_SSID, WLAN_PASS);
-  Serial.print("Connecting to WiFi");
-  unsigned long startTime = millis();
-  while (WiFi.status() != WL_CONNECTED && millis() - startTime < 15000) {
-    delay(500);
-    Serial.print(".");
-  }
-  
-  if (WiFi.status() != WL_CONNECTED) {
-    Serial.println("\nFailed to connect to WiFi!");
-  } else {
-    Serial.println("\nWiFi Connected!");
-    Serial.print("IP Address: ");
-    Serial.println(WiFi.localIP());
-  }
+  // Start joining WiFi; control runs right away and wifiPoll() finishes the join
+  wifiBeginFast();
 
-  // Setup web server routes
-  server.on("/", handleRoot);
-  server.on("/setMode", handleSetMode);
-  server.on("/setPump", handleSetPump);
-  server.on("/setLight", handleSetLight);
-  server.on("/getSensorData", handleGetSensorData);
-  
+  refreshState();
   server.begin();
+  server.setNoDelay(true);
   Serial.println("Web server started!");
-  Serial.print("Access the control panel at: http://");
-  Serial.println(WiFi.localIP());
+
+  schedulerBegin();
+  httpTask = scheduleEvery("http", HTTP_POLL_MS, 0, pollHttp);
+  scheduleEvery("wifi", WIFI_POLL_MS, 0, wifiPoll);
+  scheduleEvery("adc", ADC_SAMPLE_INTERVAL_MS, 0, sampleLdr);
+  scheduleEvery("console", CONSOLE_POLL_MS, 0, pollConsole);
+  sensorTask = scheduleEvery("sensors", SAMPLE_MIN_MS, 0, readSensors);
 }
 
 void loop() {
-  server.handleClient();
-  yield();
-
-  // Read sensors every 2 seconds
-  static unsigned long lastSensorTime = 0;
-  if(millis() - lastSensorTime > 2000){
-    lastSensorTime = millis();
-
-    temperature = dht.readTemperature();
-    humidity = dht.readHumidity();
-    int ldrRaw = analogRead(LDR_PIN);
-    lightPercent = map(ldrRaw, 0, 1023, 0, 100);
-
-    Serial.printf("Temp: %.1f°C, Hum: %.1f%%, Light: %d%%", temperature, humidity, lightPercent);
-    Serial.printf(", Mode: %s, Pump: %s, LED: %s\n", mode.c_str(), 
-                  pumpState ? "ON" : "OFF", lightState ? "ON" : "OFF");
-
-    // Apply automatic mode logic
-    if(mode == "automatic"){
-      applyAutomaticMode();
+  unsigned long loopStartUs = micros();
+  traceBegin(TRACE_LOOP);
+  uint32_t idleForMs = runScheduler();
+  traceEnd(TRACE_LOOP);
+  observe(loopHist, micros() - loopStartUs);
+  schedulerIdle(idleForMs);
+}
+
+// ---------------- Tasks ----------------
+// Serves waiting requests back to back within the pass budget (see Loop
+// Budgets). While requests keep coming, the next poll is on the next tick
+// rather than HTTP_POLL_MS later.
+void pollHttp() {
+  uint32_t before = httpRequests + httpShed;
+  unsigned long passStartUs = micros();
+  if(millis() - httpWindowStart >= HTTP_WINDOW_MS) {
+    httpWindowStart = millis();
+    httpWindowUsedUs = 0;
+  }
+  for(uint8_t i = 0; i < HTTP_MAX_PER_POLL; i++) {
+    if(i > 0 && (micros() - passStartUs >= HTTP_PASS_BUDGET_US || otherTaskDue())) {
+      httpDeferred++;
+      break;
+    }
+    uint32_t served = httpRequests + httpShed;
+    unsigned long clientStartUs = micros();
+    traceBegin(TRACE_HTTP_CLIENT);
+    httpHandleClient();
+    traceEnd(TRACE_HTTP_CLIENT);
+    uint32_t us = micros() - clientStartUs;
+    observe(handleClientHist, us);
+    httpWindowUsedUs += us;
+    if(us > HTTP_PASS_BUDGET_US) httpOverruns++;
+    if(httpRequests + httpShed == served) break;
+  }
+  serviceHeldPolls();
+  // Also back soon while a request head is still arriving or pipelined ones wait
+  if(httpRequests + httpShed != before || httpCurrent >= 0) rescheduleTask(httpTask, 1);
+}
+
+void sampleLdr() {
+  sampleAnalogChannel(ldrChannel);
+  if(abs(analogChannelPercent(ldrChannel) - lightPercent) >= SAMPLE_LIGHT_WAKE) pullSampleIn();
+}
+
+// Serial commands, one byte each: 'T' dumps the trace ring. The dump goes
+// out in one piece after the queued log records, about 0.3 s at 115200 baud.
+void pollConsole() {
+  while(Serial.available() > 0) {
+    if(Serial.read() == 'T') {
+      logFlush();
+      traceWrite(traceSerialSink);
     }
   }
 }
 
+void readSensors() {
+  unsigned long dhtStartUs = micros();
+  traceBegin(TRACE_DHT);
+  temperature = toReading(dht.readTemperature());
+  humidity = toReading(dht.readHumidity());
+  traceEnd(TRACE_DHT);
+  observe(dhtReadHist, micros() - dhtStartUs);
+  if(!temperature.valid || !humidity.valid) dhtFailures++;
+  RECORD(LOG_REC_DHT, temperature.valid ? temperature.centi : LOG_NAN, humidity.valid ? humidity.centi : LOG_NAN);
+  lightPercent = analogChannelPercent(ldrChannel);
+
+  LOG(LOG_SENSORS, temperature.valid ? temperature.centi : LOG_NAN, humidity.valid ? humidity.centi : LOG_NAN,
+      lightPercent, mode, pumpState, lightState);
+
+  // Apply automatic mode logic
+  if(mode == "automatic"){
+    applyAutomaticMode();
+  }
+
+  recordHistory(temperature, humidity, lightPercent, pumpState, lightState);
+  refreshState();
+  markBootMilestone(firstActuationMs, "first control pass");
+
+  sampleIntervalMs = nextSampleInterval();
+  setTaskPeriod(sensorTask, sampleIntervalMs);
+}
+
+// Nothing is due for ms milliseconds: queued log records go to the UART,
+// then delay() hands the CPU to the SDK, which idles it (and lets the modem
+// sleep between beacons) until then.
+void schedulerIdle(uint32_t ms) {
+  logDrain();
+  delay(ms);
+  idleMs += ms;
+}
+
 // ---------------- Web Server Handlers ----------------
 void handleRoot() {
-  String html = R"(
+  const char *html = R"rawliteral(
 <!DOCTYPE html>
 <html>
 <head>
@@ -257,64 +682,79 @@ void handleRoot() {
         let pumpState = false;
         let lightState = false;
 
+        let stateVersion = 0;
+
         function updateSensorData() {
             fetch('/getSensorData')
                 .then(response => response.json())
+                .then(render)
+                .catch(error => console.error('Error:', error));
+        }
+
+        // Long-poll: the board holds the request until the state moves past
+        // stateVersion (or answers 304 after ~20 s), then we ask again
+        function watchState() {
+            fetch('/getSensorData?since=' + stateVersion + '&wait=20')
+                .then(response => response.status === 304 ? null : response.json())
                 .then(data => {
-                    document.getElementById('temperature').textContent = data.temperature;
-                    document.getElementById('humidity').textContent = data.humidity;
-                    document.getElementById('light').textContent = data.lightPercent;
-                    
-                    // Update device states
-                    pumpState = data.pumpState;
-                    lightState = data.lightState;
-                    updateDeviceStatus();
+                    if(data) render(data);
+                    watchState();
                 })
-                .catch(error => console.error('Error:', error));
+                .catch(() => setTimeout(watchState, 3000));
+        }
+
+        function render(data) {
+            stateVersion = data.version;
+            document.getElementById('temperature').textContent = data.temperature;
+            document.getElementById('humidity').textContent = data.humidity;
+            document.getElementById('light').textContent = data.lightPercent;
+            
+            // Update mode and device states
+            currentMode = data.mode;
+            pumpState = data.pumpState;
+            lightState = data.lightState;
+            updateModeDisplay();
+            updateDeviceStatus();
+        }
+
+        // One round trip per action: /control answers with the new state.
+        // The key lets a retry after a lost answer through without the
+        // board applying the command twice.
+        function sendControl(query) {
+            const url = '/control?' + query + '&key=' + Date.now().toString(36) + Math.random().toString(36).slice(2, 6);
+            const attempt = retries => fetch(url).catch(error => retries > 0 ? attempt(retries - 1) : Promise.reject(error));
+            return attempt(2).then(response => response.json().then(data => ({ ok: response.ok, data: data })));
         }
 
         function setMode(mode) {
-            currentMode = mode;
-            fetch('/setMode?mode=' + mode)
-                .then(response => response.text())
-                .then(data => {
-                    document.getElementById('currentMode').textContent = 
-                        mode.charAt(0).toUpperCase() + mode.slice(1);
-                    
-                    // Update button states
-                    document.getElementById('offBtn').classList.toggle('active', mode === 'off');
-                    document.getElementById('autoBtn').classList.toggle('active', mode === 'automatic');
-                    document.getElementById('manualBtn').classList.toggle('active', mode === 'manual');
-                    
-                    // Show/hide manual controls
-                    document.getElementById('manualControls').classList.toggle('show', mode === 'manual');
-                });
+            sendControl('mode=' + mode).then(result => render(result.data));
         }
 
         function togglePump() {
             if (currentMode === 'manual') {
-                const newState = !pumpState;
-                fetch('/setPump?state=' + (newState ? 'ON' : 'OFF'))
-                    .then(response => response.text())
-                    .then(data => {
-                        pumpState = newState;
-                        updateDeviceStatus();
-                    });
+                sendControl('pump=' + (pumpState ? 'OFF' : 'ON')).then(result => render(result.data));
             }
         }
 
         function toggleLight() {
             if (currentMode === 'manual') {
-                const newState = !lightState;
-                fetch('/setLight?state=' + (newState ? 'ON' : 'OFF'))
-                    .then(response => response.text())
-                    .then(data => {
-                        lightState = newState;
-                        updateDeviceStatus();
-                    });
+                sendControl('light=' + (lightState ? 'OFF' : 'ON')).then(result => render(result.data));
             }
         }
 
+        function updateModeDisplay() {
+            document.getElementById('currentMode').textContent = 
+                currentMode.charAt(0).toUpperCase() + currentMode.slice(1);
+            
+            // Update button states
+            document.getElementById('offBtn').classList.toggle('active', currentMode === 'off');
+            document.getElementById('autoBtn').classList.toggle('active', currentMode === 'automatic');
+            document.getElementById('manualBtn').classList.toggle('active', currentMode === 'manual');
+            
+            // Show/hide manual controls
+            document.getElementById('manualControls').classList.toggle('show', currentMode === 'manual');
+        }
+
         function updateDeviceStatus() {
             // Update main status display
             document.getElementById('pumpState').textContent = pumpState ? 'ON' : 'OFF';
@@ -331,94 +771,650 @@ void handleRoot() {
             lightBtn.innerHTML = '💡 Light: <span id="lightStatus">' + (lightState ? 'ON' : 'OFF') + '</span>';
         }
 
-        // Update sensor data every 2 seconds
-        setInterval(updateSensorData, 2000);
-        updateSensorData(); // Initial call
+        // Live updates: the board pushes changes through the long-poll
+        watchState();
     </script>
 </body>
 </html>
-)";
+)rawliteral";
   
-  server.send(200, "text/html", html);
+  httpSend(200, "text/html", html);
+}
+
+// GET /control?mode=off|automatic|manual&pump=ON|OFF&light=ON|OFF&key=K
+// Any mix of the commands, applied together (see applyControl); the answer
+// is the resulting state with its version (see serveControl)
+void handleControl() {
+  serveControl(httpArg("mode"), httpArg("pump"), httpArg("light"));
 }
 
+// One-command forms of /control, kept for pages that still use them
 void handleSetMode() {
-  if (server.hasArg("mode")) {
-    String newMode = server.arg("mode");
-    if (newMode == "automatic" || newMode == "manual" || newMode == "off") {
-      mode = newMode;
-      Serial.print("Mode changed to: ");
-      Serial.println(mode);
-      
-      // Turn everything OFF when switching to off mode
-      if (mode == "off") {
-        setPump(false);
-        setLight(false);
-      }
-      // Apply automatic logic immediately when switching to auto mode
-      else if (mode == "automatic") {
-        applyAutomaticMode();
-      }
+  serveControl(httpArg("mode"), "", "");
+}
+
+void handleSetPump() {
+  serveControl("", httpArg("state"), "");
+}
+
+void handleSetLight() {
+  serveControl("", "", httpArg("state"));
+}
+
+// Answers a control request with the state JSON, as the state endpoint
+// sends it, so the page needs no second round trip: 200 with the state after
+// the commands, 409 with the unchanged state if they need manual mode and
+// it is not, 400 for a bad value. A non-empty key already applied marks a
+// client's retry; it is answered with the current state and nothing is
+// applied again.
+void serveControl(std::string_view newMode, std::string_view pumpCmd, std::string_view lightCmd) {
+  std::string_view key = httpArg("key");
+  uint32_t keyCrc = crc32((const uint8_t *)key.data(), key.size());
+  if(!key.empty() && controlKeyApplied(keyCrc)) {
+    controlRetries++;
+    httpSend(200, "application/json", stateJson);
+    return;
+  }
+
+  int code = applyControl(newMode, pumpCmd, lightCmd);
+  if(code == 400) {
+    httpSend(400, "text/plain", "Invalid command");
+    return;
+  }
+  if(code == 200) {
+    if(!key.empty()) {
+      controlKeys[controlKeyNext] = keyCrc;
+      controlKeyNext = (controlKeyNext + 1) % CONTROL_KEYS_KEPT;
+      if(controlKeyCount < CONTROL_KEYS_KEPT) controlKeyCount++;
     }
+    refreshState();
   }
-  server.send(200, "text/plain", "OK");
+  httpSend(code, "application/json", stateJson);
 }
 
-void handleSetPump() {
-  if (mode == "manual" && server.hasArg("state")) {
-    String state = server.arg("state");
-    setPump(state == "ON");
+bool controlKeyApplied(uint32_t keyCrc) {
+  for(uint8_t i = 0; i < controlKeyCount; i++) {
+    if(controlKeys[i] == keyCrc) return true;
   }
-  server.send(200, "text/plain", "OK");
+  return false;
 }
 
-void handleSetLight() {
-  if (mode == "manual" && server.hasArg("state")) {
-    String state = server.arg("state");
-    setLight(state == "ON");
+// Checks the commands together and applies them in one pass; an empty view
+// is a command not given. Pump and light are manual commands: the mode has
+// to be manual, already or by this request. Returns 200, or 400 / 409 with
+// nothing applied.
+int applyControl(std::string_view newMode, std::string_view pumpCmd, std::string_view lightCmd) {
+  if(!newMode.empty() && newMode != "automatic" && newMode != "manual" && newMode != "off") return 400;
+  if(!pumpCmd.empty() && pumpCmd != "ON" && pumpCmd != "OFF") return 400;
+  if(!lightCmd.empty() && lightCmd != "ON" && lightCmd != "OFF") return 400;
+  bool manual = newMode.empty() ? mode == "manual" : newMode == "manual";
+  if((!pumpCmd.empty() || !lightCmd.empty()) && !manual) return 409;
+
+  bool pumpOn = pumpState, lightOn = lightState;
+  if(!newMode.empty()) {
+    mode = newMode.data();
+    LOG(LOG_MODE, mode);
+    // Off turns everything off
+    if(mode == "off") pumpOn = lightOn = false;
+    if(mode == "automatic") clearRuleHolds();
   }
-  server.send(200, "text/plain", "OK");
+  if(!pumpCmd.empty()) pumpOn = pumpCmd == "ON";
+  if(!lightCmd.empty()) lightOn = lightCmd == "ON";
+
+  // Each device switches at most once, straight to where it ends up
+  if(mode == "automatic") {
+    if(!newMode.empty()) applyAutomaticMode();
+  } else {
+    setPump(pumpOn);
+    setLight(lightOn);
+  }
+  return 200;
 }
 
-void handleGetSensorData() {
+// ---------------- Versioned State ----------------
+// Rebuilds the state JSON and bumps stateVersion if anything in it changed.
+// Called after every sensor cycle and control request.
+void refreshState() {
+  char tempText[8], humText[8];
   String json = "{";
-  json += "\"temperature\":" + String(isnan(temperature) ? 0 : temperature, 1) + ",";
-  json += "\"humidity\":" + String(isnan(humidity) ? 0 : humidity, 1) + ",";
+  json += "\"temperature\":" + String(formatCenti(tempText, temperature.valid ? temperature.centi : 0)) + ",";
+  json += "\"humidity\":" + String(formatCenti(humText, humidity.valid ? humidity.centi : 0)) + ",";
+  json += "\"sensorOk\":" + String(temperature.valid && humidity.valid ? "true" : "false") + ",";
   json += "\"lightPercent\":" + String(lightPercent) + ",";
   json += "\"pumpState\":" + String(pumpState ? "true" : "false") + ",";
   json += "\"lightState\":" + String(lightState ? "true" : "false") + ",";
-  json += "\"mode\":\"" + mode + "\"";
+  json += "\"mode\":\"" + mode + "\",";
+  json += "\"suppressed\":{";
+  json += "\"pumpDwell\":" + String(pumpGuard.suppressedDwell) + ",";
+  json += "\"pumpRate\":" + String(pumpGuard.suppressedRate) + ",";
+  json += "\"lightDwell\":" + String(lightGuard.suppressedDwell) + ",";
+  json += "\"lightRate\":" + String(lightGuard.suppressedRate);
   json += "}";
-  
-  server.send(200, "application/json", json);
+  uint32_t crc = crc32((const uint8_t *)json.c_str(), json.length());
+  if(crc == stateCrc && stateVersion != 0) return;
+  stateCrc = crc;
+  stateVersion++;
+  stateJson = json + ",\"version\":" + String(stateVersion) + "}";
+}
+
+// Answers held long-polls on a state change or when their wait runs out.
+// Call every loop() pass.
+void serviceHeldPolls() {
+  for(uint8_t i = 0; i < LONG_POLL_MAX_CLIENTS; i++) {
+    HeldPoll &p = heldPolls[i];
+    if(!p.active) continue;
+    HttpConn &c = httpConns[p.conn];
+    if(!c.client.connected()) {
+      p.active = false;
+      httpCloseConn(p.conn);
+      continue;
+    }
+
+    bool changed = p.since != stateVersion;
+    if(!changed && (long)(millis() - p.deadline) < 0) continue;
+
+    String response = changed ? "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\n"
+                              : "HTTP/1.1 304 Not Modified\r\n";
+    response += "Content-Length: " + String(changed ? stateJson.length() : 0) + "\r\n";
+    response += c.keepAlive ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n";
+    if(changed) response += stateJson;
+    c.client.print(response);
+    p.active = false;
+    if(c.keepAlive) {
+      c.state = CONN_OPEN;
+      c.lastUsed = millis();
+    } else {
+      httpCloseConn(p.conn);
+    }
+  }
+}
+
+// Makes the poll held on connection `conn` due now and closes the
+// connection after its answer, freeing the slot
+void releaseHeldPoll(int8_t conn) {
+  for(uint8_t i = 0; i < LONG_POLL_MAX_CLIENTS; i++) {
+    if(heldPolls[i].active && heldPolls[i].conn == conn) heldPolls[i].deadline = millis();
+  }
+  httpConns[conn].keepAlive = false;
+}
+
+// GET /getSensorData               full state
+// GET /getSensorData?since=N       304 at once if the state is still at version N
+// GET /getSensorData?since=N&wait=S  hold up to S seconds for a newer version, then 304
+void handleGetSensorData() {
+  if(httpHasArg("since") && (uint32_t)httpArgInt("since") == stateVersion) {
+    unsigned long waitS = httpArgInt("wait");
+    if(waitS > LONG_POLL_MAX_WAIT_S) waitS = LONG_POLL_MAX_WAIT_S;
+    if(waitS > 0 && httpCurrent >= 0) {
+      for(uint8_t i = 0; i < LONG_POLL_MAX_CLIENTS; i++) {
+        HeldPoll &p = heldPolls[i];
+        if(p.active) continue;
+        // The connection keeps its slot and is answered from loop()
+        p.conn = httpCurrent;
+        httpConns[httpCurrent].state = CONN_HELD;
+        httpConns[httpCurrent].lastUsed = millis();
+        p.since = stateVersion;
+        p.deadline = millis() + waitS * 1000;
+        p.active = true;
+        return;
+      }
+    }
+    // Unchanged, or every hold slot is busy - the client just polls again
+    httpSend(304, "application/json", "");
+    return;
+  }
+
+  httpSend(200, "application/json", stateJson);
+  markBootMilestone(firstPublishMs, "first /getSensorData served");
+}
+
+// ---------------- Sensor History ----------------
+// Uptime in deciseconds, carried across the 49-day millis() wrap
+uint32_t uptimeDeciseconds() {
+  static uint32_t lastMs = 0, carryMs = 0, deciseconds = 0;
+  uint32_t now = millis();
+  carryMs += now - lastMs;
+  lastMs = now;
+  deciseconds += carryMs / 100;
+  carryMs %= 100;
+  return deciseconds;
+}
+
+void accumulateSample(HistoryAccumulator &acc, uint32_t startS, const HistorySample &s) {
+  if(acc.samples == 0) {
+    memset(&acc, 0, sizeof(acc));
+    acc.startS = startS;
+    acc.lMin = 255;
+  }
+  acc.samples++;
+  if(s.light < acc.lMin) acc.lMin = s.light;
+  if(s.light > acc.lMax) acc.lMax = s.light;
+  acc.lSum += s.light;
+
+  if(!(s.flags & HIST_DHT_OK)) return;
+  if(acc.dhtSamples == 0 || s.temp < acc.tMin) acc.tMin = s.temp;
+  if(acc.dhtSamples == 0 || s.temp > acc.tMax) acc.tMax = s.temp;
+  if(acc.dhtSamples == 0 || s.hum < acc.hMin) acc.hMin = s.hum;
+  if(acc.dhtSamples == 0 || s.hum > acc.hMax) acc.hMax = s.hum;
+  acc.tSum += s.temp;
+  acc.hSum += s.hum;
+  acc.dhtSamples++;
+}
+
+// Folds a closed 1-minute bucket into the 15-minute accumulator
+void accumulateBucket(HistoryAccumulator &acc, uint32_t startS, const HistoryBucket &b) {
+  if(acc.samples == 0) {
+    memset(&acc, 0, sizeof(acc));
+    acc.startS = startS;
+    acc.lMin = 255;
+  }
+  acc.samples += b.samples;
+  if(b.lMin < acc.lMin) acc.lMin = b.lMin;
+  if(b.lMax > acc.lMax) acc.lMax = b.lMax;
+  acc.lSum += (uint32_t)b.lAvg * b.samples;
+
+  if(b.dhtSamples == 0) return;
+  if(acc.dhtSamples == 0 || b.tMin < acc.tMin) acc.tMin = b.tMin;
+  if(acc.dhtSamples == 0 || b.tMax > acc.tMax) acc.tMax = b.tMax;
+  if(acc.dhtSamples == 0 || b.hMin < acc.hMin) acc.hMin = b.hMin;
+  if(acc.dhtSamples == 0 || b.hMax > acc.hMax) acc.hMax = b.hMax;
+  acc.tSum += (int32_t)b.tAvg * b.dhtSamples;
+  acc.hSum += (int32_t)b.hAvg * b.dhtSamples;
+  acc.dhtSamples += b.dhtSamples;
+}
+
+HistoryBucket closeBucket(HistoryAccumulator &acc) {
+  HistoryBucket b;
+  b.startS = acc.startS;
+  b.samples = acc.samples;
+  b.dhtSamples = acc.dhtSamples;
+  b.lMin = acc.lMin;
+  b.lMax = acc.lMax;
+  b.lAvg = acc.lSum / acc.samples;
+  if(acc.dhtSamples > 0) {
+    b.tMin = acc.tMin; b.tMax = acc.tMax; b.tAvg = acc.tSum / acc.dhtSamples;
+    b.hMin = acc.hMin; b.hMax = acc.hMax; b.hAvg = acc.hSum / acc.dhtSamples;
+  } else {
+    b.tMin = b.tMax = b.tAvg = 0;
+    b.hMin = b.hMax = b.hAvg = 0;
+  }
+  acc.samples = 0;
+  return b;
+}
+
+// Called once per sensor cycle
+void recordHistory(const Reading &temp, const Reading &hum, int light, bool pump, bool led) {
+  uint32_t nowDs = uptimeDeciseconds();
+  uint32_t nowS = nowDs / 10;
+
+  HistorySample s;
+  uint32_t dtDs = historyRawCount ? nowDs - historyNewestDs : 0;
+  s.dtDs = dtDs > 65535 ? 65535 : dtDs;
+  s.temp = temp.centi;
+  s.hum = hum.centi;
+  s.light = light;
+  s.flags = (temp.valid && hum.valid ? HIST_DHT_OK : 0) | (pump ? HIST_PUMP : 0) | (led ? HIST_LED : 0);
+  historyRaw[historyRawHead] = s;
+  historyRawHead = (historyRawHead + 1) % HISTORY_RAW_SAMPLES;
+  if(historyRawCount < HISTORY_RAW_SAMPLES) historyRawCount++;
+  historyNewestDs = nowDs;
+
+  // Close the 1-minute bucket (and the 15-minute one) when their period ends
+  if(hourAcc.samples > 0 && nowS / 60 != hourAcc.startS / 60) {
+    HistoryBucket minute = closeBucket(hourAcc);
+    historyHour[historyHourHead] = minute;
+    historyHourHead = (historyHourHead + 1) % HISTORY_HOUR_BUCKETS;
+    if(historyHourCount < HISTORY_HOUR_BUCKETS) historyHourCount++;
+
+    if(dayAcc.samples > 0 && minute.startS / 900 != dayAcc.startS / 900) {
+      historyDay[historyDayHead] = closeBucket(dayAcc);
+      historyDayHead = (historyDayHead + 1) % HISTORY_DAY_BUCKETS;
+      if(historyDayCount < HISTORY_DAY_BUCKETS) historyDayCount++;
+    }
+    accumulateBucket(dayAcc, minute.startS / 900 * 900, minute);
+  }
+  accumulateSample(hourAcc, nowS / 60 * 60, s);
+}
+
+// Response body is streamed through this buffer so it never needs one big String
+char historyChunk[512];
+size_t historyChunkLen = 0;
+
+void historyWrite(const char *row) {
+  historyWriteBytes(row, strlen(row));
+}
+
+void historyWriteBytes(const char *data, size_t len) {
+  if(historyChunkLen + len > sizeof(historyChunk)) {
+    httpSendChunk(historyChunk, historyChunkLen);
+    historyChunkLen = 0;
+  }
+  memcpy(historyChunk + historyChunkLen, data, len);
+  historyChunkLen += len;
+}
+
+// GET /history?res=raw|hour|day&from=S&to=S
+// Times are uptime seconds. Rows are CSV, delta-encoded: the first row is
+// absolute and every later row holds differences from the previous row,
+// except the flags and n columns, which are always absolute.
+void handleHistory() {
+  std::string_view res = httpHasArg("res") ? httpArg("res") : "raw";
+  uint32_t fromS = httpHasArg("from") ? httpArgInt("from") : 0;
+  uint32_t toS = httpHasArg("to") ? httpArgInt("to") : 0xFFFFFFFF;
+  if(res != "raw" && res != "hour" && res != "day") {
+    httpSend(400, "text/plain", "res must be raw, hour or day");
+    return;
+  }
+
+  httpBeginChunked(200, "text/csv");
+  historyChunkLen = 0;
+
+  char row[96];
+  snprintf(row, sizeof(row), "# now=%lu res=%s\n", (unsigned long)(uptimeDeciseconds() / 10), res.data());
+  historyWrite(row);
+
+  bool first = true;
+  if(res == "raw") {
+    historyWrite("t,temp,hum,light,flags\n");
+
+    // Walk back from the newest sample to find when the oldest was taken
+    uint32_t tDs = historyNewestDs;
+    uint16_t oldest = (historyRawHead + HISTORY_RAW_SAMPLES - historyRawCount) % HISTORY_RAW_SAMPLES;
+    for(uint16_t i = 1; i < historyRawCount; i++) {
+      tDs -= historyRaw[(oldest + i) % HISTORY_RAW_SAMPLES].dtDs;
+    }
+
+    HistorySample prev = {0, 0, 0, 0, 0};
+    uint32_t prevS = 0;
+    for(uint16_t i = 0; i < historyRawCount; i++) {
+      const HistorySample &s = historyRaw[(oldest + i) % HISTORY_RAW_SAMPLES];
+      if(i > 0) tDs += s.dtDs;
+      uint32_t tS = tDs / 10;
+      if(tS < fromS || tS > toS) continue;
+      if(first) {
+        snprintf(row, sizeof(row), "%lu,%d,%d,%d,%d\n", (unsigned long)tS, s.temp, s.hum, s.light, s.flags);
+        first = false;
+      } else {
+        snprintf(row, sizeof(row), "%ld,%d,%d,%d,%d\n", (long)(tS - prevS),
+                 s.temp - prev.temp, s.hum - prev.hum, s.light - prev.light, s.flags);
+      }
+      historyWrite(row);
+      prev = s;
+      prevS = tS;
+    }
+  } else {
+    const HistoryBucket *ring = res == "hour" ? historyHour : historyDay;
+    uint16_t size = res == "hour" ? HISTORY_HOUR_BUCKETS : HISTORY_DAY_BUCKETS;
+    uint16_t count = res == "hour" ? historyHourCount : historyDayCount;
+    uint16_t head = res == "hour" ? historyHourHead : historyDayHead;
+    historyWrite("t,n,tMin,tMax,tAvg,hMin,hMax,hAvg,lMin,lMax,lAvg\n");
+
+    HistoryBucket prev;
+    memset(&prev, 0, sizeof(prev));
+    uint16_t oldest = (head + size - count) % size;
+    for(uint16_t i = 0; i < count; i++) {
+      const HistoryBucket &b = ring[(oldest + i) % size];
+      if(b.startS < fromS || b.startS > toS) continue;
+      if(first) {
+        snprintf(row, sizeof(row), "%lu,%u,%d,%d,%d,%d,%d,%d,%u,%u,%u\n",
+                 (unsigned long)b.startS, b.dhtSamples, b.tMin, b.tMax, b.tAvg,
+                 b.hMin, b.hMax, b.hAvg, b.lMin, b.lMax, b.lAvg);
+        first = false;
+      } else {
+        snprintf(row, sizeof(row), "%ld,%u,%d,%d,%d,%d,%d,%d,%d,%d,%d\n",
+                 (long)(b.startS - prev.startS), b.dhtSamples,
+                 b.tMin - prev.tMin, b.tMax - prev.tMax, b.tAvg - prev.tAvg,
+                 b.hMin - prev.hMin, b.hMax - prev.hMax, b.hAvg - prev.hAvg,
+                 b.lMin - prev.lMin, b.lMax - prev.lMax, b.lAvg - prev.lAvg);
+      }
+      historyWrite(row);
+      prev = b;
+    }
+  }
+
+  httpSendChunk(historyChunk, historyChunkLen);
+  httpEndChunked();
+}
+
+// ---------------- Metrics ----------------
+void observe(Histogram &h, uint32_t us) {
+  uint8_t b = us <= 1 ? 0 : 32 - __builtin_clz(us - 1);
+  if(b >= METRICS_BUCKETS) b = METRICS_BUCKETS - 1;
+  h.buckets[b]++;
+  h.count++;
+  h.sumUs += us;
+}
+
+// RECORD_INPUTS: the request being handled, arguments first, so that
+// host/replay.cpp can serve the same request again
+void recordRequest() {
+  for(uint8_t i = 0; i < httpArgCount; i++) RECORD(LOG_REC_ARG, httpArgs[i].name, httpArgs[i].value);
+  RECORD(LOG_REC_REQUEST, (int)httpMethod, httpPath);
+}
+
+// The core's printf has no %llu, so print nine digits at a time. buf needs 21 bytes.
+const char *formatUint64(char *buf, uint64_t value) {
+  if(value < 1000000000) {
+    sprintf(buf, "%lu", (unsigned long)value);
+  } else {
+    formatUint64(buf, value / 1000000000);
+    sprintf(buf + strlen(buf), "%09lu", (unsigned long)(value % 1000000000));
+  }
+  return buf;
+}
+
+// One histogram series; labels is "" or e.g. "handler=\"/data\""
+void writeHistogram(const char *name, const char *labels, const Histogram &h) {
+  char row[192], sum[21];
+  const char *sep = *labels ? "," : "";
+  uint32_t cumulative = 0;
+  for(uint8_t b = 0; b < METRICS_BUCKETS; b++) {
+    cumulative += h.buckets[b];
+    if(b + 1 < METRICS_BUCKETS) {
+      snprintf(row, sizeof(row), "%s_bucket{%s%sle=\"%lu\"} %lu\n", name, labels, sep,
+               1UL << b, (unsigned long)cumulative);
+    } else {
+      snprintf(row, sizeof(row), "%s_bucket{%s%sle=\"+Inf\"} %lu\n", name, labels, sep,
+               (unsigned long)cumulative);
+    }
+    historyWrite(row);
+  }
+  formatUint64(sum, h.sumUs);
+  if(*labels) {
+    snprintf(row, sizeof(row), "%s_sum{%s} %s\n%s_count{%s} %lu\n", name, labels, sum,
+             name, labels, (unsigned long)h.count);
+  } else {
+    snprintf(row, sizeof(row), "%s_sum %s\n%s_count %lu\n", name, sum, name, (unsigned long)h.count);
+  }
+  historyWrite(row);
+}
+
+// GET /metrics   Prometheus text format, streamed through the /history chunk buffer
+void handleMetrics() {
+  httpBeginChunked(200, "text/plain; version=0.0.4");
+  historyChunkLen = 0;
+  char row[192];
+
+  historyWrite("# TYPE loop_duration_microseconds histogram\n");
+  writeHistogram("loop_duration_microseconds", "", loopHist);
+  historyWrite("# TYPE handle_client_duration_microseconds histogram\n");
+  writeHistogram("handle_client_duration_microseconds", "", handleClientHist);
+  historyWrite("# TYPE http_handler_duration_microseconds histogram\n");
+  for(uint8_t i = 0; i < HTTP_ROUTE_COUNT; i++) {
+    snprintf(row, sizeof(row), "handler=\"%s\"", routePaths[i].data());
+    writeHistogram("http_handler_duration_microseconds", row, handlerHist[i]);
+  }
+  historyWrite("# TYPE dht_read_duration_microseconds histogram\n");
+  writeHistogram("dht_read_duration_microseconds", "", dhtReadHist);
+  historyWrite("# TYPE rule_eval_duration_microseconds histogram\n");
+  writeHistogram("rule_eval_duration_microseconds", "", ruleEvalHist);
+
+  snprintf(row, sizeof(row),
+           "# TYPE dht_read_failures_total counter\ndht_read_failures_total %lu\n"
+           "# TYPE actuator_switches_total counter\n", (unsigned long)dhtFailures);
+  historyWrite(row);
+  snprintf(row, sizeof(row), "actuator_switches_total{actuator=\"pump\"} %lu\n"
+           "actuator_switches_total{actuator=\"light\"} %lu\n",
+           (unsigned long)pumpSwitches, (unsigned long)lightSwitches);
+  historyWrite(row);
+  snprintf(row, sizeof(row), "# TYPE sensor_sample_interval_milliseconds gauge\n"
+           "sensor_sample_interval_milliseconds %lu\n", (unsigned long)sampleIntervalMs);
+  historyWrite(row);
+  snprintf(row, sizeof(row), "# TYPE control_retries_total counter\ncontrol_retries_total %lu\n",
+           (unsigned long)controlRetries);
+  historyWrite(row);
+  snprintf(row, sizeof(row), "# TYPE http_connections_total counter\nhttp_connections_total %lu\n"
+           "# TYPE http_requests_total counter\nhttp_requests_total %lu\n",
+           (unsigned long)httpConnections, (unsigned long)httpRequests);
+  historyWrite(row);
+  snprintf(row, sizeof(row), "# TYPE http_shed_total counter\nhttp_shed_total %lu\n"
+           "# TYPE http_deferred_total counter\nhttp_deferred_total %lu\n",
+           (unsigned long)httpShed, (unsigned long)httpDeferred);
+  historyWrite(row);
+  snprintf(row, sizeof(row), "# TYPE http_budget_overruns_total counter\nhttp_budget_overruns_total %lu\n",
+           (unsigned long)httpOverruns);
+  historyWrite(row);
+  snprintf(row, sizeof(row), "# TYPE log_records_total counter\nlog_records_total %lu\n"
+           "# TYPE log_dropped_records_total counter\nlog_dropped_records_total %lu\n",
+           (unsigned long)logRecords, (unsigned long)logDroppedTotal);
+  historyWrite(row);
+  snprintf(row, sizeof(row), "# TYPE heap_free_bytes gauge\nheap_free_bytes %lu\n"
+           "# TYPE heap_max_free_block_bytes gauge\nheap_max_free_block_bytes %lu\n",
+           (unsigned long)ESP.getFreeHeap(), (unsigned long)ESP.getMaxFreeBlockSize());
+  historyWrite(row);
+
+  // Periodic tasks; one-shots come and go between scrapes
+  const char *taskFamilies[] = { "task_runs_total counter", "task_deadline_misses_total counter",
+                                 "task_jitter_max_microseconds gauge", "task_jitter_microseconds_total counter" };
+  for(uint8_t f = 0; f < 4; f++) {
+    const char *space = strchr(taskFamilies[f], ' ');
+    snprintf(row, sizeof(row), "# TYPE %s\n", taskFamilies[f]);
+    historyWrite(row);
+    for(int8_t id = 0; id < SCHED_MAX_TASKS; id++) {
+      const Task &t = tasks[id];
+      if(!t.active || t.periodMs == 0) continue;
+      char value[21];
+      formatUint64(value, f == 0 ? t.runs : f == 1 ? t.misses : f == 2 ? t.jitterMaxUs : t.jitterSumUs);
+      snprintf(row, sizeof(row), "%.*s{task=\"%s\"} %s\n", (int)(space - taskFamilies[f]), taskFamilies[f],
+               t.name, value);
+      historyWrite(row);
+    }
+  }
+  snprintf(row, sizeof(row), "# TYPE scheduler_idle_milliseconds_total counter\n"
+           "scheduler_idle_milliseconds_total %lu\n", (unsigned long)idleMs);
+  historyWrite(row);
+  snprintf(row, sizeof(row), "# TYPE uptime_seconds gauge\nuptime_seconds %lu\n",
+           (unsigned long)(uptimeDeciseconds() / 10));
+  historyWrite(row);
+
+  httpSendChunk(historyChunk, historyChunkLen);
+  httpEndChunked();
+}
+
+// ---------------- Adaptive Sampling ----------------
+// Permille of the way from SAMPLE_MAX_MS down to SAMPLE_MIN_MS for a reading
+// distance away from where it would switch an output: all of it within band,
+// none from twice that
+uint16_t sampleNearness(int32_t distance, int32_t band) {
+  if(distance < 0) distance = -distance;
+  if(distance <= band) return 1000;
+  return distance >= 2 * band ? 0 : 1000 - (distance - band) * 1000 / band;
+}
+
+// Time until the next DHT read, from the readings readSensors() has just
+// taken. The switching points are the configured thresholds; outputs driven
+// by uploaded rules only get the rate term.
+uint32_t nextSampleInterval() {
+  uint32_t now = millis();
+  uint16_t urgency = 0;
+  if(!temperature.valid) {
+    urgency = 1000;     // a failed read is retried as soon as the DHT allows
+  } else if(sampleLastTemp.valid) {
+    uint32_t elapsed = now - sampleLastMs;
+    uint32_t rate = (uint32_t)abs(temperature.centi - sampleLastTemp.centi) * 60000 / (elapsed ? elapsed : 1);
+    urgency = rate >= SAMPLE_FAST_RATE ? 1000 : rate * 1000 / SAMPLE_FAST_RATE;
+  }
+  if(mode == "automatic") {
+    uint16_t near;
+    if(temperature.valid) {
+      near = sampleNearness(temperature.centi - (pumpState ? config.tempThreshold - TEMP_HYSTERESIS : config.tempThreshold),
+                            SAMPLE_NEAR_TEMP);
+      if(near > urgency) urgency = near;
+    }
+    near = sampleNearness(lightPercent - (lightState ? config.lightThreshold + LIGHT_HYSTERESIS : config.lightThreshold),
+                          SAMPLE_NEAR_LIGHT);
+    if(near > urgency) urgency = near;
+  }
+  sampleLastMs = now;
+  sampleLastTemp = temperature;
+
+  uint32_t interval = SAMPLE_MAX_MS - (uint32_t)(SAMPLE_MAX_MS - SAMPLE_MIN_MS) * urgency / 1000;
+  uint32_t longest = sampleIntervalMs + sampleIntervalMs * SAMPLE_STRETCH_PCT / 100;
+  return interval < longest ? interval : longest;
+}
+
+// Brings the next readSensors() run forward to the earliest the DHT allows;
+// nothing to do once it is due, which it can be in this very pass
+void pullSampleIn() {
+  uint32_t now = millis();
+  uint32_t earliest = sampleLastMs + SAMPLE_MIN_MS;
+  if(sensorTask < 0 || (int32_t)(now - tasks[sensorTask].dueMs) >= 0) return;
+  if((int32_t)(tasks[sensorTask].dueMs - earliest) <= 0) return;
+  int32_t wait = earliest - now;
+  rescheduleTask(sensorTask, wait > 0 ? wait : 0);
 }
 
 // ---------------- Functions ----------------
 void applyAutomaticMode() {
-  // Pump control - turn ON pump if temperature >= 32°C
-  if(!isnan(temperature) && temperature >= TEMP_THRESHOLD){ 
-    setPump(true); 
-  } else { 
-    setPump(false); 
+  bool newPumpState = pumpState;
+  bool newLightState = lightState;
+
+  // Pump control - ON at >= 32°C, OFF again below 31°C or on a failed read
+  if(temperature.valid && temperature.centi >= config.tempThreshold){ 
+    newPumpState = true; 
+  } else if(!temperature.valid || temperature.centi < config.tempThreshold - TEMP_HYSTERESIS){ 
+    newPumpState = false; 
   }
   
-  // Light control - turn ON LED if light is low
-  if(lightPercent < LIGHT_THRESHOLD){ 
-    setLight(true); 
-  } else { 
-    setLight(false); 
+  // Light control - ON below 50%, OFF again at 55% or above
+  if(lightPercent < config.lightThreshold){ 
+    newLightState = true; 
+  } else if(lightPercent >= config.lightThreshold + LIGHT_HYSTERESIS){ 
+    newLightState = false; 
+  }
+
+  // Uploaded rules replace the thresholds for the targets they drive
+  if(rules.codeLen > 0){
+    bool want[RULE_TARGETS] = { newPumpState, newLightState };
+    int32_t vars[RULE_VAR_COUNT];
+    unsigned long start = micros();
+    ruleInputs(vars);
+    evalRules(rules, vars, want);
+    observe(ruleEvalHist, micros() - start);
+    newPumpState = want[RULE_PUMP];
+    newLightState = want[RULE_LIGHT];
+  }
+
+  if(newPumpState != pumpState && guardAllowsSwitch(pumpGuard, pumpState)){
+    setPump(newPumpState);
+  }
+  if(newLightState != lightState && guardAllowsSwitch(lightGuard, lightState)){
+    setLight(newLightState);
   }
 }
 
 void setPump(bool state){
   if (pumpState != state) {
     pumpState = state;
+    guardNoteSwitch(pumpGuard);
+    pumpSwitches++;
+    traceInstant(TRACE_PUMP, state);
     if(state){
-      analogWrite(ENA, pumpSpeedPWM); // Pump at full speed
-      Serial.println("Pump: ON (Full speed)");
+      analogWrite(ENA, config.pumpSpeedPWM); // Pump at full speed
+      LOG(LOG_PUMP_ON);
     } else {
       analogWrite(ENA, 0);
-      Serial.println("Pump: OFF");
+      LOG(LOG_PUMP_OFF);
     }
   }
 }
@@ -426,12 +1422,99 @@ void setPump(bool state){
 void setLight(bool state){
   if (lightState != state) {
     lightState = state;
+    guardNoteSwitch(lightGuard);
+    lightSwitches++;
+    traceInstant(TRACE_LIGHT, state);
     if(state){
-      analogWrite(ENB, ledBrightness); // LED at full brightness
-      Serial.println("LED: ON (Full brightness)");
+      analogWrite(ENB, config.ledBrightness); // LED at full brightness
+      LOG(LOG_LED_ON);
     } else {
       analogWrite(ENB, 0);
-      Serial.println("LED: OFF");
+      LOG(LOG_LED_OFF);
+    }
+  }
+}
+
+// ---------------- Automation Rules ----------------
+// The values OP_VAR reads, in ruleVars order
+void ruleInputs(int32_t vars[RULE_VAR_COUNT]) {
+  vars[0] = temperature.valid ? temperature.centi : RULE_UNKNOWN;
+  vars[1] = humidity.valid ? humidity.centi : RULE_UNKNOWN;
+  vars[2] = lightPercent * 100;
+  vars[3] = pumpState;
+  vars[4] = lightState;
+}
+
+// GET /rules             the rules in force (or staged)
+// GET /rules?set=TEXT    compile; 400 with the error, else apply on the next loop pass
+// GET /rules?set=        remove them: the /config thresholds drive both targets again
+void handleRules() {
+  if(httpHasArg("set")) {
+    RuleSet compiled;
+    char error[48];
+    if(!compileRules(httpArg("set").data(), compiled, error, sizeof(error))) {
+      httpSend(400, "text/plain", error);
+      return;
     }
+    if(!rulesPending) scheduleOnce("rules", 0, applyPendingRules);
+    pendingRules = compiled;
+    rulesPending = true;
   }
-}
\ No newline at end of file
+  httpSend(200, "application/json", rulesJson(rulesPending ? pendingRules : rules));
+}
+
+// ---------------- Runtime Config ----------------
+// GET /config                          current settings
+// GET /config?tempThreshold=31&...     validate all, apply on the next loop pass
+void handleConfig() {
+  if(httpArgCount > 0) {
+    Config c = configPending ? pendingConfig : config;
+    for(uint8_t i = 0; i < httpArgCount; i++) {
+      if(!setConfigValue(c, httpArgs[i].name, httpArgs[i].value.data())) {
+        char text[48];
+        snprintf(text, sizeof(text), "Invalid setting: %s", httpArgs[i].name.data());
+        httpSend(400, "text/plain", text);
+        return;
+      }
+    }
+    if(!validConfig(c)) {
+      httpSend(400, "text/plain", "Settings out of range");
+      return;
+    }
+    if(!configPending) scheduleOnce("config", 0, applyPendingConfig);
+    pendingConfig = c;
+    configPending = true;
+  }
+  httpSend(200, "application/json", configJson(configPending ? pendingConfig : config));
+}
+
+// ---------------- Boot Milestones ----------------
+// Records boot → milestone time once, for time-to-first-actuation/publish
+void markBootMilestone(unsigned long &slot, const char *what) {
+  if(slot != 0) return;
+  slot = millis();
+  LOG(LOG_BOOT, what, slot);
+}
+
+// ---------------- Tracing ----------------
+void traceHttpSink(const uint8_t *data, size_t len) {
+  historyWriteBytes((const char *)data, len);
+}
+
+// GET /trace: the ring as a binary dump, see traceWrite()
+void handleTrace() {
+  httpBeginChunked(200, "application/octet-stream");
+  historyChunkLen = 0;
+  traceWrite(traceHttpSink);
+  httpSendChunk(historyChunk, historyChunkLen);
+  httpEndChunked();
+}
+
+// ---------------- Fixed-Point Helpers ----------------
+// The DHT library only reports float; convert once here and stay integer after
+Reading toReading(float value) {
+  Reading r;
+  r.valid = !isnan(value);
+  r.centi = r.valid ? (int16_t)lroundf(value * 100) : 0;
+  return r;
+}
@@ -0,0 +1,62 @@
+// Fixed-point text: centi-units (2345 = 23.45°C or 23.45%) to and from
+// decimal strings with integer math only, and the strict number parsing
+// the handlers share for query and config values.
+#pragma once
+
+// ---------------- Prototypes ----------------
+// Plain C++ needs these; the Arduino IDE generates them only for .ino files
+const char *formatCenti(char *buf, int16_t centi);
+const char *scanCenti(const char *p, int16_t &out);
+bool parseCenti(const char *p, int16_t &out);
+bool parseUnsigned(const char *p, long maxValue, long &out);
+
+// ---------------- Fixed-Point Text ----------------
+// Formats centi-units with one decimal ("23.4", "-0.5") using integer math only
+const char *formatCenti(char *buf, int16_t centi) {
+  int16_t deci = centi >= 0 ? (centi + 5) / 10 : (centi - 5) / 10;
+  const char *sign = deci < 0 ? "-" : "";
+  if(deci < 0) deci = -deci;
+  snprintf(buf, 8, "%s%d.%d", sign, deci / 10, deci % 10);
+  return buf;
+}
+
+// Reads "31", "31.5" or "-0.25" as centi-units; returns the character after
+// the number, NULL if there is none at p
+const char *scanCenti(const char *p, int16_t &out) {
+  bool negative = *p == '-';
+  if(negative) p++;
+  if(!isdigit(*p)) return NULL;
+  long value = 0;
+  while(isdigit(*p)) {
+    value = value * 10 + (*p++ - '0');
+    if(value > 300) return NULL;
+  }
+  value *= 100;
+  if(*p == '.') {
+    p++;
+    if(!isdigit(*p)) return NULL;
+    value += (*p++ - '0') * 10;
+    if(isdigit(*p)) value += *p++ - '0';
+  }
+  out = negative ? -value : value;
+  return p;
+}
+
+// Parses "31", "31.5" or "-0.25" into centi-units; false on anything else
+bool parseCenti(const char *p, int16_t &out) {
+  p = scanCenti(p, out);
+  return p && !*p;
+}
+
+// Parses a plain decimal number no larger than maxValue
+bool parseUnsigned(const char *p, long maxValue, long &out) {
+  if(!*p) return false;
+  long value = 0;
+  for(; *p; p++) {
+    if(!isdigit(*p)) return false;
+    value = value * 10 + (*p - '0');
+    if(value > maxValue) return false;
+  }
+  out = value;
+  return true;
+}
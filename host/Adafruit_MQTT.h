@@ -0,0 +1,262 @@
+// Host stand-in for the Adafruit MQTT library: a small MQTT 3.1.1 client
+// (QoS 0 only) with the same API the sketches use. The transport lives in
+// Adafruit_MQTT_Client.h, as in the real library.
+#pragma once
+
+#include "Arduino.h"
+
+#include <poll.h>
+
+#define SUBSCRIPTIONDATALEN 100
+#define MAXSUBSCRIPTIONS 5
+#define MQTT_CONN_KEEPALIVE 300
+
+namespace host {
+  // Stands in for the sketch's user name in CONNECT and at the start of its
+  // topics, so boards built from one sketch each get their own feeds
+  // (node-0001/feeds/temperature) when a tool runs many of them
+  inline const char *mqttUser = nullptr;
+
+  // Optional hook called with the topic of every PUBLISH sent, as sent
+  inline void (*onMqttPublish)(const std::string &topic) = nullptr;
+}
+
+class Adafruit_MQTT;
+
+class Adafruit_MQTT_Subscribe {
+public:
+  Adafruit_MQTT_Subscribe(Adafruit_MQTT *mqtt, const char *topic, uint8_t qos = 0)
+    : topic(topic), qos(qos), mqtt_(mqtt) {}
+
+  const char *topic;
+  uint8_t qos;
+  uint8_t lastread[SUBSCRIPTIONDATALEN] = { 0 };
+  uint16_t datalen = 0;
+
+private:
+  Adafruit_MQTT *mqtt_;
+};
+
+class Adafruit_MQTT {
+public:
+  Adafruit_MQTT(const char *server, uint16_t port, const char *user, const char *pass)
+    : server_(server), port_(port), user_(user), pass_(pass) {}
+  virtual ~Adafruit_MQTT() {}
+
+  // 0 on success; -1 socket failure, otherwise the CONNACK return code
+  int8_t connect() {
+    if(!connectServer()) return -1;
+    rx_.clear();
+
+    std::string body;
+    putString(body, "MQTT");
+    body += (char)4;                                        // protocol level 3.1.1
+    uint8_t flags = 0x02;                                   // clean session
+    if(user_ && *user_) flags |= 0x80;
+    if(pass_ && *pass_) flags |= 0x40;
+    body += (char)flags;
+    body += (char)(MQTT_CONN_KEEPALIVE >> 8);
+    body += (char)(MQTT_CONN_KEEPALIVE & 0xFF);
+    putString(body, "");                                    // broker assigns the client id
+    if(flags & 0x80) putString(body, host::mqttUser ? host::mqttUser : user_);
+    if(flags & 0x40) putString(body, pass_);
+    if(!sendPacket(0x10, body)) return -1;
+
+    uint8_t type;
+    std::string packet;
+    if(!readPacket(type, packet, 5000) || (type >> 4) != 2 || packet.size() < 2) {
+      disconnectServer();
+      return -1;
+    }
+    if(packet[1] != 0) {
+      disconnectServer();
+      return packet[1];
+    }
+
+    // The real library (re)subscribes everything on connect
+    for(uint8_t i = 0; i < subCount_; i++) {
+      std::string sub;
+      uint16_t id = ++packetId_;
+      sub += (char)(id >> 8);
+      sub += (char)(id & 0xFF);
+      putString(sub, wireTopic(subs_[i]->topic).c_str());
+      sub += (char)0;
+      if(!sendPacket(0x82, sub)) return -1;
+    }
+    return 0;
+  }
+
+  const char *connectErrorString(int8_t code) {
+    switch(code) {
+      case 1: return "The Server does not support the level of the MQTT protocol requested";
+      case 2: return "The Client identifier is correct UTF-8 but not allowed by the Server";
+      case 3: return "The MQTT service is unavailable";
+      case 4: return "The data in the user name or password is malformed";
+      case 5: return "Not authorized to connect";
+      case -1: return "Connection failed";
+      default: return "Unknown error";
+    }
+  }
+
+  bool disconnect() {
+    if(connected()) sendPacket(0xE0, std::string());
+    return disconnectServer();
+  }
+
+  bool subscribe(Adafruit_MQTT_Subscribe *sub) {
+    if(subCount_ >= MAXSUBSCRIPTIONS) return false;
+    subs_[subCount_++] = sub;
+    return true;
+  }
+
+  bool publish(const char *topic, const char *payload, uint8_t qos = 0) {
+    (void)qos;
+    std::string body, wire = wireTopic(topic);
+    putString(body, wire.c_str());
+    body += payload;
+    if(host::onMqttPublish) host::onMqttPublish(wire);
+    return sendPacket(0x30, body);
+  }
+
+  bool ping(uint8_t = 1) { return sendPacket(0xC0, std::string()); }
+
+  // Waits up to timeout ms for a PUBLISH on one of our topics. On a virtual
+  // clock it does not block, but the wait still costs timeout ms of board
+  // time; under a host::onDelay scheduler it does not block either.
+  Adafruit_MQTT_Subscribe *readSubscription(int16_t timeout = 0) {
+    uint8_t type;
+    std::string packet;
+    uint64_t deadline = host::realMicros() + (uint64_t)timeout * 1000;
+    while(true) {
+      int waitMs = host::virtualClock || host::onDelay ? 0 : (int)(((int64_t)deadline - (int64_t)host::realMicros()) / 1000);
+      if(!readPacket(type, packet, waitMs > 0 ? waitMs : 0)) break;
+      if((type >> 4) != 3) continue;   // CONNACK/SUBACK/PINGRESP: nothing to hand back
+
+      size_t topicLen = ((uint8_t)packet[0] << 8) | (uint8_t)packet[1];
+      std::string topic = packet.substr(2, topicLen);
+      size_t payloadStart = 2 + topicLen + ((type & 0x06) ? 2 : 0);
+      for(uint8_t i = 0; i < subCount_; i++) {
+        if(topic != wireTopic(subs_[i]->topic)) continue;
+        size_t n = std::min(packet.size() - payloadStart, (size_t)SUBSCRIPTIONDATALEN - 1);
+        memcpy(subs_[i]->lastread, packet.data() + payloadStart, n);
+        subs_[i]->lastread[n] = 0;
+        subs_[i]->datalen = n;
+        return subs_[i];
+      }
+    }
+    if(host::virtualClock) host::advanceMicros((uint64_t)timeout * 1000);
+    return nullptr;
+  }
+
+  // Hands a PUBLISH to readSubscription() as if the broker had sent it, e.g.
+  // one replayed from a recording. feed is the topic or just its last path
+  // segment; false if no subscription matches.
+  bool deliver(const char *feed, const char *payload) {
+    for(uint8_t i = 0; i < subCount_; i++) {
+      const char *topic = subs_[i]->topic;
+      const char *slash = strrchr(topic, '/');
+      if(strcmp(topic, feed) != 0 && !(slash && strcmp(slash + 1, feed) == 0)) continue;
+      std::string body;
+      putString(body, wireTopic(topic).c_str());
+      body += payload;
+      rx_ += (char)0x30;
+      size_t len = body.size();
+      do {
+        uint8_t digit = len & 0x7F;
+        len >>= 7;
+        rx_ += (char)(len ? digit | 0x80 : digit);
+      } while(len);
+      rx_ += body;
+      return true;
+    }
+    return false;
+  }
+
+  virtual bool connected() = 0;
+
+protected:
+  virtual bool connectServer() = 0;
+  virtual bool disconnectServer() = 0;
+  virtual bool writeBytes(const uint8_t *buf, size_t len) = 0;
+  virtual int readBytes(uint8_t *buf, size_t len, int timeoutMs) = 0;
+
+  const char *server_;
+  uint16_t port_;
+
+private:
+  // topic as it goes on the wire, with host::mqttUser for our user name
+  std::string wireTopic(const char *topic) const {
+    size_t n = user_ ? strlen(user_) : 0;
+    if(!host::mqttUser || n == 0 || strncmp(topic, user_, n) != 0) return topic;
+    return host::mqttUser + std::string(topic + n);
+  }
+
+  static void putString(std::string &out, const char *s) {
+    size_t n = strlen(s);
+    out += (char)(n >> 8);
+    out += (char)(n & 0xFF);
+    out += s;
+  }
+
+  bool sendPacket(uint8_t header, const std::string &body) {
+    std::string packet(1, (char)header);
+    size_t len = body.size();
+    do {
+      uint8_t digit = len & 0x7F;
+      len >>= 7;
+      packet += (char)(len ? digit | 0x80 : digit);
+    } while(len);
+    packet += body;
+    return writeBytes((const uint8_t *)packet.data(), packet.size());
+  }
+
+  // Pulls one whole packet out of rx_, reading more if needed
+  bool readPacket(uint8_t &type, std::string &body, int timeoutMs) {
+    while(true) {
+      if(rx_.size() >= 2) {
+        size_t len = 0, pos = 1;
+        int shift = 0;
+        bool complete = false;
+        while(pos < rx_.size() && pos <= 4) {
+          uint8_t digit = rx_[pos++];
+          len |= (size_t)(digit & 0x7F) << shift;
+          shift += 7;
+          if(!(digit & 0x80)) { complete = true; break; }
+        }
+        if(complete && rx_.size() >= pos + len) {
+          type = rx_[0];
+          body.assign(rx_, pos, len);
+          rx_.erase(0, pos + len);
+          return true;
+        }
+      }
+      uint8_t buf[512];
+      int n = readBytes(buf, sizeof(buf), timeoutMs);
+      if(n <= 0) return false;
+      rx_.append((const char *)buf, n);
+    }
+  }
+
+  const char *user_;
+  const char *pass_;
+  Adafruit_MQTT_Subscribe *subs_[MAXSUBSCRIPTIONS] = {};
+  uint8_t subCount_ = 0;
+  uint16_t packetId_ = 0;
+  std::string rx_;
+};
+
+class Adafruit_MQTT_Publish {
+public:
+  Adafruit_MQTT_Publish(Adafruit_MQTT *mqtt, const char *topic, uint8_t qos = 0)
+    : mqtt_(mqtt), topic_(topic), qos_(qos) {}
+
+  bool publish(const char *payload) { return mqtt_->publish(topic_, payload, qos_); }
+  bool publish(int32_t i) { return publish(String((long)i).c_str()); }
+  bool publish(uint32_t i) { return publish(String((unsigned long)i).c_str()); }
+  bool publish(double f, uint8_t precision = 2) { return publish(String(f, precision).c_str()); }
+
+private:
+  Adafruit_MQTT *mqtt_;
+  const char *topic_;
+  uint8_t qos_;
+};
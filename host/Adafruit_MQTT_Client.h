@@ -0,0 +1,74 @@
+// Host transport for the Adafruit MQTT stand-in. The sketch's broker name is
+// ignored: HOST_MQTT_BROKER=host:port picks a local broker, and without it
+// connect() fails the way an unreachable broker would. With host::mqttLoopback
+// set there is no socket at all: connect() succeeds, publishes are counted and
+// dropped, and deliver() is the only source of incoming messages.
+#pragma once
+
+#include "Adafruit_MQTT.h"
+#include "WiFiClient.h"
+
+namespace host {
+  inline bool mqttLoopback = false;
+  inline uint32_t mqttLoopbackPublishes = 0;
+}
+
+class Adafruit_MQTT_Client : public Adafruit_MQTT {
+public:
+  Adafruit_MQTT_Client(WiFiClient *client, const char *server, uint16_t port,
+                       const char *user = "", const char *pass = "")
+    : Adafruit_MQTT(server, port, user, pass), client_(client) {}
+
+  bool connected() override { return loopbackUp_ || client_->connected(); }
+
+protected:
+  bool connectServer() override {
+    if(host::mqttLoopback) {
+      loopbackUp_ = host::wifiUp;
+      loopbackRx_.clear();
+      return loopbackUp_;
+    }
+    const char *broker = getenv("HOST_MQTT_BROKER");
+    if(!broker || !host::wifiUp) return false;
+    std::string spec = broker;
+    size_t colon = spec.find(':');
+    std::string hostName = spec.substr(0, colon);
+    uint16_t port = colon == std::string::npos ? 1883 : atoi(spec.c_str() + colon + 1);
+    return client_->connect(hostName.c_str(), port);
+  }
+
+  bool disconnectServer() override {
+    loopbackUp_ = false;
+    client_->stop();
+    return true;
+  }
+
+  bool writeBytes(const uint8_t *buf, size_t len) override {
+    if(loopbackUp_) {
+      if((buf[0] >> 4) == 1) loopbackRx_.append("\x20\x02\x00\x00", 4);   // CONNECT: accepted
+      if((buf[0] >> 4) == 3) host::mqttLoopbackPublishes++;
+      return true;
+    }
+    return client_->write(buf, len) == len;
+  }
+
+  int readBytes(uint8_t *buf, size_t len, int timeoutMs) override {
+    if(loopbackUp_) {
+      size_t n = std::min(len, loopbackRx_.size());
+      memcpy(buf, loopbackRx_.data(), n);
+      loopbackRx_.erase(0, n);
+      return n > 0 ? (int)n : -1;
+    }
+    if(client_->fd() < 0) return -1;
+    if(timeoutMs > 0) {
+      pollfd p = { client_->fd(), POLLIN, 0 };
+      poll(&p, 1, timeoutMs);
+    }
+    return client_->read(buf, len);
+  }
+
+private:
+  WiFiClient *client_;
+  bool loopbackUp_ = false;
+  std::string loopbackRx_;
+};
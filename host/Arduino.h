@@ -0,0 +1,336 @@
+// Host (Linux) stand-in for the parts of the Arduino/ESP8266 core the sketches use.
+// Lets a sketch .cpp be compiled into host tools (benchmarks, replay) unmodified.
+#pragma once
+
+#include <ctype.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <errno.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+
+using std::min;
+using std::max;
+
+// ---------------- Host Runtime ----------------
+namespace host {
+  // Virtual clock: when set, millis()/micros() only move when delay() or
+  // advanceMicros() is called, so replays can run far faster than real time
+  inline bool virtualClock = false;
+  inline uint64_t virtualMicros = 0;
+  inline bool quiet = getenv("HOST_QUIET") != nullptr;   // silence Serial output
+
+  // Simulated board inputs, set by the host tool driving the sketch
+  inline int analogValue[1] = { 512 };
+  inline int digitalValue[32] = { 0 };
+  inline int pinOutput[32] = { 0 };      // last digitalWrite/analogWrite per pin
+
+  // Optional hook called on every digitalWrite/analogWrite (pin, value, analog)
+  inline void (*onPinWrite)(uint8_t, int, bool) = nullptr;
+
+  // Optional hook called on every pinMode (pin, mode)
+  inline void (*onPinMode)(uint8_t, uint8_t) = nullptr;
+
+  // Optional source for analogRead(), e.g. to model an external multiplexer
+  inline int (*analogSource)(uint8_t pin) = nullptr;
+
+  // Optional scheduler for tools that run many boards on one thread: delay()
+  // hands it the wait instead of blocking, and the tool runs the board again
+  // once that time has passed
+  inline void (*onDelay)(unsigned long ms) = nullptr;
+
+  // Real time the board booted at; millis()/micros() count from it
+  inline uint64_t bootMicros = 0;
+
+  inline uint64_t realMicros() {
+    static const auto start = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - start).count();
+  }
+
+  inline void advanceMicros(uint64_t us) { virtualMicros += us; }
+}
+
+// ---------------- Pins ----------------
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+
+// NodeMCU pin names mapped to GPIO numbers
+#define D0 16
+#define D1 5
+#define D2 4
+#define D3 0
+#define D4 2
+#define D5 14
+#define D6 12
+#define D7 13
+#define D8 15
+#define A0 17
+
+inline void pinMode(uint8_t pin, uint8_t mode) {
+  if(host::onPinMode) host::onPinMode(pin, mode);
+}
+
+inline void digitalWrite(uint8_t pin, uint8_t value) {
+  host::pinOutput[pin & 31] = value;
+  if(host::onPinWrite) host::onPinWrite(pin, value, false);
+}
+
+inline int digitalRead(uint8_t pin) { return host::digitalValue[pin & 31]; }
+
+inline void analogWrite(uint8_t pin, int value) {
+  host::pinOutput[pin & 31] = value;
+  if(host::onPinWrite) host::onPinWrite(pin, value, true);
+}
+
+inline int analogRead(uint8_t pin) { return host::analogSource ? host::analogSource(pin) : host::analogValue[0]; }
+
+// ---------------- Time ----------------
+inline unsigned long micros() {
+  return (unsigned long)(uint32_t)(host::virtualClock ? host::virtualMicros : host::realMicros() - host::bootMicros);
+}
+
+inline unsigned long millis() {
+  return (unsigned long)(uint32_t)((host::virtualClock ? host::virtualMicros : host::realMicros() - host::bootMicros) / 1000);
+}
+
+inline void delay(unsigned long ms) {
+  if(host::onDelay) host::onDelay(ms);
+  else if(host::virtualClock) host::advanceMicros((uint64_t)ms * 1000);
+  else std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+inline void delayMicroseconds(unsigned int us) {
+  if(host::virtualClock) host::advanceMicros(us);
+  else std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+inline void yield() {}
+
+// ---------------- Math ----------------
+inline long map(long x, long inMin, long inMax, long outMin, long outMax) {
+  return (x - inMin) * (outMax - outMin) / (inMax - inMin) + outMin;
+}
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+// ---------------- String ----------------
+class String {
+public:
+  String() {}
+  String(const char *s) : s_(s ? s : "") {}
+  String(const std::string &s) : s_(s) {}
+  String(char c) : s_(1, c) {}
+  String(int v) : s_(std::to_string(v)) {}
+  String(unsigned int v) : s_(std::to_string(v)) {}
+  String(long v) : s_(std::to_string(v)) {}
+  String(unsigned long v) : s_(std::to_string(v)) {}
+  String(double v, int decimals = 2) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%.*f", decimals, v);
+    s_ = buf;
+  }
+
+  const char *c_str() const { return s_.c_str(); }
+  unsigned int length() const { return s_.size(); }
+  long toInt() const { return atol(s_.c_str()); }
+  char charAt(unsigned int i) const { return i < s_.size() ? s_[i] : 0; }
+  char operator[](unsigned int i) const { return charAt(i); }
+  void reserve(unsigned int n) { s_.reserve(n); }
+
+  int indexOf(char c, unsigned int from = 0) const {
+    size_t i = s_.find(c, from);
+    return i == std::string::npos ? -1 : (int)i;
+  }
+  int indexOf(const String &str, unsigned int from = 0) const {
+    size_t i = s_.find(str.s_, from);
+    return i == std::string::npos ? -1 : (int)i;
+  }
+  String substring(unsigned int from) const { return from < s_.size() ? String(s_.substr(from)) : String(); }
+  String substring(unsigned int from, unsigned int to) const {
+    if(from >= s_.size() || to <= from) return String();
+    return String(s_.substr(from, to - from));
+  }
+  bool startsWith(const String &p) const { return s_.compare(0, p.s_.size(), p.s_) == 0; }
+
+  void replace(const String &from, const String &to) {
+    if(from.s_.empty()) return;
+    size_t pos = 0;
+    while((pos = s_.find(from.s_, pos)) != std::string::npos) {
+      s_.replace(pos, from.s_.size(), to.s_);
+      pos += to.s_.size();
+    }
+  }
+
+  String &operator+=(const String &o) { s_ += o.s_; return *this; }
+  String &operator+=(const char *o) { s_ += o; return *this; }
+  String &operator+=(char c) { s_ += c; return *this; }
+  bool concat(const String &o) { s_ += o.s_; return true; }
+
+  bool operator==(const String &o) const { return s_ == o.s_; }
+  bool operator==(const char *o) const { return s_ == o; }
+  bool operator!=(const String &o) const { return s_ != o.s_; }
+  bool operator!=(const char *o) const { return s_ != o; }
+
+  const std::string &str() const { return s_; }
+
+private:
+  std::string s_;
+};
+
+inline String operator+(const String &a, const String &b) { String r(a); r += b; return r; }
+inline String operator+(const String &a, const char *b) { String r(a); r += b; return r; }
+inline String operator+(const char *a, const String &b) { String r(a); r += b; return r; }
+
+// ---------------- Serial ----------------
+// With uartBaud set (HOST_UART_BAUD), writes go through a model of the
+// ESP8266 UART: a 128-byte TX FIFO emptied at the baud rate, and a write
+// that finds it full waits for room (in virtual time under the virtual clock)
+class HostSerial {
+public:
+  static const size_t FIFO_BYTES = 128;
+  unsigned long uartBaud = getenv("HOST_UART_BAUD") ? strtoul(getenv("HOST_UART_BAUD"), nullptr, 10) : 0;
+
+  void begin(unsigned long) {}
+  size_t write(const uint8_t *buf, size_t n) {
+    uartSend(n);
+    if(host::quiet) return n;
+    return fwrite(buf, 1, n, stdout);
+  }
+  size_t write(uint8_t b) { return write(&b, 1); }
+  size_t write(const char *s) { return write((const uint8_t *)s, strlen(s)); }
+  int availableForWrite() {
+    if(!uartBaud) return FIFO_BYTES;
+    double queued = (fifoEmptyAtUs - nowUs()) * uartBaud / 10e6;
+    return queued <= 0 ? FIFO_BYTES : FIFO_BYTES - std::min<size_t>(FIFO_BYTES, (size_t)ceil(queued));
+  }
+  size_t print(const char *s) { return write(s); }
+  size_t print(const String &s) { return write(s.c_str()); }
+  size_t print(char c) { char b[2] = { c, 0 }; return write(b); }
+  size_t print(int v) { return print(String(v)); }
+  size_t print(unsigned int v) { return print(String(v)); }
+  size_t print(long v) { return print(String(v)); }
+  size_t print(unsigned long v) { return print(String(v)); }
+  size_t print(double v, int decimals = 2) { return print(String(v, decimals)); }
+  template <typename T> size_t println(const T &v) { return print(v) + write("\n"); }
+  size_t println() { return write("\n"); }
+  size_t printf(const char *fmt, ...) __attribute__((format(printf, 2, 3))) {
+    char buf[512];
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+    return write(buf);
+  }
+  // Bytes for the sketch to read, queued by the host tool
+  std::string input;
+  int available() { return input.size(); }
+  int read() {
+    if(input.empty()) return -1;
+    uint8_t c = input[0];
+    input.erase(0, 1);
+    return c;
+  }
+  void flush() { if(!host::quiet) fflush(stdout); }
+
+private:
+  double fifoEmptyAtUs = 0;
+
+  static double nowUs() { return host::virtualClock ? host::virtualMicros : host::realMicros(); }
+
+  void uartSend(size_t n) {
+    if(!uartBaud) return;
+    double byteUs = 10e6 / uartBaud;   // 8N1: 10 bits per byte
+    double now = nowUs();
+    if(fifoEmptyAtUs < now) fifoEmptyAtUs = now;
+    fifoEmptyAtUs += n * byteUs;
+    // Whatever does not fit in the FIFO has to wait for it to drain
+    double waitUs = fifoEmptyAtUs - FIFO_BYTES * byteUs - now;
+    if(waitUs <= 0) return;
+    if(host::virtualClock) host::advanceMicros((uint64_t)ceil(waitUs));
+    else std::this_thread::sleep_for(std::chrono::microseconds((uint64_t)ceil(waitUs)));
+  }
+};
+
+inline HostSerial Serial;
+
+// ---------------- ESP ----------------
+namespace host {
+  // Heap accounting for the sketch thread, fed by the operator new hooks in
+  // host/heap_track.h when a tool includes it
+  inline std::atomic<long> heapInUse{0};
+  inline std::atomic<long> heapPeak{0};
+  inline const long heapSize = 52 * 1024;   // typical free heap on an idle ESP8266 sketch
+  inline uint32_t rtcMemory[128];
+
+  // Optional hook called by ESP.deepSleep() with the sleep length, before the
+  // board stops (the process exits)
+  inline void (*onDeepSleep)(uint64_t us) = nullptr;
+
+  // Erased flash sectors standing in for the ones the sketches keep their
+  // config and rules logs in. Writes can only clear bits, as on NOR flash.
+  inline const uint32_t flashSectors = 2;
+  inline uint8_t *flash = [] {
+    static uint8_t sectors[2 * 4096];
+    memset(sectors, 0xFF, sizeof(sectors));
+    return sectors;
+  }();
+}
+
+#define SPI_FLASH_SEC_SIZE 4096
+#define CONFIG_FLASH_SECTOR 0
+#define RULES_FLASH_SECTOR 1
+
+class HostESP {
+public:
+  uint32_t getFreeHeap() { return host::heapSize - host::heapInUse.load(); }
+  uint32_t getMaxFreeBlockSize() { return getFreeHeap(); }
+  uint8_t getHeapFragmentation() { return 0; }
+  uint32_t getCycleCount() { return (uint32_t)(micros() * 80); }
+  bool rtcUserMemoryRead(uint32_t offset, uint32_t *data, size_t size) {
+    if(offset * 4 + size > sizeof(host::rtcMemory)) return false;
+    memcpy(data, (uint8_t *)host::rtcMemory + offset * 4, size);
+    return true;
+  }
+  bool rtcUserMemoryWrite(uint32_t offset, uint32_t *data, size_t size) {
+    if(offset * 4 + size > sizeof(host::rtcMemory)) return false;
+    memcpy((uint8_t *)host::rtcMemory + offset * 4, data, size);
+    return true;
+  }
+  bool flashEraseSector(uint32_t sector) {
+    if(sector >= host::flashSectors) return false;
+    memset(host::flash + sector * SPI_FLASH_SEC_SIZE, 0xFF, SPI_FLASH_SEC_SIZE);
+    return true;
+  }
+  bool flashWrite(uint32_t address, const uint32_t *data, size_t size) {
+    if(address + size > host::flashSectors * SPI_FLASH_SEC_SIZE) return false;
+    for(size_t i = 0; i < size; i++) host::flash[address + i] &= ((const uint8_t *)data)[i];
+    return true;
+  }
+  bool flashRead(uint32_t address, uint32_t *data, size_t size) {
+    if(address + size > host::flashSectors * SPI_FLASH_SEC_SIZE) return false;
+    memcpy(data, host::flash + address, size);
+    return true;
+  }
+  void deepSleep(uint64_t us, int = 0) {
+    if(host::onDeepSleep) host::onDeepSleep(us);
+    exit(0);
+  }
+  void restart() { exit(0); }
+};
+
+inline HostESP ESP;
+
+#define WAKE_RF_DEFAULT 0
@@ -0,0 +1,46 @@
+// Host stand-in for the Adafruit DHT library; readings come from host::dhtTemp/dhtHum.
+#pragma once
+
+#include "Arduino.h"
+
+#define DHT11 11
+#define DHT22 22
+
+namespace host {
+  inline float dhtTemp = 25.0f;   // NAN simulates a failed read
+  inline float dhtHum = 60.0f;
+  inline unsigned long dhtReadMicros = 0;   // simulated time per read (virtual clock)
+  inline uint32_t dhtTransfers = 0;         // reads that reached the sensor
+}
+
+class DHT {
+public:
+  DHT(uint8_t, uint8_t) {}
+  void begin() {}
+  float readTemperature() {
+    read();
+    return temp;
+  }
+  float readHumidity() {
+    read();
+    return hum;
+  }
+
+private:
+  // As in the library, a read within 2 s of the last one that reached the
+  // sensor hands back that reading again
+  void read() {
+    unsigned long now = millis();
+    if(transfers && now - lastMs < 2000) return;
+    lastMs = now;
+    transfers++;
+    host::dhtTransfers++;
+    if(host::virtualClock) host::advanceMicros(host::dhtReadMicros);
+    temp = host::dhtTemp;
+    hum = host::dhtHum;
+  }
+
+  unsigned long lastMs = 0;
+  uint32_t transfers = 0;
+  float temp = NAN, hum = NAN;
+};
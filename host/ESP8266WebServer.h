@@ -0,0 +1,297 @@
+// Host stand-in for ESP8266WebServer on a loopback TCP socket. Like the real
+// server it serves one request per handleClient() call and closes afterwards.
+#pragma once
+
+#include "ESP8266WiFi.h"
+
+#include <functional>
+#include <vector>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+enum HTTPMethod { HTTP_ANY, HTTP_GET, HTTP_HEAD, HTTP_POST, HTTP_PUT, HTTP_PATCH, HTTP_DELETE, HTTP_OPTIONS };
+
+#define CONTENT_LENGTH_UNKNOWN ((size_t)-1)
+#define CONTENT_LENGTH_NOT_SET ((size_t)-2)
+
+namespace host {
+  // Called after each request: path, status, response bytes, handler time, heap growth
+  inline std::function<void(const String &, int, size_t, uint64_t, long)> onRequestDone;
+}
+
+class ESP8266WebServer {
+public:
+  typedef std::function<void(void)> THandlerFunction;
+
+  explicit ESP8266WebServer(int port = 80) : port_(port) {}
+
+  void on(const String &uri, THandlerFunction fn) { on(uri, HTTP_ANY, fn); }
+  void on(const String &uri, HTTPMethod method, THandlerFunction fn) {
+    routes_.push_back({ uri, method, fn });
+  }
+  void onNotFound(THandlerFunction fn) { notFound_ = fn; }
+
+  // Port 80 needs root on a host; HOST_HTTP_PORT overrides, else low ports get +8000
+  void begin() {
+    int port = getenv("HOST_HTTP_PORT") ? atoi(getenv("HOST_HTTP_PORT")) : (port_ < 1024 ? port_ + 8000 : port_);
+    listenFd_ = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(listenFd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if(bind(listenFd_, (sockaddr *)&addr, sizeof(addr)) < 0 || listen(listenFd_, 128) < 0) {
+      perror("ESP8266WebServer: bind/listen");
+      exit(1);
+    }
+    fcntl(listenFd_, F_SETFL, O_NONBLOCK);
+  }
+
+  void handleClient() {
+    // Injected requests first, served the same way with the response discarded
+    if(!injected_.empty()) {
+      Injected r = injected_.front();
+      injected_.erase(injected_.begin());
+      resetRequest();
+      method_ = r.method;
+      uri_ = r.uri;
+      args_ = r.args;
+      current_ = WiFiClient();
+      dispatch();
+      return;
+    }
+    int fd = accept(listenFd_, nullptr, nullptr);
+    if(fd < 0) return;
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    current_ = WiFiClient(fd);
+    if(readRequest(fd)) dispatch();
+    current_ = WiFiClient();   // drops our reference; a handler may still hold one
+  }
+
+  // Queues a request that did not come over the socket, e.g. one replayed
+  // from a recording; the next handleClient() serves it
+  void inject(HTTPMethod method, const String &uri, const std::vector<std::pair<String, String>> &args) {
+    injected_.push_back({ method, uri, args });
+  }
+
+  // ---- Request
+  String uri() { return uri_; }
+  HTTPMethod method() { return method_; }
+  WiFiClient client() { return current_; }
+  int args() { return args_.size(); }
+  String argName(int i) { return i < (int)args_.size() ? args_[i].first : String(); }
+  String arg(int i) { return i < (int)args_.size() ? args_[i].second : String(); }
+  String arg(const String &name) {
+    for(auto &a : args_) if(a.first == name) return a.second;
+    return String();
+  }
+  bool hasArg(const String &name) {
+    for(auto &a : args_) if(a.first == name) return true;
+    return false;
+  }
+  String header(const String &name) {
+    for(auto &h : headers_) if(strcasecmp(h.first.c_str(), name.c_str()) == 0) return h.second;
+    return String();
+  }
+
+  // ---- Response
+  void sendHeader(const String &name, const String &value, bool = false) {
+    extraHeaders_ += name + ": " + value + "\r\n";
+  }
+  void setContentLength(size_t len) { contentLength_ = len; }
+
+  void send(int code, const char *type = "text/plain", const String &content = String()) {
+    status_ = code;
+    chunked_ = contentLength_ == CONTENT_LENGTH_UNKNOWN;
+    String head = String("HTTP/1.1 ") + String(code) + " " + reason(code) + "\r\n";
+    head += String("Content-Type: ") + type + "\r\n";
+    if(chunked_) head += "Transfer-Encoding: chunked\r\n";
+    else head += String("Content-Length: ") + String((unsigned long)content.length()) + "\r\n";
+    head += extraHeaders_;
+    head += "Connection: close\r\n\r\n";
+    current_.print(head);
+    if(chunked_) {
+      if(content.length()) sendContent(content);
+    } else {
+      current_.print(content);
+    }
+    sent_ = true;
+  }
+  void send(int code, const String &type, const String &content) { send(code, type.c_str(), content); }
+
+  void sendContent(const char *data, size_t len) {
+    if(chunked_) {
+      char size[24];
+      snprintf(size, sizeof(size), "%zx\r\n", len);
+      current_.write(size);
+      if(len) current_.write((const uint8_t *)data, len);
+      current_.write("\r\n");
+    } else {
+      current_.write((const uint8_t *)data, len);
+    }
+  }
+  void sendContent(const String &s) { sendContent(s.c_str(), s.length()); }
+
+private:
+  struct Route {
+    String uri;
+    HTTPMethod method;
+    THandlerFunction fn;
+  };
+
+  struct Injected {
+    HTTPMethod method;
+    String uri;
+    std::vector<std::pair<String, String>> args;
+  };
+
+  static const char *reason(int code) {
+    switch(code) {
+      case 200: return "OK";
+      case 204: return "No Content";
+      case 304: return "Not Modified";
+      case 400: return "Bad Request";
+      case 404: return "Not Found";
+      case 409: return "Conflict";
+      case 503: return "Service Unavailable";
+      default: return "Status";
+    }
+  }
+
+  static String urlDecode(const std::string &s) {
+    std::string out;
+    for(size_t i = 0; i < s.size(); i++) {
+      if(s[i] == '+') out += ' ';
+      else if(s[i] == '%' && i + 2 < s.size()) {
+        out += (char)strtol(s.substr(i + 1, 2).c_str(), nullptr, 16);
+        i += 2;
+      } else out += s[i];
+    }
+    return String(out);
+  }
+
+  void parseArgs(const std::string &q) {
+    size_t pos = 0;
+    while(pos < q.size()) {
+      size_t amp = q.find('&', pos);
+      if(amp == std::string::npos) amp = q.size();
+      std::string pair = q.substr(pos, amp - pos);
+      size_t eq = pair.find('=');
+      if(!pair.empty()) {
+        args_.push_back({ urlDecode(pair.substr(0, eq)),
+                          eq == std::string::npos ? String() : urlDecode(pair.substr(eq + 1)) });
+      }
+      pos = amp + 1;
+    }
+  }
+
+  void resetRequest() {
+    args_.clear();
+    headers_.clear();
+    extraHeaders_ = String();
+    contentLength_ = CONTENT_LENGTH_NOT_SET;
+    chunked_ = false;
+    sent_ = false;
+    status_ = 0;
+  }
+
+  bool readRequest(int fd) {
+    std::string buf;
+    char chunk[1024];
+    size_t headerEnd;
+    while((headerEnd = buf.find("\r\n\r\n")) == std::string::npos) {
+      pollfd p = { fd, POLLIN, 0 };
+      if(poll(&p, 1, 5000) <= 0) return false;   // HTTP_MAX_DATA_WAIT
+      ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+      if(n <= 0) return false;
+      buf.append(chunk, n);
+    }
+
+    resetRequest();
+
+    size_t lineEnd = buf.find("\r\n");
+    std::string line = buf.substr(0, lineEnd);
+    size_t sp1 = line.find(' '), sp2 = line.rfind(' ');
+    if(sp1 == std::string::npos || sp2 == sp1) return false;
+    std::string m = line.substr(0, sp1);
+    method_ = m == "GET" ? HTTP_GET : m == "POST" ? HTTP_POST : m == "PUT" ? HTTP_PUT
+            : m == "DELETE" ? HTTP_DELETE : m == "HEAD" ? HTTP_HEAD : HTTP_ANY;
+    std::string target = line.substr(sp1 + 1, sp2 - sp1 - 1);
+    size_t qm = target.find('?');
+    uri_ = String(target.substr(0, qm));
+    if(qm != std::string::npos) parseArgs(target.substr(qm + 1));
+
+    size_t contentLength = 0;
+    size_t pos = lineEnd + 2;
+    while(pos < headerEnd) {
+      size_t e = buf.find("\r\n", pos);
+      std::string h = buf.substr(pos, e - pos);
+      size_t colon = h.find(':');
+      if(colon != std::string::npos) {
+        std::string v = h.substr(colon + 1);
+        v.erase(0, v.find_first_not_of(' '));
+        headers_.push_back({ String(h.substr(0, colon)), String(v) });
+        if(strcasecmp(h.substr(0, colon).c_str(), "Content-Length") == 0) contentLength = atol(v.c_str());
+      }
+      pos = e + 2;
+    }
+
+    std::string body = buf.substr(headerEnd + 4);
+    while(body.size() < contentLength) {
+      pollfd p = { fd, POLLIN, 0 };
+      if(poll(&p, 1, 5000) <= 0) return false;
+      ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+      if(n <= 0) return false;
+      body.append(chunk, n);
+    }
+    if(contentLength > 0) {
+      if(strstr(header("Content-Type").c_str(), "x-www-form-urlencoded")) parseArgs(body);
+      args_.push_back({ String("plain"), String(body) });
+    }
+    return true;
+  }
+
+  void dispatch() {
+    uint64_t start = host::realMicros();
+    long heapBase = host::heapInUse.load();
+    host::heapPeak = heapBase;
+
+    bool handled = false;
+    for(auto &r : routes_) {
+      if(r.uri == uri_ && (r.method == HTTP_ANY || r.method == method_)) {
+        r.fn();
+        handled = true;
+        break;
+      }
+    }
+    if(!handled) {
+      if(notFound_) notFound_();
+      else send(404, "text/plain", String("Not found: ") + uri_);
+    }
+
+    if(host::onRequestDone) {
+      host::onRequestDone(uri_, status_, current_.bytesSent(), host::realMicros() - start,
+                          host::heapPeak.load() - heapBase);
+    }
+  }
+
+  int port_;
+  int listenFd_ = -1;
+  std::vector<Route> routes_;
+  std::vector<Injected> injected_;
+  THandlerFunction notFound_;
+  WiFiClient current_;
+  String uri_;
+  HTTPMethod method_ = HTTP_GET;
+  std::vector<std::pair<String, String>> args_;
+  std::vector<std::pair<String, String>> headers_;
+  String extraHeaders_;
+  size_t contentLength_ = CONTENT_LENGTH_NOT_SET;
+  bool chunked_ = false;
+  bool sent_ = false;
+  int status_ = 0;
+};
@@ -0,0 +1,70 @@
+// Host stand-in for ESP8266WiFi: the station is connected to loopback, at once
+// or after a simulated join time.
+#pragma once
+
+#include "Arduino.h"
+
+#define WL_IDLE_STATUS 0
+#define WL_DISCONNECTED 6
+#define WL_CONNECTED 3
+#define WIFI_STA 1
+#define WIFI_OFF 0
+
+class IPAddress {
+public:
+  IPAddress() : addr_(0) {}
+  IPAddress(uint32_t addr) : addr_(addr) {}
+  IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d)
+    : addr_(a | (b << 8) | (c << 16) | ((uint32_t)d << 24)) {}
+  operator uint32_t() const { return addr_; }
+  String toString() const {
+    char buf[16];
+    snprintf(buf, sizeof(buf), "%u.%u.%u.%u", addr_ & 0xFF, (addr_ >> 8) & 0xFF,
+             (addr_ >> 16) & 0xFF, addr_ >> 24);
+    return String(buf);
+  }
+
+private:
+  uint32_t addr_;
+};
+
+namespace host {
+  inline bool wifiUp = true;   // host tools can take the link down to simulate outages
+
+  // Time from WiFi.begin() to connected: with the channel and BSSID given
+  // (the sketches' cached quick join), and with a full scan
+  inline unsigned long wifiQuickJoinMs = 0;
+  inline unsigned long wifiJoinMs = 0;
+}
+
+class HostWiFi {
+public:
+  void persistent(bool) {}
+  void mode(int) {}
+  void setAutoReconnect(bool) {}
+  void begin(const char *, const char *, int32_t channel = 0, const uint8_t *bssid = nullptr, bool = true) {
+    beginMs_ = millis();
+    joinMs_ = channel && bssid ? host::wifiQuickJoinMs : host::wifiJoinMs;
+  }
+  bool config(IPAddress, IPAddress, IPAddress, IPAddress = IPAddress()) { return true; }
+  void disconnect(bool = false) {}
+  void forceSleepBegin() {}
+  int status() { return host::wifiUp && millis() - beginMs_ >= joinMs_ ? WL_CONNECTED : WL_DISCONNECTED; }
+  bool isConnected() { return status() == WL_CONNECTED; }
+  IPAddress localIP() { return IPAddress(127, 0, 0, 1); }
+  IPAddress gatewayIP() { return IPAddress(127, 0, 0, 1); }
+  IPAddress subnetMask() { return IPAddress(255, 0, 0, 0); }
+  IPAddress dnsIP(uint8_t = 0) { return IPAddress(127, 0, 0, 1); }
+  uint8_t *BSSID() { static uint8_t bssid[6] = { 2, 0, 0, 0, 0, 1 }; return bssid; }
+  int32_t channel() { return 1; }
+  int32_t RSSI() { return -50; }
+
+private:
+  unsigned long beginMs_ = 0;
+  unsigned long joinMs_ = 0;
+};
+
+inline HostWiFi WiFi;
+
+#include "WiFiClient.h"
+#include "WiFiServer.h"
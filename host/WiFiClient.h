@@ -0,0 +1,163 @@
+// Host stand-in for WiFiClient over a POSIX socket. Copies share one
+// connection, which closes when the last copy goes away or stop() is called.
+#pragma once
+
+#include "Arduino.h"
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+
+namespace host {
+  // Called for each request served on a connection accepted by WiFiServer:
+  // its request line, response bytes, time from its first byte read to the
+  // last response byte written, and heap growth over that time. A read after
+  // a response starts the next request of a kept-alive connection; requests
+  // pipelined into one read count as one.
+  inline std::function<void(const std::string &, size_t, uint64_t, long)> onConnectionDone;
+}
+
+class WiFiClient {
+public:
+  WiFiClient() {}
+  explicit WiFiClient(int fd, bool accepted = false) : conn_(std::make_shared<Conn>(fd)) {
+    conn_->accepted = accepted;
+  }
+
+  // Blocking connect, as on the board; host tools point sketches at local
+  // servers rather than the real internet
+  int connect(const char *hostName, uint16_t port) {
+    addrinfo hints = {}, *ai = nullptr;
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    if(getaddrinfo(hostName, nullptr, &hints, &ai) != 0 || !ai) return 0;
+    sockaddr_in addr = *(sockaddr_in *)ai->ai_addr;
+    freeaddrinfo(ai);
+    addr.sin_port = htons(port);
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if(fd < 0) return 0;
+    if(::connect(fd, (sockaddr *)&addr, sizeof(addr)) < 0) {
+      ::close(fd);
+      return 0;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    conn_ = std::make_shared<Conn>(fd);
+    return 1;
+  }
+
+  bool connected() {
+    if(!conn_ || conn_->fd < 0) return false;
+    char c;
+    ssize_t n = recv(conn_->fd, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+    return n > 0 || (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK));
+  }
+  operator bool() { return connected(); }
+
+  int available() {
+    if(!conn_ || conn_->fd < 0) return 0;
+    char buf[256];
+    ssize_t n = recv(conn_->fd, buf, sizeof(buf), MSG_PEEK | MSG_DONTWAIT);
+    return n > 0 ? (int)n : 0;
+  }
+
+  int read() {
+    uint8_t c;
+    return read(&c, 1) == 1 ? c : -1;
+  }
+  int read(uint8_t *buf, size_t len) {
+    if(!conn_ || conn_->fd < 0) return -1;
+    ssize_t n = recv(conn_->fd, buf, len, MSG_DONTWAIT);
+    if(n > 0 && conn_->accepted) conn_->noteRead(buf, n);
+    return n > 0 ? (int)n : -1;
+  }
+
+  size_t write(const uint8_t *buf, size_t len) {
+    if(!conn_ || conn_->fd < 0) return 0;
+    size_t sent = 0;
+    while(sent < len) {
+      ssize_t n = send(conn_->fd, buf + sent, len - sent, MSG_NOSIGNAL);
+      if(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        pollfd p = { conn_->fd, POLLOUT, 0 };
+        poll(&p, 1, 1000);
+        continue;
+      }
+      if(n <= 0) break;
+      sent += n;
+    }
+    conn_->bytesSent += sent;
+    conn_->lastWriteUs = host::realMicros();
+    conn_->heapAtWrite = host::heapPeak.load() - conn_->heapBase;
+    return sent;
+  }
+  size_t write(const char *s) { return write((const uint8_t *)s, strlen(s)); }
+  size_t print(const String &s) { return write((const uint8_t *)s.c_str(), s.length()); }
+  size_t print(const char *s) { return write(s); }
+
+  void setNoDelay(bool noDelay) {
+    int v = noDelay;
+    if(conn_ && conn_->fd >= 0) setsockopt(conn_->fd, IPPROTO_TCP, TCP_NODELAY, &v, sizeof(v));
+  }
+  void stop() { if(conn_) conn_->close(); }
+
+  int fd() const { return conn_ ? conn_->fd : -1; }
+  size_t bytesSent() const { return conn_ ? conn_->bytesSent : 0; }
+  bool operator==(const WiFiClient &o) const { return conn_ == o.conn_; }
+
+private:
+  struct Conn {
+    int fd;
+    size_t bytesSent = 0;
+    bool accepted = false;
+    std::string firstLine;
+    bool lineDone = false;
+    uint64_t firstReadUs = 0;
+    uint64_t lastWriteUs = 0;
+    long heapBase = 0;
+    long heapAtWrite = 0;     // heap growth as of the last write
+
+    // Room for the request line up front, so recording it does not show as heap use
+    explicit Conn(int f) : fd(f) { firstLine.reserve(256); }
+    ~Conn() { close(); }
+
+    void noteRead(const uint8_t *buf, size_t n) {
+      if(bytesSent > 0) report();
+      if(firstReadUs == 0) {
+        firstReadUs = host::realMicros();
+        heapBase = host::heapInUse.load();
+        host::heapPeak = heapBase;
+      }
+      for(size_t i = 0; i < n && !lineDone; i++) {
+        if(buf[i] == '\r' || buf[i] == '\n' || firstLine.size() == firstLine.capacity()) lineDone = true;
+        else firstLine += (char)buf[i];
+      }
+    }
+
+    // Hands the request just answered to onConnectionDone and starts over
+    void report() {
+      if(accepted && firstReadUs && host::onConnectionDone) {
+        bool answered = bytesSent > 0;
+        host::onConnectionDone(firstLine, bytesSent, (answered ? lastWriteUs : host::realMicros()) - firstReadUs,
+                               answered ? heapAtWrite : host::heapPeak.load() - heapBase);
+      }
+      firstLine.clear();
+      lineDone = false;
+      firstReadUs = 0;
+      bytesSent = 0;
+    }
+
+    void close() {
+      if(fd < 0) return;
+      ::close(fd);
+      fd = -1;
+      report();
+    }
+  };
+  std::shared_ptr<Conn> conn_;
+};
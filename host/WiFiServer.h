@@ -0,0 +1,71 @@
+// Host stand-in for WiFiServer: a non-blocking listener on loopback.
+// Clients it hands out report to host::onConnectionDone when they close.
+// While host::wifiUp is false nothing is accepted; connections wait in the
+// backlog, as requests to a board off the network go unanswered.
+#pragma once
+
+#include "WiFiClient.h"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+
+class WiFiServer {
+public:
+  explicit WiFiServer(uint16_t port) : port_(port) {}
+
+  // Port 80 needs root on a host; HOST_HTTP_PORT overrides, else low ports get +8000
+  void begin() {
+    int port = getenv("HOST_HTTP_PORT") ? atoi(getenv("HOST_HTTP_PORT")) : (port_ < 1024 ? port_ + 8000 : port_);
+    listenFd_ = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(listenFd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if(bind(listenFd_, (sockaddr *)&addr, sizeof(addr)) < 0 || listen(listenFd_, 128) < 0) {
+      perror("WiFiServer: bind/listen");
+      exit(1);
+    }
+    fcntl(listenFd_, F_SETFL, O_NONBLOCK);
+  }
+
+  void stop() {
+    if(listenFd_ >= 0) ::close(listenFd_);
+    listenFd_ = -1;
+  }
+
+  // Port actually listened on (HOST_HTTP_PORT=0 picks a free one), 0 before begin()
+  uint16_t port() const {
+    sockaddr_in addr = {};
+    socklen_t len = sizeof(addr);
+    if(listenFd_ < 0 || getsockname(listenFd_, (sockaddr *)&addr, &len) < 0) return 0;
+    return ntohs(addr.sin_port);
+  }
+
+  // A newly connected client, or an empty WiFiClient if none is waiting
+  WiFiClient accept() {
+    if(listenFd_ < 0 || !host::wifiUp) return WiFiClient();
+    int fd = accept4(listenFd_, nullptr, nullptr, 0);
+    if(fd < 0) return WiFiClient();
+    WiFiClient client(fd, true);
+    client.setNoDelay(noDelay_);
+    return client;
+  }
+  WiFiClient available() { return accept(); }
+
+  // A connection is waiting to be accepted
+  bool hasClient() {
+    if(listenFd_ < 0 || !host::wifiUp) return false;
+    pollfd p = { listenFd_, POLLIN, 0 };
+    return poll(&p, 1, 0) > 0;
+  }
+
+  void setNoDelay(bool noDelay) { noDelay_ = noDelay; }
+  bool getNoDelay() { return noDelay_; }
+
+private:
+  uint16_t port_;
+  int listenFd_ = -1;
+  bool noDelay_ = false;
+};
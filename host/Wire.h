@@ -0,0 +1,54 @@
+// Host stand-in for the Arduino Wire (I2C) library. Writes are counted so
+// host tools can estimate bus time; onI2cWrite sees every finished transfer.
+#pragma once
+
+#include "Arduino.h"
+
+namespace host {
+  inline uint64_t i2cTransactions = 0;
+  inline uint64_t i2cBytes = 0;   // address byte included, as on the wire
+
+  // Optional hook called at endTransmission() with the bytes written
+  inline void (*onI2cWrite)(uint8_t address, const uint8_t *data, size_t len) = nullptr;
+}
+
+class TwoWire {
+public:
+  void begin() {}
+  void begin(int, int) {}
+  void setClock(uint32_t hz) { clockHz = hz; }
+
+  void beginTransmission(uint8_t address) {
+    address_ = address;
+    len_ = 0;
+  }
+  size_t write(uint8_t b) {
+    if(len_ >= sizeof(buf_)) return 0;
+    buf_[len_++] = b;
+    return 1;
+  }
+  size_t write(const uint8_t *data, size_t len) {
+    size_t n = 0;
+    while(n < len && write(data[n])) n++;
+    return n;
+  }
+  uint8_t endTransmission(bool = true) {
+    host::i2cTransactions++;
+    host::i2cBytes += len_ + 1;
+    if(host::onI2cWrite) host::onI2cWrite(address_, buf_, len_);
+    return 0;
+  }
+
+  uint8_t requestFrom(uint8_t, size_t) { return 0; }
+  int available() { return 0; }
+  int read() { return -1; }
+
+  uint32_t clockHz = 100000;
+
+private:
+  uint8_t address_ = 0;
+  uint8_t buf_[128];   // BUFFER_LENGTH on the ESP8266 core
+  size_t len_ = 0;
+};
+
+inline TwoWire Wire;
@@ -0,0 +1,64 @@
+// Node aggregator service; see aggregator.h for the HTTP API.
+//
+// Build from the repo root:
+//   g++ -std=c++17 -O2 -Ihost host/aggregator.cpp -o node-aggregator
+//
+// Run with the boards listed on the command line or one per line in a file
+// ("name=host:port[/path]", "#" starts a comment):
+//   ./node-aggregator --http 8080 gh1=192.168.1.50:80 gh2=192.168.1.51:80/getSensorData
+//   ./node-aggregator --nodes nodes.txt
+// then open http://localhost:8080/?fleet
+
+#include "aggregator.h"
+
+#include <csignal>
+#include <fstream>
+
+static std::atomic<bool> stopping{false};
+
+int main(int argc, char **argv) {
+  int httpPort = 8080;
+  std::string page = "1.html";
+  NodeAggregator aggregator;
+
+  for(int i = 1; i < argc; i++) {
+    std::string a = argv[i];
+    const char *v = i + 1 < argc ? argv[i + 1] : "";
+    if(a == "--http") { httpPort = atoi(v); i++; }
+    else if(a == "--page") { page = v; i++; }
+    else if(a == "--nodes") {
+      std::ifstream in(v);
+      if(!in) {
+        perror(v);
+        return 1;
+      }
+      std::string line;
+      while(std::getline(in, line)) {
+        line = line.substr(0, line.find('#'));
+        line.erase(line.find_last_not_of(" \t\r") + 1);
+        if(line.empty()) continue;
+        if(!aggregator.addNode(line)) fprintf(stderr, "bad node \"%s\"\n", line.c_str());
+      }
+      i++;
+    } else if(a.find('=') != std::string::npos) {
+      if(!aggregator.addNode(a)) fprintf(stderr, "bad node \"%s\"\n", a.c_str());
+    } else {
+      fprintf(stderr, "usage: %s [--http port] [--page 1.html] [--nodes file] [name=host:port[/path] ...]\n",
+              argv[0]);
+      return 2;
+    }
+  }
+  if(aggregator.nodeCount() == 0) {
+    fprintf(stderr, "no nodes given\n");
+    return 2;
+  }
+  if(!aggregator.begin(httpPort, page)) {
+    perror("http listen");
+    return 1;
+  }
+  signal(SIGINT, [](int) { stopping = true; });
+  signal(SIGTERM, [](int) { stopping = true; });
+  fprintf(stderr, "aggregator: %zu nodes, http :%d\n", aggregator.nodeCount(), aggregator.httpPort());
+  aggregator.run(stopping);
+  return 0;
+}
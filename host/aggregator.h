@@ -0,0 +1,581 @@
+// Node aggregator: one poller for many esp1/esp3 boards and one compact
+// endpoint for every dashboard watching them.
+//
+// Each board is long-polled on its own state endpoint (/data on esp1,
+// /getSensorData on esp3) with ?since=VERSION&wait=20, so a board answers
+// once per state change or every 20 s, however many pages are open. The
+// latest values are kept per node as JSON literals; a node whose values
+// change gets a new row version.
+//
+// HTTP (Connection: close, GET only):
+//   /                       the dashboard page (1.html); open /?fleet
+//   /nodes[?since=V][&wait=S]
+//       {"version":V,"count":N,"columns":[...],"rows":[[id,name,...],...]}
+//       with only the rows changed after V; wait=S holds the request until
+//       something changes (304 after S seconds)
+//   /control?node=NAME&mode=|pump=|light=[&key=K]
+//       forwarded to that board's /control, which applies the commands
+//       together; its reply (the node's new state JSON) is passed back
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <string.h>
+#include <string>
+#include <string_view>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+class NodeAggregator {
+public:
+  static constexpr uint32_t NODE_WAIT_S = 20;        // long-poll sent to the boards
+  static constexpr uint32_t NODE_TIMEOUT_MS = 30000;
+  static constexpr uint32_t RETRY_MS = 3000;
+  static constexpr uint32_t VIEWER_MAX_WAIT_S = 25;
+
+  // Cells per row after id and name; values are kept as JSON literals
+  enum Field { TEMPERATURE, HUMIDITY, LIGHT, MODE, PUMP_STATE, LIGHT_STATE, ONLINE, FIELD_COUNT };
+
+  std::atomic<uint64_t> nodePolls{0};       // requests sent to boards
+  std::atomic<uint64_t> nodeChanges{0};     // rows that changed
+  std::atomic<uint64_t> nodeErrors{0};
+  std::atomic<uint64_t> viewerRequests{0};
+
+  // "name=host:port[/path]"; the path picks the board type (default /data)
+  bool addNode(const std::string &spec) {
+    size_t eq = spec.find('='), colon = spec.find(':', eq);
+    if(eq == std::string::npos || colon == std::string::npos) return false;
+    size_t slash = spec.find('/', colon);
+    Node n;
+    n.name = spec.substr(0, eq);
+    n.path = slash == std::string::npos ? "/data" : spec.substr(slash);
+    n.esp3 = n.path == "/getSensorData";
+    std::string host = spec.substr(eq + 1, colon - eq - 1);
+    uint16_t port = atoi(spec.c_str() + colon + 1);
+
+    addrinfo hints = {}, *ai = nullptr;
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    if(getaddrinfo(host.c_str(), nullptr, &hints, &ai) != 0 || !ai) return false;
+    n.addr = *(sockaddr_in *)ai->ai_addr;
+    freeaddrinfo(ai);
+    n.addr.sin_port = htons(port);
+    n.hostHeader = host + ":" + std::to_string(port);
+    for(auto &c : n.cells) c = "null";
+    n.cells[ONLINE] = "false";
+    nameIndex_[n.name] = nodes_.size();
+    nodes_.push_back(std::move(n));
+    return true;
+  }
+
+  bool begin(uint16_t httpPort, const std::string &page = std::string()) {
+    page_ = page;
+    epollFd_ = epoll_create1(0);
+    httpFd_ = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    int one = 1;
+    setsockopt(httpFd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(httpPort);
+    if(bind(httpFd_, (sockaddr *)&addr, sizeof(addr)) < 0 || listen(httpFd_, 1024) < 0) return false;
+    socklen_t len = sizeof(addr);
+    getsockname(httpFd_, (sockaddr *)&addr, &len);
+    httpPort_ = ntohs(addr.sin_port);
+    watch(httpFd_, EPOLLIN);
+    return true;
+  }
+
+  uint16_t httpPort() const { return httpPort_; }
+  size_t nodeCount() const { return nodes_.size(); }
+  uint64_t version() const { return version_; }
+
+  void run(const std::atomic<bool> &stop) {
+    epoll_event events[256];
+    while(!stop) {
+      uint32_t now = nowMs();
+      for(uint32_t i = 0; i < nodes_.size(); i++) {
+        Node &n = nodes_[i];
+        if(n.fd < 0 && (int32_t)(now - n.nextPollMs) >= 0) startPoll(i);
+        else if(n.fd >= 0 && now - n.startedMs > NODE_TIMEOUT_MS) finishPoll(i, false);
+      }
+      answerHeldViewers(now);
+
+      int count = epoll_wait(epollFd_, events, 256, 100);
+      for(int e = 0; e < count; e++) {
+        int fd = events[e].data.fd;
+        uint32_t ev = events[e].events;
+        if(fd == httpFd_) {
+          acceptHttp();
+          continue;
+        }
+        auto node = nodeFds_.find(fd);
+        if(node != nodeFds_.end()) {
+          serviceNode(node->second, ev);
+          continue;
+        }
+        auto proxy = proxies_.find(fd);
+        if(proxy != proxies_.end()) serviceProxy(fd, ev);
+        else serviceHttp(fd, ev);
+      }
+    }
+    for(auto &n : nodes_) {
+      if(n.fd >= 0) close(n.fd);
+    }
+    for(auto &p : proxies_) close(p.first);
+    for(auto &c : http_) close(c.first);
+    close(httpFd_);
+    close(epollFd_);
+  }
+
+private:
+  struct Node {
+    std::string name, path, hostHeader;
+    sockaddr_in addr;
+    bool esp3 = false;
+    int fd = -1;
+    std::string rx, tx;
+    uint32_t since = 0;          // the board's state version
+    uint32_t nextPollMs = 0;
+    uint32_t startedMs = 0;
+    uint32_t lastOkMs = 0;
+    uint64_t rowVersion = 0;
+    bool dirty = false;          // cells changed since rowVersion was set
+    std::string cells[FIELD_COUNT];
+  };
+
+  struct HttpConn {
+    std::string rx, tx;
+    bool held = false;           // long-poll waiting for a change
+    uint64_t since = 0;
+    uint32_t deadlineMs = 0;
+    bool proxying = false;       // waiting on a board's /control reply
+  };
+
+  // A /control request forwarded to a board on behalf of a viewer
+  struct Proxy {
+    int viewerFd;
+    std::string rx, tx;
+  };
+
+  static uint32_t nowMs() {
+    static const auto start = std::chrono::steady_clock::now();
+    return (uint32_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now() - start).count();
+  }
+
+  void watch(int fd, uint32_t events, int op = EPOLL_CTL_ADD) {
+    epoll_event ev = {};
+    ev.events = events;
+    ev.data.fd = fd;
+    epoll_ctl(epollFd_, op, fd, &ev);
+  }
+
+  void unwatch(int fd) {
+    epoll_ctl(epollFd_, EPOLL_CTL_DEL, fd, nullptr);
+    close(fd);
+  }
+
+  static int connectTo(const sockaddr_in &addr) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if(connect(fd, (const sockaddr *)&addr, sizeof(addr)) < 0 && errno != EINPROGRESS) {
+      close(fd);
+      return -1;
+    }
+    return fd;
+  }
+
+  // Sends tx once writable, then collects the reply until the board closes
+  // the connection (the sketches answer with Connection: close). Returns
+  // true when the reply is complete, false while it is still arriving.
+  static bool pumpExchange(int fd, uint32_t ev, std::string &tx, std::string &rx, bool &failed) {
+    failed = false;
+    if(!tx.empty() && (ev & EPOLLOUT)) {
+      ssize_t n = send(fd, tx.data(), tx.size(), MSG_NOSIGNAL);
+      if(n < 0 && errno != EAGAIN) {
+        failed = true;
+        return true;
+      }
+      if(n > 0) tx.erase(0, n);
+    }
+    if(ev & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+      char buf[4096];
+      ssize_t n;
+      while((n = recv(fd, buf, sizeof(buf), 0)) > 0) rx.append(buf, n);
+      if(n == 0) return true;
+      if(n < 0 && errno != EAGAIN) {
+        failed = rx.empty();
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // ---------------- Board Polling ----------------
+  void startPoll(uint32_t i) {
+    Node &n = nodes_[i];
+    n.startedMs = nowMs();
+    n.fd = connectTo(n.addr);
+    if(n.fd < 0) {
+      finishPoll(i, false);
+      return;
+    }
+    n.rx.clear();
+    n.tx = "GET " + n.path + "?since=" + std::to_string(n.since) + "&wait=" + std::to_string(NODE_WAIT_S) +
+           " HTTP/1.1\r\nHost: " + n.hostHeader + "\r\nConnection: close\r\n\r\n";
+    nodeFds_[n.fd] = i;
+    watch(n.fd, EPOLLIN | EPOLLOUT);
+    nodePolls++;
+  }
+
+  void serviceNode(uint32_t i, uint32_t ev) {
+    Node &n = nodes_[i];
+    bool failed;
+    if(!pumpExchange(n.fd, ev, n.tx, n.rx, failed)) {
+      if(n.tx.empty()) watch(n.fd, EPOLLIN, EPOLL_CTL_MOD);
+      return;
+    }
+    if(failed) {
+      finishPoll(i, false);
+      return;
+    }
+    int status = httpStatus(n.rx);
+    size_t bodyAt = n.rx.find("\r\n\r\n");
+    if(status == 200 && bodyAt != std::string::npos) {
+      updateRow(i, std::string_view(n.rx).substr(bodyAt + 4));
+      finishPoll(i, true);
+    } else if(status == 503) {
+      // Shedding load: alive, so ask again when it says
+      size_t at = n.rx.find("\r\nRetry-After: ");
+      uint32_t waitS = at < bodyAt ? strtoul(n.rx.c_str() + at + 15, nullptr, 10) : 1;
+      finishPoll(i, true, (waitS ? waitS : 1) * 1000);
+    } else finishPoll(i, status == 304);
+  }
+
+  // Ends the current poll. A good answer re-polls at once (the board holds
+  // the next request until it changes) or after waitMs; a failure waits
+  // RETRY_MS and marks the node offline.
+  void finishPoll(uint32_t i, bool ok, uint32_t waitMs = 0) {
+    Node &n = nodes_[i];
+    if(n.fd >= 0) {
+      nodeFds_.erase(n.fd);
+      unwatch(n.fd);
+      n.fd = -1;
+    }
+    uint32_t now = nowMs();
+    if(ok) {
+      n.lastOkMs = now;
+      n.nextPollMs = now + waitMs;
+      setCell(n, ONLINE, "true");
+    } else {
+      nodeErrors++;
+      n.nextPollMs = now + RETRY_MS;
+      n.since = 0;   // the board may have rebooted; take a full state next time
+      setCell(n, ONLINE, "false");
+    }
+    if(n.dirty) commitRow(n);
+  }
+
+  void updateRow(uint32_t i, std::string_view body) {
+    Node &n = nodes_[i];
+    std::string_view v;
+    if(jsonField(body, "version", v)) n.since = strtoul(std::string(v).c_str(), nullptr, 10);
+    if(jsonField(body, "temperature", v)) setCell(n, TEMPERATURE, v);
+    if(jsonField(body, "humidity", v)) setCell(n, HUMIDITY, v);
+    if(jsonField(body, n.esp3 ? "lightPercent" : "light", v)) setCell(n, LIGHT, v);
+    if(jsonField(body, "mode", v)) setCell(n, MODE, v);
+    if(jsonField(body, "pumpState", v)) setCell(n, PUMP_STATE, v);
+    if(jsonField(body, "lightState", v)) setCell(n, LIGHT_STATE, v);
+  }
+
+  void setCell(Node &n, Field f, std::string_view v) {
+    if(n.cells[f] == v) return;
+    n.cells[f].assign(v.data(), v.size());
+    n.dirty = true;
+  }
+
+  void commitRow(Node &n) {
+    n.dirty = false;
+    n.rowVersion = ++version_;
+    nodeChanges++;
+  }
+
+  static int httpStatus(const std::string &rx) {
+    if(rx.compare(0, 9, "HTTP/1.1 ") != 0 && rx.compare(0, 9, "HTTP/1.0 ") != 0) return 0;
+    return atoi(rx.c_str() + 9);
+  }
+
+  // Top-level scalar "key":value of a flat JSON object; strings keep their
+  // quotes so the value can be copied into a response as is
+  static bool jsonField(std::string_view body, std::string_view key, std::string_view &out) {
+    size_t pos = 0;
+    while((pos = body.find(key, pos)) != std::string_view::npos) {
+      size_t colon = pos + key.size() + 1;
+      if(pos > 0 && body[pos - 1] == '"' && colon < body.size() && body[colon - 1] == '"' && body[colon] == ':') {
+        size_t start = colon + 1, end = start;
+        if(end < body.size() && body[end] == '"') end = body.find('"', end + 1) + 1;
+        else while(end < body.size() && body[end] != ',' && body[end] != '}') end++;
+        if(end == 0 || end > body.size()) return false;
+        out = body.substr(start, end - start);
+        return true;
+      }
+      pos += key.size();
+    }
+    return false;
+  }
+
+  // ---------------- Viewers ----------------
+  void acceptHttp() {
+    int fd;
+    while((fd = accept4(httpFd_, nullptr, nullptr, SOCK_NONBLOCK)) >= 0) {
+      int one = 1;
+      setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+      http_[fd];
+      watch(fd, EPOLLIN);
+    }
+  }
+
+  void closeHttp(int fd) {
+    unwatch(fd);
+    http_.erase(fd);
+  }
+
+  void serviceHttp(int fd, uint32_t ev) {
+    auto it = http_.find(fd);
+    if(it == http_.end()) return;
+    HttpConn &c = it->second;
+    if(ev & (EPOLLHUP | EPOLLERR | EPOLLRDHUP)) {
+      closeHttp(fd);
+      return;
+    }
+    if((ev & EPOLLIN) && c.tx.empty()) {
+      char buf[4096];
+      ssize_t n;
+      while((n = recv(fd, buf, sizeof(buf), 0)) > 0) c.rx.append(buf, n);
+      if(n == 0 && c.rx.find("\r\n\r\n") == std::string::npos) {
+        closeHttp(fd);
+        return;
+      }
+      if(c.rx.find("\r\n\r\n") == std::string::npos) {
+        if(c.rx.size() > 8192) closeHttp(fd);
+        return;
+      }
+      viewerRequests++;
+      respond(fd, c);
+    }
+    flushHttp(fd);
+  }
+
+  void flushHttp(int fd) {
+    auto it = http_.find(fd);
+    if(it == http_.end()) return;
+    HttpConn &c = it->second;
+    while(!c.tx.empty()) {
+      ssize_t n = send(fd, c.tx.data(), c.tx.size(), MSG_NOSIGNAL);
+      if(n < 0) {
+        if(errno == EAGAIN) {
+          watch(fd, EPOLLOUT, EPOLL_CTL_MOD);
+          return;
+        }
+        break;
+      }
+      c.tx.erase(0, n);
+    }
+    if(c.tx.empty() && !c.held && !c.proxying) closeHttp(fd);
+  }
+
+  void answerHeldViewers(uint32_t now) {
+    for(auto &entry : http_) {
+      HttpConn &c = entry.second;
+      if(!c.held) continue;
+      bool changed = version_ > c.since;
+      if(!changed && (int32_t)(now - c.deadlineMs) < 0) continue;
+      c.held = false;
+      c.tx = changed ? reply(200, "application/json", nodesJson(c.since)) : reply(304, "", "");
+      pendingFlush_.push_back(entry.first);
+    }
+    for(int fd : pendingFlush_) flushHttp(fd);
+    pendingFlush_.clear();
+  }
+
+  static std::string queryArg(std::string_view query, std::string_view name) {
+    size_t pos = 0;
+    while(pos < query.size()) {
+      size_t amp = query.find('&', pos);
+      if(amp == std::string_view::npos) amp = query.size();
+      std::string_view item = query.substr(pos, amp - pos);
+      size_t eq = item.find('=');
+      if(item.substr(0, eq) == name) return eq == std::string_view::npos ? "" : std::string(item.substr(eq + 1));
+      pos = amp + 1;
+    }
+    return std::string();
+  }
+
+  static std::string reply(int status, const char *type, const std::string &body) {
+    const char *reason = status == 200 ? "OK" : status == 304 ? "Not Modified" : status == 404 ? "Not Found" :
+                         status == 409 ? "Conflict" : status == 502 ? "Bad Gateway" :
+                         status == 503 ? "Service Unavailable" : "Bad Request";
+    char head[192];
+    snprintf(head, sizeof(head), "HTTP/1.1 %d %s\r\n%s%s%sContent-Length: %zu\r\nConnection: close\r\n\r\n",
+             status, reason, *type ? "Content-Type: " : "", type, *type ? "\r\n" : "", body.size());
+    return head + body;
+  }
+
+  // Every row for since = 0, else the rows changed after since
+  std::string nodesJson(uint64_t since) const {
+    std::string out;
+    out.reserve(64 + nodes_.size() * (since ? 8 : 72));
+    out += "{\"version\":" + std::to_string(version_) + ",\"count\":" + std::to_string(nodes_.size()) +
+           ",\"columns\":[\"id\",\"name\",\"temperature\",\"humidity\",\"light\",\"mode\",\"pumpState\","
+           "\"lightState\",\"online\"],\"rows\":[";
+    bool first = true;
+    for(size_t i = 0; i < nodes_.size(); i++) {
+      const Node &n = nodes_[i];
+      if(since && n.rowVersion <= since) continue;
+      if(!first) out += ",";
+      first = false;
+      out += "[" + std::to_string(i) + ",\"" + n.name + "\"";
+      for(const auto &cell : n.cells) {
+        out += ",";
+        out += cell;
+      }
+      out += "]";
+    }
+    out += "]}";
+    return out;
+  }
+
+  void respond(int fd, HttpConn &c) {
+    const std::string &request = c.rx;
+    if(request.compare(0, 4, "GET ") != 0) {
+      c.tx = reply(400, "text/plain", "GET only\n");
+      return;
+    }
+    size_t end = request.find(' ', 4);
+    std::string_view target(request.data() + 4, (end == std::string::npos ? request.size() : end) - 4);
+    size_t q = target.find('?');
+    std::string_view path = target.substr(0, q);
+    std::string_view query = q == std::string_view::npos ? std::string_view() : target.substr(q + 1);
+
+    if(path == "/") {
+      if(page_.empty()) {
+        c.tx = reply(404, "text/plain", "No page\n");
+        return;
+      }
+      FILE *f = fopen(page_.c_str(), "rb");
+      std::string body;
+      if(f) {
+        char buf[8192];
+        size_t n;
+        while((n = fread(buf, 1, sizeof(buf), f)) > 0) body.append(buf, n);
+        fclose(f);
+      }
+      c.tx = f ? reply(200, "text/html", body) : reply(404, "text/plain", "No page\n");
+      return;
+    }
+
+    if(path == "/nodes") {
+      uint64_t since = strtoull(queryArg(query, "since").c_str(), nullptr, 10);
+      uint32_t waitS = std::min<uint32_t>(VIEWER_MAX_WAIT_S, strtoul(queryArg(query, "wait").c_str(), nullptr, 10));
+      if(since && since >= version_) {
+        if(waitS == 0) {
+          c.tx = reply(304, "", "");
+          return;
+        }
+        c.held = true;
+        c.since = since;
+        c.deadlineMs = nowMs() + waitS * 1000;
+        watch(fd, EPOLLRDHUP, EPOLL_CTL_MOD);   // only notice the viewer going away
+        return;
+      }
+      c.tx = reply(200, "application/json", nodesJson(since));
+      return;
+    }
+
+    if(path == "/control") {
+      auto it = nameIndex_.find(queryArg(query, "node"));
+      if(it == nameIndex_.end()) {
+        c.tx = reply(404, "text/plain", "Unknown node\n");
+        return;
+      }
+      std::string boardPath = controlPath(query);
+      if(boardPath.empty()) {
+        c.tx = reply(400, "text/plain", "Nothing to control\n");
+        return;
+      }
+      int pfd = connectTo(nodes_[it->second].addr);
+      if(pfd < 0) {
+        c.tx = reply(502, "text/plain", "Node unreachable\n");
+        return;
+      }
+      Proxy &p = proxies_[pfd];
+      p.viewerFd = fd;
+      p.tx = "GET " + boardPath + " HTTP/1.1\r\nHost: " + nodes_[it->second].hostHeader +
+             "\r\nConnection: close\r\n\r\n";
+      watch(pfd, EPOLLIN | EPOLLOUT);
+      watch(fd, EPOLLRDHUP, EPOLL_CTL_MOD);
+      c.proxying = true;
+      return;
+    }
+
+    c.tx = reply(404, "text/plain", "Not found\n");
+  }
+
+  // The commands and the idempotency key for the board's /control; both
+  // esp1 and esp3 take the same arguments there
+  static std::string controlPath(std::string_view query) {
+    std::string args;
+    for(const char *name : { "mode", "pump", "light" }) {
+      std::string v = queryArg(query, name);
+      if(!v.empty()) args += std::string("&") + name + "=" + v;
+    }
+    if(args.empty()) return args;
+    std::string key = queryArg(query, "key");
+    if(!key.empty()) args += "&key=" + key;
+    return "/control?" + args.substr(1);
+  }
+
+  void serviceProxy(int fd, uint32_t ev) {
+    Proxy &p = proxies_[fd];
+    bool failed;
+    if(!pumpExchange(fd, ev, p.tx, p.rx, failed)) {
+      if(p.tx.empty()) watch(fd, EPOLLIN, EPOLL_CTL_MOD);
+      return;
+    }
+    int viewerFd = p.viewerFd;
+    int status = failed ? 0 : httpStatus(p.rx);
+    size_t bodyAt = p.rx.find("\r\n\r\n");
+    std::string body = bodyAt == std::string::npos ? std::string() : p.rx.substr(bodyAt + 4);
+    bool json = p.rx.find("Content-Type: application/json") < bodyAt;
+    unwatch(fd);
+    proxies_.erase(fd);
+
+    auto it = http_.find(viewerFd);
+    if(it == http_.end()) return;
+    it->second.proxying = false;
+    it->second.tx = status ? reply(status, json ? "application/json" : "text/plain", body)
+                           : reply(502, "text/plain", "Node unreachable\n");
+    flushHttp(viewerFd);
+  }
+
+  std::string page_;
+  int epollFd_ = -1;
+  int httpFd_ = -1;
+  uint16_t httpPort_ = 0;
+  uint64_t version_ = 0;
+  std::vector<Node> nodes_;
+  std::unordered_map<std::string, uint32_t> nameIndex_;
+  std::unordered_map<int, uint32_t> nodeFds_;
+  std::unordered_map<int, Proxy> proxies_;
+  std::unordered_map<int, HttpConn> http_;
+  std::vector<int> pendingFlush_;
+};
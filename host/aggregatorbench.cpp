@@ -0,0 +1,387 @@
+// Benchmark for the node aggregator (aggregator.h) with hundreds of boards.
+//
+// Simulated boards answer /data the way esp1 does (JSON state with a
+// version, ?since=&wait= long-poll, Connection: close), each on its own
+// loopback port, all in one thread. For every fleet size the run reports:
+//   snapshot   GET /nodes: bytes and latency
+//   propagate  one board changes → the change reaches a viewer that is
+//              long-polling /nodes?since=&wait= (latency, bytes per delta)
+//   churn      --churn of the boards change per second for --seconds;
+//              requests the boards had to serve vs. what the same number
+//              of open pages would cost polling every board every 3 s
+//
+// Build from the repo root:
+//   g++ -std=c++17 -O2 -Ihost host/aggregatorbench.cpp -o aggregatorbench -lpthread
+//   ./aggregatorbench [--nodes 100,300,1000] [--viewers 10] [--churn 0.1] [--seconds 5]
+// Page-side update cost for the same responses: host/fleetpagebench.js.
+
+#include "aggregator.h"
+
+#include <algorithm>
+#include <sys/eventfd.h>
+#include <thread>
+
+static uint64_t nowUs() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// ---------------- Simulated Boards ----------------
+class SimBoards {
+public:
+  std::atomic<uint64_t> requests{0};
+  std::atomic<uint32_t> changeOne{UINT32_MAX};   // board to change on the next wake-up
+  std::atomic<double> churnPerS{0};
+
+  bool begin(uint32_t count) {
+    epollFd_ = epoll_create1(0);
+    wakeFd_ = eventfd(0, EFD_NONBLOCK);
+    add(wakeFd_, EPOLLIN);
+    boards_.resize(count);
+    for(uint32_t i = 0; i < count; i++) {
+      Board &b = boards_[i];
+      b.listenFd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+      sockaddr_in addr = {};
+      addr.sin_family = AF_INET;
+      addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+      if(bind(b.listenFd, (sockaddr *)&addr, sizeof(addr)) < 0 || listen(b.listenFd, 16) < 0) return false;
+      socklen_t len = sizeof(addr);
+      getsockname(b.listenFd, (sockaddr *)&addr, &len);
+      b.port = ntohs(addr.sin_port);
+      b.tempCenti = 2000 + (i * 37) % 1200;
+      b.hum = 40 + i % 40;
+      b.light = (i * 13) % 101;
+      listeners_[b.listenFd] = i;
+      add(b.listenFd, EPOLLIN);
+    }
+    return true;
+  }
+
+  uint16_t port(uint32_t i) const { return boards_[i].port; }
+  void wake() { uint64_t one = 1; (void)!write(wakeFd_, &one, sizeof(one)); }
+
+  void run(const std::atomic<bool> &stop) {
+    epoll_event events[256];
+    uint64_t lastChurnUs = nowUs();
+    double churnDebt = 0;
+    uint64_t rng = 88172645463325252ULL;
+    while(!stop) {
+      int n = epoll_wait(epollFd_, events, 256, 10);
+      for(int e = 0; e < n; e++) {
+        int fd = events[e].data.fd;
+        if(fd == wakeFd_) {
+          uint64_t v;
+          (void)!read(wakeFd_, &v, sizeof(v));
+          uint32_t i = changeOne.exchange(UINT32_MAX);
+          if(i != UINT32_MAX) change(i);
+          continue;
+        }
+        auto l = listeners_.find(fd);
+        if(l != listeners_.end()) {
+          int c;
+          while((c = accept4(fd, nullptr, nullptr, SOCK_NONBLOCK)) >= 0) {
+            conns_[c].board = l->second;
+            add(c, EPOLLIN);
+          }
+          continue;
+        }
+        serve(fd);
+      }
+      uint64_t now = nowUs();
+      churnDebt += churnPerS.load() * boards_.size() * (now - lastChurnUs) / 1e6;
+      lastChurnUs = now;
+      while(churnDebt >= 1) {
+        rng ^= rng << 13;
+        rng ^= rng >> 7;
+        rng ^= rng << 17;
+        change(rng % boards_.size());
+        churnDebt -= 1;
+      }
+      answerHeld(now);
+    }
+    for(auto &c : conns_) close(c.first);
+    for(auto &b : boards_) close(b.listenFd);
+    close(wakeFd_);
+    close(epollFd_);
+  }
+
+private:
+  struct Board {
+    int listenFd = -1;
+    uint16_t port = 0;
+    uint32_t version = 1;
+    int tempCenti = 2500, hum = 60, light = 50;
+    bool pump = false;
+    std::string mode = "automatic";
+  };
+
+  struct Conn {
+    uint32_t board;
+    std::string rx;
+    bool held = false;
+    uint32_t since = 0;
+    uint64_t deadlineUs = 0;
+  };
+
+  void add(int fd, uint32_t events) {
+    epoll_event ev = {};
+    ev.events = events;
+    ev.data.fd = fd;
+    epoll_ctl(epollFd_, EPOLL_CTL_ADD, fd, &ev);
+  }
+
+  void change(uint32_t i) {
+    Board &b = boards_[i];
+    b.tempCenti += b.tempCenti >= 3400 ? -10 : 10;
+    b.pump = b.tempCenti >= 3200;
+    b.version++;
+  }
+
+  std::string stateJson(const Board &b) const {
+    char buf[256];
+    snprintf(buf, sizeof(buf), "{\"temperature\":%d.%d,\"humidity\":%d.0,\"sensorOk\":true,\"light\":%d,"
+             "\"mode\":\"%s\",\"pumpState\":%s,\"lightState\":false,\"suppressed\":{\"pumpDwell\":0,"
+             "\"pumpRate\":0,\"lightDwell\":0,\"lightRate\":0},\"version\":%u}",
+             b.tempCenti / 100, b.tempCenti % 100 / 10, b.hum, b.light, b.mode.c_str(),
+             b.pump ? "true" : "false", b.version);
+    return buf;
+  }
+
+  void finish(int fd, int status, const std::string &body) {
+    char head[160];
+    snprintf(head, sizeof(head), "HTTP/1.1 %d %s\r\nContent-Type: application/json\r\nContent-Length: %zu\r\n"
+             "Connection: close\r\n\r\n", status, status == 200 ? "OK" : "Not Modified", body.size());
+    std::string out = head + body;
+    (void)!send(fd, out.data(), out.size(), MSG_NOSIGNAL);
+    epoll_ctl(epollFd_, EPOLL_CTL_DEL, fd, nullptr);
+    close(fd);
+    conns_.erase(fd);
+  }
+
+  static uint32_t arg(const std::string &req, const char *name) {
+    size_t at = req.find(name);
+    return at == std::string::npos ? 0 : strtoul(req.c_str() + at + strlen(name), nullptr, 10);
+  }
+
+  void serve(int fd) {
+    Conn &c = conns_[fd];
+    char buf[2048];
+    ssize_t n;
+    while((n = recv(fd, buf, sizeof(buf), 0)) > 0) c.rx.append(buf, n);
+    if(n == 0 && (c.held || c.rx.find("\r\n\r\n") == std::string::npos)) {
+      epoll_ctl(epollFd_, EPOLL_CTL_DEL, fd, nullptr);
+      close(fd);
+      conns_.erase(fd);
+      return;
+    }
+    if(c.held || c.rx.find("\r\n\r\n") == std::string::npos) return;
+    requests++;
+    Board &b = boards_[c.board];
+    if(c.rx.compare(0, 13, "GET /control?") == 0) {
+      size_t m = c.rx.find("mode=");
+      if(m != std::string::npos) b.mode = c.rx.substr(m + 5, c.rx.find_first_of("& ", m) - m - 5);
+      b.version++;
+      finish(fd, 200, "OK");
+      return;
+    }
+    uint32_t since = arg(c.rx, "since="), waitS = arg(c.rx, "wait=");
+    if(since != b.version) finish(fd, 200, stateJson(b));
+    else if(waitS == 0) finish(fd, 304, "");
+    else {
+      c.held = true;
+      c.since = since;
+      c.deadlineUs = nowUs() + waitS * 1000000ULL;
+    }
+  }
+
+  void answerHeld(uint64_t now) {
+    std::vector<int> done;
+    for(auto &entry : conns_) {
+      Conn &c = entry.second;
+      if(c.held && (boards_[c.board].version != c.since || now >= c.deadlineUs)) done.push_back(entry.first);
+    }
+    for(int fd : done) {
+      Conn &c = conns_[fd];
+      const Board &b = boards_[c.board];
+      if(b.version != c.since) finish(fd, 200, stateJson(b));
+      else finish(fd, 304, "");
+    }
+  }
+
+  int epollFd_ = -1;
+  int wakeFd_ = -1;
+  std::vector<Board> boards_;
+  std::unordered_map<int, uint32_t> listeners_;
+  std::unordered_map<int, Conn> conns_;
+};
+
+// ---------------- Viewer Side ----------------
+static std::string httpGet(uint16_t port, const std::string &path, int &status) {
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = htons(port);
+  status = 0;
+  if(connect(fd, (sockaddr *)&addr, sizeof(addr)) < 0) {
+    close(fd);
+    return std::string();
+  }
+  std::string req = "GET " + path + " HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n";
+  (void)!send(fd, req.data(), req.size(), MSG_NOSIGNAL);
+  std::string out;
+  char buf[65536];
+  ssize_t n;
+  while((n = recv(fd, buf, sizeof(buf), 0)) > 0) out.append(buf, n);
+  close(fd);
+  if(out.size() > 12) status = atoi(out.c_str() + 9);
+  size_t body = out.find("\r\n\r\n");
+  return body == std::string::npos ? std::string() : out.substr(body + 4);
+}
+
+static uint64_t versionOf(const std::string &body) {
+  size_t at = body.find("\"version\":");
+  return at == std::string::npos ? 0 : strtoull(body.c_str() + at + 10, nullptr, 10);
+}
+
+static size_t rowsIn(const std::string &body) {
+  size_t at = body.find("\"rows\":[");
+  if(at == std::string::npos) return 0;
+  size_t rows = 0;
+  for(size_t i = at + 7; (i = body.find("[", i + 1)) != std::string::npos;) rows++;
+  return rows;
+}
+
+static size_t countOf(const std::string &body, const char *needle) {
+  size_t n = 0, at = 0;
+  while((at = body.find(needle, at)) != std::string::npos) {
+    n++;
+    at++;
+  }
+  return n;
+}
+
+static uint64_t percentile(std::vector<uint64_t> &v, double p) {
+  if(v.empty()) return 0;
+  std::sort(v.begin(), v.end());
+  return v[std::min(v.size() - 1, (size_t)(p * v.size()))];
+}
+
+int main(int argc, char **argv) {
+  std::vector<uint32_t> fleetSizes = { 100, 300, 1000 };
+  uint32_t viewers = 10, changes = 200;
+  double churn = 0.1, seconds = 5;
+  for(int i = 1; i < argc; i++) {
+    std::string a = argv[i];
+    const char *v = i + 1 < argc ? argv[i + 1] : "";
+    if(a == "--nodes") {
+      fleetSizes.clear();
+      for(const char *p = v; *p;) {
+        fleetSizes.push_back(strtoul(p, (char **)&p, 10));
+        if(*p == ',') p++;
+      }
+      i++;
+    } else if(a == "--viewers") { viewers = strtoul(v, nullptr, 10); i++; }
+    else if(a == "--churn") { churn = atof(v); i++; }
+    else if(a == "--seconds") { seconds = atof(v); i++; }
+    else if(a == "--changes") { changes = strtoul(v, nullptr, 10); i++; }
+    else {
+      fprintf(stderr, "usage: %s [--nodes 100,300,1000] [--viewers V] [--churn F] [--seconds S] [--changes N]\n",
+              argv[0]);
+      return 2;
+    }
+  }
+
+  for(uint32_t count : fleetSizes) {
+    std::atomic<bool> stop{false};
+    SimBoards boards;
+    if(!boards.begin(count)) {
+      perror("boards");
+      return 1;
+    }
+    std::thread boardThread([&] { boards.run(stop); });
+
+    NodeAggregator aggregator;
+    for(uint32_t i = 0; i < count; i++) {
+      aggregator.addNode("node" + std::to_string(i) + "=127.0.0.1:" + std::to_string(boards.port(i)));
+    }
+    if(!aggregator.begin(0)) {
+      perror("aggregator");
+      return 1;
+    }
+    std::thread aggThread([&] { aggregator.run(stop); });
+    uint16_t port = aggregator.httpPort();
+
+    // Until every board has been heard from
+    int status;
+    std::string body;
+    uint64_t readyUs = nowUs();
+    while(countOf(body = httpGet(port, "/nodes", status), "true]") < count) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    double readyMs = (nowUs() - readyUs) / 1e3;
+
+    // ---- snapshot
+    std::vector<uint64_t> us;
+    size_t snapshotBytes = 0;
+    for(int q = 0; q < 200; q++) {
+      uint64_t t0 = nowUs();
+      snapshotBytes = httpGet(port, "/nodes", status).size();
+      us.push_back(nowUs() - t0);
+    }
+    uint64_t snapP50 = percentile(us, 0.5), snapP99 = percentile(us, 0.99);
+
+    // ---- propagate: board change → long-polling viewer
+    uint64_t version = versionOf(httpGet(port, "/nodes", status));
+    std::vector<uint64_t> lat;
+    size_t deltaBytes = 0;
+    for(uint32_t c = 0; c < changes; c++) {
+      std::string path = "/nodes?since=" + std::to_string(version) + "&wait=5";
+      std::thread viewer([&] { body = httpGet(port, path, status); });
+      std::this_thread::sleep_for(std::chrono::milliseconds(2));   // viewer is held by now
+      uint64_t t0 = nowUs();
+      boards.changeOne = (c * 7919) % count;
+      boards.wake();
+      viewer.join();
+      if(status == 200) {
+        lat.push_back(nowUs() - t0);
+        deltaBytes += body.size();
+        version = versionOf(body);
+      }
+    }
+
+    // ---- churn: one long-polling viewer follows every delta
+    uint64_t req0 = boards.requests, polls0 = aggregator.nodePolls;
+    uint64_t updates = 0, rows = 0, bytes = 0;
+    boards.churnPerS = churn;
+    uint64_t end = nowUs() + (uint64_t)(seconds * 1e6), t0 = nowUs();
+    while(nowUs() < end) {
+      body = httpGet(port, "/nodes?since=" + std::to_string(version) + "&wait=1", status);
+      if(status != 200) continue;
+      updates++;
+      rows += rowsIn(body);
+      bytes += body.size();
+      version = versionOf(body);
+    }
+    boards.churnPerS = 0;
+    double elapsed = (nowUs() - t0) / 1e6;
+    double boardRps = (boards.requests - req0) / elapsed;
+
+    printf("{\"nodes\":%u,\"ready_ms\":%.1f,\"snapshot\":{\"bytes\":%zu,\"p50_us\":%llu,\"p99_us\":%llu},"
+           "\"propagate\":{\"p50_us\":%llu,\"p99_us\":%llu,\"avg_delta_bytes\":%.0f},"
+           "\"churn\":{\"changes_per_s\":%.0f,\"viewer_updates_per_s\":%.1f,\"avg_rows_per_update\":%.1f,"
+           "\"viewer_bytes_per_s\":%.0f,\"board_requests_per_s\":%.1f,\"aggregator_polls\":%llu,"
+           "\"per_page_polling_model_rps\":{\"viewers\":%u,\"board_requests_per_s\":%.1f}}}\n",
+           count, readyMs, snapshotBytes, (unsigned long long)snapP50, (unsigned long long)snapP99,
+           (unsigned long long)percentile(lat, 0.5), (unsigned long long)percentile(lat, 0.99),
+           lat.empty() ? 0.0 : (double)deltaBytes / lat.size(), churn * count, updates / elapsed,
+           updates ? (double)rows / updates : 0.0, bytes / elapsed, boardRps,
+           (unsigned long long)(aggregator.nodePolls - polls0), viewers, viewers * count / 3.0);
+    fflush(stdout);
+
+    stop = true;
+    aggThread.join();
+    boardThread.join();
+  }
+  return 0;
+}
@@ -0,0 +1,110 @@
+// Update-cost benchmark for the fleet mode of 1.html.
+//
+// Loads the page's script into a stub DOM that counts writes, feeds it a
+// full /nodes snapshot and then streams of deltas (the aggregator's
+// ?since= responses) for several fleet sizes, and prints one JSON object
+// per case: script time per update and DOM writes per update, next to the
+// writes a full table redraw would cost. The stub has no layout or paint,
+// so the write counts are what carries over to a browser; there the page
+// keeps the same figures in window.fleetStats.
+//
+// Run from the repo root:
+//   node host/fleetpagebench.js [--updates 200] [--nodes 100,300,1000]
+
+'use strict';
+const fs = require('fs');
+const path = require('path');
+const vm = require('vm');
+const { performance } = require('perf_hooks');
+
+const args = process.argv.slice(2);
+const arg = (name, dflt) => {
+    const i = args.indexOf(name);
+    return i >= 0 && i + 1 < args.length ? args[i + 1] : dflt;
+};
+const updates = parseInt(arg('--updates', '200'), 10);
+const fleetSizes = arg('--nodes', '100,300,1000').split(',').map(Number);
+
+const html = fs.readFileSync(path.join(__dirname, '..', '1.html'), 'utf8');
+const script = html.slice(html.lastIndexOf('<script>') + 8, html.lastIndexOf('</script>'));
+
+let domWrites = 0;
+
+class Element {
+    constructor(tag) {
+        this.tagName = tag;
+        this.children = [];
+        this.style = {};
+        this.classList = { add() {}, remove() {} };
+        this.text = '';
+        this.cls = '';
+    }
+    set textContent(v) { domWrites++; this.text = String(v); }
+    get textContent() { return this.text; }
+    set className(v) { domWrites++; this.cls = v; }
+    get className() { return this.cls; }
+    appendChild(child) { domWrites++; this.children.push(child); return child; }
+}
+
+function loadPage() {
+    const byId = {};
+    const document = {
+        body: new Element('body'),
+        getElementById: id => byId[id] || (byId[id] = new Element('div')),
+        createElement: tag => new Element(tag),
+    };
+    const context = {
+        document: document,
+        location: { search: '?fleet' },
+        window: {},
+        performance: performance,
+        console: { log() {}, error() {} },
+        fetch: () => new Promise(() => {}),   // watchFleet() stays pending
+        setTimeout: () => 0,
+        URLSearchParams: URLSearchParams,
+    };
+    vm.createContext(context);
+    vm.runInContext(script, context);
+    return { context: context, byId: byId };
+}
+
+function makeRow(id, tick) {
+    const t = 20 + ((id * 7 + tick) % 150) / 10;
+    return [id, 'node' + id, Number(t.toFixed(1)), 40 + (id * 3 + tick) % 40, (id * 13 + tick) % 101,
+            id % 3 ? 'automatic' : 'manual', t >= 32, (id + tick) % 5 === 0, id % 50 !== 0];
+}
+
+for(const n of fleetSizes) {
+    const page = loadPage();
+    const rows = [];
+    for(let id = 0; id < n; id++) rows.push(makeRow(id, 0));
+    let version = n;
+
+    domWrites = 0;
+    let start = performance.now();
+    page.context.applyFleet({ version: version, count: n, rows: rows });
+    const fullMs = performance.now() - start;
+    const fullWrites = domWrites;
+
+    // Deltas with 1 row, 1 %, 10 % and every row changed per update
+    const sizes = [...new Set([1, Math.round(n / 100), Math.round(n / 10), n].filter(c => c > 0))];
+    const cases = [];
+    for(const changed of sizes) {
+        let tick = 1, ms = 0;
+        domWrites = 0;
+        for(let u = 0; u < updates; u++, tick++) {
+            const delta = [];
+            for(let k = 0; k < changed; k++) delta.push(makeRow((u * 7919 + k) % n, tick));
+            version++;
+            start = performance.now();
+            page.context.applyFleet({ version: version, count: n, rows: delta });
+            ms += performance.now() - start;
+        }
+        cases.push({ rows_changed: changed, us_per_update: Number((ms * 1000 / updates).toFixed(1)),
+                     dom_writes_per_update: Number((domWrites / updates).toFixed(1)),
+                     full_redraw_writes: n * 8 });
+    }
+    console.log(JSON.stringify({ nodes: n, first_render_ms: Number(fullMs.toFixed(2)),
+                                 first_render_writes: fullWrites, table_rows: page.byId.fleetBody.children.length,
+                                 updates: cases }));
+}
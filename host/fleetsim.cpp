@@ -0,0 +1,774 @@
+// Virtual node fleet for scale tests of the broker, the dashboards and the
+// Adafruit IO rate limits: thousands of simulated boards in one process, each
+// running the sketch's own setup()/loop() (scheduler, MQTT client or HTTP
+// server, control logic) against a sensor model, on one event loop.
+//
+// The sketch is compiled on its own (host/fleetsim_node.cpp) with its .data
+// and .bss renamed to fleet_data/fleet_bss: those globals are the board's RAM.
+// Every node keeps a copy, and the loop copies it in before running the node
+// and back out before running another, so the sketch runs unmodified. Per
+// node it also swaps the flash sectors, RTC memory, boot time (millis()),
+// link state and the DHT/LDR readings. delay() is hooked (host::onDelay): the
+// scheduler's idle time becomes the node's next wake-up in the loop's timer
+// heap instead of a sleep.
+//
+// MQTT sketches (codedup) connect to the host broker (mqtt_broker.h) on a
+// thread here, or to --broker; each node's AIO_USERNAME becomes its name, so
+// it publishes node12/feeds/temperature, the layout fleet-gateway reads. With
+// --loopback there is no broker (host::mqttLoopback): commands go straight to
+// mqtt.deliver() and publishes are only counted. HTTP sketches (esp1, esp3)
+// listen on --http-port + node (free ports by default), and --http-workers
+// client threads send them the polls and commands.
+//
+// Load, all Poisson: --command-rate pump commands/s across the fleet (mode
+// manual and pump ON/OFF, as the dashboard's switch sends them), --poll-rate
+// state polls/s (HTTP), --churn reboots per node-hour (RAM reset, flash and
+// RTC memory kept, as after a watchdog reset; off for --reboot-s), --outages
+// link losses per node-hour, --outage-s long. Nodes boot over --ramp seconds.
+// A reboot does not run the sketch's destructors, so the heap its Strings and
+// sockets held leaks, a few hundred bytes per reboot.
+//
+// Prints one JSON object on stdout at the end: loop passes/s and the lag of
+// passes behind their wake-up time (it grows once the host cannot keep up),
+// MQTT connects and reconnect times, broker and telemetry throughput,
+// telemetry latency (publish → fleet subscriber), command latency (command
+// sent → pump switched) and lost commands, HTTP latency and errors, and the
+// publish rate against an Adafruit IO limit of --aio-limit data points per
+// minute per account. --interval S adds a progress line every S seconds.
+//
+// Build one binary per sketch from the repo root:
+//   g++ -std=c++17 -O2 -Ihost -DSKETCH='"../codedup.cpp"' -c host/fleetsim_node.cpp -o fleetsim_node-codedup.o
+//   objcopy --rename-section .data=fleet_data --rename-section .data.rel=fleet_data --rename-section .data.rel.local=fleet_data --rename-section .bss=fleet_bss fleetsim_node-codedup.o
+//   g++ -std=c++17 -O2 -Ihost host/fleetsim.cpp fleetsim_node-codedup.o -o fleetsim-codedup -lpthread
+//
+// Run:
+//   ./fleetsim-codedup --nodes 2000 --duration 120 --command-rate 20 --churn 2 --outages 2 --interval 10
+//   ./fleetsim-codedup --nodes 2000 --broker 127.0.0.1:1883      (with ./fleet-gateway on that broker)
+//   ./fleetsim-esp1 --nodes 200 --duration 60 --poll-rate 200 --command-rate 5
+
+#include "fleetsim_node.h"
+
+#include "Arduino.h"
+#include "DHT.h"
+#include "ESP8266WiFi.h"
+#include "Adafruit_MQTT_Client.h"
+#include "mqtt_broker.h"
+#include "mqtt_wire.h"
+
+#include <malloc.h>
+#include <mutex>
+#include <queue>
+#include <random>
+#include <vector>
+#include <sys/resource.h>
+
+static uint64_t nowUs() { return host::realMicros(); }
+
+// ---- Latency histogram: 8 buckets per power of two, good to about 12%
+struct Hist {
+  uint64_t counts[512] = {};
+  uint64_t n = 0, maxUs = 0;
+
+  static int bucket(uint64_t v) {
+    if(v < 8) return v;
+    int e = 63 - __builtin_clzll(v);
+    return (e - 2) * 8 + ((v >> (e - 3)) & 7);
+  }
+  static uint64_t upper(int b) {
+    if(b < 8) return b;
+    int e = b / 8 + 2;
+    return ((uint64_t)(8 + b % 8 + 1) << (e - 3)) - 1;
+  }
+  void add(uint64_t us) {
+    counts[bucket(us)]++;
+    n++;
+    maxUs = std::max(maxUs, us);
+  }
+  uint64_t percentile(double p) const {
+    uint64_t rank = (uint64_t)ceil(p * n), seen = 0;
+    for(int b = 0; b < 512; b++) {
+      seen += counts[b];
+      if(seen >= rank && seen > 0) return std::min(upper(b), maxUs);
+    }
+    return maxUs;
+  }
+  // {"n":..,"p50":..,"p95":..,"max":..} in ms
+  std::string json() const {
+    char buf[128];
+    snprintf(buf, sizeof(buf), "{\"n\":%llu,\"p50\":%.1f,\"p95\":%.1f,\"max\":%.1f}", (unsigned long long)n,
+             percentile(0.5) / 1e3, percentile(0.95) / 1e3, maxUs / 1e3);
+    return buf;
+  }
+};
+
+// ---- Options
+static uint32_t nodeCount = 100;
+static double durationS = 60, rampS = 5, commandRate = 1, pollRate = 10, churnRate = 0, outageRate = 0;
+static double outageS = 30, rebootS = 2, commandTimeoutS = 10, dhtFail = 0.01, intervalS = 0;
+static uint32_t httpPortBase = 0, httpWorkers = 32, httpTimeoutMs = 2000, aioLimit = 30, seed = 1;
+static std::string brokerSpec;
+static bool loopback = false;
+
+// ---- Nodes
+struct Node {
+  char name[16];
+  std::vector<uint8_t> ram;        // fleet_data then fleet_bss
+  std::vector<uint8_t> flash;
+  uint32_t rtc[128] = {};
+  uint64_t bootUs = 0;
+  uint32_t gen = 0;                // bumped on power-off; older wake-ups are dropped
+  bool running = false;
+  bool linkUp = true;
+  bool connected = false;          // MQTT
+  uint64_t waitConnectUs = 0;      // boot or link back, until MQTT is connected
+  bool afterOutage = false;
+  // Sensor model: slow sine waves with a random phase, plus noise
+  float tempMid, tempAmp, humMid, humAmp, lightMid, lightAmp;
+  double periodS, phase;
+};
+
+// What the client threads read and write
+struct Shared {
+  std::atomic<uint64_t> command{0};    // (sent us << 1) | wanted pump state, 0 for none
+  std::atomic<bool> pumpOn{false};
+  std::atomic<bool> up{false};         // running with its link up
+  std::atomic<uint16_t> port{0};
+  std::atomic<uint64_t> publishUs{0};  // last PUBLISH sent
+};
+
+static fleetnode::Kind kind;
+static std::vector<Node> nodes;
+static std::unique_ptr<Shared[]> shared;
+static std::vector<uint8_t> pristine;
+static size_t dataSize, bssSize;
+static int resident = -1;              // node whose RAM is loaded
+static uint32_t current = 0;           // node being run, for the hooks
+static unsigned long idleMs;
+static std::mt19937 rng;
+static std::atomic<bool> stopping{false};
+static std::atomic<uint32_t> workersBusy{0};   // HTTP requests in flight
+
+// ---- Stats (main thread unless atomic)
+static uint64_t passes, passUs, swaps, swapUs, busyUs, lagSumUs;
+static uint64_t boots, reboots, outages, mqttConnects, mqttDrops;
+static uint64_t commandsApplied, commandsLost;
+static std::atomic<uint64_t> commandsSent{0}, commandsOffline{0};
+static std::atomic<uint64_t> published{0}, telemetryIn{0};
+static std::atomic<uint64_t> httpPolls{0}, httpCommands{0}, httpOk{0}, httpShed{0}, httpErrors{0}, httpLate{0};
+static Hist lagHist, commandHist, bootConnectHist, reconnectHist;
+static Hist telemetryHist, pollHist, httpCommandHist;     // under statsLock
+static std::mutex statsLock;
+
+static double expInterval(std::mt19937 &r, double ratePerS) {
+  return -log(1.0 - std::uniform_real_distribution<double>(0, 1)(r)) / ratePerS;
+}
+
+static void saveRam(Node &n) {
+  memcpy(n.ram.data(), __start_fleet_data, dataSize);
+  memcpy(n.ram.data() + dataSize, __start_fleet_bss, bssSize);
+  memcpy(n.rtc, host::rtcMemory, sizeof(n.rtc));
+}
+
+static void loadRam(const Node &n) {
+  memcpy(__start_fleet_data, n.ram.data(), dataSize);
+  memcpy(__start_fleet_bss, n.ram.data() + dataSize, bssSize);
+  memcpy(host::rtcMemory, n.rtc, sizeof(n.rtc));
+}
+
+// Makes node i the board the sketch code runs on
+static void swapTo(uint32_t i) {
+  Node &n = nodes[i];
+  if(resident != (int)i) {
+    uint64_t s = nowUs();
+    if(resident >= 0) saveRam(nodes[resident]);
+    loadRam(n);
+    resident = i;
+    swaps++;
+    swapUs += nowUs() - s;
+  }
+  current = i;
+  host::flash = n.flash.data();
+  host::wifiUp = n.linkUp;
+  host::bootMicros = n.bootUs;
+  host::mqttUser = n.name;
+}
+
+// DHT11 readings in whole degrees and percent
+static void sense(Node &n, uint64_t now) {
+  static std::normal_distribution<float> noise(0, 0.3f);
+  double x = 2 * M_PI * (now / 1e6) / n.periodS + n.phase;
+  bool fail = std::uniform_real_distribution<double>(0, 1)(rng) < dhtFail;
+  host::dhtTemp = fail ? NAN : roundf(n.tempMid + n.tempAmp * sin(x) + noise(rng));
+  host::dhtHum = fail ? NAN : roundf(n.humMid + n.humAmp * cos(x) + noise(rng));
+  host::analogValue[0] = constrain((int)(n.lightMid + n.lightAmp * sin(0.7 * x + 1) + 20 * noise(rng)), 0, 1023);
+}
+
+// ---- Event loop
+enum EventType : uint8_t { EV_BOOT, EV_CHURN, EV_OUTAGE, EV_LINK_UP, EV_COMMAND, EV_TICK };
+
+struct Event {
+  uint64_t us;
+  EventType type;
+  uint32_t node;
+  bool operator>(const Event &o) const { return us > o.us; }
+};
+
+struct Wake {
+  uint64_t us;
+  uint32_t node, gen;
+  bool operator>(const Wake &o) const { return us > o.us; }
+};
+
+static std::priority_queue<Event, std::vector<Event>, std::greater<Event>> events;
+static std::priority_queue<Wake, std::vector<Wake>, std::greater<Wake>> wakes;
+
+// After setup() or a loop() pass: command completion, MQTT link changes
+static void afterPass(uint32_t i, uint64_t now) {
+  Node &n = nodes[i];
+  Shared &s = shared[i];
+  bool pump = fleetnode::pumpOn();
+  s.pumpOn = pump;
+  uint64_t cmd = s.command.load();
+  if(cmd && (bool)(cmd & 1) == pump && s.command.compare_exchange_strong(cmd, 0)) {
+    commandsApplied++;
+    commandHist.add(now - (cmd >> 1));
+  }
+  if(kind != fleetnode::KIND_MQTT) return;
+  bool up = fleetnode::mqttConnected();
+  if(up && !n.connected) {
+    mqttConnects++;
+    if(n.waitConnectUs) (n.afterOutage ? reconnectHist : bootConnectHist).add(now - n.waitConnectUs);
+    n.waitConnectUs = 0;
+  }
+  if(!up && n.connected) mqttDrops++;
+  n.connected = up;
+}
+
+static void boot(uint32_t i, uint64_t now) {
+  Node &n = nodes[i];
+  n.running = true;
+  n.bootUs = now;
+  n.waitConnectUs = n.linkUp ? now : 0;
+  n.afterOutage = false;
+  if(kind == fleetnode::KIND_HTTP) setenv("HOST_HTTP_PORT", std::to_string(httpPortBase ? httpPortBase + i : 0).c_str(), 1);
+  swapTo(i);
+  sense(n, now);
+  fleetnode::boot();
+  shared[i].port = fleetnode::httpPort();
+  shared[i].up = n.linkUp;
+  afterPass(i, nowUs());
+  wakes.push({ now, i, n.gen });
+  boots++;
+}
+
+static void powerOff(uint32_t i) {
+  Node &n = nodes[i];
+  swapTo(i);
+  fleetnode::powerOff();
+  if(resident == (int)i) resident = -1;    // what is loaded is now stale
+  n.ram = pristine;
+  n.running = false;
+  n.connected = false;
+  n.gen++;
+  shared[i].up = false;
+  shared[i].port = 0;
+}
+
+static void runNode(const Wake &w) {
+  Node &n = nodes[w.node];
+  uint64_t start = nowUs();
+  lagHist.add(start - w.us);
+  lagSumUs += start - w.us;
+  swapTo(w.node);
+  sense(n, start);
+  idleMs = 1;      // a pass that does not idle runs again right away
+  fleetnode::pass();
+  uint64_t end = nowUs();
+  passes++;
+  passUs += end - start;
+  afterPass(w.node, end);
+  wakes.push({ end + idleMs * 1000ULL, w.node, n.gen });
+}
+
+// ---- Broker connections (MQTT sketches)
+static int connectTcp(const std::string &spec) {
+  size_t colon = spec.find(':');
+  std::string hostName = spec.substr(0, colon);
+  addrinfo hints = {}, *ai = nullptr;
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  if(getaddrinfo(hostName.c_str(), colon == std::string::npos ? "1883" : spec.c_str() + colon + 1, &hints, &ai) != 0) return -1;
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  if(connect(fd, ai->ai_addr, ai->ai_addrlen) < 0) {
+    close(fd);
+    fd = -1;
+  }
+  freeaddrinfo(ai);
+  return fd;
+}
+
+static bool sendAll(int fd, const std::string &data) {
+  size_t sent = 0;
+  while(sent < data.size()) {
+    ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+    if(n <= 0) return false;
+    sent += n;
+  }
+  return true;
+}
+
+static int mqttSession(const char *clientId, const char *filter) {
+  int fd = connectTcp(brokerSpec);
+  if(fd < 0) return -1;
+  std::string out;
+  mqtt::appendConnect(out, clientId, 600);
+  if(filter) mqtt::appendSubscribe(out, 1, filter);
+  return sendAll(fd, out) ? fd : -1;
+}
+
+static bool isCommandFeed(std::string_view feed) { return feed == "mode" || feed == "pumpControl"; }
+
+// Everything the nodes publish, via a "+/feeds/+" subscription
+static void subscriber(int fd) {
+  std::string rx;
+  char buf[65536];
+  while(!stopping) {
+    pollfd p = { fd, POLLIN, 0 };
+    if(poll(&p, 1, 100) <= 0) continue;
+    ssize_t got = recv(fd, buf, sizeof(buf), 0);
+    if(got <= 0) break;
+    rx.append(buf, got);
+    uint64_t now = nowUs();
+    size_t used = 0;
+    uint8_t header;
+    std::string_view body, topic, payload;
+    long len;
+    std::lock_guard<std::mutex> lock(statsLock);
+    while((len = mqtt::parsePacket(std::string_view(rx).substr(used), header, body)) > 0) {
+      used += len;
+      if((header >> 4) != mqtt::PUBLISH || !mqtt::parsePublish(header, body, topic, payload)) continue;
+      size_t slash = topic.rfind('/');
+      if(topic.compare(0, 4, "node") != 0 || slash == std::string_view::npos || isCommandFeed(topic.substr(slash + 1))) continue;
+      uint32_t i = strtoul(std::string(topic.substr(4, 8)).c_str(), nullptr, 10);
+      if(i >= nodeCount) continue;
+      telemetryIn++;
+      uint64_t sent = shared[i].publishUs.load();
+      if(sent && sent <= now) telemetryHist.add(now - sent);
+    }
+    rx.erase(0, used);
+  }
+}
+
+static int commandFd = -1;
+
+// One dashboard command: manual mode, then the pump to the other state. A
+// node has one command outstanding at most, as with one user at a dashboard;
+// one sent to a node that is down is lost and not timed.
+static void sendCommand(uint32_t i, uint64_t now) {
+  Shared &s = shared[i];
+  if(s.command.load()) return;
+  commandsSent++;
+  bool want = !s.pumpOn;
+  if(s.up) s.command = (now << 1) | want;
+  else commandsOffline++;
+  if(loopback) {
+    if(!s.up) return;
+    swapTo(i);
+    fleetnode::deliver("mode", "manual");
+    fleetnode::deliver("pumpControl", want ? "ON" : "OFF");
+    return;
+  }
+  std::string out, prefix = std::string(nodes[i].name) + "/feeds/";
+  mqtt::appendPublish(out, prefix + "mode", "manual");
+  mqtt::appendPublish(out, prefix + "pumpControl", want ? "ON" : "OFF");
+  sendAll(commandFd, out);
+}
+
+// ---- HTTP clients (HTTP sketches)
+static std::mutex jobLock;
+static uint64_t nextPollUs, nextCommandUs;
+static std::mt19937 jobRng;
+
+// Status code, or -1 for no answer within httpTimeoutMs
+static int httpGet(uint16_t port, const std::string &path) {
+  if(!port) return -1;
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  timeval tv = { (time_t)(httpTimeoutMs / 1000), (suseconds_t)(httpTimeoutMs % 1000 * 1000) };
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+  sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = htons(port);
+  std::string in;
+  if(connect(fd, (sockaddr *)&addr, sizeof(addr)) == 0 &&
+     sendAll(fd, "GET " + path + " HTTP/1.1\r\nHost: node\r\nConnection: close\r\n\r\n")) {
+    char buf[16384];
+    ssize_t n;
+    while((n = recv(fd, buf, sizeof(buf), 0)) > 0) in.append(buf, n);
+  }
+  close(fd);
+  return in.compare(0, 9, "HTTP/1.1 ") == 0 ? atoi(in.c_str() + 9) : -1;
+}
+
+static void httpWorker() {
+  const std::string statePath = fleetnode::statePath();
+  while(!stopping) {
+    bool command;
+    uint64_t due;
+    uint32_t i;
+    {
+      std::lock_guard<std::mutex> lock(jobLock);
+      command = commandRate > 0 && (pollRate <= 0 || nextCommandUs < nextPollUs);
+      uint64_t &next = command ? nextCommandUs : nextPollUs;
+      due = next;
+      next += (uint64_t)(expInterval(jobRng, command ? commandRate : pollRate) * 1e6);
+      i = jobRng() % nodeCount;
+    }
+    uint64_t now = nowUs();
+    if(due > now) std::this_thread::sleep_for(std::chrono::microseconds(due - now));
+    else if(now - due > 100000) httpLate++;     // the workers are behind the offered load
+    workersBusy++;
+    if(stopping) {
+      workersBusy--;
+      break;
+    }
+
+    // As sendCommand(); with a command outstanding the node gets a poll instead
+    Shared &s = shared[i];
+    std::string path = statePath;
+    if(command) {
+      bool want = !s.pumpOn;
+      uint64_t expected = 0;
+      if(!s.up) commandsOffline++;
+      if(!s.up || s.command.compare_exchange_strong(expected, (nowUs() << 1) | want)) {
+        commandsSent++;
+        path = fleetnode::commandPath(want);
+      } else {
+        command = false;
+      }
+    }
+    uint64_t start = nowUs();
+    int code = httpGet(s.port, path);
+    uint64_t us = nowUs() - start;
+    (command ? httpCommands : httpPolls)++;
+    if(code >= 200 && code < 300) httpOk++;
+    else if(code == 503) httpShed++;
+    else httpErrors++;
+    if(code > 0) {
+      std::lock_guard<std::mutex> lock(statsLock);
+      (command ? httpCommandHist : pollHist).add(us);
+    }
+    workersBusy--;
+  }
+}
+
+// ---- Setup checks
+static void raiseFdLimit() {
+  rlimit r;
+  if(getrlimit(RLIMIT_NOFILE, &r) == 0 && r.rlim_cur < r.rlim_max) {
+    r.rlim_cur = r.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &r);
+  }
+}
+
+// A global that owns heap memory after static init would be shared by every
+// node's copy of it. Looks for pointers into the main malloc arena.
+static bool ramOwnsHeap() {
+  struct mallinfo2 mi = mallinfo2();
+  uintptr_t top = (uintptr_t)sbrk(0), bottom = top - mi.arena;
+  for(size_t off = 0; off + sizeof(uintptr_t) <= pristine.size(); off += sizeof(uintptr_t)) {
+    uintptr_t v;
+    memcpy(&v, pristine.data() + off, sizeof(v));
+    if(v >= bottom && v < top) return true;
+  }
+  return false;
+}
+
+static void usage(const char *argv0) {
+  fprintf(stderr, "usage: %s [--nodes N] [--duration S] [--ramp S] [--command-rate R] [--poll-rate R]\n"
+                  "          [--churn R] [--reboot-s S] [--outages R] [--outage-s S] [--command-timeout S]\n"
+                  "          [--dht-fail P] [--broker host:port | --loopback] [--http-port P] [--http-workers N]\n"
+                  "          [--http-timeout-ms MS] [--aio-limit N] [--seed N] [--interval S] [--verbose]\n", argv0);
+}
+
+// Progress over the last interval
+struct Progress {
+  uint64_t passes, lagUs, telemetry, applied, httpOk, httpErrors;
+};
+
+static void printInterval(double t, double spanS, Progress &last) {
+  uint32_t running = 0, online = 0;
+  for(uint32_t i = 0; i < nodeCount; i++) {
+    running += nodes[i].running;
+    online += kind == fleetnode::KIND_MQTT ? nodes[i].connected : shared[i].up.load();
+  }
+  Progress now = { passes, lagSumUs, telemetryIn, commandsApplied, httpOk, httpErrors };
+  uint64_t p = now.passes - last.passes;
+  printf("{\"t\":%.0f,\"running\":%u,\"online\":%u,\"passes_per_s\":%.0f,\"lag_ms_mean\":%.2f,"
+         "\"commands_applied\":%llu,", t, running, online, p / spanS, p ? (now.lagUs - last.lagUs) / 1e3 / p : 0.0,
+         (unsigned long long)(now.applied - last.applied));
+  if(kind == fleetnode::KIND_MQTT) printf("\"telemetry_per_s\":%.1f}\n", (now.telemetry - last.telemetry) / spanS);
+  else printf("\"http_ok\":%llu,\"http_errors\":%llu}\n", (unsigned long long)(now.httpOk - last.httpOk),
+              (unsigned long long)(now.httpErrors - last.httpErrors));
+  fflush(stdout);
+  last = now;
+}
+
+int main(int argc, char **argv) {
+  bool verbose = false;
+  for(int i = 1; i < argc; i++) {
+    std::string a = argv[i];
+    const char *v = i + 1 < argc ? argv[i + 1] : "";
+    if(a == "--loopback") { loopback = true; continue; }
+    if(a == "--verbose") { verbose = true; continue; }
+    i++;
+    if(a == "--nodes") nodeCount = strtoul(v, nullptr, 10);
+    else if(a == "--duration") durationS = atof(v);
+    else if(a == "--ramp") rampS = atof(v);
+    else if(a == "--command-rate") commandRate = atof(v);
+    else if(a == "--poll-rate") pollRate = atof(v);
+    else if(a == "--churn") churnRate = atof(v);
+    else if(a == "--reboot-s") rebootS = atof(v);
+    else if(a == "--outages") outageRate = atof(v);
+    else if(a == "--outage-s") outageS = atof(v);
+    else if(a == "--command-timeout") commandTimeoutS = atof(v);
+    else if(a == "--dht-fail") dhtFail = atof(v);
+    else if(a == "--broker") brokerSpec = v;
+    else if(a == "--http-port") httpPortBase = strtoul(v, nullptr, 10);
+    else if(a == "--http-workers") httpWorkers = strtoul(v, nullptr, 10);
+    else if(a == "--http-timeout-ms") httpTimeoutMs = strtoul(v, nullptr, 10);
+    else if(a == "--aio-limit") aioLimit = strtoul(v, nullptr, 10);
+    else if(a == "--seed") seed = strtoul(v, nullptr, 10);
+    else if(a == "--interval") intervalS = atof(v);
+    else {
+      usage(argv[0]);
+      return 2;
+    }
+  }
+  if(nodeCount == 0 || durationS <= 0) {
+    usage(argv[0]);
+    return 2;
+  }
+  kind = fleetnode::kind();
+  if(loopback && kind != fleetnode::KIND_MQTT) {
+    fprintf(stderr, "fleetsim: --loopback is for MQTT sketches\n");
+    return 2;
+  }
+  raiseFdLimit();
+  host::quiet = !verbose;
+
+  // The board's RAM as static init left it: every node starts from this
+  dataSize = __stop_fleet_data - __start_fleet_data;
+  bssSize = __stop_fleet_bss - __start_fleet_bss;
+  pristine.resize(dataSize + bssSize);
+  memcpy(pristine.data(), __start_fleet_data, dataSize);
+  memcpy(pristine.data() + dataSize, __start_fleet_bss, bssSize);
+  if(ramOwnsHeap()) {
+    fprintf(stderr, "fleetsim: the sketch's globals own heap memory after static init; nodes cannot share it\n");
+    return 1;
+  }
+
+  rng.seed(seed);
+  jobRng.seed(seed + 1);
+  nodes.resize(nodeCount);
+  shared.reset(new Shared[nodeCount]);
+  std::uniform_real_distribution<float> u(0, 1);
+  for(uint32_t i = 0; i < nodeCount; i++) {
+    Node &n = nodes[i];
+    snprintf(n.name, sizeof(n.name), "node%u", i);
+    n.ram = pristine;
+    n.flash.assign(host::flashSectors * SPI_FLASH_SEC_SIZE, 0xFF);
+    n.tempMid = 24 + 8 * u(rng);
+    n.tempAmp = 1 + 3 * u(rng);
+    n.humMid = 45 + 20 * u(rng);
+    n.humAmp = 5 + 10 * u(rng);
+    n.lightMid = 300 + 400 * u(rng);
+    n.lightAmp = 100 + 200 * u(rng);
+    n.periodS = 300 + 1500 * u(rng);
+    n.phase = 2 * M_PI * u(rng);
+  }
+
+  // Broker: our own unless one is given
+  MqttBroker broker;
+  std::thread brokerThread, subscriberThread;
+  std::vector<std::thread> workers;
+  bool ownBroker = false;
+  host::mqttLoopback = loopback;
+  if(kind == fleetnode::KIND_MQTT && !loopback) {
+    if(brokerSpec.empty()) {
+      if(!broker.begin(0)) {
+        perror("fleetsim: broker");
+        return 1;
+      }
+      brokerThread = std::thread([&] { broker.run(stopping); });
+      brokerSpec = "127.0.0.1:" + std::to_string(broker.port());
+      ownBroker = true;
+    }
+    setenv("HOST_MQTT_BROKER", brokerSpec.c_str(), 1);
+    int subFd = mqttSession("fleetsim-telemetry", "+/feeds/+");
+    commandFd = mqttSession("fleetsim-commands", nullptr);
+    if(subFd < 0 || commandFd < 0) {
+      fprintf(stderr, "fleetsim: cannot reach the broker at %s\n", brokerSpec.c_str());
+      return 1;
+    }
+    subscriberThread = std::thread(subscriber, subFd);
+  }
+  host::onDelay = [](unsigned long ms) { idleMs = ms; };
+  host::onMqttPublish = [](const std::string &) {
+    published++;
+    shared[current].publishUs = nowUs();
+  };
+
+  uint64_t t0 = nowUs(), endUs = t0 + (uint64_t)(durationS * 1e6);
+  for(uint32_t i = 0; i < nodeCount; i++) events.push({ t0 + (uint64_t)(rampS * 1e6 * i / nodeCount), EV_BOOT, i });
+  auto schedule = [&](EventType type, double rate, uint64_t from) {
+    if(rate > 0) events.push({ from + (uint64_t)(expInterval(rng, rate) * 1e6), type, 0 });
+  };
+  double perNodeHour = nodeCount / 3600.0;
+  schedule(EV_CHURN, churnRate * perNodeHour, t0);
+  schedule(EV_OUTAGE, outageRate * perNodeHour, t0);
+  if(kind == fleetnode::KIND_MQTT) schedule(EV_COMMAND, commandRate, t0);
+  events.push({ t0 + 1000000, EV_TICK, 0 });
+  if(kind == fleetnode::KIND_HTTP) {
+    nextPollUs = nextCommandUs = t0 + (uint64_t)(rampS * 1e6);
+    if(commandRate > 0 || pollRate > 0) {
+      for(uint32_t w = 0; w < httpWorkers; w++) workers.emplace_back(httpWorker);
+    }
+  }
+
+  Progress progress = {};
+  uint64_t nextIntervalUs = t0 + (uint64_t)(intervalS * 1e6);
+  while(true) {
+    // At the end the nodes keep running until the requests in flight are answered
+    uint64_t now = nowUs();
+    if(now >= endUs) {
+      stopping = true;
+      if(workersBusy == 0 || now >= endUs + httpTimeoutMs * 1000ULL) break;
+    }
+    if(!stopping && !events.empty() && events.top().us <= now) {
+      Event e = events.top();
+      events.pop();
+      uint64_t s = nowUs();
+      switch(e.type) {
+        case EV_BOOT:
+          boot(e.node, now);
+          break;
+        case EV_CHURN: {
+          uint32_t i = rng() % nodeCount;
+          if(nodes[i].running) {
+            powerOff(i);
+            reboots++;
+            events.push({ now + (uint64_t)(rebootS * 1e6), EV_BOOT, i });
+          }
+          schedule(EV_CHURN, churnRate * perNodeHour, now);
+          break;
+        }
+        case EV_OUTAGE: {
+          uint32_t i = rng() % nodeCount;
+          Node &n = nodes[i];
+          if(n.linkUp) {
+            n.linkUp = false;
+            shared[i].up = false;
+            if(n.running) {
+              swapTo(i);
+              fleetnode::linkDown();
+            }
+            outages++;
+            events.push({ now + (uint64_t)(outageS * 1e6), EV_LINK_UP, i });
+          }
+          schedule(EV_OUTAGE, outageRate * perNodeHour, now);
+          break;
+        }
+        case EV_LINK_UP: {
+          Node &n = nodes[e.node];
+          n.linkUp = true;
+          n.waitConnectUs = now;
+          n.afterOutage = true;
+          shared[e.node].up = n.running;
+          break;
+        }
+        case EV_COMMAND:
+          if(now >= t0 + rampS * 1e6) sendCommand(rng() % nodeCount, now);
+          schedule(EV_COMMAND, commandRate, now);
+          break;
+        case EV_TICK:
+          // Commands not applied in time were lost on the way
+          for(uint32_t i = 0; i < nodeCount; i++) {
+            uint64_t cmd = shared[i].command.load();
+            if(cmd && now - (cmd >> 1) > commandTimeoutS * 1e6 && shared[i].command.compare_exchange_strong(cmd, 0)) commandsLost++;
+          }
+          if(intervalS > 0 && now >= nextIntervalUs) {
+            printInterval((now - t0) / 1e6, intervalS + (now - nextIntervalUs) / 1e6, progress);
+            nextIntervalUs += (uint64_t)(intervalS * 1e6);
+          }
+          events.push({ e.us + 1000000, EV_TICK, 0 });
+          break;
+      }
+      busyUs += nowUs() - s;
+      continue;
+    }
+    // Wake-ups left by a node's earlier life are dropped
+    while(!wakes.empty() && (!nodes[wakes.top().node].running || wakes.top().gen != nodes[wakes.top().node].gen)) wakes.pop();
+    if(!wakes.empty() && wakes.top().us <= now) {
+      Wake w = wakes.top();
+      wakes.pop();
+      uint64_t s = nowUs();
+      runNode(w);
+      busyUs += nowUs() - s;
+      continue;
+    }
+    uint64_t next = stopping ? now + 1000 : endUs;
+    if(!stopping && !events.empty()) next = std::min(next, events.top().us);
+    if(!wakes.empty()) next = std::min(next, wakes.top().us);
+    if(next > now) std::this_thread::sleep_for(std::chrono::microseconds(next - now));
+  }
+  stopping = true;
+  for(auto &w : workers) w.join();
+  if(subscriberThread.joinable()) subscriberThread.join();
+  if(brokerThread.joinable()) brokerThread.join();
+
+  // ---- Report
+  double wallS = (nowUs() - t0) / 1e6;
+  double nodeMin = 0;
+  uint32_t running = 0;
+  for(auto &n : nodes) {
+    running += n.running;
+    nodeMin += n.running ? (nowUs() - n.bootUs) / 60e6 : 0;
+  }
+  double perNodeMin = nodeMin > 0 ? published / nodeMin : 0;
+  double fleetPerMin = published / (wallS / 60);
+  printf("{\"sketch\":\"%s\",\"kind\":\"%s\",\"nodes\":%u,\"running\":%u,\"seconds\":%.1f,\"ram_bytes\":%zu,"
+         "\"loop\":{\"passes_per_s\":%.0f,\"pass_us\":%.2f,\"swap_us\":%.2f,\"busy_share\":%.3f,\"lag_ms\":%s},"
+         "\"events\":{\"boots\":%llu,\"reboots\":%llu,\"outages\":%llu},",
+         fleetnode::sketch(), kind == fleetnode::KIND_MQTT ? "mqtt" : "http", nodeCount, running, wallS,
+         pristine.size(), passes / wallS, passes ? (double)passUs / passes : 0.0, swaps ? (double)swapUs / swaps : 0.0,
+         busyUs / 1e6 / wallS, lagHist.json().c_str(),
+         (unsigned long long)boots, (unsigned long long)reboots, (unsigned long long)outages);
+  if(kind == fleetnode::KIND_MQTT) {
+    printf("\"mqtt\":{\"broker\":\"%s\",\"connects\":%llu,\"drops\":%llu,\"boot_to_connect_ms\":%s,\"reconnect_ms\":%s},",
+           loopback ? "loopback" : brokerSpec.c_str(), (unsigned long long)mqttConnects,
+           (unsigned long long)mqttDrops, bootConnectHist.json().c_str(), reconnectHist.json().c_str());
+    if(ownBroker) {
+      printf("\"broker\":{\"in_per_s\":%.0f,\"out_per_s\":%.0f,\"dropped\":%llu},",
+             broker.messagesIn / wallS, broker.messagesOut / wallS, (unsigned long long)broker.messagesDropped.load());
+    }
+    printf("\"telemetry\":{\"published\":%llu,\"received\":%llu,\"per_s\":%.1f,\"latency_ms\":%s,"
+           "\"per_node_min\":%.2f,\"aio_limit_per_min\":%u,\"aio_accounts_needed\":%.0f},",
+           (unsigned long long)published.load(), (unsigned long long)telemetryIn.load(), published / wallS,
+           telemetryHist.json().c_str(), perNodeMin, aioLimit, ceil(fleetPerMin / aioLimit));
+  } else {
+    printf("\"http\":{\"polls\":%llu,\"commands\":%llu,\"ok\":%llu,\"shed\":%llu,\"errors\":%llu,\"late\":%llu,"
+           "\"poll_ms\":%s,\"command_ms\":%s},",
+           (unsigned long long)httpPolls.load(), (unsigned long long)httpCommands.load(),
+           (unsigned long long)httpOk.load(), (unsigned long long)httpShed.load(),
+           (unsigned long long)httpErrors.load(), (unsigned long long)httpLate.load(),
+           pollHist.json().c_str(), httpCommandHist.json().c_str());
+  }
+  printf("\"commands\":{\"sent\":%llu,\"to_offline\":%llu,\"applied\":%llu,\"lost\":%llu,\"latency_ms\":%s}}\n",
+         (unsigned long long)commandsSent.load(), (unsigned long long)commandsOffline.load(), (unsigned long long)commandsApplied,
+         (unsigned long long)commandsLost, commandHist.json().c_str());
+  fflush(stdout);
+  // Skip static destructors: the sketch's would run on whichever node's RAM is loaded
+  _exit(0);
+}
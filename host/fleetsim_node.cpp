@@ -0,0 +1,90 @@
+// The sketch under test for host/fleetsim.cpp, compiled on its own so its
+// globals can be renamed into the fleet_data/fleet_bss sections (see the
+// build lines there). Nothing here may add globals of its own: they would be
+// swapped with the board's RAM.
+//
+// Supports the sketches with an MQTT client (codedup) or the HTTP server
+// (esp1, esp3).
+
+#include "fleetsim_node.h"
+
+#include SKETCH
+
+#if !defined(MQTT_CONN_KEEPALIVE) && !defined(HTTP_MAX_CONNS)
+#error "fleetsim needs a sketch with the MQTT client or the HTTP server"
+#endif
+
+namespace fleetnode {
+
+Kind kind() {
+#ifdef MQTT_CONN_KEEPALIVE
+  return KIND_MQTT;
+#else
+  return KIND_HTTP;
+#endif
+}
+
+const char *sketch() { return SKETCH; }
+
+void boot() { setup(); }
+
+void pass() { loop(); }
+
+void powerOff() {
+  linkDown();
+#ifdef HTTP_MAX_CONNS
+  server.stop();
+#endif
+}
+
+void linkDown() {
+#ifdef MQTT_CONN_KEEPALIVE
+  client.stop();
+#endif
+#ifdef HTTP_MAX_CONNS
+  for(auto &c : httpConns) c.client.stop();
+#endif
+}
+
+bool pumpOn() { return pumpState; }
+
+bool mqttConnected() {
+#ifdef MQTT_CONN_KEEPALIVE
+  return mqtt.connected();
+#else
+  return false;
+#endif
+}
+
+bool deliver(const char *feed, const char *payload) {
+#ifdef MQTT_CONN_KEEPALIVE
+  return mqtt.deliver(feed, payload);
+#else
+  (void)feed;
+  (void)payload;
+  return false;
+#endif
+}
+
+uint16_t httpPort() {
+#ifdef HTTP_MAX_CONNS
+  return server.port();
+#else
+  return 0;
+#endif
+}
+
+const char *statePath() {
+#ifdef HTTP_MAX_CONNS
+  return findRoute("/data") >= 0 ? "/data" : "/getSensorData";
+#else
+  return nullptr;
+#endif
+}
+
+// The dashboard's manual switch: mode and pump in one request
+std::string commandPath(bool on) {
+  return std::string("/control?mode=manual&pump=") + (on ? "ON" : "OFF");
+}
+
+}  // namespace fleetnode
@@ -0,0 +1,34 @@
+// What host/fleetsim.cpp sees of the sketch compiled into host/fleetsim_node.cpp.
+// The sketch's .data and .bss are renamed to fleet_data and fleet_bss in that
+// object, so the simulator can find the board's RAM and keep one copy per
+// node; these calls act on whichever copy is loaded.
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+namespace fleetnode {
+  enum Kind : uint8_t { KIND_MQTT, KIND_HTTP };
+
+  Kind kind();
+  const char *sketch();   // the SKETCH it was built from
+  void boot();            // setup()
+  void pass();            // one loop()
+  void powerOff();        // closes the board's sockets before its RAM is reset
+  void linkDown();        // drops its connections, as losing the access point does
+  bool pumpOn();
+
+  // MQTT sketches
+  bool mqttConnected();
+  bool deliver(const char *feed, const char *payload);   // broker-less (host::mqttLoopback)
+
+  // HTTP sketches
+  uint16_t httpPort();
+  const char *statePath();
+  std::string commandPath(bool pumpOn);
+}
+
+extern "C" {
+  extern uint8_t __start_fleet_data[], __stop_fleet_data[];
+  extern uint8_t __start_fleet_bss[], __stop_fleet_bss[];
+}
@@ -0,0 +1,61 @@
+// Fleet gateway service; see gateway.h for the topics and HTTP API.
+//
+// Build from the repo root:
+//   g++ -std=c++17 -O2 -Ihost host/gateway.cpp -o fleet-gateway
+//
+// Run against a local broker (mosquitto, or host/mqttbroker.cpp):
+//   ./fleet-gateway --broker 127.0.0.1:1883 --http 8080
+//   curl 'localhost:8080/stats?online=60'
+//   curl 'localhost:8080/command?feed=mode&value=automatic&tempAbove=31'
+//
+// With --store DIR every reading is also kept in a time-series store
+// (tsdb.h) and served by /history:
+//   curl 'localhost:8080/history?id=node1&feed=temperature&step=3600000'
+
+#include "gateway.h"
+
+#include <csignal>
+
+static std::atomic<bool> stopping{false};
+
+int main(int argc, char **argv) {
+  std::string broker = "127.0.0.1:1883";
+  int httpPort = 8080;
+  std::string filter = "+/feeds/+";
+  std::string storeDir;
+
+  for(int i = 1; i < argc; i++) {
+    std::string a = argv[i];
+    const char *v = i + 1 < argc ? argv[i + 1] : "";
+    if(a == "--broker") { broker = v; i++; }
+    else if(a == "--http") { httpPort = atoi(v); i++; }
+    else if(a == "--filter") { filter = v; i++; }
+    else if(a == "--store") { storeDir = v; i++; }
+    else {
+      fprintf(stderr, "usage: %s [--broker host:port] [--http port] [--filter topic-filter] [--store dir]\n", argv[0]);
+      return 2;
+    }
+  }
+  size_t colon = broker.find(':');
+  std::string brokerHost = broker.substr(0, colon);
+  uint16_t brokerPort = colon == std::string::npos ? 1883 : atoi(broker.c_str() + colon + 1);
+
+  FleetGateway gateway;
+  tsdb::Store store;
+  if(!storeDir.empty()) {
+    if(!store.open(storeDir)) {
+      perror(storeDir.c_str());
+      return 1;
+    }
+    gateway.setStore(&store);
+  }
+  if(!gateway.begin(brokerHost, brokerPort, httpPort, filter)) {
+    perror("http listen");
+    return 1;
+  }
+  signal(SIGINT, [](int) { stopping = true; });
+  signal(SIGTERM, [](int) { stopping = true; });
+  fprintf(stderr, "gateway: broker %s, filter %s, http :%d\n", broker.c_str(), filter.c_str(), gateway.httpPort());
+  gateway.run(stopping);
+  return 0;
+}
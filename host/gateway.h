@@ -0,0 +1,593 @@
+// Fleet gateway: one MQTT subscription to every node's telemetry, a
+// latest-state table indexed by node, and a small HTTP API for aggregate
+// queries and command fan-out. Single-threaded on epoll.
+//
+// Nodes publish the way codedup.cpp does: "<node>/feeds/<feed>" with
+// feeds temperature, humidity (text, "23.4") and lightPercent ("57"), and
+// metrics, which only counts as being heard from. Commands go out on the
+// same scheme ("<node>/feeds/mode" = "manual"); the broker echoes them back
+// to the subscription, and they are not counted as the node's messages.
+//
+// HTTP (Connection: close, GET only):
+//   /stats[?online=S]                node count, messages, min/max/avg per reading
+//   /nodes[?online=S]                [name, temp, hum, light, ageS] per node
+//   /node?id=NAME                    one node
+//   /command?feed=F&value=V          publish V to F on every node matching
+//         [&nodes=a,b][&online=S][&tempAbove=31.5]
+//   /history?id=NODE&feed=F          min/max/avg from the time-series store
+//         [&from=MS][&to=MS][&step=MS]   (default: last 24 h, one bucket)
+// "online=S" keeps nodes heard from in the last S seconds. /history needs
+// setStore(); readings are kept there as "<node>/<feed>" in centi-units.
+#pragma once
+
+#include "mqtt_wire.h"
+#include "tsdb.h"
+
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+class FleetGateway {
+public:
+  static constexpr int16_t NO_VALUE = INT16_MIN;
+  static constexpr uint32_t STORE_FLUSH_MS = 5000;
+  static constexpr size_t MAX_HISTORY_BUCKETS = 10000;
+
+  // Latest state per node as structure-of-arrays: aggregate queries walk
+  // one or two dense columns instead of every node record
+  struct NodeTable {
+    std::unordered_map<std::string, uint32_t> index;
+    std::vector<std::string> name;
+    std::vector<int16_t> temp;          // centidegrees
+    std::vector<int16_t> hum;           // centipercent
+    std::vector<int16_t> light;         // percent
+    std::vector<uint32_t> lastSeenMs;   // gateway clock
+    std::vector<uint32_t> messages;
+  };
+
+  std::atomic<uint64_t> messagesIn{0};
+  std::atomic<uint64_t> badMessages{0};
+  std::atomic<uint64_t> commandsOut{0};
+  std::atomic<uint64_t> brokerReconnects{0};
+  std::atomic<uint32_t> nodeCount{0};
+
+  bool begin(const std::string &brokerHost, uint16_t brokerPort, uint16_t httpPort,
+             const std::string &filter = "+/feeds/+") {
+    brokerHost_ = brokerHost;
+    brokerPort_ = brokerPort;
+    filter_ = filter;
+    epollFd_ = epoll_create1(0);
+
+    httpFd_ = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    int one = 1;
+    setsockopt(httpFd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(httpPort);
+    if(bind(httpFd_, (sockaddr *)&addr, sizeof(addr)) < 0 || listen(httpFd_, 256) < 0) return false;
+    socklen_t len = sizeof(addr);
+    getsockname(httpFd_, (sockaddr *)&addr, &len);
+    httpPort_ = ntohs(addr.sin_port);
+    watch(httpFd_, EPOLLIN);
+    lastConnectMs_ = nowMs() - 1000;   // first broker attempt right away
+    return true;
+  }
+
+  // Every parsed reading is also appended to store (wall-clock ms); the
+  // store is flushed every few seconds and on exit
+  void setStore(tsdb::Store *store) { store_ = store; }
+
+  uint16_t httpPort() const { return httpPort_; }
+  bool brokerConnected() const { return brokerReady_; }
+
+  void run(const std::atomic<bool> &stop) {
+    epoll_event events[256];
+    uint32_t lastPingMs = 0, lastFlushMs = nowMs();
+    while(!stop) {
+      uint32_t now = nowMs();
+      if(store_ && now - lastFlushMs >= STORE_FLUSH_MS) {
+        lastFlushMs = now;
+        store_->flush();
+      }
+      if(brokerFd_ < 0 && now - lastConnectMs_ >= 1000) connectBroker();
+      if(brokerReady_ && now - lastPingMs >= 60000) {
+        lastPingMs = now;
+        brokerTx_.append("\xC0\x00", 2);
+        flushBroker();
+      }
+
+      int n = epoll_wait(epollFd_, events, 256, 100);
+      for(int i = 0; i < n; i++) {
+        int fd = events[i].data.fd;
+        uint32_t ev = events[i].events;
+        if(fd == httpFd_) acceptHttp();
+        else if(fd == brokerFd_) {
+          if(ev & (EPOLLHUP | EPOLLERR)) dropBroker();
+          else {
+            if(ev & EPOLLIN) readBroker();
+            if((ev & EPOLLOUT) && brokerFd_ >= 0) flushBroker();
+          }
+        } else {
+          serviceHttp(fd, ev);
+        }
+      }
+    }
+    if(store_) store_->flush();
+    if(brokerFd_ >= 0) close(brokerFd_);
+    for(auto &c : http_) close(c.first);
+    close(httpFd_);
+    close(epollFd_);
+  }
+
+private:
+  struct HttpConn {
+    std::string rx, tx;
+  };
+
+  static uint32_t nowMs() {
+    static const auto start = std::chrono::steady_clock::now();
+    return (uint32_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now() - start).count();
+  }
+
+  void watch(int fd, uint32_t events, int op = EPOLL_CTL_ADD) {
+    epoll_event ev = {};
+    ev.events = events;
+    ev.data.fd = fd;
+    epoll_ctl(epollFd_, op, fd, &ev);
+  }
+
+  // ---------------- Broker ----------------
+  void connectBroker() {
+    lastConnectMs_ = nowMs();
+    addrinfo hints = {}, *ai = nullptr;
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    if(getaddrinfo(brokerHost_.c_str(), nullptr, &hints, &ai) != 0 || !ai) return;
+    sockaddr_in addr = *(sockaddr_in *)ai->ai_addr;
+    freeaddrinfo(ai);
+    addr.sin_port = htons(brokerPort_);
+
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if(connect(fd, (sockaddr *)&addr, sizeof(addr)) < 0 && errno != EINPROGRESS) {
+      close(fd);
+      return;
+    }
+    brokerFd_ = fd;
+    brokerRx_.clear();
+    brokerTx_.clear();
+    mqtt::appendConnect(brokerTx_, "fleet-gateway", 120);
+    mqtt::appendSubscribe(brokerTx_, 1, filter_);
+    watch(fd, EPOLLIN | EPOLLOUT);
+    brokerWantWrite_ = true;
+  }
+
+  void dropBroker() {
+    epoll_ctl(epollFd_, EPOLL_CTL_DEL, brokerFd_, nullptr);
+    close(brokerFd_);
+    brokerFd_ = -1;
+    if(brokerReady_) brokerReconnects++;
+    brokerReady_ = false;
+  }
+
+  void flushBroker() {
+    while(!brokerTx_.empty()) {
+      ssize_t n = send(brokerFd_, brokerTx_.data(), brokerTx_.size(), MSG_NOSIGNAL);
+      if(n < 0) {
+        if(errno == EAGAIN || errno == EWOULDBLOCK) break;
+        dropBroker();
+        return;
+      }
+      brokerTx_.erase(0, n);
+    }
+    bool want = !brokerTx_.empty();
+    if(want != brokerWantWrite_) {
+      brokerWantWrite_ = want;
+      watch(brokerFd_, EPOLLIN | (want ? (uint32_t)EPOLLOUT : 0u), EPOLL_CTL_MOD);
+    }
+  }
+
+  void readBroker() {
+    char buf[65536];
+    while(brokerFd_ >= 0) {
+      ssize_t n = recv(brokerFd_, buf, sizeof(buf), 0);
+      if(n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+        dropBroker();
+        return;
+      }
+      if(n < 0) break;
+      brokerRx_.append(buf, n);
+
+      size_t used = 0;
+      uint8_t header;
+      std::string_view body;
+      long len;
+      uint32_t now = nowMs();
+      while((len = mqtt::parsePacket(std::string_view(brokerRx_).substr(used), header, body)) > 0) {
+        used += len;
+        uint8_t type = header >> 4;
+        if(type == mqtt::CONNACK) brokerReady_ = body.size() >= 2 && body[1] == 0;
+        else if(type == mqtt::PUBLISH) {
+          std::string_view topic, payload;
+          if(mqtt::parsePublish(header, body, topic, payload)) ingest(topic, payload, now);
+        }
+      }
+      if(len < 0) {
+        dropBroker();
+        return;
+      }
+      brokerRx_.erase(0, used);
+    }
+  }
+
+  // ---------------- Node Table ----------------
+  // "<node>/feeds/<feed>" → one column of the node's row
+  void ingest(std::string_view topic, std::string_view payload, uint32_t now) {
+    size_t slash = topic.find('/');
+    size_t feedAt = topic.rfind('/');
+    if(slash == std::string_view::npos || feedAt == slash) {
+      messagesIn++;
+      badMessages++;
+      return;
+    }
+    std::string_view feed = topic.substr(feedAt + 1);
+    if(!isTelemetryFeed(feed)) return;     // a command, ours or a dashboard's
+    messagesIn++;
+    uint32_t row = nodeRow(topic.substr(0, slash));
+
+    int32_t value;
+    bool parsed = false;
+    if(feed == "temperature" && (parsed = parseCenti(payload, value))) nodes_.temp[row] = value;
+    else if(feed == "humidity" && (parsed = parseCenti(payload, value))) nodes_.hum[row] = value;
+    else if(feed == "lightPercent" && (parsed = parseCenti(payload, value))) nodes_.light[row] = value / 100;
+    else if(feed == "temperature" || feed == "humidity" || feed == "lightPercent") badMessages++;
+    if(parsed && store_) {
+      seriesKey_.assign(nodes_.name[row]).append("/").append(feed.data(), feed.size());
+      store_->append(seriesKey_, wallMs(), value);
+    }
+    nodes_.lastSeenMs[row] = now;
+    nodes_.messages[row]++;
+  }
+
+  static bool isTelemetryFeed(std::string_view feed) {
+    return feed == "temperature" || feed == "humidity" || feed == "lightPercent" || feed == "metrics";
+  }
+
+  uint32_t nodeRow(std::string_view node) {
+    key_.assign(node.data(), node.size());   // reused buffer: no allocation per message
+    auto it = nodes_.index.find(key_);
+    if(it != nodes_.index.end()) return it->second;
+    uint32_t row = nodes_.name.size();
+    nodes_.index.emplace(key_, row);
+    nodes_.name.push_back(key_);
+    nodes_.temp.push_back(NO_VALUE);
+    nodes_.hum.push_back(NO_VALUE);
+    nodes_.light.push_back(NO_VALUE);
+    nodes_.lastSeenMs.push_back(0);
+    nodes_.messages.push_back(0);
+    nodeCount = row + 1;
+    return row;
+  }
+
+  // "23.4", "-0.25", "57" → centi-units, the sketches' fixed-point format
+  static bool parseCenti(std::string_view s, int32_t &out) {
+    size_t i = 0;
+    bool negative = i < s.size() && s[i] == '-';
+    if(negative) i++;
+    if(i >= s.size() || !isdigit((uint8_t)s[i])) return false;
+    int32_t whole = 0, frac = 0, scale = 10;
+    while(i < s.size() && isdigit((uint8_t)s[i])) {
+      whole = whole * 10 + (s[i++] - '0');
+      if(whole > 100000) return false;
+    }
+    if(i < s.size() && s[i] == '.') {
+      i++;
+      while(i < s.size() && isdigit((uint8_t)s[i])) {
+        if(scale) frac += (s[i] - '0') * scale;
+        scale /= 10;
+        i++;
+      }
+    }
+    if(i != s.size()) return false;
+    int32_t v = whole * 100 + frac;
+    if(v > INT16_MAX) return false;
+    out = negative ? -v : v;
+    return true;
+  }
+
+  static int64_t wallMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::system_clock::now().time_since_epoch()).count();
+  }
+
+  // ---------------- HTTP ----------------
+  void acceptHttp() {
+    int fd;
+    while((fd = accept4(httpFd_, nullptr, nullptr, SOCK_NONBLOCK)) >= 0) {
+      http_[fd];
+      watch(fd, EPOLLIN);
+    }
+  }
+
+  void closeHttp(int fd) {
+    epoll_ctl(epollFd_, EPOLL_CTL_DEL, fd, nullptr);
+    close(fd);
+    http_.erase(fd);
+  }
+
+  void serviceHttp(int fd, uint32_t ev) {
+    auto it = http_.find(fd);
+    if(it == http_.end()) return;
+    HttpConn &c = it->second;
+    if(ev & (EPOLLHUP | EPOLLERR)) {
+      closeHttp(fd);
+      return;
+    }
+    if((ev & EPOLLIN) && c.tx.empty()) {
+      char buf[4096];
+      ssize_t n;
+      while((n = recv(fd, buf, sizeof(buf), 0)) > 0) c.rx.append(buf, n);
+      if(n == 0 && c.rx.find("\r\n\r\n") == std::string::npos) {
+        closeHttp(fd);
+        return;
+      }
+      if(c.rx.find("\r\n\r\n") == std::string::npos) {
+        if(c.rx.size() > 8192) closeHttp(fd);
+        return;
+      }
+      c.tx = respond(c.rx);
+    }
+    while(!c.tx.empty()) {
+      ssize_t n = send(fd, c.tx.data(), c.tx.size(), MSG_NOSIGNAL);
+      if(n < 0) {
+        if(errno == EAGAIN || errno == EWOULDBLOCK) {
+          watch(fd, EPOLLOUT, EPOLL_CTL_MOD);
+          return;
+        }
+        break;
+      }
+      c.tx.erase(0, n);
+    }
+    closeHttp(fd);
+  }
+
+  static std::string urlDecode(std::string_view s) {
+    std::string out;
+    for(size_t i = 0; i < s.size(); i++) {
+      if(s[i] == '+') out += ' ';
+      else if(s[i] == '%' && i + 2 < s.size()) {
+        out += (char)strtol(std::string(s.substr(i + 1, 2)).c_str(), nullptr, 16);
+        i += 2;
+      } else out += s[i];
+    }
+    return out;
+  }
+
+  static std::string queryArg(std::string_view query, std::string_view name) {
+    size_t pos = 0;
+    while(pos < query.size()) {
+      size_t amp = query.find('&', pos);
+      if(amp == std::string_view::npos) amp = query.size();
+      std::string_view item = query.substr(pos, amp - pos);
+      size_t eq = item.find('=');
+      if(item.substr(0, eq) == name) return eq == std::string_view::npos ? "" : urlDecode(item.substr(eq + 1));
+      pos = amp + 1;
+    }
+    return std::string();
+  }
+
+  static std::string reply(int status, const char *type, const std::string &body) {
+    const char *reason = status == 200 ? "OK" : status == 404 ? "Not Found" : "Bad Request";
+    char head[160];
+    snprintf(head, sizeof(head), "HTTP/1.1 %d %s\r\nContent-Type: %s\r\nContent-Length: %zu\r\n"
+             "Connection: close\r\n\r\n", status, reason, type, body.size());
+    return head + body;
+  }
+
+  static void appendCenti(std::string &out, int32_t v) {
+    if(v == NO_VALUE) {
+      out += "null";
+      return;
+    }
+    char buf[16];
+    snprintf(buf, sizeof(buf), "%s%d.%02d", v < 0 ? "-" : "", abs(v) / 100, abs(v) % 100);
+    out += buf;
+  }
+
+  // Rows heard from within onlineS seconds (0 = all rows)
+  bool online(uint32_t row, uint32_t now, uint32_t onlineS) const {
+    return onlineS == 0 || now - nodes_.lastSeenMs[row] <= onlineS * 1000;
+  }
+
+  std::string respond(const std::string &request) {
+    if(request.compare(0, 4, "GET ") != 0) return reply(400, "text/plain", "GET only\n");
+    size_t end = request.find(' ', 4);
+    std::string_view target(request.data() + 4, (end == std::string::npos ? request.size() : end) - 4);
+    size_t q = target.find('?');
+    std::string_view path = target.substr(0, q);
+    std::string_view query = q == std::string_view::npos ? std::string_view() : target.substr(q + 1);
+    uint32_t now = nowMs();
+    uint32_t onlineS = strtoul(queryArg(query, "online").c_str(), nullptr, 10);
+    size_t count = nodes_.name.size();
+
+    if(path == "/stats") {
+      // One pass per column keeps each loop on a single dense array
+      struct Agg { int32_t min = INT32_MAX, max = INT32_MIN; int64_t sum = 0; uint32_t n = 0; };
+      auto column = [&](const std::vector<int16_t> &col) {
+        Agg a;
+        for(size_t r = 0; r < count; r++) {
+          int16_t v = col[r];
+          if(v == NO_VALUE || !online(r, now, onlineS)) continue;
+          a.min = std::min<int32_t>(a.min, v);
+          a.max = std::max<int32_t>(a.max, v);
+          a.sum += v;
+          a.n++;
+        }
+        return a;
+      };
+      auto emit = [&](std::string &out, const char *name, const Agg &a, bool centi) {
+        out += ",\"";
+        out += name;
+        out += "\":{\"n\":" + std::to_string(a.n);
+        if(a.n) {
+          int32_t avg = (int32_t)(a.sum / a.n);
+          out += ",\"min\":";
+          centi ? appendCenti(out, a.min) : (void)(out += std::to_string(a.min));
+          out += ",\"max\":";
+          centi ? appendCenti(out, a.max) : (void)(out += std::to_string(a.max));
+          out += ",\"avg\":";
+          centi ? appendCenti(out, avg) : (void)(out += std::to_string(avg));
+        }
+        out += "}";
+      };
+      uint32_t live = 0;
+      for(size_t r = 0; r < count; r++) live += online(r, now, onlineS);
+      std::string out = "{\"nodes\":" + std::to_string(count) + ",\"matching\":" + std::to_string(live) +
+                        ",\"messages\":" + std::to_string(messagesIn.load()) +
+                        ",\"bad\":" + std::to_string(badMessages.load()) +
+                        ",\"commands\":" + std::to_string(commandsOut.load()) +
+                        ",\"broker\":" + (brokerReady_ ? "true" : "false");
+      emit(out, "temperature", column(nodes_.temp), true);
+      emit(out, "humidity", column(nodes_.hum), true);
+      emit(out, "light", column(nodes_.light), false);
+      out += "}";
+      return reply(200, "application/json", out);
+    }
+
+    auto appendRow = [&](std::string &out, uint32_t r) {
+      out += "[\"" + nodes_.name[r] + "\",";
+      appendCenti(out, nodes_.temp[r]);
+      out += ",";
+      appendCenti(out, nodes_.hum[r]);
+      out += ",";
+      out += nodes_.light[r] == NO_VALUE ? "null" : std::to_string(nodes_.light[r]);
+      out += "," + std::to_string((now - nodes_.lastSeenMs[r]) / 1000) + "]";
+    };
+
+    if(path == "/node") {
+      auto it = nodes_.index.find(queryArg(query, "id"));
+      if(it == nodes_.index.end()) return reply(404, "text/plain", "Unknown node\n");
+      std::string out;
+      appendRow(out, it->second);
+      return reply(200, "application/json", out);
+    }
+
+    if(path == "/nodes") {
+      std::string out;
+      out.reserve(48 * count + 16);
+      out += "{\"nodes\":[";
+      bool first = true;
+      for(size_t r = 0; r < count; r++) {
+        if(!online(r, now, onlineS)) continue;
+        if(!first) out += ",";
+        first = false;
+        appendRow(out, r);
+      }
+      out += "]}";
+      return reply(200, "application/json", out);
+    }
+
+    if(path == "/command") {
+      std::string feed = queryArg(query, "feed"), value = queryArg(query, "value");
+      if(feed.empty() || feed.find_first_of("/+#") != std::string::npos) {
+        return reply(400, "text/plain", "Invalid feed\n");
+      }
+      if(!brokerReady_) return reply(400, "text/plain", "Broker not connected\n");
+      std::string list = queryArg(query, "nodes");
+      std::string above = queryArg(query, "tempAbove");
+      int32_t tempAbove = INT32_MIN;
+      if(!above.empty() && !parseCenti(above, tempAbove)) return reply(400, "text/plain", "Invalid tempAbove\n");
+
+      // All publishes are built into the broker buffer and leave in as few
+      // send() calls as the socket allows
+      uint32_t sent = 0;
+      std::string topic;
+      auto publishTo = [&](uint32_t r) {
+        if(!online(r, now, onlineS)) return;
+        if(tempAbove != INT32_MIN && (nodes_.temp[r] == NO_VALUE || nodes_.temp[r] <= tempAbove)) return;
+        topic.assign(nodes_.name[r]).append("/feeds/").append(feed);
+        mqtt::appendPublish(brokerTx_, topic, value);
+        sent++;
+      };
+      if(list.empty()) {
+        for(size_t r = 0; r < count; r++) publishTo(r);
+      } else {
+        size_t pos = 0;
+        while(pos <= list.size()) {
+          size_t comma = list.find(',', pos);
+          if(comma == std::string::npos) comma = list.size();
+          auto it = nodes_.index.find(list.substr(pos, comma - pos));
+          if(it != nodes_.index.end()) publishTo(it->second);
+          pos = comma + 1;
+        }
+      }
+      commandsOut += sent;
+      flushBroker();
+      return reply(200, "application/json", "{\"sent\":" + std::to_string(sent) + "}");
+    }
+
+    if(path == "/history") {
+      if(!store_) return reply(404, "text/plain", "No store\n");
+      std::string name = queryArg(query, "id") + "/" + queryArg(query, "feed");
+      tsdb::Series *series = store_->series(name, false);
+      if(!series) return reply(404, "text/plain", "Unknown series\n");
+      std::string toArg = queryArg(query, "to"), fromArg = queryArg(query, "from");
+      int64_t to = toArg.empty() ? wallMs() : strtoll(toArg.c_str(), nullptr, 10);
+      int64_t from = fromArg.empty() ? to - 86400000LL : strtoll(fromArg.c_str(), nullptr, 10);
+      int64_t step = strtoll(queryArg(query, "step").c_str(), nullptr, 10);
+      if(step <= 0) step = to - from;
+      if(to <= from || (size_t)((to - from + step - 1) / step) > MAX_HISTORY_BUCKETS) {
+        return reply(400, "text/plain", "Invalid range\n");
+      }
+      series->rollup(from, to, step, history_);
+      std::string out = "{\"series\":\"" + name + "\",\"step\":" + std::to_string(step) + ",\"buckets\":[";
+      for(size_t i = 0; i < history_.size(); i++) {
+        const tsdb::Summary &b = history_[i];
+        if(i) out += ",";
+        out += "[" + std::to_string(from + (int64_t)i * step) + "," + std::to_string(b.count) + ",";
+        if(b.count) {
+          appendCenti(out, b.min);
+          out += ",";
+          appendCenti(out, b.max);
+          out += ",";
+          appendCenti(out, (int32_t)(b.sum / (int64_t)b.count));
+        } else out += "null,null,null";
+        out += "]";
+      }
+      out += "]}";
+      return reply(200, "application/json", out);
+    }
+
+    return reply(404, "text/plain", "Not found\n");
+  }
+
+  std::string brokerHost_;
+  uint16_t brokerPort_ = 1883;
+  std::string filter_;
+  int epollFd_ = -1;
+  int httpFd_ = -1;
+  uint16_t httpPort_ = 0;
+  int brokerFd_ = -1;
+  bool brokerReady_ = false;
+  bool brokerWantWrite_ = false;
+  uint32_t lastConnectMs_ = 0;
+  std::string brokerRx_, brokerTx_;
+  std::unordered_map<int, HttpConn> http_;
+  NodeTable nodes_;
+  std::string key_;
+  tsdb::Store *store_ = nullptr;
+  std::string seriesKey_;
+  std::vector<tsdb::Summary> history_;
+};
@@ -0,0 +1,247 @@
+// Benchmark for the fleet gateway (gateway.h) with thousands of simulated
+// nodes. Runs the host broker (mqtt_broker.h) and the gateway in-process on
+// their own threads, then:
+//   ingest   every node publishes temperature/humidity/lightPercent for
+//            --rounds rounds; messages/s until the gateway has them all
+//   latency  single telemetry messages, publish → in the gateway table
+//   queries  /stats, /stats?online=60 and /nodes over loopback HTTP
+//   fanout   one /command to every node; time until all nodes have it
+// Simulated nodes share --connections broker connections (a node is a
+// topic prefix, not a socket), which keeps fd use low.
+//
+// Build from the repo root:
+//   g++ -std=c++17 -O2 -Ihost host/gatewaybench.cpp -o gatewaybench -lpthread
+//   ./gatewaybench --nodes 5000 --connections 64 --rounds 5
+
+#include "gateway.h"
+#include "mqtt_broker.h"
+
+#include <algorithm>
+#include <thread>
+
+static uint64_t nowUs() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static int connectTo(uint16_t port) {
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = htons(port);
+  if(connect(fd, (sockaddr *)&addr, sizeof(addr)) < 0) {
+    close(fd);
+    return -1;
+  }
+  int one = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  return fd;
+}
+
+static bool sendAll(int fd, const std::string &data) {
+  size_t sent = 0;
+  while(sent < data.size()) {
+    ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+    if(n <= 0) return false;
+    sent += n;
+  }
+  return true;
+}
+
+static std::string httpGet(uint16_t port, const std::string &path) {
+  int fd = connectTo(port);
+  if(fd < 0) return std::string();
+  sendAll(fd, "GET " + path + " HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n");
+  std::string out;
+  char buf[65536];
+  ssize_t n;
+  while((n = recv(fd, buf, sizeof(buf), 0)) > 0) out.append(buf, n);
+  close(fd);
+  return out;
+}
+
+// Counts what the simulated nodes receive: SUBACKs and command publishes
+static std::atomic<uint64_t> subAcks{0};
+static std::atomic<uint64_t> commandsIn{0};
+
+static void nodeReader(std::vector<int> fds, const std::atomic<bool> *stop) {
+  int ep = epoll_create1(0);
+  std::vector<std::string> rx(fds.size());
+  for(size_t i = 0; i < fds.size(); i++) {
+    fcntl(fds[i], F_SETFL, fcntl(fds[i], F_GETFL) | O_NONBLOCK);
+    epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.u32 = i;
+    epoll_ctl(ep, EPOLL_CTL_ADD, fds[i], &ev);
+  }
+  epoll_event events[64];
+  char buf[65536];
+  while(!*stop) {
+    int n = epoll_wait(ep, events, 64, 50);
+    for(int e = 0; e < n; e++) {
+      uint32_t i = events[e].data.u32;
+      ssize_t got;
+      while((got = recv(fds[i], buf, sizeof(buf), 0)) > 0) rx[i].append(buf, got);
+      size_t used = 0;
+      uint8_t header;
+      std::string_view body;
+      long len;
+      while((len = mqtt::parsePacket(std::string_view(rx[i]).substr(used), header, body)) > 0) {
+        used += len;
+        if((header >> 4) == mqtt::SUBACK) subAcks++;
+        else if((header >> 4) == mqtt::PUBLISH) commandsIn++;
+      }
+      rx[i].erase(0, used);
+    }
+  }
+  close(ep);
+}
+
+static bool waitFor(const std::atomic<uint64_t> &counter, uint64_t target, double timeoutS) {
+  uint64_t deadline = nowUs() + (uint64_t)(timeoutS * 1e6);
+  while(counter.load() < target) {
+    if(nowUs() > deadline) return false;
+    std::this_thread::yield();
+  }
+  return true;
+}
+
+static uint64_t percentile(std::vector<uint64_t> &v, double p) {
+  if(v.empty()) return 0;
+  std::sort(v.begin(), v.end());
+  return v[std::min(v.size() - 1, (size_t)(p * v.size()))];
+}
+
+int main(int argc, char **argv) {
+  uint32_t nodes = 5000, connections = 64, rounds = 5, queries = 200, probes = 1000;
+  for(int i = 1; i < argc; i++) {
+    std::string a = argv[i];
+    uint32_t v = i + 1 < argc ? strtoul(argv[i + 1], nullptr, 10) : 0;
+    if(a == "--nodes") nodes = v;
+    else if(a == "--connections") connections = v;
+    else if(a == "--rounds") rounds = v;
+    else if(a == "--queries") queries = v;
+    else if(a == "--probes") probes = v;
+    else {
+      fprintf(stderr, "usage: %s [--nodes N] [--connections C] [--rounds R] [--queries Q] [--probes P]\n", argv[0]);
+      return 2;
+    }
+    i++;
+  }
+  connections = std::max<uint32_t>(1, std::min(connections, nodes));
+
+  std::atomic<bool> stop{false};
+  MqttBroker broker;
+  if(!broker.begin(0)) {
+    perror("broker");
+    return 1;
+  }
+  std::thread brokerThread([&] { broker.run(stop); });
+
+  FleetGateway gateway;
+  if(!gateway.begin("127.0.0.1", broker.port(), 0)) {
+    perror("gateway");
+    return 1;
+  }
+  std::thread gatewayThread([&] { gateway.run(stop); });
+  while(!gateway.brokerConnected()) std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+  // Simulated nodes: node i lives on connection i % connections and listens
+  // for commands on its own mode feed
+  std::vector<int> fds(connections);
+  for(uint32_t c = 0; c < connections; c++) {
+    fds[c] = connectTo(broker.port());
+    if(fds[c] < 0) {
+      perror("connect");
+      return 1;
+    }
+    std::string out;
+    mqtt::appendConnect(out, "sim-" + std::to_string(c), 600);
+    for(uint32_t n = c; n < nodes; n += connections) {
+      mqtt::appendSubscribe(out, (n & 0xFFFF) | 1, "node" + std::to_string(n) + "/feeds/mode");
+    }
+    sendAll(fds[c], out);
+  }
+  std::thread reader(nodeReader, fds, &stop);
+  if(!waitFor(subAcks, nodes, 30)) fprintf(stderr, "warning: only %llu/%u SUBACKs\n",
+                                           (unsigned long long)subAcks.load(), nodes);
+
+  // ---- ingest
+  uint64_t base = gateway.messagesIn;
+  uint64_t total = (uint64_t)nodes * 3 * rounds;
+  uint64_t t0 = nowUs();
+  std::vector<std::thread> writers;
+  for(uint32_t c = 0; c < connections; c++) {
+    writers.emplace_back([&, c] {
+      std::string out;
+      char value[16];
+      for(uint32_t r = 0; r < rounds; r++) {
+        out.clear();
+        for(uint32_t n = c; n < nodes; n += connections) {
+          std::string prefix = "node" + std::to_string(n) + "/feeds/";
+          snprintf(value, sizeof(value), "%d.%d", 18 + (n + r) % 15, (n * 7 + r) % 10);
+          mqtt::appendPublish(out, prefix + "temperature", value);
+          snprintf(value, sizeof(value), "%d.%d", 40 + (n + r) % 40, (n * 3 + r) % 10);
+          mqtt::appendPublish(out, prefix + "humidity", value);
+          snprintf(value, sizeof(value), "%d", (n * 13 + r * 7) % 101);
+          mqtt::appendPublish(out, prefix + "lightPercent", value);
+        }
+        sendAll(fds[c], out);
+      }
+    });
+  }
+  for(auto &w : writers) w.join();
+  bool complete = waitFor(gateway.messagesIn, base + total, 60);
+  double ingestS = (nowUs() - t0) / 1e6;
+
+  // ---- latency: one message at a time, publish → counted by the gateway
+  std::vector<uint64_t> lat;
+  for(uint32_t p = 0; p < probes; p++) {
+    std::string out;
+    mqtt::appendPublish(out, "node" + std::to_string(p % nodes) + "/feeds/temperature", "25.5");
+    uint64_t before = gateway.messagesIn, s = nowUs();
+    sendAll(fds[p % connections], out);
+    if(!waitFor(gateway.messagesIn, before + 1, 5)) break;
+    lat.push_back(nowUs() - s);
+  }
+
+  // ---- queries
+  printf("{\"nodes\":%u,\"connections\":%u,\"ingest\":{\"messages\":%llu,\"complete\":%s,\"seconds\":%.3f,"
+         "\"msgs_per_s\":%.0f},\"latency_us\":{\"p50\":%llu,\"p99\":%llu},\"queries\":[",
+         nodes, connections, (unsigned long long)total, complete ? "true" : "false", ingestS,
+         total / ingestS, (unsigned long long)percentile(lat, 0.5), (unsigned long long)percentile(lat, 0.99));
+  const char *paths[] = { "/stats", "/stats?online=60", "/nodes" };
+  for(int q = 0; q < 3; q++) {
+    std::vector<uint64_t> us;
+    size_t bytes = 0;
+    for(uint32_t i = 0; i < queries; i++) {
+      uint64_t s = nowUs();
+      bytes = httpGet(gateway.httpPort(), paths[q]).size();
+      us.push_back(nowUs() - s);
+    }
+    printf("%s{\"path\":\"%s\",\"p50_us\":%llu,\"p99_us\":%llu,\"bytes\":%zu}", q ? "," : "", paths[q],
+           (unsigned long long)percentile(us, 0.5), (unsigned long long)percentile(us, 0.99), bytes);
+  }
+
+  // ---- fan-out
+  uint64_t before = commandsIn;
+  uint64_t s = nowUs();
+  std::string reply = httpGet(gateway.httpPort(), "/command?feed=mode&value=manual");
+  uint64_t acceptedUs = nowUs() - s;
+  bool delivered = waitFor(commandsIn, before + nodes, 30);
+  double fanoutMs = (nowUs() - s) / 1e3;
+  printf("],\"fanout\":{\"commands\":%u,\"delivered\":%s,\"request_us\":%llu,\"all_delivered_ms\":%.2f},"
+         "\"gateway\":{\"bad\":%llu,\"node_rows\":%u},\"broker\":{\"in\":%llu,\"out\":%llu,\"dropped\":%llu}}\n",
+         nodes, delivered ? "true" : "false", (unsigned long long)acceptedUs, fanoutMs,
+         (unsigned long long)gateway.badMessages.load(), gateway.nodeCount.load(),
+         (unsigned long long)broker.messagesIn.load(), (unsigned long long)broker.messagesOut.load(),
+         (unsigned long long)broker.messagesDropped.load());
+
+  stop = true;
+  reader.join();
+  gatewayThread.join();
+  brokerThread.join();
+  for(int fd : fds) close(fd);
+  return 0;
+}
@@ -0,0 +1,38 @@
+// Counts heap use of threads that set host::trackHeap, for heap high-water
+// figures. Include from exactly one translation unit of a host tool.
+#pragma once
+
+#include "Arduino.h"
+
+#include <malloc.h>
+#include <new>
+
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+
+namespace host {
+  inline thread_local bool trackHeap = false;
+  inline std::atomic<uint64_t> heapAllocs{0};   // allocations by tracked threads
+}
+
+void *operator new(size_t size) {
+  void *p = malloc(size ? size : 1);
+  if(!p) throw std::bad_alloc();
+  if(host::trackHeap) {
+    host::heapAllocs++;
+    long now = host::heapInUse += malloc_usable_size(p);
+    long peak = host::heapPeak.load();
+    while(now > peak && !host::heapPeak.compare_exchange_weak(peak, now)) {}
+  }
+  return p;
+}
+
+void operator delete(void *p) noexcept {
+  if(!p) return;
+  if(host::trackHeap) host::heapInUse -= malloc_usable_size(p);
+  free(p);
+}
+
+void operator delete(void *p, size_t) noexcept { operator delete(p); }
+void *operator new[](size_t size) { return operator new(size); }
+void operator delete[](void *p) noexcept { operator delete(p); }
+void operator delete[](void *p, size_t) noexcept { operator delete(p); }
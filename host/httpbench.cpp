@@ -0,0 +1,420 @@
+// HTTP endpoint benchmark for the sketches' web handlers.
+//
+// Runs a sketch's setup()/loop() on the host (see host/Arduino.h) with its
+// web server on loopback, then drives it with concurrent clients using a
+// weighted request mix. Prints one JSON object per run on stdout:
+// throughput, p50/p99/p99.9 latency, bytes and heap high-water per endpoint.
+// handler_avg_us is the handler's run time under ESP8266WebServer; for the
+// sketches with their own server it runs from the first request byte read
+// to the last response byte written, so it includes parsing and routing.
+//
+// By default every request goes out on a fresh connection with
+// "Connection: close", as the dashboards' requests did when the server closed
+// after each response. --keepalive keeps one connection per client open and
+// reconnects only when the server closes it; --pipeline N (implies
+// --keepalive) sends N requests before reading their responses, and each
+// response's latency is measured from the send of its batch.
+//
+// Build one binary per sketch from the repo root:
+//   g++ -std=c++17 -O2 -Ihost -DSKETCH='"../esp1.cpp"' host/httpbench.cpp -o httpbench-esp1 -lpthread
+//
+// Run:
+//   HOST_QUIET=1 ./httpbench-esp1 --mix esp1 --concurrency 4 --seconds 10
+//   HOST_QUIET=1 ./httpbench-esp1 --mix esp1 --keepalive
+//   ./httpbench-esp1 --target 192.168.1.50:80 --mix esp1     (real board; no heap figures)
+//   --mix also takes "path=weight,path=weight", e.g. "/data=9,/control?pump=ON=1"
+
+#include "heap_track.h"
+#include "ESP8266WebServer.h"
+
+#include <map>
+#include <mutex>
+#include <netdb.h>
+#include <random>
+#include <vector>
+
+#include SKETCH
+
+// Request mixes modelled on the current dashboards: a status poll every
+// 2-3 s per open page plus occasional button presses and page loads
+static const char *presetMix(const std::string &name) {
+  if(name == "esp1") return "/data=90,/control?mode=manual=2,/control?pump=ON=3,/control?pump=OFF=3,/=1,/history?res=raw=1";
+  if(name == "esp3") return "/getSensorData=90,/setMode?mode=manual=2,/setPump?state=ON=3,/setLight?state=OFF=3,/=2";
+  if(name == "esp2") return "/speed?value=60=50,/forward=10,/left=10,/right=10,/stop=10,/backward=8,/=2";
+  return nullptr;
+}
+
+struct MixEntry {
+  std::string path;
+  int weight;
+};
+
+struct EndpointStats {
+  std::vector<uint32_t> latencyUs;
+  uint64_t bytes = 0;
+  uint64_t errors = 0;
+};
+
+struct ServerStats {
+  long heapPeak = 0;
+  uint64_t handlerUs = 0;
+  uint64_t count = 0;
+};
+
+static std::vector<MixEntry> mix;
+static std::string targetHost = "127.0.0.1";
+static int targetPort = 8080;
+static bool keepAlive = false;
+static int pipelineDepth = 1;
+static std::atomic<bool> stopClients{false};
+static std::atomic<bool> stopSketch{false};
+static std::mutex serverStatsLock;
+static std::map<std::string, ServerStats> serverStats;
+
+static std::vector<MixEntry> parseMix(const std::string &spec) {
+  std::vector<MixEntry> out;
+  size_t pos = 0;
+  while(pos < spec.size()) {
+    size_t comma = spec.find(',', pos);
+    if(comma == std::string::npos) comma = spec.size();
+    std::string item = spec.substr(pos, comma - pos);
+    size_t eq = item.rfind('=');
+    if(eq != std::string::npos) out.push_back({ item.substr(0, eq), atoi(item.c_str() + eq + 1) });
+    pos = comma + 1;
+  }
+  return out;
+}
+
+static std::string pathOnly(const std::string &p) { return p.substr(0, p.find('?')); }
+
+static void noteServerStats(const std::string &path, uint64_t us, long heap) {
+  std::lock_guard<std::mutex> g(serverStatsLock);
+  ServerStats &s = serverStats[path];
+  s.heapPeak = std::max(s.heapPeak, heap);
+  s.handlerUs += us;
+  s.count++;
+}
+
+static int openConnection(const sockaddr_in &addr) {
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  if(fd < 0) return -1;
+  int one = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  if(connect(fd, (const sockaddr *)&addr, sizeof(addr)) < 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+// One request on a fresh connection, the way the dashboards' fetch() calls
+// reached the board while it closed after every response. Returns the HTTP
+// status or -1 on failure.
+static int doRequest(const sockaddr_in &addr, const std::string &path, uint64_t &bytes) {
+  int fd = openConnection(addr);
+  if(fd < 0) return -1;
+  std::string req = "GET " + path + " HTTP/1.1\r\nHost: " + targetHost + "\r\nConnection: close\r\n\r\n";
+  if(send(fd, req.data(), req.size(), MSG_NOSIGNAL) != (ssize_t)req.size()) {
+    close(fd);
+    return -1;
+  }
+
+  char buf[4096];
+  std::string head;
+  ssize_t n;
+  bytes = 0;
+  while((n = recv(fd, buf, sizeof(buf), 0)) > 0) {
+    if(head.size() < 16) head.append(buf, std::min<size_t>(n, 16));
+    bytes += n;
+  }
+  close(fd);
+  if(head.compare(0, 5, "HTTP/") != 0) return -1;
+  return atoi(head.c_str() + 9);
+}
+
+// A kept-alive connection: responses are framed by Content-Length or
+// chunked encoding, and the connection is reopened when the server closes it
+struct KeptConnection {
+  const sockaddr_in &addr;
+  int fd = -1;
+  std::string in;           // received, not yet consumed
+  uint64_t connects = 0;
+
+  explicit KeptConnection(const sockaddr_in &a) : addr(a) {}
+  ~KeptConnection() { drop(); }
+
+  void drop() {
+    if(fd >= 0) close(fd);
+    fd = -1;
+    in.clear();
+  }
+
+  bool sendAll(const std::string &data) {
+    if(fd < 0) {
+      fd = openConnection(addr);
+      if(fd < 0) return false;
+      connects++;
+    }
+    return send(fd, data.data(), data.size(), MSG_NOSIGNAL) == (ssize_t)data.size();
+  }
+
+  // Until `in` holds at least n bytes; false if the connection ends first
+  bool fill(size_t n) {
+    char buf[4096];
+    while(in.size() < n) {
+      ssize_t got = recv(fd, buf, sizeof(buf), 0);
+      if(got <= 0) return false;
+      in.append(buf, got);
+    }
+    return true;
+  }
+
+  // Up to and including the next CRLF
+  bool line(std::string &out) {
+    size_t eol;
+    while((eol = in.find("\r\n")) == std::string::npos) {
+      if(!fill(in.size() + 1)) return false;
+    }
+    out = in.substr(0, eol);
+    in.erase(0, eol + 2);
+    return true;
+  }
+
+  // Reads one response; returns its status, or -1 if the connection broke.
+  // `closing` tells whether the server closes after it.
+  int response(uint64_t &bytes, bool &closing) {
+    std::string l;
+    if(!line(l) || l.compare(0, 5, "HTTP/") != 0) return -1;
+    int status = atoi(l.c_str() + 9);
+    bytes = l.size() + 2;
+    long length = -1;
+    bool chunked = false;
+    closing = false;
+    while(line(l) && !l.empty()) {
+      bytes += l.size() + 2;
+      std::string lower = l;
+      for(auto &ch : lower) ch = tolower(ch);
+      if(lower.compare(0, 15, "content-length:") == 0) length = atol(l.c_str() + 15);
+      if(lower.compare(0, 18, "transfer-encoding:") == 0 && lower.find("chunked") != std::string::npos) chunked = true;
+      if(lower.compare(0, 11, "connection:") == 0 && lower.find("close") != std::string::npos) closing = true;
+    }
+    bytes += 2;
+    if(chunked) {
+      while(true) {
+        if(!line(l)) return -1;
+        long size = strtol(l.c_str(), nullptr, 16);
+        if(!fill(size + 2)) return -1;
+        bytes += l.size() + 2 + size + 2;
+        in.erase(0, size + 2);
+        if(size == 0) break;
+      }
+    } else if(length >= 0) {
+      if(!fill(length)) return -1;
+      in.erase(0, length);
+      bytes += length;
+    } else {
+      // Body runs to the close
+      while(fill(in.size() + 1)) {}
+      bytes += in.size();
+      in.clear();
+      closing = true;
+    }
+    return status;
+  }
+};
+
+static std::atomic<uint64_t> connections{0};
+
+static void clientThread(int id, std::vector<EndpointStats> *stats, uint64_t maxRequests,
+                         std::atomic<uint64_t> *issued) {
+  std::mt19937 rng(1234 + id);
+  int total = 0;
+  for(auto &m : mix) total += m.weight;
+  std::uniform_int_distribution<int> pick(0, total - 1);
+
+  sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(targetPort);
+  addrinfo *ai = nullptr;
+  if(getaddrinfo(targetHost.c_str(), nullptr, nullptr, &ai) == 0 && ai) {
+    addr.sin_addr = ((sockaddr_in *)ai->ai_addr)->sin_addr;
+    freeaddrinfo(ai);
+  }
+
+  auto next = [&]() {
+    int r = pick(rng);
+    size_t i = 0;
+    while(r >= mix[i].weight) r -= mix[i++].weight;
+    return i;
+  };
+  auto note = [&](size_t i, int status, uint64_t elapsed, uint64_t bytes) {
+    EndpointStats &s = (*stats)[i];
+    if(status < 200 || status >= 400) s.errors++;
+    else s.latencyUs.push_back(elapsed);
+    s.bytes += bytes;
+  };
+
+  if(!keepAlive) {
+    while(!stopClients && (maxRequests == 0 || (*issued)++ < maxRequests)) {
+      size_t i = next();
+      uint64_t bytes = 0;
+      uint64_t start = host::realMicros();
+      int status = doRequest(addr, mix[i].path, bytes);
+      note(i, status, host::realMicros() - start, bytes);
+    }
+    return;
+  }
+
+  KeptConnection conn(addr);
+  std::vector<size_t> batch;
+  while(!stopClients) {
+    batch.clear();
+    std::string out;
+    while((int)batch.size() < pipelineDepth && (maxRequests == 0 || (*issued)++ < maxRequests)) {
+      size_t i = next();
+      batch.push_back(i);
+      out += "GET " + mix[i].path + " HTTP/1.1\r\nHost: " + targetHost + "\r\n\r\n";
+    }
+    if(batch.empty()) break;
+
+    uint64_t start = host::realMicros();
+    if(!conn.sendAll(out)) {
+      for(size_t i : batch) note(i, -1, 0, 0);
+      conn.drop();
+      continue;
+    }
+    // Responses come back in request order; the ones lost to a close count as errors
+    size_t done = 0;
+    bool closing = false;
+    for(; done < batch.size() && !closing; done++) {
+      uint64_t bytes = 0;
+      int status = conn.response(bytes, closing);
+      note(batch[done], status, host::realMicros() - start, bytes);
+      if(status < 0) closing = true;
+    }
+    for(; done < batch.size(); done++) note(batch[done], -1, 0, 0);
+    if(closing) conn.drop();
+  }
+  connections += conn.connects;
+}
+
+static void sketchThread() {
+  host::trackHeap = true;
+  setup();
+  while(!stopSketch) loop();
+}
+
+static uint32_t percentile(std::vector<uint32_t> &v, double p) {
+  if(v.empty()) return 0;
+  size_t i = std::min(v.size() - 1, (size_t)(p * v.size()));
+  return v[i];
+}
+
+int main(int argc, char **argv) {
+  std::string mixSpec = "esp1";
+  int concurrency = 4;
+  double seconds = 10;
+  uint64_t maxRequests = 0;
+  bool external = false;
+
+  for(int i = 1; i < argc; i++) {
+    std::string a = argv[i];
+    const char *v = i + 1 < argc ? argv[i + 1] : "";
+    if(a == "--mix") { mixSpec = v; i++; }
+    else if(a == "--concurrency") { concurrency = atoi(v); i++; }
+    else if(a == "--seconds") { seconds = atof(v); i++; }
+    else if(a == "--requests") { maxRequests = strtoull(v, nullptr, 10); i++; }
+    else if(a == "--port") { targetPort = atoi(v); i++; }
+    else if(a == "--keepalive") keepAlive = true;
+    else if(a == "--pipeline") { pipelineDepth = std::max(1, atoi(v)); keepAlive = true; i++; }
+    else if(a == "--target") {
+      std::string t = v;
+      size_t colon = t.find(':');
+      targetHost = t.substr(0, colon);
+      targetPort = colon == std::string::npos ? 80 : atoi(t.c_str() + colon + 1);
+      external = true;
+      i++;
+    } else {
+      fprintf(stderr, "usage: %s [--mix esp1|esp2|esp3|spec] [--concurrency N] "
+                      "[--seconds S | --requests N] [--keepalive] [--pipeline N] [--port P] [--target host:port]\n", argv[0]);
+      return 2;
+    }
+  }
+  const char *preset = presetMix(mixSpec);
+  mix = parseMix(preset ? preset : mixSpec);
+  if(mix.empty()) {
+    fprintf(stderr, "empty request mix\n");
+    return 2;
+  }
+
+  std::thread sketch;
+  if(!external) {
+    char port[16];
+    snprintf(port, sizeof(port), "%d", targetPort);
+    setenv("HOST_HTTP_PORT", port, 1);
+    host::onRequestDone = [](const String &uri, int, size_t, uint64_t us, long heap) {
+      noteServerStats(uri.str(), us, heap);
+    };
+    host::onConnectionDone = [](const std::string &requestLine, size_t, uint64_t us, long heap) {
+      size_t sp = requestLine.find(' ');
+      std::string target = sp == std::string::npos ? "" : requestLine.substr(sp + 1, requestLine.rfind(' ') - sp - 1);
+      noteServerStats(pathOnly(target), us, heap);
+    };
+    sketch = std::thread(sketchThread);
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  }
+
+  std::vector<std::vector<EndpointStats>> perThread(concurrency, std::vector<EndpointStats>(mix.size()));
+  std::vector<std::thread> clients;
+  std::atomic<uint64_t> issued{0};
+  uint64_t start = host::realMicros();
+  for(int i = 0; i < concurrency; i++) {
+    clients.emplace_back(clientThread, i, &perThread[i], maxRequests, &issued);
+  }
+  if(maxRequests == 0) {
+    std::this_thread::sleep_for(std::chrono::microseconds((uint64_t)(seconds * 1e6)));
+    stopClients = true;
+  }
+  for(auto &t : clients) t.join();
+  double elapsedS = (host::realMicros() - start) / 1e6;
+
+  stopSketch = true;
+  if(sketch.joinable()) sketch.join();
+
+  printf("{\"target\":\"%s:%d\",\"concurrency\":%d,\"keepalive\":%s,\"pipeline\":%d,\"seconds\":%.3f,"
+         "\"endpoints\":[", targetHost.c_str(), targetPort, concurrency, keepAlive ? "true" : "false",
+         pipelineDepth, elapsedS);
+  uint64_t allOk = 0, allErrors = 0;
+  for(size_t e = 0; e < mix.size(); e++) {
+    EndpointStats merged;
+    for(auto &t : perThread) {
+      merged.latencyUs.insert(merged.latencyUs.end(), t[e].latencyUs.begin(), t[e].latencyUs.end());
+      merged.bytes += t[e].bytes;
+      merged.errors += t[e].errors;
+    }
+    std::sort(merged.latencyUs.begin(), merged.latencyUs.end());
+    uint64_t ok = merged.latencyUs.size();
+    allOk += ok;
+    allErrors += merged.errors;
+
+    ServerStats srv;
+    auto it = serverStats.find(pathOnly(mix[e].path));
+    if(it != serverStats.end()) srv = it->second;
+
+    printf("%s{\"endpoint\":\"%s\",\"requests\":%llu,\"errors\":%llu,\"rps\":%.1f,"
+           "\"p50_us\":%u,\"p99_us\":%u,\"p999_us\":%u,\"bytes\":%llu,\"bytes_per_req\":%llu",
+           e ? "," : "", mix[e].path.c_str(), (unsigned long long)ok, (unsigned long long)merged.errors,
+           ok / elapsedS, percentile(merged.latencyUs, 0.50), percentile(merged.latencyUs, 0.99),
+           percentile(merged.latencyUs, 0.999), (unsigned long long)merged.bytes,
+           (unsigned long long)(ok + merged.errors ? merged.bytes / (ok + merged.errors) : 0));
+    if(!external) {
+      printf(",\"heap_peak_bytes\":%ld,\"handler_avg_us\":%llu", srv.heapPeak,
+             (unsigned long long)(srv.count ? srv.handlerUs / srv.count : 0));
+    }
+    printf("}");
+  }
+  // Without --keepalive every request opened its own connection
+  uint64_t opened = keepAlive ? connections.load() : allOk + allErrors;
+  printf("],\"total_rps\":%.1f,\"connections\":%llu}\n", allOk / elapsedS, (unsigned long long)opened);
+  return 0;
+}
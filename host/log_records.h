@@ -0,0 +1,114 @@
+// The sketches' binary log records (see "Logging" in a sketch), for the host
+// tools that read them: the LOG_FORMATS table parser, the frame check and the
+// payload decoder. Used by logdecode.cpp and replay.cpp.
+#pragma once
+
+#include <stdint.h>
+
+#include <fstream>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+static const uint8_t LOG_RECORD_SYNC = 0xA5;
+static const int64_t LOG_RECORD_NAN = -32768;   // %C value of a failed reading
+
+struct LogFormat {
+  std::string id;
+  std::string level;
+  std::string text;
+};
+
+// One decoded argument: a string for %s, otherwise an integer
+struct LogArg {
+  bool isString;
+  int64_t value;
+  std::string text;
+};
+
+// Collects the X(id, level, "text") rows of the LOG_FORMATS macro in a sketch
+inline bool loadLogFormats(const char *path, std::vector<LogFormat> &formats) {
+  std::ifstream in(path);
+  if(!in) return false;
+  std::stringstream ss;
+  ss << in.rdbuf();
+  std::string src = ss.str();
+
+  size_t start = src.find("#define LOG_FORMATS(X)");
+  if(start == std::string::npos) return false;
+  size_t end = start;
+  // The macro runs until the first line that does not end in a backslash
+  while(end < src.size()) {
+    size_t eol = src.find('\n', end);
+    if(eol == std::string::npos) eol = src.size();
+    bool more = eol > 0 && src[eol - 1] == '\\';
+    end = eol + 1;
+    if(!more) break;
+  }
+  std::string table = src.substr(start, end - start);
+
+  std::regex row("X\\(\\s*(\\w+)\\s*,\\s*(\\w+)\\s*,\\s*\"((?:[^\"\\\\]|\\\\.)*)\"\\s*\\)");
+  for(std::sregex_iterator it(table.begin(), table.end(), row), last; it != last; ++it) {
+    std::string text;
+    std::string raw = (*it)[3];
+    for(size_t i = 0; i < raw.size(); i++) {
+      if(raw[i] == '\\' && i + 1 < raw.size()) i++;
+      text += raw[i];
+    }
+    formats.push_back({ (*it)[1], (*it)[2], text });
+  }
+  return !formats.empty();
+}
+
+inline bool readLogVarint(const uint8_t *&p, const uint8_t *end, int64_t &out) {
+  uint64_t v = 0;
+  for(int shift = 0; p < end && shift < 64; shift += 7) {
+    uint8_t b = *p++;
+    v |= (uint64_t)(b & 0x7F) << shift;
+    if(!(b & 0x80)) {
+      out = (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+      return true;
+    }
+  }
+  return false;
+}
+
+enum LogFrame { LOG_FRAME_OK, LOG_FRAME_SHORT, LOG_FRAME_BAD };
+
+// Checks the frame starting at p[0] == LOG_RECORD_SYNC: sync, id, length,
+// payload, 8-bit sum. SHORT means it runs past the n bytes available.
+inline LogFrame checkLogFrame(const uint8_t *p, size_t n) {
+  if(n < 3 || n < (size_t)p[2] + 4) return LOG_FRAME_SHORT;
+  uint8_t len = p[2];
+  uint8_t sum = p[1] + len;
+  for(uint8_t k = 0; k < len; k++) sum += p[3 + k];
+  return sum == p[3 + len] ? LOG_FRAME_OK : LOG_FRAME_BAD;
+}
+
+// Splits a payload into its millis() stamp and the arguments of the
+// format's conversions; false if they disagree
+inline bool decodeLogPayload(const LogFormat &f, const uint8_t *p, const uint8_t *end, int64_t &ms,
+                             std::vector<LogArg> &args) {
+  args.clear();
+  if(!readLogVarint(p, end, ms)) return false;
+  const std::string &t = f.text;
+  for(size_t i = 0; i < t.size(); i++) {
+    if(t[i] != '%') continue;
+    while(i + 1 < t.size() && t[i + 1] == 'l') i++;   // %lu and friends
+    if(++i >= t.size()) return false;
+    char conv = t[i];
+    if(conv == '%') continue;
+    if(conv == 's') {
+      if(p >= end || end - p - 1 < *p) return false;
+      uint8_t n = *p++;
+      args.push_back({ true, 0, std::string((const char *)p, n) });
+      p += n;
+    } else {
+      int64_t v;
+      if(!readLogVarint(p, end, v)) return false;
+      args.push_back({ false, v, std::string() });
+    }
+  }
+  return p == end;
+}
@@ -0,0 +1,92 @@
+// Serial logging cost benchmark for the sketches.
+//
+// Runs a sketch on the host with the UART model from host/Arduino.h at
+// 115200 baud and measures what the sensor task and the actuator switches
+// cost the loop, for two load shapes:
+//   cycle  one sensor cycle per SAMPLE_MIN_MS plus a pump and an LED
+//          switch, the loop idling in between
+//   burst  the same work on every loop pass with 1 ms idle in between, as
+//          while control requests keep arriving
+// Prints one JSON object per shape on stdout: time blocked waiting for the
+// UART (virtual clock, so only the UART advances it) and CPU time per pass
+// with the UART model off. The CPU figure includes the non-logging work of
+// readSensors(); compare builds of the same sketch for the logging part.
+//
+// Build from the repo root, e.g. against the current and an older sketch:
+//   g++ -std=c++17 -O2 -Ihost -DSKETCH='"../esp1.cpp"' host/logbench.cpp -o logbench-esp1 -lpthread
+//   git show HEAD~1:esp1.cpp > /tmp/esp1-old.cpp
+//   g++ -std=c++17 -O2 -Ihost -DSKETCH='"/tmp/esp1-old.cpp"' host/logbench.cpp -o logbench-esp1-old -lpthread
+//
+// Run:
+//   ./logbench-esp1 [--cycles 2000]
+
+#include <string>
+
+#include SKETCH
+
+static bool toggle = false;
+
+// One pass of the work under test: a sensor cycle and two switches
+static void work() {
+  readSensors();
+  toggle = !toggle;
+  setPump(toggle);
+  setLight(!toggle);
+}
+
+static void runShape(const char *shape, int cycles, uint32_t idlePerPassMs) {
+  uint64_t blockedUs = 0, blockedMaxUs = 0;
+
+  // UART-blocked time: the virtual clock only moves while a write waits
+  host::virtualClock = true;
+  host::quiet = true;
+  Serial.uartBaud = 115200;
+  for(int i = 0; i < cycles; i++) {
+    uint64_t start = host::virtualMicros;
+    work();
+    uint64_t us = host::virtualMicros - start;
+    blockedUs += us;
+    blockedMaxUs = max(blockedMaxUs, us);
+    for(uint32_t idle = 0; idle < idlePerPassMs; idle += min<uint32_t>(SCHED_MAX_IDLE_MS, idlePerPassMs - idle)) {
+      schedulerIdle(min<uint32_t>(SCHED_MAX_IDLE_MS, idlePerPassMs - idle));
+    }
+  }
+#ifdef LOG_SYNC
+  uint32_t dropped = logDroppedTotal;
+#else
+  uint32_t dropped = 0;
+#endif
+
+  // CPU time: real clock, UART model off, output discarded
+  host::virtualClock = false;
+  Serial.uartBaud = 0;
+  uint64_t cpuStart = host::realMicros();
+  for(int i = 0; i < cycles; i++) {
+    work();
+    schedulerIdle(0);
+  }
+  uint64_t cpuUs = host::realMicros() - cpuStart;
+
+  printf("{\"shape\":\"%s\",\"cycles\":%d,\"uart_blocked_us_per_pass\":%.1f,\"uart_blocked_max_us\":%llu,"
+         "\"cpu_us_per_pass\":%.2f,\"log_dropped\":%u}\n",
+         shape, cycles, (double)blockedUs / cycles, (unsigned long long)blockedMaxUs,
+         (double)cpuUs / cycles, dropped);
+}
+
+int main(int argc, char **argv) {
+  int cycles = 2000;
+  for(int i = 1; i + 1 < argc; i++) {
+    if(std::string(argv[i]) == "--cycles") cycles = atoi(argv[++i]);
+  }
+  setenv("HOST_HTTP_PORT", "0", 0);
+  host::quiet = true;
+  host::virtualClock = true;
+  setup();
+
+  runShape("cycle", cycles, SAMPLE_MIN_MS);
+#ifdef LOG_SYNC
+  logDroppedTotal = 0;
+#endif
+  runShape("burst", cycles, 1);
+  return 0;
+}
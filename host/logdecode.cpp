@@ -0,0 +1,151 @@
+// Decoder for the sketches' binary log records (see "Logging" in a sketch).
+//
+// Reads the LOG_FORMATS table from the sketch source, then turns a Serial
+// capture back into text, one line per record with its millis() timestamp.
+// Bytes outside records, such as the boot banner printed with
+// Serial.println(), pass through unchanged. Counts of decoded, corrupt and
+// unknown records go to stderr at the end.
+//
+// Build from the repo root:
+//   g++ -std=c++17 -O2 host/logdecode.cpp -o logdecode
+//
+// Run:
+//   ./logdecode esp1.cpp capture.bin
+//   stty -F /dev/ttyUSB0 115200 raw && ./logdecode esp1.cpp < /dev/ttyUSB0
+//   HOST_HTTP_PORT=8080 ./esp1-host | ./logdecode esp1.cpp     (sketch built for the host)
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "log_records.h"
+
+static std::vector<LogFormat> formats;
+static unsigned long decoded = 0, corrupt = 0, unknown = 0;
+static bool atLineStart = true;
+
+// Same rounding as the sketches' formatCenti(): one decimal
+static std::string formatCenti(int64_t centi) {
+  if(centi == LOG_RECORD_NAN) return "nan";
+  int64_t deci = centi >= 0 ? (centi + 5) / 10 : (centi - 5) / 10;
+  char buf[32];
+  snprintf(buf, sizeof(buf), "%s%lld.%lld", deci < 0 ? "-" : "", (long long)(llabs(deci) / 10),
+           (long long)(llabs(deci) % 10));
+  return buf;
+}
+
+// Expands one record's payload through its format; false if they disagree
+static bool formatRecord(const LogFormat &f, const uint8_t *p, const uint8_t *end, std::string &out) {
+  int64_t ms;
+  std::vector<LogArg> args;
+  if(!decodeLogPayload(f, p, end, ms, args)) return false;
+  char stamp[32];
+  snprintf(stamp, sizeof(stamp), "[%6lld.%03lld] ", (long long)(ms / 1000), (long long)(ms % 1000));
+  out = stamp;
+
+  const std::string &t = f.text;
+  size_t arg = 0;
+  for(size_t i = 0; i < t.size(); i++) {
+    if(t[i] != '%') {
+      out += t[i];
+      continue;
+    }
+    while(i + 1 < t.size() && t[i + 1] == 'l') i++;
+    char conv = t[++i];
+    if(conv == '%') out += '%';
+    else if(conv == 's') out += args[arg++].text;
+    else if(conv == 'C') out += formatCenti(args[arg++].value);
+    else if(conv == 'B') out += args[arg++].value ? "ON" : "OFF";
+    else out += std::to_string(args[arg++].value);
+  }
+  return true;
+}
+
+static void emitText(const uint8_t *p, size_t n) {
+  if(n == 0) return;
+  fwrite(p, 1, n, stdout);
+  atLineStart = p[n - 1] == '\n';
+}
+
+static void emitRecord(const std::string &line) {
+  if(!atLineStart) fputc('\n', stdout);
+  fputs(line.c_str(), stdout);
+  fputc('\n', stdout);
+  atLineStart = true;
+}
+
+// Decodes what it can from buf; returns the bytes consumed. A record cut off
+// at the end of buf is left for the next call unless eof is set.
+static size_t decode(const uint8_t *buf, size_t n, bool eof) {
+  size_t i = 0, textStart = 0;
+  while(i < n) {
+    if(buf[i] != LOG_RECORD_SYNC) {
+      i++;
+      continue;
+    }
+    emitText(buf + textStart, i - textStart);
+    textStart = i;
+    LogFrame frame = checkLogFrame(buf + i, n - i);
+    if(frame == LOG_FRAME_SHORT) {
+      if(!eof) return i;
+      i++;                // truncated tail: show it as text
+      continue;
+    }
+    uint8_t id = buf[i + 1], len = buf[i + 2];
+    std::string line;
+    if(frame == LOG_FRAME_BAD) {
+      corrupt++;
+      i++;                // not a record after all, or damaged: resync on the next byte
+      textStart = i;
+      continue;
+    }
+    if(id >= formats.size()) {
+      unknown++;
+      char note[64];
+      snprintf(note, sizeof(note), "<record id %u, %u bytes: format table out of date?>", id, len);
+      emitRecord(note);
+    } else if(formatRecord(formats[id], buf + i + 3, buf + i + 3 + len, line)) {
+      decoded++;
+      emitRecord(line);
+    } else {
+      corrupt++;
+      emitRecord("<" + formats[id].id + ": payload does not match the format>");
+    }
+    i += len + 4;
+    textStart = i;
+  }
+  emitText(buf + textStart, n - textStart);
+  return n;
+}
+
+int main(int argc, char **argv) {
+  if(argc < 2) {
+    fprintf(stderr, "usage: %s SKETCH.cpp [CAPTURE]\n", argv[0]);
+    return 2;
+  }
+  if(!loadLogFormats(argv[1], formats)) {
+    fprintf(stderr, "%s: no LOG_FORMATS table\n", argv[1]);
+    return 1;
+  }
+  int fd = argc > 2 ? open(argv[2], O_RDONLY) : 0;
+  if(fd < 0) {
+    perror(argv[2]);
+    return 1;
+  }
+
+  // read() rather than fread() so a live serial stream shows up as it arrives
+  std::vector<uint8_t> pending;
+  uint8_t chunk[4096];
+  ssize_t got;
+  while((got = read(fd, chunk, sizeof(chunk))) > 0) {
+    pending.insert(pending.end(), chunk, chunk + got);
+    size_t used = decode(pending.data(), pending.size(), false);
+    pending.erase(pending.begin(), pending.begin() + used);
+    fflush(stdout);
+  }
+  decode(pending.data(), pending.size(), true);
+  fflush(stdout);
+  fprintf(stderr, "logdecode: %lu records, %lu corrupt, %lu unknown id\n", decoded, corrupt, unknown);
+  return 0;
+}
@@ -0,0 +1,270 @@
+// Small single-threaded MQTT broker on epoll (QoS 0, no retained messages,
+// no will). Enough to run the host tools against each other where no
+// broker such as mosquitto is installed.
+#pragma once
+
+#include "mqtt_wire.h"
+
+#include <atomic>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+class MqttBroker {
+public:
+  static constexpr size_t MAX_BACKLOG = 16 << 20;   // unsent bytes per subscriber
+
+  std::atomic<uint64_t> messagesIn{0};
+  std::atomic<uint64_t> messagesOut{0};
+  std::atomic<uint64_t> messagesDropped{0};   // subscriber too far behind
+  std::atomic<uint32_t> clients{0};
+
+  // Binds the listening socket; port 0 picks a free one (see port())
+  bool begin(uint16_t port) {
+    listenFd_ = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    int one = 1;
+    setsockopt(listenFd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    if(bind(listenFd_, (sockaddr *)&addr, sizeof(addr)) < 0 || listen(listenFd_, 1024) < 0) return false;
+    socklen_t len = sizeof(addr);
+    getsockname(listenFd_, (sockaddr *)&addr, &len);
+    port_ = ntohs(addr.sin_port);
+
+    epollFd_ = epoll_create1(0);
+    epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.fd = listenFd_;
+    epoll_ctl(epollFd_, EPOLL_CTL_ADD, listenFd_, &ev);
+    return true;
+  }
+
+  uint16_t port() const { return port_; }
+
+  void run(const std::atomic<bool> &stop) {
+    epoll_event events[256];
+    while(!stop) {
+      int n = epoll_wait(epollFd_, events, 256, 100);
+      for(int i = 0; i < n; i++) {
+        int fd = events[i].data.fd;
+        if(fd == listenFd_) {
+          acceptClients();
+          continue;
+        }
+        if(events[i].events & (EPOLLHUP | EPOLLERR)) {
+          dropClient(fd);
+          continue;
+        }
+        if(events[i].events & EPOLLIN) readClient(fd);
+        if((events[i].events & EPOLLOUT) && conns_.count(fd)) flushClient(fd);
+      }
+      // Publishes fanned out during this wakeup go out one send() per client
+      for(int fd : pending_) flushClient(fd);
+      pending_.clear();
+    }
+    for(auto &c : conns_) close(c.first);
+    conns_.clear();
+    close(listenFd_);
+    close(epollFd_);
+  }
+
+private:
+  struct Conn {
+    std::string rx, tx;
+    std::vector<std::string> filters;
+    bool wantWrite = false;
+  };
+
+  void acceptClients() {
+    int fd;
+    while((fd = accept4(listenFd_, nullptr, nullptr, SOCK_NONBLOCK)) >= 0) {
+      int one = 1;
+      setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+      conns_[fd];
+      epoll_event ev = {};
+      ev.events = EPOLLIN;
+      ev.data.fd = fd;
+      epoll_ctl(epollFd_, EPOLL_CTL_ADD, fd, &ev);
+      clients++;
+    }
+  }
+
+  void dropClient(int fd) {
+    auto it = conns_.find(fd);
+    if(it == conns_.end()) return;
+    for(auto &f : it->second.filters) unsubscribe(fd, f);
+    conns_.erase(it);
+    epoll_ctl(epollFd_, EPOLL_CTL_DEL, fd, nullptr);
+    close(fd);
+    clients--;
+  }
+
+  void readClient(int fd) {
+    char buf[16384];
+    while(true) {
+      auto it = conns_.find(fd);
+      if(it == conns_.end()) return;
+      ssize_t n = recv(fd, buf, sizeof(buf), 0);
+      if(n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+        dropClient(fd);
+        return;
+      }
+      if(n < 0) break;
+      it->second.rx.append(buf, n);
+      if(!handlePackets(fd)) {
+        dropClient(fd);
+        return;
+      }
+    }
+  }
+
+  bool handlePackets(int fd) {
+    std::string &rx = conns_[fd].rx;
+    size_t used = 0;
+    uint8_t header;
+    std::string_view body;
+    long n;
+    while((n = mqtt::parsePacket(std::string_view(rx).substr(used), header, body)) > 0) {
+      used += n;
+      switch(header >> 4) {
+        case mqtt::CONNECT:
+          queue(fd, std::string("\x20\x02\x00\x00", 4));
+          break;
+        case mqtt::SUBSCRIBE: {
+          if(body.size() < 2) return false;      // no packet id
+          std::string_view rest = body.substr(2);
+          std::string ackBody(body.substr(0, 2));
+          while(!rest.empty()) {
+            std::string_view filter = mqtt::getString(rest);
+            if(filter.empty() || rest.empty()) return false;
+            rest.remove_prefix(1);   // requested QoS; we grant 0
+            subscribe(fd, std::string(filter));
+            ackBody += (char)0;
+          }
+          std::string packet;
+          mqtt::appendPacket(packet, mqtt::SUBACK << 4, ackBody);
+          queue(fd, packet);
+          break;
+        }
+        case mqtt::PUBLISH: {
+          std::string_view topic, payload;
+          if(!mqtt::parsePublish(header, body, topic, payload)) return false;
+          messagesIn++;
+          route(topic, payload);
+          break;
+        }
+        case mqtt::PINGREQ:
+          queue(fd, std::string("\xD0\x00", 2));
+          break;
+        case mqtt::DISCONNECT:
+          return false;
+        default:
+          break;
+      }
+    }
+    if(n < 0) return false;
+    // The connection may have been written to (not erased) while routing
+    conns_[fd].rx.erase(0, used);
+    return true;
+  }
+
+  // Exact filters are indexed by topic; only wildcard filters are scanned
+  void subscribe(int fd, const std::string &filter) {
+    Conn &c = conns_[fd];
+    c.filters.push_back(filter);
+    if(filter.find_first_of("+#") == std::string::npos) exact_[filter].push_back(fd);
+    else wildcard_.push_back({ filter, fd });
+  }
+
+  void unsubscribe(int fd, const std::string &filter) {
+    auto it = exact_.find(filter);
+    if(it != exact_.end()) {
+      auto &v = it->second;
+      for(size_t i = 0; i < v.size(); i++) {
+        if(v[i] == fd) { v[i] = v.back(); v.pop_back(); break; }
+      }
+      if(v.empty()) exact_.erase(it);
+      return;
+    }
+    for(size_t i = 0; i < wildcard_.size(); i++) {
+      if(wildcard_[i].fd == fd && wildcard_[i].filter == filter) {
+        wildcard_[i] = wildcard_.back();
+        wildcard_.pop_back();
+        return;
+      }
+    }
+  }
+
+  void route(std::string_view topic, std::string_view payload) {
+    auto deliver = [&](int fd) {
+      auto it = conns_.find(fd);
+      if(it == conns_.end()) return;
+      Conn &c = it->second;
+      if(c.tx.size() > MAX_BACKLOG) {
+        messagesDropped++;
+        return;
+      }
+      mqtt::appendPublish(c.tx, topic, payload);
+      messagesOut++;
+      if(c.tx.size() > 65536) flushClient(fd);
+      else pending_.push_back(fd);
+    };
+    auto it = exact_.find(std::string(topic));
+    if(it != exact_.end()) {
+      for(int fd : it->second) deliver(fd);
+    }
+    for(auto &w : wildcard_) {
+      if(mqtt::topicMatches(w.filter, topic)) deliver(w.fd);
+    }
+  }
+
+  void queue(int fd, const std::string &data) {
+    conns_[fd].tx += data;
+    pending_.push_back(fd);
+  }
+
+  void flushClient(int fd) {
+    auto it = conns_.find(fd);
+    if(it == conns_.end()) return;
+    Conn &c = it->second;
+    while(!c.tx.empty()) {
+      ssize_t n = send(fd, c.tx.data(), c.tx.size(), MSG_NOSIGNAL);
+      if(n < 0) {
+        if(errno != EAGAIN && errno != EWOULDBLOCK) {
+          c.tx.clear();
+          return;
+        }
+        break;
+      }
+      c.tx.erase(0, n);
+    }
+    bool want = !c.tx.empty();
+    if(want != c.wantWrite) {
+      c.wantWrite = want;
+      epoll_event ev = {};
+      ev.events = EPOLLIN | (want ? (uint32_t)EPOLLOUT : 0u);
+      ev.data.fd = fd;
+      epoll_ctl(epollFd_, EPOLL_CTL_MOD, fd, &ev);
+    }
+  }
+
+  struct Wildcard {
+    std::string filter;
+    int fd;
+  };
+
+  int listenFd_ = -1;
+  int epollFd_ = -1;
+  uint16_t port_ = 0;
+  std::unordered_map<int, Conn> conns_;
+  std::unordered_map<std::string, std::vector<int>> exact_;
+  std::vector<Wildcard> wildcard_;
+  std::vector<int> pending_;
+};
@@ -0,0 +1,122 @@
+// MQTT 3.1.1 packet framing for the host-side services (QoS 0 only):
+// building packets and cutting whole packets out of a receive buffer.
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <string_view>
+
+namespace mqtt {
+
+enum PacketType : uint8_t {
+  CONNECT = 1, CONNACK = 2, PUBLISH = 3, SUBSCRIBE = 8, SUBACK = 9,
+  UNSUBSCRIBE = 10, UNSUBACK = 11, PINGREQ = 12, PINGRESP = 13, DISCONNECT = 14,
+};
+
+inline void putLength(std::string &out, size_t len) {
+  do {
+    uint8_t digit = len & 0x7F;
+    len >>= 7;
+    out += (char)(len ? digit | 0x80 : digit);
+  } while(len);
+}
+
+inline void putString(std::string &out, std::string_view s) {
+  out += (char)(s.size() >> 8);
+  out += (char)(s.size() & 0xFF);
+  out.append(s.data(), s.size());
+}
+
+inline std::string_view getString(std::string_view &in) {
+  if(in.size() < 2) return {};
+  size_t n = ((uint8_t)in[0] << 8) | (uint8_t)in[1];
+  if(in.size() < 2 + n) return {};
+  std::string_view s = in.substr(2, n);
+  in.remove_prefix(2 + n);
+  return s;
+}
+
+// Appends a whole packet to out, so many packets can share one send()
+inline void appendPacket(std::string &out, uint8_t header, std::string_view body) {
+  out += (char)header;
+  putLength(out, body.size());
+  out.append(body.data(), body.size());
+}
+
+inline void appendPublish(std::string &out, std::string_view topic, std::string_view payload) {
+  out += (char)(PUBLISH << 4);
+  putLength(out, 2 + topic.size() + payload.size());
+  putString(out, topic);
+  out.append(payload.data(), payload.size());
+}
+
+inline void appendConnect(std::string &out, std::string_view clientId, uint16_t keepAliveS) {
+  std::string body;
+  putString(body, "MQTT");
+  body += (char)4;      // protocol level 3.1.1
+  body += (char)0x02;   // clean session
+  body += (char)(keepAliveS >> 8);
+  body += (char)(keepAliveS & 0xFF);
+  putString(body, clientId);
+  appendPacket(out, CONNECT << 4, body);
+}
+
+inline void appendSubscribe(std::string &out, uint16_t packetId, std::string_view filter) {
+  std::string body;
+  body += (char)(packetId >> 8);
+  body += (char)(packetId & 0xFF);
+  putString(body, filter);
+  body += (char)0;      // QoS 0
+  appendPacket(out, (SUBSCRIBE << 4) | 0x02, body);
+}
+
+// Cuts the next whole packet from buf. Returns the bytes it used, 0 if the
+// packet is still incomplete, or -1 if the length field is malformed.
+inline long parsePacket(std::string_view buf, uint8_t &header, std::string_view &body) {
+  if(buf.size() < 2) return 0;
+  size_t len = 0, pos = 1;
+  for(int shift = 0;; shift += 7) {
+    if(pos >= buf.size()) return 0;
+    if(pos > 4) return -1;
+    uint8_t digit = buf[pos++];
+    len |= (size_t)(digit & 0x7F) << shift;
+    if(!(digit & 0x80)) break;
+  }
+  if(buf.size() < pos + len) return 0;
+  header = buf[0];
+  body = buf.substr(pos, len);
+  return pos + len;
+}
+
+// PUBLISH body → topic and payload (skips the packet id of QoS 1/2)
+inline bool parsePublish(uint8_t header, std::string_view body, std::string_view &topic,
+                         std::string_view &payload) {
+  topic = getString(body);
+  if(topic.empty()) return false;
+  if(header & 0x06) {
+    if(body.size() < 2) return false;
+    body.remove_prefix(2);
+  }
+  payload = body;
+  return true;
+}
+
+// Topic filter match with the "+" (one level) and "#" (rest) wildcards
+inline bool topicMatches(std::string_view filter, std::string_view topic) {
+  size_t f = 0, t = 0;
+  while(f < filter.size()) {
+    if(filter[f] == '#') return true;
+    if(filter[f] == '+') {
+      while(t < topic.size() && topic[t] != '/') t++;
+      f++;
+    } else {
+      if(t >= topic.size() || filter[f] != topic[t]) return false;
+      f++;
+      t++;
+    }
+  }
+  return t == topic.size();
+}
+
+}  // namespace mqtt
@@ -0,0 +1,36 @@
+// Minimal local MQTT broker (QoS 0) for running the sketches and host
+// tools together where mosquitto is not installed.
+//
+// Build from the repo root:
+//   g++ -std=c++17 -O2 -Ihost host/mqttbroker.cpp -o mqttbroker
+//   ./mqttbroker --port 1883
+
+#include "mqtt_broker.h"
+
+#include <csignal>
+#include <stdio.h>
+#include <stdlib.h>
+
+static std::atomic<bool> stopping{false};
+
+int main(int argc, char **argv) {
+  int port = 1883;
+  for(int i = 1; i < argc; i++) {
+    std::string a = argv[i];
+    if(a == "--port" && i + 1 < argc) port = atoi(argv[++i]);
+    else {
+      fprintf(stderr, "usage: %s [--port P]\n", argv[0]);
+      return 2;
+    }
+  }
+  MqttBroker broker;
+  if(!broker.begin(port)) {
+    perror("listen");
+    return 1;
+  }
+  signal(SIGINT, [](int) { stopping = true; });
+  signal(SIGTERM, [](int) { stopping = true; });
+  fprintf(stderr, "broker: 127.0.0.1:%d\n", broker.port());
+  broker.run(stopping);
+  return 0;
+}
@@ -0,0 +1,640 @@
+// Deterministic replay of recorded sensor inputs through a sketch's control
+// code, for comparing controller variants offline.
+//
+// The recording is a Serial capture of a sketch built with RECORD_INPUTS 1
+// (see the LOG_REC_* rows of its LOG_FORMATS table). The unmodified sketch
+// runs on the virtual clock and its inputs come from the recording:
+//   LOG_REC_DHT      DHT readings: the recorded reading nearest in time
+//   LOG_REC_ADC      analogRead() of that pin: the recorded sample nearest in time
+//   LOG_REC_IR       the sketch's first two INPUT pins (left, right), held
+//                    until the next recorded change
+//   LOG_REC_ARG,     rebuilt as a request line at the recorded time and served
+//   LOG_REC_REQUEST  by the sketch's own httpDispatch(); responses are dropped
+//   LOG_REC_MQTT     delivered to the subscription of that feed, broker-less
+// Text and other log records in the capture are skipped. The same build on
+// the same recording always produces the same output.
+//
+// Prints one JSON object per run on stdout: input counts, the DHT reads the
+// sketch made, replay speed, and per output pin (named from the sketch's
+// pinMode() calls) the number of switches, the on-time fraction, the
+// on-interval lengths and the mean level (PWM duty). --timeline writes every
+// pin change as CSV: ms,pin,value.
+//
+// --react PIN[:ON[:OFF]] adds the control reaction time of that pin: each time
+// the recorded temperature reaches ON °C (drops below OFF °C) after being on
+// the other side, the time until the pin turns on (off). ON and OFF default to
+// the sketch's TEMP_THRESHOLD and TEMP_HYSTERESIS. A pin that was already
+// there counts as 0 s, as the sketch sees a recorded reading up to half a
+// recording interval early; a crossing undone before the pin followed counts
+// as missed.
+//
+// A build of codedup.cpp with LOW_POWER_MODE 1 deep-sleeps at the end of
+// setup() and never reaches loop(). It is replayed wake by wake instead: each
+// wake boots a fresh copy of the board (a fork taken before setup() first
+// ran) at its time in the recording, with only the RTC memory carried over,
+// and the next one follows after the sleep the sketch asked for. WiFi takes
+// --join-ms QUICK,FULL to connect (default 400,3500: cached channel and BSSID
+// with a static IP, and a full scan with DHCP). Prints one JSON object: the
+// wake-to-sleep time per sample and the energy per sample and average current
+// from the sketch's ENERGY_* board figures.
+//
+// Build from the repo root, one binary per sketch or controller variant:
+//   g++ -std=c++17 -O2 -Ihost -DSKETCH='"../esp1.cpp"' host/replay.cpp -o replay-esp1 -lpthread
+//   g++ -std=c++17 -O2 -Ihost -DSKETCH='"../codedup.cpp"' -DLOW_POWER_MODE=1 host/replay.cpp -o replay-codedup-sleep -lpthread
+//   sed 's/TEMP_HYSTERESIS   100/TEMP_HYSTERESIS   50/' esp1.cpp > /tmp/esp1-h50.cpp
+//   g++ -std=c++17 -O2 -Ihost -DSKETCH='"/tmp/esp1-h50.cpp"' host/replay.cpp -o replay-esp1-h50 -lpthread
+//
+// Run:
+//   ./replay-esp1 capture.bin [--speed 1000] [--timeline pins.csv] [--until-ms N]
+//                 [--pass-us 50] [--ir-pins L,R] [--label name] [--source sketch.cpp]
+//                 [--rules "pump = temp > 31 for 2m"] [--react ENA:32:31] [--join-ms 400,3500]
+// --speed caps the replay at that multiple of real time (default: as fast as
+// it goes); --pass-us is the time charged for a loop() pass that does not
+// wait itself, as in the line followers. --rules installs automation rules
+// (see /rules in the sketch) before the replay starts.
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "Arduino.h"       // the line followers rely on the IDE including it
+#include "DHT.h"           // and have no DHT, so the readings go nowhere
+#include "log_records.h"
+
+#include SKETCH
+
+// ---------------- Recording ----------------
+struct Sample {
+  int64_t ms;
+  int64_t a, b;
+};
+
+// Inputs that happen at one moment, in recording order
+struct Event {
+  int64_t ms;
+  enum { IR, REQUEST, MQTT } kind;
+  int64_t a, b;
+  std::string text, text2;
+  std::vector<std::pair<std::string, std::string>> args;
+};
+
+static std::vector<Sample> dhtSamples;
+static std::map<uint8_t, std::vector<Sample>> adcSamples;
+static std::vector<Event> events;
+static uint32_t inputsLost = 0, recordsCorrupt = 0, recordsOther = 0;
+
+static bool loadRecording(const char *path, const std::vector<LogFormat> &formats) {
+  std::ifstream in(path, std::ios::binary);
+  if(!in) return false;
+  std::vector<uint8_t> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+  std::vector<std::pair<std::string, std::string>> pendingArgs;
+  std::vector<LogArg> args;
+  for(size_t i = 0; i < data.size(); ) {
+    if(data[i] != LOG_RECORD_SYNC) {
+      i++;
+      continue;
+    }
+    LogFrame frame = checkLogFrame(&data[i], data.size() - i);
+    if(frame != LOG_FRAME_OK) {
+      if(frame == LOG_FRAME_BAD) recordsCorrupt++;
+      i++;
+      continue;
+    }
+    uint8_t id = data[i + 1], len = data[i + 2];
+    const uint8_t *payload = &data[i + 3];
+    i += len + 4;
+    int64_t ms;
+    if(id >= formats.size() || !decodeLogPayload(formats[id], payload, payload + len, ms, args)) {
+      recordsCorrupt++;
+      continue;
+    }
+
+    const std::string &name = formats[id].id;
+    if(name == "LOG_REC_DHT" && !args.empty()) {
+      dhtSamples.push_back({ ms, args[0].value, args.size() > 1 ? args[1].value : LOG_RECORD_NAN });
+    } else if(name == "LOG_REC_ADC" && args.size() == 2) {
+      adcSamples[(uint8_t)args[0].value].push_back({ ms, args[1].value, 0 });
+    } else if(name == "LOG_REC_IR" && args.size() == 2) {
+      events.push_back({ ms, Event::IR, args[0].value, args[1].value, "", "", {} });
+    } else if(name == "LOG_REC_ARG" && args.size() == 2) {
+      pendingArgs.push_back({ args[0].text, args[1].text });
+    } else if(name == "LOG_REC_REQUEST" && args.size() == 2) {
+      events.push_back({ ms, Event::REQUEST, args[0].value, 0, args[1].text, "", pendingArgs });
+      pendingArgs.clear();
+    } else if(name == "LOG_REC_MQTT" && args.size() == 2) {
+      events.push_back({ ms, Event::MQTT, 0, 0, args[0].text, args[1].text, {} });
+    } else if(name == "LOG_DROPPED" && args.size() == 1) {
+      inputsLost += args[0].value;    // an upper bound: not every dropped record was an input
+    } else {
+      recordsOther++;
+    }
+  }
+  return true;
+}
+
+// The recorded sample nearest to ms; cursor only moves forward, as time does
+static const Sample *nearest(const std::vector<Sample> &samples, size_t &cursor, int64_t ms) {
+  if(samples.empty()) return nullptr;
+  while(cursor + 1 < samples.size() && samples[cursor + 1].ms <= ms) cursor++;
+  if(cursor + 1 < samples.size() && samples[cursor + 1].ms - ms < ms - samples[cursor].ms) return &samples[cursor + 1];
+  return &samples[cursor];
+}
+
+static size_t dhtCursor = 0;
+static std::map<uint8_t, size_t> adcCursor;
+static int64_t bootMs = 0;     // recording time of the board's last boot; millis() counts from it
+
+static int replayAnalogRead(uint8_t pin) {
+  auto it = adcSamples.find(pin);
+  if(it == adcSamples.end()) return host::analogValue[0];
+  return (int)nearest(it->second, adcCursor[pin], bootMs + millis())->a;
+}
+
+static void setDhtReading(int64_t ms) {
+  if(const Sample *s = nearest(dhtSamples, dhtCursor, ms)) {
+    host::dhtTemp = s->a == LOG_RECORD_NAN ? NAN : s->a / 100.0f;
+    host::dhtHum = s->b == LOG_RECORD_NAN ? NAN : s->b / 100.0f;
+  }
+}
+
+// ---------------- Pins ----------------
+struct PinTrack {
+  std::string name;
+  uint8_t gpio;
+  int value = 0;
+  uint64_t sinceUs = 0;
+  uint32_t switches = 0;
+  uint64_t onUs = 0;
+  double levelSum = 0;       // value x us, for the mean level
+  uint64_t onStartUs = 0;
+  uint32_t onIntervals = 0;
+  uint64_t onIntervalSumUs = 0, onIntervalMinUs = UINT64_MAX, onIntervalMaxUs = 0;
+};
+
+static std::vector<std::pair<uint8_t, uint8_t>> pinModes;    // (pin, mode) in call order
+static std::vector<PinTrack> outputs;
+static int trackIndex[32];
+static FILE *timeline = nullptr;
+static int reactIndex = -1;
+static std::vector<std::pair<int64_t, bool>> reactChanges;   // (ms, on) of that pin
+
+static void onPinMode(uint8_t pin, uint8_t mode) {
+  pinModes.push_back({ (uint8_t)(pin & 31), mode });
+}
+
+// Closes the current level's segment at nowUs
+static void settle(PinTrack &t, uint64_t nowUs) {
+  uint64_t us = nowUs - t.sinceUs;
+  t.levelSum += (double)t.value * us;
+  if(t.value) t.onUs += us;
+  t.sinceUs = nowUs;
+}
+
+static void onPinWrite(uint8_t pin, int value, bool) {
+  int index = trackIndex[pin & 31];
+  if(index < 0) return;
+  PinTrack &t = outputs[index];
+  if(value == t.value) return;
+  uint64_t now = host::virtualMicros;
+  settle(t, now);
+  if(!t.value) {
+    t.onStartUs = now;
+  } else if(!value) {
+    uint64_t on = now - t.onStartUs;
+    t.onIntervals++;
+    t.onIntervalSumUs += on;
+    t.onIntervalMinUs = std::min(t.onIntervalMinUs, on);
+    t.onIntervalMaxUs = std::max(t.onIntervalMaxUs, on);
+  }
+  if(index == reactIndex && !t.value != !value) reactChanges.push_back({ (int64_t)(now / 1000), value != 0 });
+  t.value = value;
+  t.switches++;
+  if(timeline) fprintf(timeline, "%llu,%s,%d\n", (unsigned long long)(now / 1000), t.name.c_str(), value);
+}
+
+#ifdef HTTP_REQUEST_BYTES
+// The request head a client would have sent, arguments URL-encoded again
+static std::string requestHead(int method, const std::string &path,
+                               const std::vector<std::pair<std::string, std::string>> &args) {
+  static const char *const methods[] = { "GET", "GET", "HEAD", "POST", "PUT", "PATCH", "DELETE", "OPTIONS" };
+  auto encode = [](const std::string &in) {
+    std::string out;
+    for(unsigned char c : in) {
+      if(isalnum(c) || strchr("-._~/", c)) {
+        out += c;
+      } else {
+        char hex[4];
+        snprintf(hex, sizeof(hex), "%%%02X", c);
+        out += hex;
+      }
+    }
+    return out;
+  };
+  std::string head = std::string(method >= 0 && method < 8 ? methods[method] : "GET") + " " + encode(path);
+  for(size_t i = 0; i < args.size(); i++) {
+    head += (i ? "&" : "?") + encode(args[i].first) + "=" + encode(args[i].second);
+  }
+  return head + " HTTP/1.1\r\n\r\n";
+}
+#endif
+
+// Names for the pins: the identifiers passed to pinMode() in the sketch
+// source, each resolved through its #define or int constant to a number
+static std::map<int, std::string> pinNames(const char *path) {
+  std::ifstream in(path);
+  std::string src((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  std::map<std::string, std::string> values = {
+    { "D0", std::to_string(D0) }, { "D1", std::to_string(D1) }, { "D2", std::to_string(D2) },
+    { "D3", std::to_string(D3) }, { "D4", std::to_string(D4) }, { "D5", std::to_string(D5) },
+    { "D6", std::to_string(D6) }, { "D7", std::to_string(D7) }, { "D8", std::to_string(D8) },
+    { "A0", std::to_string(A0) },
+  };
+  std::regex constant("(?:#define\\s+(\\w+)\\s+(\\w+))|(?:\\bint\\s+(\\w+)\\s*=\\s*(\\w+)\\s*;)");
+  for(std::sregex_iterator it(src.begin(), src.end(), constant), last; it != last; ++it) {
+    if((*it)[1].matched) values.emplace((*it)[1], (*it)[2]);
+    else values.emplace((*it)[3], (*it)[4]);
+  }
+
+  std::map<int, std::string> names;
+  std::regex call("pinMode\\s*\\(\\s*(\\w+)\\s*,");
+  for(std::sregex_iterator it(src.begin(), src.end(), call), last; it != last; ++it) {
+    std::string token = (*it)[1];
+    for(int depth = 0; depth < 4 && !isdigit((unsigned char)token[0]) && values.count(token); depth++) token = values[token];
+    if(isdigit((unsigned char)token[0])) names.emplace(atoi(token.c_str()), (*it)[1]);
+  }
+  return names;
+}
+
+// Reaction of the --react pin to the recorded temperature crossing onC/offC.
+// Delays go to delaysMs; returns the crossings the pin never followed.
+static uint32_t reactionTimes(double onC, double offC, int64_t untilMs, std::vector<int64_t> &delaysMs) {
+  uint32_t missed = 0;
+  int state = -1;                 // which side of the band the readings are on, -1 = not known yet
+  int64_t crossedMs = -1;         // pending crossing still waiting for the pin
+  bool switched = false;          // the pin changed since the last crossing
+  size_t change = 0;
+  bool pinOn = reactChanges.empty() ? outputs[reactIndex].value != 0 : !reactChanges[0].second;
+  for(const Sample &x : dhtSamples) {
+    if(x.ms >= untilMs) break;
+    // The pin as it was when this reading was recorded
+    for(; change < reactChanges.size() && reactChanges[change].first <= x.ms; change++) {
+      pinOn = reactChanges[change].second;
+      switched = true;
+      if(crossedMs >= 0 && pinOn == (state == 1)) {
+        delaysMs.push_back(reactChanges[change].first - crossedMs);
+        crossedMs = -1;
+      }
+    }
+    if(x.a == LOG_RECORD_NAN) continue;
+    int side = x.a >= onC * 100 ? 1 : x.a < offC * 100 ? 0 : state;
+    if(side == state || side < 0) continue;
+    if(crossedMs >= 0) missed++;
+    crossedMs = -1;
+    bool first = state < 0;
+    state = side;
+    // A pin already there counts as 0 s if it switched since the last
+    // crossing; if it never left, it missed that one rather than followed this
+    if(!first && pinOn != (side == 1)) crossedMs = x.ms;
+    else if(!first && switched) delaysMs.push_back(0);
+    switched = false;
+  }
+  for(; crossedMs >= 0 && change < reactChanges.size(); change++) {
+    if(reactChanges[change].second == (state == 1)) {
+      delaysMs.push_back(reactChanges[change].first - crossedMs);
+      crossedMs = -1;
+    }
+  }
+  return missed + (crossedMs >= 0);
+}
+
+// ---------------- Deep Sleep ----------------
+#if LOW_POWER_MODE
+// What a wake hands back when the sketch calls ESP.deepSleep()
+struct WakeReport {
+  uint32_t awakeMs;
+  uint64_t sleepUs;
+  uint32_t publishes;
+  uint32_t rtcMemory[sizeof(host::rtcMemory) / 4];
+};
+
+static int wakePipe = -1;
+
+static void reportWake(uint64_t us) {
+  WakeReport r;
+  r.awakeMs = millis();
+  r.sleepUs = us;
+  r.publishes = host::mqttLoopbackPublishes;
+  memcpy(r.rtcMemory, host::rtcMemory, sizeof(r.rtcMemory));
+  if(write(wakePipe, &r, sizeof(r)) != sizeof(r)) _exit(1);
+}
+
+static int replayWakes(const std::string &label, int64_t untilMs) {
+  std::vector<uint32_t> awakeMs;
+  uint64_t sleepUs = 0, awakeSumMs = 0;
+  uint32_t publishes = 0, unpublished = 0;
+  uint64_t wallStartUs = host::realMicros();
+  for(int64_t wakeAt = 0; wakeAt < untilMs; ) {
+    setDhtReading(wakeAt + DHT_POWERUP_MS);
+    int fds[2];
+    if(pipe(fds) != 0) {
+      perror("pipe");
+      return 1;
+    }
+    fflush(stdout);
+    pid_t pid = fork();
+    if(pid == 0) {
+      close(fds[0]);
+      wakePipe = fds[1];
+      bootMs = wakeAt;
+      host::onDeepSleep = reportWake;
+      setup();
+      _exit(1);    // a low-power setup() ends in deep sleep
+    }
+    close(fds[1]);
+    WakeReport r;
+    bool slept = pid > 0 && read(fds[0], &r, sizeof(r)) == sizeof(r);
+    close(fds[0]);
+    if(pid > 0) waitpid(pid, nullptr, 0);
+    if(!slept) {
+      fprintf(stderr, "wake %zu at %lld ms did not reach deep sleep\n", awakeMs.size() + 1, (long long)wakeAt);
+      return 1;
+    }
+    memcpy(host::rtcMemory, r.rtcMemory, sizeof(r.rtcMemory));
+    awakeMs.push_back(r.awakeMs);
+    awakeSumMs += r.awakeMs;
+    sleepUs += r.sleepUs;
+    publishes += r.publishes;
+    if(r.publishes == 0) unpublished++;
+    wakeAt += r.awakeMs + r.sleepUs / 1000;
+  }
+  uint64_t wallUs = host::realMicros() - wallStartUs;
+
+  // The sketch's own energy model, as in its LOG_ENERGY report
+  size_t wakes = awakeMs.size();
+  double sleepMs = sleepUs / 1e3;
+  double awakeMj = (double)ENERGY_AWAKE_MA * ENERGY_SUPPLY_MV * awakeSumMs / 1e6 / wakes;
+  double asleepMj = (double)ENERGY_SLEEP_UA * ENERGY_SUPPLY_MV * sleepMs / 1e9 / wakes;
+  double averageUa = ((double)ENERGY_AWAKE_MA * 1000 * awakeSumMs + (double)ENERGY_SLEEP_UA * sleepMs) /
+                     (awakeSumMs + sleepMs);
+  std::sort(awakeMs.begin(), awakeMs.end());
+  auto at = [&](double q) { return awakeMs[(size_t)(q * (wakes - 1) + 0.5)]; };
+  printf("{\"label\":\"%s\",\"replayed_s\":%.1f,\"wall_ms\":%.1f,\"wakes\":%zu,\"join_ms\":[%lu,%lu],"
+         "\"wake_to_sleep_ms\":{\"mean\":%.0f,\"p50\":%u,\"p95\":%u,\"max\":%u},\"sleep_mean_s\":%.1f,"
+         "\"energy_per_sample_mj\":{\"awake\":%.1f,\"asleep\":%.1f,\"total\":%.1f},\"average_ua\":%.0f,"
+         "\"publishes\":%u,\"wakes_unpublished\":%u}\n",
+         label.c_str(), (awakeSumMs + sleepMs) / 1e3, wallUs / 1e3, wakes, host::wifiQuickJoinMs, host::wifiJoinMs,
+         (double)awakeSumMs / wakes, at(0.5), at(0.95), at(1.0), sleepMs / 1e3 / wakes,
+         awakeMj, asleepMj, awakeMj + asleepMj, averageUa, publishes, unpublished);
+  return 0;
+}
+#endif
+
+int main(int argc, char **argv) {
+  if(argc < 2) {
+    fprintf(stderr, "usage: %s CAPTURE [--speed X] [--timeline FILE] [--until-ms N] [--pass-us N] "
+                    "[--ir-pins L,R] [--label NAME] [--source SKETCH.cpp] [--rules TEXT] "
+                    "[--react PIN[:ON[:OFF]]] [--join-ms QUICK,FULL]\n", argv[0]);
+    return 2;
+  }
+  // SKETCH is relative to this file's directory, as for the #include; that
+  // path in turn is relative to where it was built
+  std::string source = SKETCH;
+  if(source[0] != '/') {
+    std::string here = __FILE__;
+    source = here.substr(0, here.find_last_of('/') + 1) + source;
+  }
+  const char *capture = argv[1];
+  double speed = 0;
+  const char *timelinePath = nullptr;
+  int64_t untilMs = -1;
+  uint32_t passUs = 50;
+  int irLeft = -1, irRight = -1;
+  std::string label;
+  const char *rulesText = nullptr;
+  std::string reactPin;
+#if defined(TEMP_THRESHOLD) && defined(TEMP_HYSTERESIS)
+  double reactOnC = TEMP_THRESHOLD / 100.0, reactOffC = (TEMP_THRESHOLD - TEMP_HYSTERESIS) / 100.0;
+#else
+  double reactOnC = NAN, reactOffC = NAN;
+#endif
+#if LOW_POWER_MODE
+  host::wifiQuickJoinMs = 400;
+  host::wifiJoinMs = 3500;
+#endif
+  for(int i = 2; i + 1 < argc; i += 2) {
+    std::string opt = argv[i];
+    if(opt == "--speed") speed = atof(argv[i + 1]);
+    else if(opt == "--timeline") timelinePath = argv[i + 1];
+    else if(opt == "--until-ms") untilMs = atoll(argv[i + 1]);
+    else if(opt == "--pass-us") passUs = atoi(argv[i + 1]);
+    else if(opt == "--ir-pins") sscanf(argv[i + 1], "%d,%d", &irLeft, &irRight);
+    else if(opt == "--label") label = argv[i + 1];
+    else if(opt == "--source") source = argv[i + 1];
+    else if(opt == "--rules") rulesText = argv[i + 1];
+#if LOW_POWER_MODE
+    else if(opt == "--join-ms") sscanf(argv[i + 1], "%lu,%lu", &host::wifiQuickJoinMs, &host::wifiJoinMs);
+#endif
+    else if(opt == "--react") {
+      std::string spec = argv[i + 1];
+      size_t colon = spec.find(':');
+      reactPin = spec.substr(0, colon);
+      if(colon != std::string::npos) {
+        reactOnC = reactOffC = atof(spec.c_str() + colon + 1);
+        size_t second = spec.find(':', colon + 1);
+        if(second != std::string::npos) reactOffC = atof(spec.c_str() + second + 1);
+      }
+    }
+  }
+  if(!reactPin.empty() && (isnan(reactOnC) || reactOffC > reactOnC)) {
+    fprintf(stderr, "--react: give ON and OFF temperatures, OFF <= ON\n");
+    return 2;
+  }
+  if(label.empty()) label = source.substr(source.find_last_of('/') + 1);
+
+  std::vector<LogFormat> formats;
+  if(!loadLogFormats(source.c_str(), formats)) {
+    fprintf(stderr, "%s: no LOG_FORMATS table (run from the repo root, or give --source)\n", source.c_str());
+    return 1;
+  }
+  if(!loadRecording(capture, formats)) {
+    perror(capture);
+    return 1;
+  }
+  if(dhtSamples.empty() && adcSamples.empty() && events.empty()) {
+    fprintf(stderr, "%s: no input records (was the sketch built with RECORD_INPUTS 1?)\n", capture);
+    return 1;
+  }
+  int64_t lastMs = 0;
+  if(!dhtSamples.empty()) lastMs = std::max(lastMs, dhtSamples.back().ms);
+  for(auto &ch : adcSamples) lastMs = std::max(lastMs, ch.second.back().ms);
+  if(!events.empty()) lastMs = std::max(lastMs, events.back().ms);
+  if(untilMs < 0) untilMs = lastMs;
+
+  setenv("HOST_HTTP_PORT", "0", 0);
+  host::quiet = true;
+  host::virtualClock = true;
+  host::analogSource = replayAnalogRead;
+  host::onPinMode = onPinMode;
+#ifdef MQTT_CONN_KEEPALIVE
+  host::mqttLoopback = true;
+#endif
+#if LOW_POWER_MODE
+  return replayWakes(label, untilMs);
+#endif
+  // The first reading is what the sensor showed at boot
+  setDhtReading(0);
+  setup();
+  if(rulesText) {
+#ifdef RULES_SOURCE_BYTES
+    char error[48];
+    if(!compileRules(rulesText, pendingRules, error, sizeof(error))) {
+      fprintf(stderr, "--rules: %s\n", error);
+      return 2;
+    }
+    rulesPending = true;
+    applyPendingRules();
+#else
+    fprintf(stderr, "--rules: %s has no automation rules\n", label.c_str());
+    return 2;
+#endif
+  }
+
+  // Outputs and IR inputs from the pinMode() calls setup() made
+  std::map<int, std::string> names = pinNames(source.c_str());
+  std::vector<uint8_t> inputs;
+  std::fill(std::begin(trackIndex), std::end(trackIndex), -1);
+  for(size_t i = 0; i < pinModes.size(); i++) {
+    uint8_t pin = pinModes[i].first;
+    if(pinModes[i].second != OUTPUT) {
+      inputs.push_back(pin);
+      continue;
+    }
+    if(trackIndex[pin] >= 0) continue;
+    PinTrack t;
+    t.name = names.count(pin) ? names[pin] : "gpio" + std::to_string(pin);
+    t.gpio = pin;
+    t.value = host::pinOutput[pin];
+    t.sinceUs = host::virtualMicros;
+    if(t.value) t.onStartUs = t.sinceUs;
+    trackIndex[pin] = outputs.size();
+    if(t.name == reactPin) reactIndex = outputs.size();
+    outputs.push_back(t);
+  }
+  if(!reactPin.empty() && reactIndex < 0) {
+    fprintf(stderr, "--react: %s is not an output of %s\n", reactPin.c_str(), label.c_str());
+    return 2;
+  }
+  if(irLeft < 0 && inputs.size() >= 2) {
+    irLeft = inputs[0];
+    irRight = inputs[1];
+  }
+  if(timelinePath) {
+    timeline = fopen(timelinePath, "w");
+    if(!timeline) {
+      perror(timelinePath);
+      return 1;
+    }
+    fprintf(timeline, "ms,pin,value\n");
+    for(auto &t : outputs) fprintf(timeline, "%llu,%s,%d\n", (unsigned long long)(t.sinceUs / 1000), t.name.c_str(), t.value);
+  }
+  host::onPinWrite = onPinWrite;
+
+  uint32_t httpReplayed = 0, mqttReplayed = 0, irReplayed = 0, skipped = 0;
+  uint64_t passes = 0;
+  size_t next = 0;
+  uint64_t startUs = host::virtualMicros, wallStartUs = host::realMicros();
+  uint32_t dhtReadsBefore = host::dhtTransfers;    // setup() may read once
+  while((int64_t)millis() < untilMs) {
+    int64_t now = millis();
+    for(; next < events.size() && events[next].ms <= now; next++) {
+      Event &e = events[next];
+      if(e.kind == Event::IR && irLeft >= 0) {
+        host::digitalValue[irLeft & 31] = e.a;
+        host::digitalValue[irRight & 31] = e.b;
+        irReplayed++;
+#ifdef HTTP_REQUEST_BYTES
+      } else if(e.kind == Event::REQUEST) {
+        std::string head = requestHead(e.a, e.text, e.args);
+        if(head.size() < sizeof(httpRequest)) {
+          memcpy(httpRequest, head.c_str(), head.size() + 1);
+          httpDispatch();
+          httpReplayed++;
+        } else {
+          skipped++;
+        }
+#endif
+#ifdef MQTT_CONN_KEEPALIVE
+      } else if(e.kind == Event::MQTT && mqtt.deliver(e.text.c_str(), e.text2.c_str())) {
+        mqttReplayed++;
+#endif
+      } else {
+        skipped++;
+      }
+    }
+    setDhtReading(now);
+
+    uint64_t before = host::virtualMicros;
+    loop();
+    if(host::virtualMicros == before) host::advanceMicros(passUs);
+    passes++;
+
+    if(speed > 0) {
+      uint64_t dueUs = (host::virtualMicros - startUs) / speed;
+      uint64_t wallUs = host::realMicros() - wallStartUs;
+      if(dueUs > wallUs + 1000) usleep(dueUs - wallUs);
+    }
+  }
+  uint64_t endUs = host::virtualMicros;
+  uint64_t wallUs = host::realMicros() - wallStartUs;
+  if(timeline) fclose(timeline);
+
+  // Samples within the replayed span; events are counted as they are applied
+  auto within = [&](const Sample &x) { return x.ms < untilMs; };
+  size_t dhtCount = std::count_if(dhtSamples.begin(), dhtSamples.end(), within), adcCount = 0;
+  for(auto &ch : adcSamples) adcCount += std::count_if(ch.second.begin(), ch.second.end(), within);
+  double spanUs = endUs - startUs;
+  printf("{\"label\":\"%s\",\"replayed_s\":%.1f,\"wall_ms\":%.1f,\"speedup\":%.0f,\"loop_passes\":%llu,"
+         "\"inputs\":{\"dht\":%zu,\"adc\":%zu,\"ir\":%u,\"http\":%u,\"mqtt\":%u,\"skipped\":%u,\"lost\":%u},"
+         "\"records_other\":%u,\"records_corrupt\":%u,\"dht_reads\":%u,",
+         label.c_str(), spanUs / 1e6, wallUs / 1e3, wallUs ? spanUs / wallUs : 0.0, (unsigned long long)passes,
+         dhtCount, adcCount, irReplayed, httpReplayed, mqttReplayed, skipped, inputsLost,
+         recordsOther, recordsCorrupt, host::dhtTransfers - dhtReadsBefore);
+  if(reactIndex >= 0) {
+    std::vector<int64_t> delays;
+    uint32_t missed = reactionTimes(reactOnC, reactOffC, untilMs, delays);
+    std::sort(delays.begin(), delays.end());
+    double sum = 0;
+    for(int64_t d : delays) sum += d;
+    auto at = [&](double q) { return delays.empty() ? 0.0 : delays[(size_t)(q * (delays.size() - 1) + 0.5)] / 1e3; };
+    printf("\"reaction\":{\"pin\":\"%s\",\"on_c\":%.2f,\"off_c\":%.2f,\"followed\":%zu,\"missed\":%u,"
+           "\"mean_s\":%.2f,\"p50_s\":%.2f,\"p95_s\":%.2f,\"max_s\":%.2f},",
+           reactPin.c_str(), reactOnC, reactOffC, delays.size(), missed,
+           delays.empty() ? 0.0 : sum / delays.size() / 1e3, at(0.5), at(0.95), at(1.0));
+  }
+#ifdef MQTT_CONN_KEEPALIVE
+  printf("\"mqtt_published\":%u,", host::mqttLoopbackPublishes);
+#endif
+  printf("\"pins\":[");
+  for(size_t i = 0; i < outputs.size(); i++) {
+    PinTrack &t = outputs[i];
+    settle(t, endUs);
+    // An interval still open at the end counts in on_fraction only
+    printf("%s{\"pin\":\"%s\",\"gpio\":%u,\"switches\":%u,\"on_fraction\":%.4f,\"mean_level\":%.1f,"
+           "\"on_intervals\":%u,\"on_mean_s\":%.1f,\"on_min_s\":%.1f,\"on_max_s\":%.1f,\"final\":%d}",
+           i ? "," : "", t.name.c_str(), t.gpio, t.switches, spanUs ? t.onUs / spanUs : 0.0,
+           spanUs ? t.levelSum / spanUs : 0.0, t.onIntervals,
+           t.onIntervals ? t.onIntervalSumUs / 1e6 / t.onIntervals : 0.0,
+           t.onIntervals ? t.onIntervalMinUs / 1e6 : 0.0, t.onIntervalMaxUs / 1e6, t.value);
+  }
+  printf("]}\n");
+  return 0;
+}
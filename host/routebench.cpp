@@ -0,0 +1,300 @@
+// Request routing benchmark: the sketch's own request path (request line
+// parsed in place, compile-time perfect-hash route table, arguments as string
+// views) against a model of the ESP8266WebServer path it replaced.
+//
+// Both sides get the same request heads, drawn from the dashboards' request
+// mixes (the httpbench presets) with the headers a browser's fetch() sends,
+// already in memory, so the figures are parse + route + argument lookup only:
+// no sockets, no handlers. For each request the arguments it carries are
+// looked up by name, as the handlers do. The ESP8266WebServer model follows
+// its Parsing.cpp: the request line and every header line are read into
+// Strings and split with substring(), each argument is decoded into a new
+// String pair, handlers are searched in registration order by String compare,
+// and arg() returns a copy. The host's std::string keeps up to 15 characters
+// without allocating, the ESP8266 String 11, so the board allocates somewhat
+// more than the old-model figures here.
+//
+// Prints one JSON object per run on stdout: ns per request and heap
+// allocations/bytes per request for both, and the speedup.
+//
+// Build one binary per sketch from the repo root:
+//   g++ -std=c++17 -O2 -Ihost -DSKETCH='"../esp2.cpp"' host/routebench.cpp -o routebench-esp2 -lpthread
+//
+// Run:
+//   ./routebench-esp2 [--mix esp2] [--requests 20000] [--passes 20]
+
+#include "heap_track.h"
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+
+#include SKETCH
+
+static const char *presetMix(const std::string &name) {
+  if(name == "esp1") return "/data=90,/control?mode=manual=2,/control?pump=ON=3,/control?pump=OFF=3,/=1,/history?res=raw=1";
+  if(name == "esp3") return "/getSensorData=90,/setMode?mode=manual=2,/setPump?state=ON=3,/setLight?state=OFF=3,/=2";
+  if(name == "esp2") return "/speed?value=60=50,/forward=10,/left=10,/right=10,/stop=10,/backward=8,/=2";
+  return nullptr;
+}
+
+// What a browser sends with fetch('/path') from the dashboard page
+static std::string requestHead(const std::string &target) {
+  return "GET " + target + " HTTP/1.1\r\n"
+         "Host: 192.168.1.50\r\n"
+         "Connection: keep-alive\r\n"
+         "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/120.0 Safari/537.36\r\n"
+         "Accept: */*\r\n"
+         "Referer: http://192.168.1.50/\r\n"
+         "Accept-Encoding: gzip, deflate\r\n"
+         "Accept-Language: en-US,en;q=0.9\r\n"
+         "\r\n";
+}
+
+// ---- ESP8266WebServer model
+struct OldArgument {
+  String key;
+  String value;
+};
+
+struct OldServer {
+  std::vector<String> routes;     // registration order, as its handler list
+  String method, uri;
+  OldArgument *args = nullptr;
+  int argCount = 0;
+
+  // Stream::readStringUntil() over the request bytes
+  static String readStringUntil(const std::string &in, size_t &pos, char end) {
+    String out;
+    while(pos < in.size() && in[pos] != end) out += in[pos++];
+    if(pos < in.size()) pos++;
+    return out;
+  }
+
+  static String urlDecode(const String &text) {
+    String decoded;
+    for(unsigned int i = 0; i < text.length(); i++) {
+      char c = text[i];
+      if(c == '+') {
+        decoded += ' ';
+      } else if(c == '%' && i + 2 < text.length()) {
+        char hex[3] = { text[i + 1], text[i + 2], 0 };
+        decoded += (char)strtol(hex, nullptr, 16);
+        i += 2;
+      } else {
+        decoded += c;
+      }
+    }
+    return decoded;
+  }
+
+  void parseArguments(const String &data) {
+    delete[] args;
+    args = nullptr;
+    argCount = 0;
+    if(data.length() == 0) return;
+    int count = 1;
+    for(int i = 0; (i = data.indexOf('&', i)) >= 0; i++) count++;
+    args = new OldArgument[count + 1];
+    int pos = 0;
+    for(int i = 0; i < count; i++) {
+      int equal = data.indexOf('=', pos);
+      int next = data.indexOf('&', pos);
+      if(next < 0) next = data.length();
+      if(equal < 0 || equal > next) {
+        pos = next + 1;
+        continue;
+      }
+      OldArgument &a = args[argCount++];
+      a.key = urlDecode(data.substring(pos, equal));
+      a.value = urlDecode(data.substring(equal + 1, next));
+      pos = next + 1;
+    }
+  }
+
+  // Returns the matching route, -1 for none
+  int handle(const std::string &request) {
+    size_t pos = 0;
+    String req = readStringUntil(request, pos, '\r');
+    readStringUntil(request, pos, '\n');
+    int addrStart = req.indexOf(' ');
+    int addrEnd = req.indexOf(' ', addrStart + 1);
+    if(addrStart < 0 || addrEnd < 0) return -1;
+    method = req.substring(0, addrStart);
+    String url = req.substring(addrStart + 1, addrEnd);
+    String searchStr;
+    int hasSearch = url.indexOf('?');
+    if(hasSearch >= 0) {
+      searchStr = url.substring(hasSearch + 1);
+      url = url.substring(0, hasSearch);
+    }
+    uri = url;
+
+    // Header lines are read and split even when nobody asked for them
+    while(true) {
+      req = readStringUntil(request, pos, '\r');
+      readStringUntil(request, pos, '\n');
+      if(req.length() == 0) break;
+      int colon = req.indexOf(':');
+      if(colon < 0) break;
+      String headerName = req.substring(0, colon);
+      String headerValue = req.substring(colon + 2);
+      (void)headerName;
+      (void)headerValue;
+    }
+    parseArguments(searchStr);
+
+    for(size_t i = 0; i < routes.size(); i++) {
+      if(routes[i] == uri) return i;
+    }
+    return -1;
+  }
+
+  bool hasArg(const String &name) {
+    for(int i = 0; i < argCount; i++) {
+      if(args[i].key == name) return true;
+    }
+    return false;
+  }
+
+  String arg(const String &name) {
+    for(int i = 0; i < argCount; i++) {
+      if(args[i].key == name) return args[i].value;
+    }
+    return String();
+  }
+};
+
+// ---- The sketch's path, as httpHandleClient() runs it once the bytes are in
+static int newHandle(const std::string &request) {
+  size_t len = std::min(request.size(), sizeof(httpRequest) - 1);
+  memcpy(httpRequest, request.data(), len);
+  uint8_t matched = 0;
+  for(size_t i = 0; i < request.size() && matched < 4; i++) {
+    char c = request[i];
+    matched = c == "\r\n\r\n"[matched] ? matched + 1 : c == '\r';
+  }
+  httpRequest[len] = '\0';
+  if(!httpParseRequest()) return -1;
+  return findRoute(httpPath);
+}
+
+struct Result {
+  double nsPerRequest;
+  double allocsPerRequest;
+  double bytesPerRequest;
+  uint64_t checksum;     // keeps the work from being optimised away
+};
+
+template<typename Fn> static Result measure(const std::vector<std::string> &requests, int passes, Fn fn) {
+  Result r = { 0, 0, 0, 0 };
+  for(const auto &q : requests) r.checksum += fn(q);    // warm-up
+  uint64_t allocs = host::heapAllocs.load();
+  long peakSum = 0;
+  for(const auto &q : requests) {
+    long base = host::heapInUse.load();
+    host::heapPeak = base;
+    r.checksum += fn(q);
+    peakSum += host::heapPeak.load() - base;
+  }
+  r.allocsPerRequest = (double)(host::heapAllocs.load() - allocs) / requests.size();
+  r.bytesPerRequest = (double)peakSum / requests.size();
+
+  auto start = std::chrono::steady_clock::now();
+  for(int p = 0; p < passes; p++) {
+    for(const auto &q : requests) r.checksum += fn(q);
+  }
+  double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+  r.nsPerRequest = ns / ((double)passes * requests.size());
+  return r;
+}
+
+int main(int argc, char **argv) {
+  std::string mixName = "";
+  size_t count = 20000;
+  int passes = 20;
+  for(int i = 1; i < argc; i++) {
+    std::string a = argv[i];
+    const char *v = i + 1 < argc ? argv[i + 1] : "";
+    if(a == "--mix") { mixName = v; i++; }
+    else if(a == "--requests") { count = strtoul(v, nullptr, 10); i++; }
+    else if(a == "--passes") { passes = atoi(v); i++; }
+    else {
+      fprintf(stderr, "usage: %s [--mix esp1|esp2|esp3|spec] [--requests N] [--passes N]\n", argv[0]);
+      return 2;
+    }
+  }
+  // Default: the mix of the sketch under test
+  if(mixName.empty()) mixName = routePaths[1] == "/control" ? "esp1" : routePaths[1] == "/setMode" ? "esp3" : "esp2";
+  const char *preset = presetMix(mixName);
+  std::string spec = preset ? preset : mixName;
+
+  std::vector<std::pair<std::string, int>> mix;
+  for(size_t pos = 0; pos < spec.size();) {
+    size_t comma = spec.find(',', pos);
+    if(comma == std::string::npos) comma = spec.size();
+    std::string item = spec.substr(pos, comma - pos);
+    size_t eq = item.rfind('=');
+    if(eq != std::string::npos) mix.push_back({ item.substr(0, eq), atoi(item.c_str() + eq + 1) });
+    pos = comma + 1;
+  }
+  int total = 0;
+  for(auto &m : mix) total += m.second;
+  if(total <= 0) {
+    fprintf(stderr, "empty request mix\n");
+    return 2;
+  }
+
+  std::mt19937 rng(1234);
+  std::uniform_int_distribution<int> pick(0, total - 1);
+  std::vector<std::string> requests;
+  for(size_t i = 0; i < count; i++) {
+    int r = pick(rng);
+    size_t m = 0;
+    while(r >= mix[m].second) r -= mix[m++].second;
+    requests.push_back(requestHead(mix[m].first));
+  }
+
+  // Each side looks up the arguments a request carries by name, as the handlers do
+  OldServer old;
+  for(auto &p : routePaths) old.routes.push_back(String(std::string(p)));
+
+  host::trackHeap = true;
+  Result before = measure(requests, passes, [&](const std::string &q) {
+    int route = old.handle(q);
+    uint64_t sum = route + 1;
+    for(int i = 0; i < old.argCount; i++) {
+      const String &n = old.args[i].key;
+      if(old.hasArg(n)) sum += old.arg(n).length();
+    }
+    return sum;
+  });
+  Result after = measure(requests, passes, [&](const std::string &q) {
+    int route = newHandle(q);
+    uint64_t sum = route + 1;
+    for(uint8_t i = 0; i < httpArgCount; i++) {
+      std::string_view n = httpArgs[i].name;
+      if(httpHasArg(n)) sum += httpArg(n).size();
+    }
+    return sum;
+  });
+  host::trackHeap = false;
+
+  if(before.checksum != after.checksum) {
+    fprintf(stderr, "routebench: the two paths disagree (checksum %llu vs %llu)\n",
+            (unsigned long long)before.checksum, (unsigned long long)after.checksum);
+    return 1;
+  }
+
+  printf("{\"mix\":\"%s\",\"routes\":%d,\"route_slots\":%d,\"route_seed\":%u,\"requests\":%zu,\"passes\":%d,"
+         "\"esp8266webserver\":{\"ns_per_req\":%.1f,\"allocs_per_req\":%.2f,\"heap_peak_bytes_per_req\":%.1f},"
+         "\"router\":{\"ns_per_req\":%.1f,\"allocs_per_req\":%.2f,\"heap_peak_bytes_per_req\":%.1f},"
+         "\"speedup\":%.2f}\n",
+         mixName.c_str(), HTTP_ROUTE_COUNT, HTTP_ROUTE_SLOTS, (unsigned)routeTable.seed, requests.size(), passes,
+         before.nsPerRequest, before.allocsPerRequest, before.bytesPerRequest,
+         after.nsPerRequest, after.allocsPerRequest, after.bytesPerRequest,
+         before.nsPerRequest / after.nsPerRequest);
+  return 0;
+}
@@ -0,0 +1,111 @@
+// Rule engine benchmark: compiles rule sets with the sketch's compileRules()
+// and times evalRules() on them, the way applyAutomaticMode() runs it once per
+// sensor cycle, over a sweep of readings that includes failed DHT reads.
+//
+// The code has no jumps, so one run executes every instruction once and its
+// cost is bounded by RULES_CODE_BYTES; the "longest" preset nearly fills the
+// code buffer to show that bound. The board's own figures are the
+// rule_eval_duration_microseconds histogram in /metrics.
+//
+// Prints one JSON object per rule set on stdout: code bytes, instructions,
+// compile time, ns per evaluation, and that time as a share of the scheduler's
+// SCHED_LATE_MS deadline.
+//
+// Build one binary per sketch from the repo root:
+//   g++ -std=c++17 -O2 -Ihost -DSKETCH='"../esp1.cpp"' host/rulebench.cpp -o rulebench-esp1 -lpthread
+//
+// Run:
+//   ./rulebench-esp1 [--evals 1000000] ["pump = temp > 31 ..."]...
+
+#include <array>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include SKETCH
+
+static const char *presets[][2] = {
+  { "thresholds", "pump = temp >= 32 || pumpOn && temp >= 31; light = light <= 50 || lightOn && light <= 55" },
+  { "example",    "pump = temp > 31 && hum < 60 for 2m; light = light < 45" },
+  { "longest",    "pump = (temp > 31 && hum < 60 || temp > 35) && !(light > 90 && hum > 80) && (pumpOn || temp >= 32.5) for 1m;"
+                  "light = light < 45 && !lightOn || lightOn && light < 55 && (temp < 40 || hum < 70)" },
+};
+
+// Instructions in one run
+static int countOps(const RuleSet &r) {
+  int ops = 0;
+  for(uint8_t pc = 0; pc < r.codeLen; ops++) {
+    uint8_t op = r.code[pc++];
+    pc += op == OP_VAR ? 1 : op == OP_CONST ? 2 : op == OP_OUT ? 3 : 0;
+  }
+  return ops;
+}
+
+static bool bench(const char *name, const char *text, long evals) {
+  RuleSet r;
+  char error[48];
+  auto start = std::chrono::steady_clock::now();
+  const int compiles = 10000;
+  for(int i = 0; i < compiles; i++) {
+    if(!compileRules(text, r, error, sizeof(error))) {
+      fprintf(stderr, "rulebench: %s: %s\n", name, error);
+      return false;
+    }
+  }
+  double compileNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / compiles;
+  if(!verifyRules(r)) {
+    fprintf(stderr, "rulebench: %s: compiled code fails verifyRules()\n", name);
+    return false;
+  }
+
+  // Readings sweep 10-45°C, 20-95% humidity and 0-100% light; one in 16 DHT
+  // reads fails. The outputs feed back as pumpOn/lightOn, as they would.
+  std::vector<std::array<int32_t, RULE_VAR_COUNT>> inputs(1024);
+  for(int i = 0; i < 1024; i++) {
+    bool failed = i % 16 == 5;
+    inputs[i][0] = failed ? RULE_UNKNOWN : 1000 + (i * 37) % 3500;
+    inputs[i][1] = failed ? RULE_UNKNOWN : 2000 + (i * 53) % 7500;
+    inputs[i][2] = (i * 7) % 101 * 100;
+  }
+  clearRuleHolds();
+  bool want[RULE_TARGETS] = { false, false };
+  uint64_t onCount = 0;
+  start = std::chrono::steady_clock::now();
+  for(long i = 0; i < evals; i++) {
+    auto &vars = inputs[i & 1023];
+    vars[3] = want[RULE_PUMP];
+    vars[4] = want[RULE_LIGHT];
+    evalRules(r, vars.data(), want);
+    onCount += want[RULE_PUMP] + want[RULE_LIGHT];
+  }
+  double evalNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / evals;
+
+  printf("{\"set\":\"%s\",\"code_bytes\":%u,\"code_limit\":%d,\"instructions\":%d,\"compile_ns\":%.0f,"
+         "\"eval_ns\":%.1f,\"budget_us\":%d,\"budget_share\":%.2e,\"on_share\":%.3f}\n",
+         name, r.codeLen, RULES_CODE_BYTES, countOps(r), compileNs, evalNs, SCHED_LATE_MS * 1000,
+         evalNs / (SCHED_LATE_MS * 1e6), (double)onCount / (2.0 * evals));
+  return true;
+}
+
+int main(int argc, char **argv) {
+  long evals = 1000000;
+  std::vector<std::string> sets;
+  for(int i = 1; i < argc; i++) {
+    std::string a = argv[i];
+    if(a == "--evals" && i + 1 < argc) evals = strtol(argv[++i], nullptr, 10);
+    else if(a.rfind("--", 0) == 0) {
+      fprintf(stderr, "usage: %s [--evals N] [rules]...\n", argv[0]);
+      return 2;
+    } else sets.push_back(a);
+  }
+  if(evals <= 0) evals = 1;
+
+  bool ok = true;
+  if(sets.empty()) {
+    for(auto &p : presets) ok &= bench(p[0], p[1], evals);
+  } else {
+    for(size_t i = 0; i < sets.size(); i++) ok &= bench(("arg" + std::to_string(i + 1)).c_str(), sets[i].c_str(), evals);
+  }
+  logDrain();
+  return ok ? 0 : 1;
+}
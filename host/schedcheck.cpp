@@ -0,0 +1,108 @@
+// Scheduler check: runs the sketch's timer wheel (scheduler.h) on the virtual
+// clock with two tasks of its own, where "puller" moves "sensors" while
+// runScheduler() has already taken it off the wheel for the same pass. That
+// is what pullSampleIn() does from the "adc" task when the DHT read is due.
+// Two cases: moved to now (it runs in that pass) and moved later (it waits).
+// The period is one wheel revolution plus one slot, so a second link to the
+// task would land in the slot it is already in.
+//
+// After every 1 ms pass each active task must be linked into the wheel exactly
+// once, and "sensors" must run at the times its schedule gives. Prints one
+// JSON object per case on stdout and exits 1 if any case fails.
+//
+// Build one binary per sketch from the repo root:
+//   g++ -std=c++17 -O2 -Ihost -DSKETCH='"../esp1.cpp"' host/schedcheck.cpp -o schedcheck-esp1 -lpthread
+//
+// Run:
+//   ./schedcheck-esp1
+
+#include <vector>
+
+#include SKETCH
+
+static const uint32_t START_MS = 10;                        // both tasks' first run
+static const uint32_t PERIOD_MS = SCHED_WHEEL_SLOTS + 1;    // lands in the slot after the pull
+static const uint32_t RUN_MS = 1000;
+
+static int8_t sensorsId = -1;
+static uint32_t pullDelayMs = 0;
+static bool pulled = false;
+static std::vector<uint32_t> sensorRuns;
+
+static void sensorsRun() { sensorRuns.push_back(millis()); }
+
+static void pullerRun() {
+  if(pulled) return;
+  pulled = true;
+  rescheduleTask(sensorsId, pullDelayMs);
+}
+
+// Empty if every active task is linked once and no chain is longer than
+// there are tasks, else what is wrong
+static std::string wheelProblem() {
+  int links[SCHED_MAX_TASKS] = {};
+  for(uint8_t slot = 0; slot < SCHED_WHEEL_SLOTS; slot++) {
+    int steps = 0;
+    for(int8_t id = wheel[slot]; id >= 0; id = tasks[id].next) {
+      if(++steps > SCHED_MAX_TASKS) return "slot " + std::to_string(slot) + " chain loops";
+      links[id]++;
+    }
+  }
+  for(int id = 0; id < SCHED_MAX_TASKS; id++) {
+    if(tasks[id].active && links[id] != 1) {
+      return std::string(tasks[id].name) + " linked " + std::to_string(links[id]) + " times";
+    }
+  }
+  return "";
+}
+
+// "sensors" runs at START_MS + pullDelayMs, then every PERIOD_MS
+static bool runCase(const char *label, uint32_t delayMs) {
+  memset(tasks, 0, sizeof(tasks));
+  host::virtualMicros = 0;
+  schedulerBegin();
+  pullDelayMs = delayMs;
+  pulled = false;
+  sensorRuns.clear();
+
+  // Inserted last, "puller" heads the slot's chain and runs first
+  sensorsId = scheduleEvery("sensors", PERIOD_MS, START_MS, sensorsRun);
+  scheduleEvery("puller", 1000, START_MS, pullerRun);
+
+  std::string problem;
+  uint32_t passes = 0;
+  while(millis() < RUN_MS && problem.empty()) {
+    host::advanceMicros(1000);
+    runScheduler();
+    passes++;
+    problem = wheelProblem();
+  }
+
+  std::vector<uint32_t> want;
+  for(uint32_t at = START_MS + delayMs; at < millis(); at += PERIOD_MS) want.push_back(at);
+  if(problem.empty() && sensorRuns != want) {
+    problem = "sensors ran " + std::to_string(sensorRuns.size()) + " times, expected "
+              + std::to_string(want.size());
+    for(size_t i = 0; i < sensorRuns.size() && i < want.size(); i++) {
+      if(sensorRuns[i] != want[i]) {
+        problem = "sensors run " + std::to_string(i) + " at " + std::to_string(sensorRuns[i])
+                  + " ms, expected " + std::to_string(want[i]);
+        break;
+      }
+    }
+  }
+
+  printf("{\"sketch\":\"%s\",\"case\":\"%s\",\"passes\":%u,\"sensor_runs\":%zu,\"ok\":%s",
+         SKETCH, label, passes, sensorRuns.size(), problem.empty() ? "true" : "false");
+  if(!problem.empty()) printf(",\"problem\":\"%s\"", problem.c_str());
+  printf("}\n");
+  return problem.empty();
+}
+
+int main() {
+  host::virtualClock = true;
+  host::quiet = true;
+  bool ok = runCase("pull to now", 0);
+  ok = runCase("pull later", 30) && ok;
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,151 @@
+// Converts a sketch's trace dump (see "Tracing" in a sketch) to the Chrome
+// trace event JSON that chrome://tracing and ui.perfetto.dev open.
+//
+// The input is either the body of GET /trace or a raw Serial capture taken
+// while sending 'T'; the dump is found by its "TRC1" header, so log records
+// around it do not matter. Timestamps are micros() since boot, with 32-bit
+// wraps undone. Spans whose begin fell out of the ring are dropped; spans
+// still open at the dump are closed at the dump time.
+//
+// Build from the repo root:
+//   g++ -std=c++17 -O2 host/trace2json.cpp -o trace2json
+//
+// Run:
+//   curl -s http://192.168.1.50/trace > trace.bin && ./trace2json trace.bin > trace.json
+//   ./trace2json capture.bin > trace.json        (Serial capture with a 'T' dump)
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+struct TraceEvent {
+  uint32_t us;
+  char phase;
+  uint8_t name;
+  uint16_t arg;
+};
+
+static_assert(sizeof(TraceEvent) == 8, "matches the sketches' TraceEvent");
+
+static uint32_t readU32(const uint8_t *p) {
+  return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static std::string jsonEscape(const std::string &s) {
+  std::string out;
+  for(char c : s) {
+    if(c == '"' || c == '\\') out += '\\';
+    if((unsigned char)c < 0x20) continue;
+    out += c;
+  }
+  return out;
+}
+
+int main(int argc, char **argv) {
+  if(argc < 2) {
+    fprintf(stderr, "usage: %s DUMP > trace.json\n", argv[0]);
+    return 2;
+  }
+  std::ifstream in(argv[1], std::ios::binary);
+  if(!in) {
+    perror(argv[1]);
+    return 1;
+  }
+  std::vector<uint8_t> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+  // The last dump in the file wins
+  size_t at = std::string::npos;
+  for(size_t i = 0; i + 15 <= data.size(); i++) {
+    if(memcmp(&data[i], "TRC1", 4) == 0) at = i;
+  }
+  if(at == std::string::npos) {
+    fprintf(stderr, "%s: no trace dump (TRC1 header) found\n", argv[1]);
+    return 1;
+  }
+  const uint8_t *p = &data[at], *end = data.data() + data.size();
+  uint32_t nowUs = readU32(p + 4), nowMs = readU32(p + 8);
+  uint8_t nameCount = p[12], handlerBase = p[13], taskBase = p[14];
+  p += 15;
+
+  std::vector<std::string> names;
+  for(uint8_t i = 0; i < nameCount; i++) {
+    if(p >= end || end - p - 1 < *p) {
+      fprintf(stderr, "%s: dump cut short in the name table\n", argv[1]);
+      return 1;
+    }
+    names.emplace_back((const char *)p + 1, *p);
+    p += 1 + *p;
+  }
+  if(end - p < 2) {
+    fprintf(stderr, "%s: dump cut short before the events\n", argv[1]);
+    return 1;
+  }
+  uint16_t count = p[0] | p[1] << 8;
+  p += 2;
+  if((size_t)(end - p) < count * sizeof(TraceEvent)) {
+    fprintf(stderr, "%s: dump holds %zu of %u events\n", argv[1], (size_t)(end - p) / sizeof(TraceEvent), count);
+    count = (end - p) / sizeof(TraceEvent);
+  }
+  std::vector<TraceEvent> events(count);
+  memcpy(events.data(), p, count * sizeof(TraceEvent));
+
+  // Undo micros() wraps, anchoring the dump time at nowMs (which wraps after
+  // 49 days rather than 71 minutes)
+  std::vector<uint64_t> ts(count);
+  uint64_t wraps = 0;
+  for(size_t i = 0; i < count; i++) {
+    if(i > 0 && events[i].us < events[i - 1].us) wraps++;
+    ts[i] = (wraps << 32) + events[i].us;
+  }
+  uint64_t dumpUs = (wraps << 32) + nowUs;
+  if(count > 0 && nowUs < events[count - 1].us) dumpUs += 1ULL << 32;
+  uint64_t anchorUs = (uint64_t)nowMs * 1000;
+  uint64_t shift = anchorUs > dumpUs ? (anchorUs - dumpUs + (1ULL << 31)) >> 32 << 32 : 0;
+
+  auto category = [&](uint8_t name) {
+    return name < handlerBase ? "sketch" : name < taskBase ? "http" : "task";
+  };
+  auto label = [&](uint8_t name) {
+    std::string text = name < names.size() && !names[name].empty() ? names[name] : "#" + std::to_string(name);
+    return jsonEscape(name >= taskBase ? "task " + text : text);
+  };
+
+  printf("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+  printf("{\"ph\":\"M\",\"pid\":1,\"tid\":1,\"name\":\"thread_name\",\"args\":{\"name\":\"loop\"}}");
+  std::vector<uint8_t> open;
+  size_t dropped = 0;
+  for(size_t i = 0; i < count; i++) {
+    const TraceEvent &e = events[i];
+    if(e.phase == 'E') {
+      // A begin that was overwritten leaves an end with nothing to close
+      if(open.empty() || open.back() != e.name) {
+        dropped++;
+        continue;
+      }
+      open.pop_back();
+    } else if(e.phase == 'B') {
+      open.push_back(e.name);
+    } else if(e.phase != 'i') {
+      dropped++;
+      continue;
+    }
+    printf(",\n{\"ph\":\"%c\",\"pid\":1,\"tid\":1,\"ts\":%llu,\"cat\":\"%s\",\"name\":\"%s\"", e.phase,
+           (unsigned long long)(ts[i] + shift), category(e.name), label(e.name).c_str());
+    if(e.phase == 'i') printf(",\"s\":\"t\",\"args\":{\"state\":%u}", e.arg);
+    printf("}");
+  }
+  while(!open.empty()) {
+    printf(",\n{\"ph\":\"E\",\"pid\":1,\"tid\":1,\"ts\":%llu,\"cat\":\"%s\",\"name\":\"%s\"}",
+           (unsigned long long)(dumpUs + shift), category(open.back()), label(open.back()).c_str());
+    open.pop_back();
+  }
+  printf("\n]}\n");
+  fprintf(stderr, "trace2json: %u events, %zu unmatched skipped, %.3f s span\n", count, dropped,
+          count > 0 ? (ts[count - 1] - ts[0]) / 1e6 : 0.0);
+  return 0;
+}
@@ -0,0 +1,503 @@
+// Compressed time-series store for node telemetry (host side).
+//
+// One append-only file per series ("<node>/<feed>"), made of 4 KB blocks.
+// A block keeps its first sample in the header and packs the rest as a
+// bit stream:
+//   timestamps  delta-of-delta, zigzag, in 1/9/15/24/68-bit buckets; a
+//               steady publish interval costs 1 bit per sample
+//   values      delta of the fixed-point value (centi-units, as the
+//               sketches publish them), zigzag, 1/6/11/20/37-bit buckets
+// Readings are already small integers, so a plain delta beats XOR of the
+// float bit patterns here.
+//
+// Each block header carries count/min/max/sum, so range summaries only
+// decode the (at most two) blocks that straddle the range edges. Sealed
+// blocks are read through a shared read-only mmap; the block still being
+// filled lives in memory and is written to the end of the file by flush()
+// and when it fills up. Files are opened only for those writes, so
+// thousands of series do not hold thousands of descriptors.
+//
+// On reopen the last block is checked (magic + CRC); a block torn by a
+// crash mid-flush is dropped, losing at most the samples since its last
+// good write.
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <memory>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+namespace tsdb {
+
+constexpr size_t BLOCK_SIZE = 4096;
+constexpr uint32_t BLOCK_MAGIC = 0x31425354;   // "TSB1"
+
+struct BlockHeader {
+  uint32_t magic;
+  uint32_t crc;          // of the whole block with this field zero
+  uint16_t count;
+  uint8_t sealed;        // full; never written again
+  uint8_t reserved;
+  uint32_t bits;         // payload bits used
+  int64_t firstTime;     // ms
+  int64_t lastTime;
+  int64_t lastDelta;     // lastTime minus the time before it
+  int64_t sum;
+  int32_t firstValue;
+  int32_t lastValue;
+  int32_t minValue;
+  int32_t maxValue;
+};
+
+struct Block {
+  BlockHeader h;
+  uint8_t payload[BLOCK_SIZE - sizeof(BlockHeader)];
+};
+static_assert(sizeof(BlockHeader) == 64, "header layout is on disk");
+static_assert(sizeof(Block) == BLOCK_SIZE, "block layout is on disk");
+
+constexpr uint32_t PAYLOAD_BITS = sizeof(Block::payload) * 8;
+
+// ---------------- Bit Packing ----------------
+// Prefix codes: '0', '10', '110', '1110', '1111', each followed by that
+// bucket's payload bits
+struct Bucket {
+  uint8_t prefixBits;
+  uint8_t prefix;
+  uint8_t valueBits;
+};
+constexpr Bucket TIME_BUCKETS[5] = { {1, 0x0, 0}, {2, 0x2, 7}, {3, 0x6, 12}, {4, 0xE, 20}, {4, 0xF, 64} };
+constexpr Bucket VALUE_BUCKETS[5] = { {1, 0x0, 0}, {2, 0x2, 4}, {3, 0x6, 8}, {4, 0xE, 16}, {4, 0xF, 33} };
+
+inline uint64_t zigzag(int64_t v) { return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63); }
+inline int64_t unzigzag(uint64_t z) { return (int64_t)(z >> 1) ^ -(int64_t)(z & 1); }
+
+inline const Bucket &pickBucket(const Bucket (&table)[5], uint64_t z) {
+  if(z == 0) return table[0];
+  for(int i = 1; i < 4; i++) {
+    if(z < (1ULL << table[i].valueBits)) return table[i];
+  }
+  return table[4];
+}
+
+// MSB first; the payload starts zeroed so writes only OR bits in
+inline void putBits(uint8_t *p, uint32_t &bit, uint64_t v, int n) {
+  while(n > 0) {
+    int room = 8 - (bit & 7);
+    int take = std::min(room, n);
+    p[bit >> 3] |= (uint8_t)(((v >> (n - take)) & ((1u << take) - 1)) << (room - take));
+    bit += take;
+    n -= take;
+  }
+}
+
+inline uint64_t getBits(const uint8_t *p, uint32_t &bit, int n) {
+  uint64_t v = 0;
+  while(n > 0) {
+    int room = 8 - (bit & 7);
+    int take = std::min(room, n);
+    v = (v << take) | ((p[bit >> 3] >> (room - take)) & ((1u << take) - 1));
+    bit += take;
+    n -= take;
+  }
+  return v;
+}
+
+// Reads a prefix code and its payload. Away from the end of the payload
+// this works on a 64-bit window (prefix and payload of the common buckets
+// fit in one); near the end, or for 64-bit payloads, it falls back to
+// getBits().
+inline uint64_t getBucketed(const uint8_t *p, uint32_t &bit, const Bucket (&table)[5], size_t payloadBytes) {
+  if((bit >> 3) + 8 <= payloadBytes) {
+    uint64_t w;
+    memcpy(&w, p + (bit >> 3), 8);
+    w = __builtin_bswap64(w) << (bit & 7);
+    int ones = std::min(4, __builtin_clzll(~w | 1));
+    const Bucket &b = table[ones];
+    int n = b.prefixBits + b.valueBits;
+    if(n <= 57) {
+      bit += n;
+      return (w << b.prefixBits) >> (63 - b.valueBits) >> 1;   // no branch for 0-bit payloads
+    }
+  }
+  int ones = 0;
+  while(ones < 4 && getBits(p, bit, 1)) ones++;
+  return table[ones].valueBits ? getBits(p, bit, table[ones].valueBits) : 0;
+}
+
+inline uint32_t crc32(const uint8_t *data, size_t len) {
+  static const std::array<uint32_t, 256> table = [] {
+    std::array<uint32_t, 256> t;
+    for(uint32_t i = 0; i < 256; i++) {
+      uint32_t c = i;
+      for(int k = 0; k < 8; k++) c = (c >> 1) ^ (0xEDB88320 & -(c & 1));
+      t[i] = c;
+    }
+    return t;
+  }();
+  uint32_t crc = 0xFFFFFFFF;
+  for(size_t i = 0; i < len; i++) crc = (crc >> 8) ^ table[(crc ^ data[i]) & 0xFF];
+  return ~crc;
+}
+
+inline uint32_t blockCrc(const Block &b) {
+  Block copy = b;
+  copy.h.crc = 0;
+  return crc32((const uint8_t *)&copy, sizeof(copy));
+}
+
+// Calls f(timeMs, value) for every sample of a block, in order
+template <class F>
+void decodeBlock(const Block &b, F &&f) {
+  if(b.h.count == 0) return;
+  int64_t t = b.h.firstTime, delta = 0;
+  int32_t v = b.h.firstValue;
+  f(t, v);
+  uint32_t bit = 0;
+  for(uint32_t i = 1; i < b.h.count; i++) {
+    delta += unzigzag(getBucketed(b.payload, bit, TIME_BUCKETS, sizeof(b.payload)));
+    t += delta;
+    v += (int32_t)unzigzag(getBucketed(b.payload, bit, VALUE_BUCKETS, sizeof(b.payload)));
+    f(t, v);
+  }
+}
+
+// ---------------- Summaries ----------------
+struct Summary {
+  uint64_t count = 0;
+  int32_t min = INT32_MAX;
+  int32_t max = INT32_MIN;
+  int64_t sum = 0;
+
+  void add(int32_t v) {
+    count++;
+    min = std::min(min, v);
+    max = std::max(max, v);
+    sum += v;
+  }
+
+  void add(const BlockHeader &h) {
+    count += h.count;
+    min = std::min(min, h.minValue);
+    max = std::max(max, h.maxValue);
+    sum += h.sum;
+  }
+
+  double avg() const { return count ? (double)sum / count : 0; }
+};
+
+// ---------------- Series ----------------
+class Series {
+public:
+  explicit Series(std::string path) : path_(std::move(path)) { resetOpen(); }
+
+  ~Series() {
+    flush();
+    if(map_) munmap(map_, mapBytes_);
+  }
+
+  Series(const Series &) = delete;
+  Series &operator=(const Series &) = delete;
+
+  // Loads an existing file; a missing file is an empty series
+  bool load() {
+    int fd = ::open(path_.c_str(), O_RDWR);
+    if(fd < 0) return errno == ENOENT;
+    struct stat st;
+    fstat(fd, &st);
+    uint32_t blocks = st.st_size / BLOCK_SIZE;
+    sealed_ = blocks;
+    if(blocks > 0) {
+      Block last;
+      bool ok = pread(fd, &last, BLOCK_SIZE, (off_t)(blocks - 1) * BLOCK_SIZE) == (ssize_t)BLOCK_SIZE &&
+                last.h.magic == BLOCK_MAGIC && last.h.crc == blockCrc(last);
+      if(!ok) {
+        droppedBlocks_++;
+        sealed_ = blocks - 1;
+      } else if(!last.h.sealed) {
+        open_ = last;
+        sealed_ = blocks - 1;
+      }
+    }
+    if(st.st_size != (off_t)(sealed_ + (open_.h.count ? 1 : 0)) * (off_t)BLOCK_SIZE) {
+      if(ftruncate(fd, (off_t)sealed_ * BLOCK_SIZE) < 0) {
+        close(fd);
+        return false;
+      }
+      if(open_.h.count) writeBlock(fd, open_, sealed_);
+    }
+    close(fd);
+    if(!remap()) return false;
+    samples_ = open_.h.count;
+    for(uint32_t i = 0; i < sealed_; i++) samples_ += block(i).h.count;
+    lastTime_ = open_.h.count ? open_.h.lastTime : sealed_ ? block(sealed_ - 1).h.lastTime : INT64_MIN;
+    return true;
+  }
+
+  // Samples must come in time order; an older timestamp is rejected
+  bool append(int64_t t, int32_t v) {
+    if(t < lastTime_) return false;
+    BlockHeader &h = open_.h;
+    if(h.count == 0) {
+      h.firstTime = h.lastTime = t;
+      h.firstValue = h.lastValue = h.minValue = h.maxValue = v;
+      h.sum = v;
+      h.count = 1;
+    } else {
+      int64_t delta = t - h.lastTime;
+      uint64_t zt = zigzag(delta - h.lastDelta);
+      uint64_t zv = zigzag((int64_t)v - h.lastValue);
+      const Bucket &bt = pickBucket(TIME_BUCKETS, zt);
+      const Bucket &bv = pickBucket(VALUE_BUCKETS, zv);
+      if(h.bits + bt.prefixBits + bt.valueBits + bv.prefixBits + bv.valueBits > PAYLOAD_BITS) {
+        seal();
+        return append(t, v);
+      }
+      putBits(open_.payload, h.bits, bt.prefix, bt.prefixBits);
+      putBits(open_.payload, h.bits, zt, bt.valueBits);
+      putBits(open_.payload, h.bits, bv.prefix, bv.prefixBits);
+      putBits(open_.payload, h.bits, zv, bv.valueBits);
+      h.lastDelta = delta;
+      h.lastTime = t;
+      h.lastValue = v;
+      h.minValue = std::min(h.minValue, v);
+      h.maxValue = std::max(h.maxValue, v);
+      h.sum += v;
+      h.count++;
+    }
+    lastTime_ = t;
+    samples_++;
+    dirty_ = true;
+    return true;
+  }
+
+  // Writes the partly filled block (no fsync)
+  bool flush() {
+    if(!dirty_) return true;
+    int fd = ::open(path_.c_str(), O_RDWR | O_CREAT, 0644);
+    open_.h.crc = blockCrc(open_);
+    bool ok = fd >= 0 && writeBlock(fd, open_, sealed_);
+    if(fd >= 0) close(fd);
+    if(!ok) writeErrors_++;
+    dirty_ = !ok;
+    return ok;
+  }
+
+  // [from, to) in ms
+  Summary summarize(int64_t from, int64_t to) const {
+    Summary s;
+    forBlocks(from, to, [&](const Block &b) {
+      if(b.h.firstTime >= from && b.h.lastTime < to) s.add(b.h);
+      else decodeBlock(b, [&](int64_t t, int32_t v) {
+        if(t >= from && t < to) s.add(v);
+      });
+    });
+    return s;
+  }
+
+  // f(timeMs, value) for every sample in [from, to)
+  template <class F>
+  void scan(int64_t from, int64_t to, F &&f) const {
+    forBlocks(from, to, [&](const Block &b) {
+      decodeBlock(b, [&](int64_t t, int32_t v) {
+        if(t >= from && t < to) f(t, v);
+      });
+    });
+  }
+
+  // Fixed-width buckets over [from, to); out[i] covers from + i*step.
+  // One pass: a block inside a single bucket adds its header, any other
+  // block is decoded and its samples spread over the buckets.
+  void rollup(int64_t from, int64_t to, int64_t step, std::vector<Summary> &out) const {
+    out.assign(to > from ? (to - from + step - 1) / step : 0, Summary());
+    forBlocks(from, to, [&](const Block &b) {
+      if(b.h.firstTime >= from && b.h.lastTime < to &&
+         (b.h.firstTime - from) / step == (b.h.lastTime - from) / step) {
+        out[(b.h.firstTime - from) / step].add(b.h);
+      } else decodeBlock(b, [&](int64_t t, int32_t v) {
+        if(t >= from && t < to) out[(t - from) / step].add(v);
+      });
+    });
+  }
+
+  uint64_t samples() const { return samples_; }
+  uint32_t blocks() const { return sealed_ + (open_.h.count ? 1 : 0); }
+  uint64_t bytes() const { return (uint64_t)blocks() * BLOCK_SIZE; }
+  uint32_t droppedBlocks() const { return droppedBlocks_; }
+  uint32_t writeErrors() const { return writeErrors_; }
+  int64_t firstTime() const { return sealed_ ? block(0).h.firstTime : open_.h.firstTime; }
+  int64_t lastTime() const { return lastTime_; }
+
+private:
+  void resetOpen() {
+    memset(&open_, 0, sizeof(open_));
+    open_.h.magic = BLOCK_MAGIC;
+  }
+
+  const Block &block(uint32_t i) const { return ((const Block *)map_)[i]; }
+
+  static bool writeBlock(int fd, const Block &b, uint32_t index) {
+    return pwrite(fd, &b, BLOCK_SIZE, (off_t)index * BLOCK_SIZE) == (ssize_t)BLOCK_SIZE;
+  }
+
+  void seal() {
+    open_.h.sealed = 1;
+    open_.h.crc = blockCrc(open_);
+    int fd = ::open(path_.c_str(), O_RDWR | O_CREAT, 0644);
+    if(fd < 0 || !writeBlock(fd, open_, sealed_)) writeErrors_++;
+    if(fd >= 0) close(fd);
+    sealed_++;
+    resetOpen();
+    remap();
+  }
+
+  // The mapping reserves room past the end of the file and grows by
+  // doubling, so sealing a block rarely touches it; only pages inside the
+  // file are ever read
+  bool remap() {
+    size_t need = (size_t)sealed_ * BLOCK_SIZE;
+    if(need <= mapBytes_) return true;
+    size_t bytes = std::max<size_t>(64 * BLOCK_SIZE, mapBytes_ * 2);
+    while(bytes < need) bytes *= 2;
+    int fd = ::open(path_.c_str(), O_RDONLY);
+    if(fd < 0) return false;
+    void *p = mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(p == MAP_FAILED) return false;
+    if(map_) munmap(map_, mapBytes_);
+    map_ = p;
+    mapBytes_ = bytes;
+    return true;
+  }
+
+  // Sealed blocks are in time order: binary search for the first one that
+  // reaches from, then walk until a block starts at or after to
+  template <class F>
+  void forBlocks(int64_t from, int64_t to, F &&f) const {
+    uint32_t lo = 0, hi = sealed_;
+    while(lo < hi) {
+      uint32_t mid = (lo + hi) / 2;
+      if(block(mid).h.lastTime < from) lo = mid + 1;
+      else hi = mid;
+    }
+    for(uint32_t i = lo; i < sealed_ && block(i).h.firstTime < to; i++) f(block(i));
+    if(open_.h.count && open_.h.lastTime >= from && open_.h.firstTime < to) f(open_);
+  }
+
+  std::string path_;
+  Block open_;
+  void *map_ = nullptr;
+  size_t mapBytes_ = 0;
+  uint32_t sealed_ = 0;
+  uint64_t samples_ = 0;
+  int64_t lastTime_ = INT64_MIN;
+  uint32_t droppedBlocks_ = 0;
+  uint32_t writeErrors_ = 0;
+  bool dirty_ = false;
+};
+
+// ---------------- Store ----------------
+// A directory of series files. Names are kept readable in the file name;
+// anything outside [A-Za-z0-9_-] is written as %XX ("node/temp" →
+// "node%2Ftemp.ts").
+class Store {
+public:
+  bool open(const std::string &dir) {
+    dir_ = dir;
+    mkdir(dir_.c_str(), 0755);
+    DIR *d = opendir(dir_.c_str());
+    if(!d) return false;
+    bool ok = true;
+    while(dirent *e = readdir(d)) {
+      std::string file = e->d_name;
+      if(file.size() < 4 || file.compare(file.size() - 3, 3, ".ts") != 0) continue;
+      ok &= series(unescape(file.substr(0, file.size() - 3))) != nullptr;
+    }
+    closedir(d);
+    return ok;
+  }
+
+  // Opens or creates a series; nullptr if its file cannot be read
+  Series *series(std::string_view name, bool create = true) {
+    key_.assign(name.data(), name.size());   // reused buffer: no allocation per lookup
+    auto it = series_.find(key_);
+    if(it != series_.end()) return it->second.get();
+    if(!create) return nullptr;
+    auto s = std::make_unique<Series>(dir_ + "/" + escape(key_) + ".ts");
+    if(!s->load()) return nullptr;
+    return series_.emplace(key_, std::move(s)).first->second.get();
+  }
+
+  bool append(std::string_view name, int64_t t, int32_t v) {
+    Series *s = series(name);
+    return s && s->append(t, v);
+  }
+
+  void flush() {
+    for(auto &s : series_) s.second->flush();
+  }
+
+  std::vector<std::string> names() const {
+    std::vector<std::string> out;
+    for(auto &s : series_) out.push_back(s.first);
+    std::sort(out.begin(), out.end());
+    return out;
+  }
+
+  uint64_t bytes() const {
+    uint64_t total = 0;
+    for(auto &s : series_) total += s.second->bytes();
+    return total;
+  }
+
+  uint64_t samples() const {
+    uint64_t total = 0;
+    for(auto &s : series_) total += s.second->samples();
+    return total;
+  }
+
+private:
+  static std::string escape(const std::string &name) {
+    std::string out;
+    for(unsigned char c : name) {
+      if(isalnum(c) || c == '_' || c == '-') out += c;
+      else {
+        char hex[4];
+        snprintf(hex, sizeof(hex), "%%%02X", c);
+        out += hex;
+      }
+    }
+    return out;
+  }
+
+  static std::string unescape(const std::string &file) {
+    std::string out;
+    for(size_t i = 0; i < file.size(); i++) {
+      if(file[i] == '%' && i + 2 < file.size()) {
+        out += (char)strtol(file.substr(i + 1, 2).c_str(), nullptr, 16);
+        i += 2;
+      } else out += file[i];
+    }
+    return out;
+  }
+
+  std::string dir_;
+  std::unordered_map<std::string, std::unique_ptr<Series>> series_;
+  std::string key_;
+};
+
+}  // namespace tsdb
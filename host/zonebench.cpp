@@ -0,0 +1,107 @@
+// Scan-pass benchmark for zones.cpp.
+//
+// Runs scanZones() for every zone count from 1 to MAX_ZONES with moving
+// simulated soil readings, and prints one JSON object per zone count:
+// host CPU time per scan (p50/p99), the I/O each scan issues (ADC reads,
+// mux select writes, I2C bytes) and an estimate of the scan time on the
+// board from that I/O. The board figures are a model; the defaults are
+// typical ESP8266 numbers and can be overridden.
+//
+// Build from the repo root:
+//   g++ -std=c++17 -O2 -Ihost host/zonebench.cpp -o zonebench -lpthread
+//
+// Run:
+//   HOST_QUIET=1 ./zonebench [--scans N] [--adc-us 90] [--gpio-us 1]
+
+#include "../zones.cpp"
+
+#include <vector>
+
+static uint64_t adcReads = 0;
+static uint64_t gpioWrites = 0;
+static uint8_t selected = 0;   // mux channel as seen on the select pins
+static uint32_t currentScan = 0;
+
+static void trackPins(uint8_t pin, int value, bool) {
+  static const uint8_t selectPins[4] = { MUX_S0, MUX_S1, MUX_S2, MUX_S3 };
+  gpioWrites++;
+  for(uint8_t bit = 0; bit < 4; bit++) {
+    if(pin == selectPins[bit]) selected = value ? selected | (1 << bit) : selected & ~(1 << bit);
+  }
+}
+
+// Each zone dries out and gets watered on its own slow cycle, so valves
+// actually switch during the run
+static int soilReading(uint8_t ch, uint32_t scan) {
+  double phase = (scan + ch * 97) * 2 * M_PI / (600 + ch * 37);
+  return 575 + (int)(260 * sin(phase)) + (int)((scan * 7919 + ch * 104729) % 21) - 10;
+}
+
+// The ADC input is whichever channel the select pins currently pick
+static int muxInput(uint8_t) {
+  adcReads++;
+  return soilReading(selected, currentScan);
+}
+
+static uint64_t nowNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int main(int argc, char **argv) {
+  uint32_t scans = 20000;
+  double adcUs = 90;     // analogRead() with WiFi on
+  double gpioUs = 1;     // digitalWrite()
+
+  for(int i = 1; i < argc; i++) {
+    std::string a = argv[i];
+    const char *v = i + 1 < argc ? argv[i + 1] : "";
+    if(a == "--scans") { scans = strtoul(v, nullptr, 10); i++; }
+    else if(a == "--adc-us") { adcUs = atof(v); i++; }
+    else if(a == "--gpio-us") { gpioUs = atof(v); i++; }
+    else {
+      fprintf(stderr, "usage: %s [--scans N] [--adc-us US] [--gpio-us US]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  host::virtualClock = true;   // settle delays and dwell timers cost no real time
+  host::onPinWrite = trackPins;
+  host::analogSource = muxInput;
+
+  for(uint8_t count = 1; count <= MAX_ZONES; count++) {
+    zonesBegin();
+    zones.count = count;
+    adcReads = gpioWrites = 0;
+    uint64_t i2cBytes0 = host::i2cBytes, i2cTx0 = host::i2cTransactions;
+    uint32_t switches = 0;
+    std::vector<uint32_t> ns;
+    ns.reserve(scans);
+
+    for(uint32_t scan = 0; scan < scans; scan++) {
+      currentScan = scan;
+      host::advanceMicros(ZONE_SCAN_INTERVAL_MS * 1000UL);
+      uint64_t t0 = nowNs();
+      scanZones();
+      ns.push_back((uint32_t)(nowNs() - t0));
+    }
+    for(uint8_t z = 0; z < count; z++) switches += zones.switches[z];
+
+    std::sort(ns.begin(), ns.end());
+    uint64_t total = 0;
+    for(uint32_t v : ns) total += v;
+    double i2cBytes = (double)(host::i2cBytes - i2cBytes0) / scans;
+    double i2cTx = (double)(host::i2cTransactions - i2cTx0) / scans;
+    // 9 clocks per byte plus start/stop per transfer
+    double i2cUs = (i2cBytes * 9 + i2cTx * 2) * 1e6 / I2C_CLOCK_HZ;
+    double boardUs = (double)adcReads / scans * (adcUs + MUX_SETTLE_US) +
+                     (double)gpioWrites / scans * gpioUs + i2cUs;
+
+    printf("{\"zones\":%d,\"scans\":%u,\"host_ns_avg\":%llu,\"host_ns_p50\":%u,\"host_ns_p99\":%u,"
+           "\"adc_reads_per_scan\":%.2f,\"gpio_writes_per_scan\":%.2f,\"i2c_bytes_per_scan\":%.2f,"
+           "\"valve_switches\":%u,\"board_us_est\":%.1f}\n",
+           count, scans, (unsigned long long)(total / scans), ns[ns.size() / 2], ns[ns.size() * 99 / 100],
+           (double)adcReads / scans, (double)gpioWrites / scans, i2cBytes, switches, boardUs);
+  }
+  return 0;
+}
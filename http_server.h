@@ -0,0 +1,576 @@
+// Web server for the sketches that serve their page themselves: keep-alive
+// connections, the request head parsed in place and routed through a perfect
+// hash built at compile time, responses written straight to the client.
+// Expands the sketch's HTTP_ROUTES table and calls its handlers. Long-polls,
+// handler metrics, tracing and input recording hook in where the sketch has
+// them (LONG_POLL_MAX_CLIENTS, METRICS_BUCKETS, TRACE_NAMES, RECORD_INPUTS).
+#pragma once
+
+#include <string_view>
+
+typedef void (*HandlerFn)();
+
+// Numbered like ESP8266WebServer's HTTPMethod, as recorded in LOG_REC_REQUEST
+enum HttpMethod : uint8_t { METHOD_ANY, METHOD_GET, METHOD_HEAD, METHOD_POST, METHOD_PUT, METHOD_PATCH,
+                            METHOD_DELETE, METHOD_OPTIONS };
+
+// LOAD_SHED routes are answered 503 while HTTP is over its time budget;
+// LOAD_KEEP ones, the operator's commands and settings, are always served
+enum RouteLoad : uint8_t { LOAD_SHED, LOAD_KEEP };
+
+// Query argument, URL-decoded in place; both views are NUL-terminated
+struct HttpArg {
+  std::string_view name;
+  std::string_view value;
+};
+
+WiFiServer server(HTTP_PORT);
+
+// An accepted connection. An OPEN one is waiting for its next request or
+// reading it; a HELD one carries a long-poll that serviceHeldPolls() answers.
+enum HttpConnState : uint8_t { CONN_FREE, CONN_OPEN, CONN_HELD };
+
+struct HttpConn {
+  WiFiClient client;
+  HttpConnState state;
+  bool keepAlive;               // HELD: stays open after the held response
+  unsigned long lastUsed;       // millis() of the accept or the last response
+};
+
+HttpConn httpConns[HTTP_MAX_CONNS];
+int8_t httpCurrent = -1;            // connection whose request is in httpRequest, -1 for none
+uint8_t httpNextConn = 0;           // where the round-robin search for the next request starts
+uint32_t httpConnections = 0;       // accepted since boot
+uint32_t httpWindowStart = 0;       // millis() the current budget window began
+uint32_t httpWindowUsedUs = 0;      // HTTP time spent in it
+uint32_t httpShed = 0;              // requests answered 503 over budget
+uint32_t httpDeferred = 0;          // pollHttp() runs cut short by the pass budget or a due task
+uint32_t httpOverruns = 0;          // single requests longer than the whole pass budget
+
+// The request being read or handled; httpPath and httpArgs point into httpRequest
+WiFiClient httpClient;
+char httpRequest[HTTP_REQUEST_BYTES];
+uint16_t httpRequestLen = 0;
+uint8_t httpHeadMatched = 0;        // bytes of the closing "\r\n\r\n" seen so far
+uint16_t httpHeadLen = 0;           // once the head is complete, its length; the body and pipelined requests follow
+uint16_t httpBodyLen = 0;           // Content-Length of the request being handled
+bool httpKeepAlive = false;         // the connection stays open after this response
+unsigned long httpRequestStart = 0;
+HttpMethod httpMethod = METHOD_GET;
+std::string_view httpPath;
+HttpArg httpArgs[HTTP_MAX_ARGS];
+uint8_t httpArgCount = 0;
+
+// buildRouteTable() looks for a hash seed that gives every path its own
+// slot, so a lookup is one hash and one string compare
+#define ROUTE_PATH_OF(path, method, load, fn) path,
+#define ROUTE_METHOD_OF(path, method, load, fn) method,
+#define ROUTE_LOAD_OF(path, method, load, fn) load,
+#define ROUTE_HANDLER_OF(path, method, load, fn) fn,
+constexpr std::string_view routePaths[] = { HTTP_ROUTES(ROUTE_PATH_OF) };
+constexpr HttpMethod routeMethods[] = { HTTP_ROUTES(ROUTE_METHOD_OF) };
+constexpr RouteLoad routeLoads[] = { HTTP_ROUTES(ROUTE_LOAD_OF) };
+const HandlerFn routeHandlers[] = { HTTP_ROUTES(ROUTE_HANDLER_OF) };
+
+#define ROUTE_NO_SEED 0xFFFFFFFF
+
+struct RouteTable {
+  uint32_t seed;
+  int8_t slot[HTTP_ROUTE_SLOTS];    // route index, -1 = free
+};
+
+// FNV-1a, seeded. Its low bits depend only on the low bits of the input
+// bytes, so the high half is folded in before masking.
+constexpr uint32_t routeHash(std::string_view path, uint32_t seed) {
+  uint32_t h = 2166136261u ^ seed;
+  for(char c : path) h = (h ^ (uint8_t)c) * 16777619u;
+  return h ^ h >> 16;
+}
+
+constexpr RouteTable buildRouteTable() {
+  for(uint32_t seed = 0; seed < 1000; seed++) {
+    RouteTable t = { seed, {} };
+    for(int8_t &s : t.slot) s = -1;
+    bool ok = true;
+    for(int8_t r = 0; r < HTTP_ROUTE_COUNT && ok; r++) {
+      int8_t &s = t.slot[routeHash(routePaths[r], seed) & (HTTP_ROUTE_SLOTS - 1)];
+      ok = s < 0;
+      s = r;
+    }
+    if(ok) return t;
+  }
+  return { ROUTE_NO_SEED, {} };
+}
+
+constexpr RouteTable routeTable = buildRouteTable();
+static_assert((HTTP_ROUTE_SLOTS & (HTTP_ROUTE_SLOTS - 1)) == 0, "HTTP_ROUTE_SLOTS must be a power of two");
+static_assert(routeTable.seed != ROUTE_NO_SEED, "no collision-free route hash; raise HTTP_ROUTE_SLOTS");
+
+// ---------------- Prototypes ----------------
+// Plain C++ needs these; the Arduino IDE generates them only for .ino files
+void httpHandleClient();
+void httpSweepConns();
+void httpAcceptConn();
+bool httpTakeReadable();
+void httpCloseConn(int8_t i);
+void httpHeadStep(char c);
+void httpScanHead(uint16_t from);
+void httpDispatch();
+bool httpOverBudget();
+bool httpParseRequest();
+void httpParseArgs(char *query);
+const char *httpHeaderValue(const char *from, const char *name);
+bool httpHeaderHas(const char *from, const char *name, const char *token);
+int32_t httpBodyLength();
+size_t httpUrlDecode(char *s);
+uint8_t hexDigit(char c);
+const char *routeName(uint8_t route);
+int8_t findRoute(std::string_view path);
+bool httpHasArg(std::string_view name);
+std::string_view httpArg(std::string_view name);
+long httpArgInt(std::string_view name);
+const char *httpReason(int code);
+void httpSend(int code, const char *type, const char *body, size_t len);
+void httpSendShed();
+void httpSend(int code, const char *type, const char *body);
+void httpSend(int code, const char *type, const String &body);
+void httpBeginChunked(int code, const char *type);
+void httpSendChunk(const char *data, size_t len);
+void httpEndChunked();
+
+// ---------------- HTTP Server ----------------
+// Connections stay open between requests (HTTP/1.1 keep-alive), up to
+// HTTP_MAX_CONNS of them. One at a time owns httpRequest while its request
+// head and body arrive; the others wait with their bytes in the TCP stack. Requests
+// pipelined behind a head are served in order from what is left in the
+// buffer. Serves at most one request per call and never waits on the
+// network; pollHttp() comes back for the rest.
+void httpHandleClient() {
+  httpSweepConns();
+  httpAcceptConn();
+  if(httpCurrent < 0 && !httpTakeReadable()) return;
+  HttpConn &c = httpConns[httpCurrent];
+
+  // Keep what fits of the head. Past that, read no further than the head's
+  // end can be, so a pipelined request behind it is not read into the void.
+  while(httpHeadMatched < 4) {
+    int available = c.client.available();
+    if(available <= 0) break;
+    char skip[4];
+    bool room = httpRequestLen < sizeof(httpRequest) - 1;
+    char *to = room ? httpRequest + httpRequestLen : skip;
+    size_t want = room ? sizeof(httpRequest) - 1 - httpRequestLen : 4 - httpHeadMatched;
+    int n = c.client.read((uint8_t *)to, want < (size_t)available ? want : available);
+    if(n <= 0) break;
+    if(room) {
+      httpRequestLen += n;
+      httpScanHead(httpRequestLen - n);
+    } else {
+      for(int i = 0; i < n; i++) httpHeadStep(skip[i]);
+      if(httpHeadMatched == 4) httpHeadLen = httpRequestLen;
+    }
+  }
+
+  // A body is read whole into the buffer after the head. One that does not
+  // fit, or has no Content-Length, is refused and the connection closed, as
+  // its bytes would otherwise be taken for the next request.
+  int32_t bodyLen = 0;
+  if(httpHeadMatched == 4) {
+    char next = httpRequest[httpHeadLen];
+    httpRequest[httpHeadLen] = '\0';
+    bodyLen = httpBodyLength();
+    httpRequest[httpHeadLen] = next;
+    if(bodyLen < 0 || httpHeadLen + bodyLen > (int32_t)sizeof(httpRequest) - 1) {
+      httpClient = c.client;
+      httpKeepAlive = false;
+      if(bodyLen < 0) httpSend(411, "text/plain", "Length Required");
+      else httpSend(413, "text/plain", "Payload Too Large");
+      httpClient = WiFiClient();
+      httpCloseConn(httpCurrent);
+      httpCurrent = -1;
+      return;
+    }
+    while(httpRequestLen < httpHeadLen + bodyLen) {
+      int available = c.client.available();
+      if(available <= 0) break;
+      size_t room = sizeof(httpRequest) - 1 - httpRequestLen;
+      int n = c.client.read((uint8_t *)httpRequest + httpRequestLen, room < (size_t)available ? room : available);
+      if(n <= 0) break;
+      httpRequestLen += n;
+    }
+  }
+  if(httpHeadMatched < 4 || httpRequestLen < httpHeadLen + bodyLen) {
+    if(!c.client.connected() || millis() - httpRequestStart > HTTP_READ_TIMEOUT_MS) {
+      httpCloseConn(httpCurrent);
+      httpCurrent = -1;
+    }
+    return;
+  }
+
+  // The parser wants the head and the body NUL-terminated: the head at its
+  // last '\n', the body at its end, where the byte under the NUL may start
+  // the next request
+  uint16_t end = httpHeadLen + bodyLen;
+  char next = httpRequest[end];
+  httpRequest[end] = '\0';
+  if(bodyLen > 0) httpRequest[httpHeadLen - 1] = '\0';
+  httpBodyLen = bodyLen;
+  httpClient = c.client;
+  httpDispatch();
+  httpClient = WiFiClient();
+  httpRequest[end] = next;
+  httpBodyLen = 0;
+  // A head cut short may have lost its Content-Length, so nothing after it
+  // can be trusted to start a request
+  if(httpHeadLen == sizeof(httpRequest) - 1) httpKeepAlive = false;
+
+  uint16_t left = httpRequestLen - end;
+  if(c.state == CONN_HELD) {
+    // Its answer comes later and nothing behind it may overtake it: requests
+    // already pipelined after it are dropped and the connection closes after
+    // the held response, so the client sends them again
+    c.keepAlive = httpKeepAlive && left == 0;
+    httpCurrent = -1;
+  } else if(!httpKeepAlive) {
+    httpCloseConn(httpCurrent);
+    httpCurrent = -1;
+  } else {
+    c.lastUsed = millis();
+    memmove(httpRequest, httpRequest + end, left);
+    httpRequestLen = left;
+    httpHeadMatched = 0;
+    httpHeadLen = 0;
+    httpRequestStart = millis();
+    httpScanHead(0);
+    if(left == 0) httpCurrent = -1;
+  }
+}
+
+// Closes connections whose peer has gone and kept-alive ones idle for
+// HTTP_IDLE_TIMEOUT_MS
+void httpSweepConns() {
+  for(int8_t i = 0; i < HTTP_MAX_CONNS; i++) {
+    HttpConn &c = httpConns[i];
+    if(c.state != CONN_OPEN || i == httpCurrent) continue;
+    if(!c.client.connected() || millis() - c.lastUsed > HTTP_IDLE_TIMEOUT_MS) httpCloseConn(i);
+  }
+}
+
+// Takes a waiting connection into a free slot. With every slot in use the
+// connection idle longest is closed to make room; if all of them hold
+// long-polls, the oldest is answered now and the accept waits for its slot.
+void httpAcceptConn() {
+  if(!server.hasClient()) return;
+  int8_t slot = -1, idle = -1, held = -1;
+  for(int8_t i = 0; i < HTTP_MAX_CONNS && slot < 0; i++) {
+    HttpConn &c = httpConns[i];
+    if(c.state == CONN_FREE) slot = i;
+    if(i == httpCurrent) continue;
+    if(c.state == CONN_OPEN && (idle < 0 || (long)(c.lastUsed - httpConns[idle].lastUsed) < 0)) idle = i;
+    if(c.state == CONN_HELD && (held < 0 || (long)(c.lastUsed - httpConns[held].lastUsed) < 0)) held = i;
+  }
+  if(slot < 0 && idle >= 0) {
+    httpCloseConn(idle);
+    slot = idle;
+  }
+  if(slot < 0) {
+#ifdef LONG_POLL_MAX_CLIENTS
+    if(held >= 0) releaseHeldPoll(held);
+#endif
+    return;
+  }
+
+  HttpConn &c = httpConns[slot];
+  c.client = server.accept();
+  if(!c.client) return;
+  c.state = CONN_OPEN;
+  c.lastUsed = millis();
+  httpConnections++;
+}
+
+// Gives httpRequest to the next open connection with bytes waiting, round robin
+bool httpTakeReadable() {
+  for(uint8_t k = 0; k < HTTP_MAX_CONNS; k++) {
+    uint8_t i = (httpNextConn + k) % HTTP_MAX_CONNS;
+    HttpConn &c = httpConns[i];
+    if(c.state != CONN_OPEN || c.client.available() <= 0) continue;
+    httpNextConn = (i + 1) % HTTP_MAX_CONNS;
+    httpCurrent = i;
+    httpRequestLen = 0;
+    httpHeadMatched = 0;
+    httpHeadLen = 0;
+    httpRequestStart = millis();
+    return true;
+  }
+  return false;
+}
+
+void httpCloseConn(int8_t i) {
+  httpConns[i].client.stop();
+  httpConns[i].client = WiFiClient();
+  httpConns[i].state = CONN_FREE;
+}
+
+// Advances the match of the "\r\n\r\n" that ends a request head
+void httpHeadStep(char c) {
+  httpHeadMatched = c == "\r\n\r\n"[httpHeadMatched] ? httpHeadMatched + 1 : c == '\r';
+}
+
+// Looks for the end of the head in httpRequest from `from` on
+void httpScanHead(uint16_t from) {
+  for(uint16_t i = from; i < httpRequestLen && httpHeadMatched < 4; i++) {
+    httpHeadStep(httpRequest[i]);
+    if(httpHeadMatched == 4) httpHeadLen = i + 1;
+  }
+}
+
+// Parses httpRequest (NUL-terminated) in place and runs the route's handler,
+// timed under its route. host/replay.cpp fills httpRequest and calls this.
+void httpDispatch() {
+  if(!httpParseRequest()) {
+    httpSend(400, "text/plain", "Bad Request");
+    return;
+  }
+  int8_t route = findRoute(httpPath);
+  if(route < 0) {
+    httpSend(404, "text/plain", "Not Found");
+    return;
+  }
+  if(routeMethods[route] != METHOD_ANY && routeMethods[route] != httpMethod) {
+    httpSend(405, "text/plain", "Method Not Allowed");
+    return;
+  }
+  if(routeLoads[route] == LOAD_SHED && httpOverBudget()) {
+    httpShed++;
+    httpSendShed();
+    return;
+  }
+#ifdef RECORD_INPUTS
+  if(RECORD_INPUTS) recordRequest();
+#endif
+#ifdef METRICS_BUCKETS
+  unsigned long startUs = micros();
+  httpRequests++;
+#endif
+#ifdef TRACE_NAMES
+  traceBegin(TRACE_HANDLER_BASE + route);
+#endif
+  routeHandlers[route]();
+#ifdef TRACE_NAMES
+  traceEnd(TRACE_HANDLER_BASE + route);
+#endif
+#ifdef METRICS_BUCKETS
+  observe(handlerHist[route], micros() - startUs);
+#endif
+}
+
+// True while HTTP has used up the current window's budget
+bool httpOverBudget() {
+  return millis() - httpWindowStart < HTTP_WINDOW_MS && httpWindowUsedUs >= HTTP_WINDOW_BUDGET_US;
+}
+
+// Splits "GET /path?a=1&b=x%20y HTTP/1.1" where it lies: NULs end the path
+// and each argument name and value, which are then URL-decoded in place
+bool httpParseRequest() {
+  httpKeepAlive = false;
+  char *target = strchr(httpRequest, ' ');
+  if(!target || *++target != '/') return false;
+  std::string_view method(httpRequest, target - 1 - httpRequest);
+  httpMethod = method == "GET" ? METHOD_GET : method == "POST" ? METHOD_POST : method == "HEAD" ? METHOD_HEAD
+             : method == "PUT" ? METHOD_PUT : method == "DELETE" ? METHOD_DELETE : method == "PATCH" ? METHOD_PATCH
+             : method == "OPTIONS" ? METHOD_OPTIONS : METHOD_ANY;
+
+  char *end = strpbrk(target, " \r\n");
+  if(!end) return false;
+  // HTTP/1.1 keeps the connection unless the client says close, HTTP/1.0 only if it asks
+  httpKeepAlive = strncmp(end, " HTTP/1.1\r", 10) == 0 ? !httpHeaderHas(end, "Connection", "close")
+                                                       : httpHeaderHas(end, "Connection", "keep-alive");
+  // Form fields in the body are arguments too, after the query's, as in
+  // ESP8266WebServer; other bodies are read and left to the handler
+  bool form = httpBodyLen > 0 && httpHeaderHas(end, "Content-Type", "application/x-www-form-urlencoded");
+  *end = '\0';
+  char *query = strchr(target, '?');
+  if(query) *query++ = '\0';
+  httpPath = std::string_view(target, httpUrlDecode(target));
+
+  httpArgCount = 0;
+  httpParseArgs(query);
+  if(form) httpParseArgs(httpRequest + httpHeadLen);
+  return true;
+}
+
+// Adds the arguments of "a=1&b=x%20y", split and decoded in place
+void httpParseArgs(char *query) {
+  while(query && *query && httpArgCount < HTTP_MAX_ARGS) {
+    char *next = strchr(query, '&');
+    if(next) *next++ = '\0';
+    char *value = strchr(query, '=');
+    if(value) *value++ = '\0';
+    if(*query) {
+      HttpArg &a = httpArgs[httpArgCount++];
+      a.name = std::string_view(query, httpUrlDecode(query));
+      a.value = value ? std::string_view(value, httpUrlDecode(value)) : std::string_view("");
+    }
+    query = next;
+  }
+}
+
+// Value of the first header line after `from` named `name`, compared
+// without regard to case, up to the line's end; NULL if there is none
+const char *httpHeaderValue(const char *from, const char *name) {
+  size_t nameLen = strlen(name);
+  for(const char *line = strchr(from, '\n'); line; line = strchr(line, '\n')) {
+    line++;
+    if((*line | 0x20) != (*name | 0x20) || strncasecmp(line, name, nameLen) != 0 || line[nameLen] != ':') continue;
+    return line + nameLen + 1;
+  }
+  return nullptr;
+}
+
+// True if the first header line after `from` named `name` has `token`
+// (lower case) in its value; both are compared without regard to case
+bool httpHeaderHas(const char *from, const char *name, const char *token) {
+  const char *value = httpHeaderValue(from, name);
+  if(!value) return false;
+  size_t tokenLen = strlen(token);
+  const char *eol = strchr(value, '\r');
+  if(!eol) eol = value + strlen(value);
+  for(const char *p = value; p + tokenLen <= eol; p++) {
+    if((*p | 0x20) == *token && strncasecmp(p, token, tokenLen) == 0) return true;
+  }
+  return false;
+}
+
+// Body length from the head in httpRequest (NUL-terminated): 0 without a
+// body, -1 if it is chunked or its Content-Length is not a plain number
+int32_t httpBodyLength() {
+  if(httpHeaderHas(httpRequest, "Transfer-Encoding", "chunked")) return -1;
+  const char *value = httpHeaderValue(httpRequest, "Content-Length");
+  if(!value) return 0;
+  while(*value == ' ') value++;
+  char *end;
+  unsigned long len = strtoul(value, &end, 10);
+  if(end == value || !isdigit(*value) || (*end != '\r' && *end != '\0') || len > INT16_MAX) return -1;
+  return len;
+}
+
+// Decodes %XX and '+' in place; returns the new length
+size_t httpUrlDecode(char *s) {
+  char *out = s;
+  for(const char *in = s; *in; in++) {
+    if(*in == '+') {
+      *out++ = ' ';
+    } else if(*in == '%' && isxdigit(in[1]) && isxdigit(in[2])) {
+      *out++ = hexDigit(in[1]) << 4 | hexDigit(in[2]);
+      in += 2;
+    } else {
+      *out++ = *in;
+    }
+  }
+  *out = '\0';
+  return out - s;
+}
+
+uint8_t hexDigit(char c) {
+  return c <= '9' ? c - '0' : (c | 0x20) - 'a' + 10;
+}
+
+// The route's path, for the trace dump
+const char *routeName(uint8_t route) {
+  return routePaths[route].data();
+}
+
+// Route index for the path, -1 if there is none
+int8_t findRoute(std::string_view path) {
+  int8_t route = routeTable.slot[routeHash(path, routeTable.seed) & (HTTP_ROUTE_SLOTS - 1)];
+  return route >= 0 && routePaths[route] == path ? route : -1;
+}
+
+bool httpHasArg(std::string_view name) {
+  for(uint8_t i = 0; i < httpArgCount; i++) {
+    if(httpArgs[i].name == name) return true;
+  }
+  return false;
+}
+
+// Value of the named argument, "" if it is absent
+std::string_view httpArg(std::string_view name) {
+  for(uint8_t i = 0; i < httpArgCount; i++) {
+    if(httpArgs[i].name == name) return httpArgs[i].value;
+  }
+  return "";
+}
+
+// Like String::toInt(): the leading number, 0 if there is none
+long httpArgInt(std::string_view name) {
+  return atol(httpArg(name).data());
+}
+
+const char *httpReason(int code) {
+  switch(code) {
+    case 200: return "OK";
+    case 304: return "Not Modified";
+    case 400: return "Bad Request";
+    case 404: return "Not Found";
+    case 405: return "Method Not Allowed";
+    case 409: return "Conflict";
+    case 411: return "Length Required";
+    case 413: return "Payload Too Large";
+    case 503: return "Service Unavailable";
+    default: return "Status";
+  }
+}
+
+// Sends a whole response. A body that fits after the head goes out in the same write.
+void httpSend(int code, const char *type, const char *body, size_t len) {
+  char head[HTTP_HEAD_BYTES];
+  size_t n = snprintf(head, sizeof(head), "HTTP/1.1 %d %s\r\nContent-Type: %s\r\nContent-Length: %u\r\n"
+                      "Connection: %s\r\n\r\n", code, httpReason(code), type, (unsigned)len,
+                      httpKeepAlive ? "keep-alive" : "close");
+  if(n + len <= sizeof(head)) {
+    memcpy(head + n, body, len);
+    httpClient.write((const uint8_t *)head, n + len);
+  } else {
+    httpClient.write((const uint8_t *)head, n);
+    httpClient.write((const uint8_t *)body, len);
+  }
+}
+
+// The answer to a request shed over budget: come back in HTTP_RETRY_AFTER_S
+void httpSendShed() {
+  char head[HTTP_HEAD_BYTES];
+  size_t n = snprintf(head, sizeof(head), "HTTP/1.1 503 %s\r\nContent-Type: text/plain\r\nContent-Length: 5\r\n"
+                      "Retry-After: %d\r\nConnection: %s\r\n\r\nBusy\n", httpReason(503), HTTP_RETRY_AFTER_S,
+                      httpKeepAlive ? "keep-alive" : "close");
+  httpClient.write((const uint8_t *)head, n);
+}
+
+void httpSend(int code, const char *type, const char *body) {
+  httpSend(code, type, body, strlen(body));
+}
+
+void httpSend(int code, const char *type, const String &body) {
+  httpSend(code, type, body.c_str(), body.length());
+}
+
+// Chunked response for a body streamed in pieces: httpSendChunk() for each
+// piece, then httpEndChunked()
+void httpBeginChunked(int code, const char *type) {
+  char head[HTTP_HEAD_BYTES];
+  size_t n = snprintf(head, sizeof(head), "HTTP/1.1 %d %s\r\nContent-Type: %s\r\nTransfer-Encoding: chunked\r\n"
+                      "Connection: %s\r\n\r\n", code, httpReason(code), type, httpKeepAlive ? "keep-alive" : "close");
+  httpClient.write((const uint8_t *)head, n);
+}
+
+void httpSendChunk(const char *data, size_t len) {
+  if(len == 0) return;    // an empty chunk would end the body
+  char size[12];
+  size_t n = snprintf(size, sizeof(size), "%x\r\n", (unsigned)len);
+  httpClient.write((const uint8_t *)size, n);
+  httpClient.write((const uint8_t *)data, len);
+  httpClient.write((const uint8_t *)"\r\n", 2);
+}
+
+void httpEndChunked() {
+  httpClient.write((const uint8_t *)"0\r\n\r\n", 5);
+}
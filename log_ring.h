@@ -0,0 +1,134 @@
+// Runtime log records, queued as binary in a RAM ring and sent to Serial
+// while the scheduler idles. The settings and the LOG_FORMATS table stay in
+// the sketch ("Logging"), where host/logdecode.cpp reads them.
+#pragma once
+
+#include <string_view>
+
+// Log ids and levels from LOG_FORMATS; the format text is not compiled in
+#define LOG_ID_OF(id, level, text) id,
+#define LOG_LEVEL_OF(id, level, text) level,
+enum LogId : uint8_t { LOG_FORMATS(LOG_ID_OF) LOG_FORMAT_COUNT };
+constexpr uint8_t logLevels[] = { LOG_FORMATS(LOG_LEVEL_OF) };
+
+// Queues a record unless its level is compiled out. Arguments are integers,
+// bools, const char * or String, in the order of the format's conversions.
+#define LOG(id, ...) do { if(logLevels[id] <= LOG_LEVEL) logRecord(id, ##__VA_ARGS__); } while(0)
+#define LOG_NAN  -32768     // %C argument for a failed reading
+
+// Input records for host/replay.cpp: on with RECORD_INPUTS, whatever LOG_LEVEL
+#define RECORD(id, ...) do { if(RECORD_INPUTS) logRecord(id, ##__VA_ARGS__); } while(0)
+
+uint8_t logRing[LOG_RING_BYTES];
+uint16_t logHead = 0, logTail = 0;  // next byte to queue / to send; equal when empty
+uint32_t logRecords = 0;
+uint32_t logDropped = 0;            // lost to a full ring, not yet reported
+uint32_t logDroppedTotal = 0;
+
+// ---------------- Prototypes ----------------
+// Plain C++ needs these; the Arduino IDE generates them only for .ino files
+void logPutVarint(uint8_t *buf, uint8_t &len, int64_t value);
+void logPutString(uint8_t *buf, uint8_t &len, const char *s);
+void logPutArg(uint8_t *buf, uint8_t &len, const char *s);
+void logPutArg(uint8_t *buf, uint8_t &len, const String &s);
+void logPutArg(uint8_t *buf, uint8_t &len, std::string_view s);
+uint16_t logFree();
+void logPutByte(uint8_t b);
+void logWrite(uint8_t id, const uint8_t *payload, uint8_t len);
+void logDrain();
+void logFlush();
+
+// ---------------- Logging ----------------
+// Record: LOG_SYNC, format id, payload length, payload, checksum (8-bit sum
+// of id, length and payload). The payload is millis() and then the
+// arguments: integers as zigzag varints, strings as a length byte and text.
+void logPutVarint(uint8_t *buf, uint8_t &len, int64_t value) {
+  uint64_t v = ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+  while(v >= 0x80) {
+    buf[len++] = (uint8_t)v | 0x80;
+    v >>= 7;
+  }
+  buf[len++] = (uint8_t)v;
+}
+
+void logPutString(uint8_t *buf, uint8_t &len, const char *s) {
+  uint8_t n = strnlen(s, LOG_MAX_STRING);
+  buf[len++] = n;
+  memcpy(buf + len, s, n);
+  len += n;
+}
+
+void logPutArg(uint8_t *buf, uint8_t &len, const char *s) { logPutString(buf, len, s); }
+void logPutArg(uint8_t *buf, uint8_t &len, const String &s) { logPutString(buf, len, s.c_str()); }
+void logPutArg(uint8_t *buf, uint8_t &len, std::string_view s) {
+  uint8_t n = s.size() < LOG_MAX_STRING ? s.size() : LOG_MAX_STRING;
+  buf[len++] = n;
+  memcpy(buf + len, s.data(), n);
+  len += n;
+}
+template<typename T> void logPutArg(uint8_t *buf, uint8_t &len, T value) { logPutVarint(buf, len, (int64_t)value); }
+
+// Encodes on the stack and copies into the ring: no formatting, no allocation
+template<typename... Args> void logRecord(uint8_t id, const Args &...args) {
+  static_assert(sizeof...(Args) <= LOG_MAX_ARGS, "too many log arguments");
+  uint8_t payload[5 + LOG_MAX_ARGS * (LOG_MAX_STRING + 1)];
+  uint8_t len = 0;
+  logPutVarint(payload, len, millis());
+  (logPutArg(payload, len, args), ...);
+  logWrite(id, payload, len);
+}
+
+uint16_t logFree() {
+  // One byte always stays free so that a full ring differs from an empty one
+  return LOG_RING_BYTES - 1 - (logHead + LOG_RING_BYTES - logTail) % LOG_RING_BYTES;
+}
+
+void logPutByte(uint8_t b) {
+  logRing[logHead] = b;
+  logHead = (logHead + 1) % LOG_RING_BYTES;
+}
+
+// Appends one record, or counts it as dropped when the ring is full
+void logWrite(uint8_t id, const uint8_t *payload, uint8_t len) {
+  if(logFree() < len + 4) {
+    logDropped++;
+    logDroppedTotal++;
+    return;
+  }
+  uint8_t sum = id + len;
+  logPutByte(LOG_SYNC);
+  logPutByte(id);
+  logPutByte(len);
+  for(uint8_t i = 0; i < len; i++) {
+    logPutByte(payload[i]);
+    sum += payload[i];
+  }
+  logPutByte(sum);
+  logRecords++;
+}
+
+// Hands the UART only what fits in its TX FIFO, so this never waits
+void logDrain() {
+  int room = Serial.availableForWrite();
+  while(room > 0 && logTail != logHead) {
+    uint16_t n = (logHead > logTail ? logHead : LOG_RING_BYTES) - logTail;
+    if(n > room) n = room;
+    Serial.write(logRing + logTail, n);
+    logTail = (logTail + n) % LOG_RING_BYTES;
+    room -= n;
+  }
+  // Report losses once there is room for the report
+  if(logDropped > 0 && logFree() > 16) {
+    LOG(LOG_DROPPED, logDropped);
+    logDropped = 0;
+  }
+}
+
+// Sends everything queued, waiting on the UART; before deep sleep and for trace dumps
+void logFlush() {
+  while(logTail != logHead) {
+    logDrain();
+    yield();
+  }
+  Serial.flush();
+}
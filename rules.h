@@ -0,0 +1,502 @@
+// Automation rules engine: the compiler from rule text to bytecode, the
+// verifier for code read back from flash, the interpreter and the flash log.
+// The sketch sets the limits ("Automation Rules") and provides ruleInputs().
+#pragma once
+
+// Rule bytecode, postfix: each rule's expression, then OP_OUT with its
+// target and hold time. Values are centi-units (31.5°C = 3150, 45% = 4500),
+// conditions 0 or 1.
+enum RuleOp : uint8_t {
+  OP_VAR,       // + variable index
+  OP_CONST,     // + int16, little-endian
+  OP_LT, OP_LE, OP_GT, OP_GE, OP_EQ, OP_NE,
+  OP_AND, OP_OR,
+  OP_NOT,
+  OP_OUT,       // + target, + uint16 hold seconds, little-endian
+  OP_COUNT
+};
+
+enum RuleType : uint8_t { RULE_NUMBER, RULE_BOOL, RULE_ERROR };
+enum RuleTarget : uint8_t { RULE_PUMP, RULE_LIGHT, RULE_TARGETS };
+
+// What a rule can read, in OP_VAR index order
+struct RuleVar {
+  const char *name;
+  RuleType type;
+};
+
+const RuleVar ruleVars[] = {
+  { "temp", RULE_NUMBER }, { "hum", RULE_NUMBER }, { "light", RULE_NUMBER },
+  { "pumpOn", RULE_BOOL }, { "lightOn", RULE_BOOL },
+};
+#define RULE_VAR_COUNT (sizeof(ruleVars) / sizeof(ruleVars[0]))
+const char *const ruleTargetNames[RULE_TARGETS] = { "pump", "light" };
+
+// A compiled rule set and the text it came from, swapped in as a whole
+struct RuleSet {
+  uint8_t codeLen;          // 0: no rules
+  uint8_t targets;          // bit per RuleTarget a rule drives
+  uint8_t reserved[2];
+  uint8_t code[RULES_CODE_BYTES];
+  char source[RULES_SOURCE_BYTES];   // NUL-terminated
+};
+
+// One entry of the rules log, kept like the config log
+struct RuleSlot {
+  uint32_t seq;
+  RuleSet rules;
+  uint32_t crc;   // over seq and rules
+};
+
+// Compiler state for one upload
+struct RuleParser {
+  const char *start;
+  const char *p;            // next character
+  RuleSet *out;
+  uint8_t depth;            // stack slots the code so far leaves
+  uint8_t nesting;
+  const char *error;        // first error, NULL while there is none
+  const char *errorAt;
+};
+
+RuleSet rules;                  // codeLen 0 until loaded or uploaded
+RuleSet pendingRules;
+bool rulesPending = false;
+uint32_t rulesSeq = 0;          // seq of the newest slot
+uint16_t rulesNextSlot = 0;     // first free slot in the sector
+bool ruleHolding[RULE_TARGETS];             // a "for" rule's condition has held since ruleHoldSince
+unsigned long ruleHoldSince[RULE_TARGETS];
+
+// ---------------- Prototypes ----------------
+// Plain C++ needs these; the Arduino IDE generates them only for .ino files
+bool ruleWordChar(char c);
+void ruleSkipSpace(RuleParser &ps);
+void ruleFail(RuleParser &ps, const char *error);
+bool ruleAccept(RuleParser &ps, const char *tok);
+void ruleEmit(RuleParser &ps, uint8_t byte);
+void ruleStack(RuleParser &ps, int8_t change);
+bool ruleNest(RuleParser &ps);
+RuleType ruleValue(RuleParser &ps);
+RuleType ruleCompare(RuleParser &ps);
+RuleType ruleNot(RuleParser &ps);
+RuleType ruleLogic(RuleParser &ps, bool isOr);
+RuleType ruleOr(RuleParser &ps);
+bool ruleHold(RuleParser &ps, uint16_t &seconds);
+bool compileRules(const char *text, RuleSet &out, char *error, size_t errorLen);
+bool verifyRules(const RuleSet &r);
+void evalRules(const RuleSet &r, const int32_t vars[RULE_VAR_COUNT], bool want[RULE_TARGETS]);
+void clearRuleHolds();
+uint32_t ruleSlotAddress(uint16_t slot);
+uint32_t ruleSlotCrc(const RuleSlot &s);
+bool ruleSlotUsed(uint16_t slot);
+void loadRules();
+void saveRules();
+void applyPendingRules();
+String rulesJson(const RuleSet &r);
+
+// Defined by the sketch: its readings, in ruleVars order
+void ruleInputs(int32_t vars[RULE_VAR_COUNT]);
+
+// ---------------- Automation Rules ----------------
+bool ruleWordChar(char c) {
+  return isalnum((unsigned char)c) || c == '_';
+}
+
+void ruleSkipSpace(RuleParser &ps) {
+  while(*ps.p == ' ' || *ps.p == '\t' || *ps.p == '\r') ps.p++;
+}
+
+// Keeps the first error only; everything after it is noise
+void ruleFail(RuleParser &ps, const char *error) {
+  if(ps.error) return;
+  ps.error = error;
+  ps.errorAt = ps.p;
+}
+
+// Consumes tok if it comes next; a word must not run on into a longer one
+bool ruleAccept(RuleParser &ps, const char *tok) {
+  ruleSkipSpace(ps);
+  size_t n = strlen(tok);
+  if(strncmp(ps.p, tok, n) != 0) return false;
+  if(ruleWordChar(tok[0]) && ruleWordChar(ps.p[n])) return false;
+  ps.p += n;
+  return true;
+}
+
+void ruleEmit(RuleParser &ps, uint8_t byte) {
+  if(ps.out->codeLen >= RULES_CODE_BYTES) {
+    ruleFail(ps, "rules too long");
+    return;
+  }
+  ps.out->code[ps.out->codeLen++] = byte;
+}
+
+// Follows the interpreter's stack: +1 per value pushed, -1 per binary operator
+void ruleStack(RuleParser &ps, int8_t change) {
+  ps.depth += change;
+  if(ps.depth > RULES_STACK) ruleFail(ps, "expression too deep");
+}
+
+bool ruleNest(RuleParser &ps) {
+  if(++ps.nesting <= RULES_MAX_NESTING) return true;
+  ruleFail(ps, "nested too deep");
+  return false;
+}
+
+// A number, a name or a parenthesised expression
+RuleType ruleValue(RuleParser &ps) {
+  if(ruleAccept(ps, "(")) {
+    if(!ruleNest(ps)) return RULE_ERROR;
+    RuleType t = ruleOr(ps);
+    ps.nesting--;
+    if(t == RULE_ERROR) return t;
+    if(!ruleAccept(ps, ")")) {
+      ruleFail(ps, "expected )");
+      return RULE_ERROR;
+    }
+    return t;
+  }
+  int16_t centi;
+  const char *end = scanCenti(ps.p, centi);
+  if(end) {
+    if(ruleWordChar(*end)) {
+      ruleFail(ps, "bad number");
+      return RULE_ERROR;
+    }
+    ps.p = end;
+    ruleEmit(ps, OP_CONST);
+    ruleEmit(ps, centi & 0xFF);
+    ruleEmit(ps, (uint16_t)centi >> 8);
+    ruleStack(ps, 1);
+    return ps.error ? RULE_ERROR : RULE_NUMBER;
+  }
+  for(uint8_t i = 0; i < RULE_VAR_COUNT; i++) {
+    if(!ruleAccept(ps, ruleVars[i].name)) continue;
+    ruleEmit(ps, OP_VAR);
+    ruleEmit(ps, i);
+    ruleStack(ps, 1);
+    return ps.error ? RULE_ERROR : ruleVars[i].type;
+  }
+  ruleFail(ps, "expected a value");
+  return RULE_ERROR;
+}
+
+// value [op value], comparing two numbers
+RuleType ruleCompare(RuleParser &ps) {
+  static const struct { const char *tok; uint8_t op; } ops[] = {
+    { "<=", OP_LE }, { ">=", OP_GE }, { "==", OP_EQ }, { "!=", OP_NE }, { "<", OP_LT }, { ">", OP_GT },
+  };
+  RuleType left = ruleValue(ps);
+  if(left == RULE_ERROR) return left;
+  for(const auto &o : ops) {
+    if(!ruleAccept(ps, o.tok)) continue;
+    if(left != RULE_NUMBER) {
+      ruleFail(ps, "expected a number before this");
+      return RULE_ERROR;
+    }
+    RuleType right = ruleValue(ps);
+    if(right == RULE_ERROR) return right;
+    if(right != RULE_NUMBER) {
+      ruleFail(ps, "expected a number");
+      return RULE_ERROR;
+    }
+    ruleEmit(ps, o.op);
+    ruleStack(ps, -1);
+    return ps.error ? RULE_ERROR : RULE_BOOL;
+  }
+  return left;
+}
+
+RuleType ruleNot(RuleParser &ps) {
+  if(!ruleAccept(ps, "!")) return ruleCompare(ps);
+  if(!ruleNest(ps)) return RULE_ERROR;
+  RuleType t = ruleNot(ps);
+  ps.nesting--;
+  if(t == RULE_ERROR) return t;
+  if(t != RULE_BOOL) {
+    ruleFail(ps, "expected a condition");
+    return RULE_ERROR;
+  }
+  ruleEmit(ps, OP_NOT);
+  return ps.error ? RULE_ERROR : RULE_BOOL;
+}
+
+// Conditions joined by && (isOr false) or by || over && groups
+RuleType ruleLogic(RuleParser &ps, bool isOr) {
+  RuleType t = isOr ? ruleLogic(ps, false) : ruleNot(ps);
+  while(t != RULE_ERROR && ruleAccept(ps, isOr ? "||" : "&&")) {
+    if(t != RULE_BOOL) {
+      ruleFail(ps, "expected a condition before this");
+      return RULE_ERROR;
+    }
+    t = isOr ? ruleLogic(ps, false) : ruleNot(ps);
+    if(t == RULE_ERROR) return t;
+    if(t != RULE_BOOL) {
+      ruleFail(ps, "expected a condition");
+      return RULE_ERROR;
+    }
+    ruleEmit(ps, isOr ? OP_OR : OP_AND);
+    ruleStack(ps, -1);
+    if(ps.error) return RULE_ERROR;
+  }
+  return t;
+}
+
+RuleType ruleOr(RuleParser &ps) {
+  return ruleLogic(ps, true);
+}
+
+// Optional "for 90s", "for 2m" or "for 1h" after a rule, in seconds
+bool ruleHold(RuleParser &ps, uint16_t &seconds) {
+  seconds = 0;
+  if(!ruleAccept(ps, "for")) return true;
+  ruleSkipSpace(ps);
+  if(!isdigit((unsigned char)*ps.p)) {
+    ruleFail(ps, "expected a duration");
+    return false;
+  }
+  unsigned long n = 0;
+  while(isdigit((unsigned char)*ps.p) && n <= 65535) n = n * 10 + (*ps.p++ - '0');
+  unsigned long scale = *ps.p == 's' ? 1 : *ps.p == 'm' ? 60 : *ps.p == 'h' ? 3600 : 0;
+  if(!scale || ruleWordChar(ps.p[1])) {
+    ruleFail(ps, "expected s, m or h");
+    return false;
+  }
+  if(n * scale > 65535) {
+    ruleFail(ps, "longer than 18h");
+    return false;
+  }
+  ps.p++;
+  seconds = n * scale;
+  return true;
+}
+
+// Compiles rules separated by ';' or newlines into out, at most one per
+// target. Empty text compiles to no rules. On failure returns false with
+// e.g. "col 12: expected a value" in error.
+bool compileRules(const char *text, RuleSet &out, char *error, size_t errorLen) {
+  memset(&out, 0, sizeof(out));
+  size_t len = strlen(text);
+  if(len >= RULES_SOURCE_BYTES) {
+    snprintf(error, errorLen, "longer than %d characters", RULES_SOURCE_BYTES - 1);
+    return false;
+  }
+  memcpy(out.source, text, len);
+
+  RuleParser ps = { text, text, &out, 0, 0, NULL, NULL };
+  while(!ps.error) {
+    while(*ps.p == ';' || isspace((unsigned char)*ps.p)) ps.p++;
+    if(!*ps.p) break;
+
+    uint8_t target = 0;
+    while(target < RULE_TARGETS && !ruleAccept(ps, ruleTargetNames[target])) target++;
+    if(target == RULE_TARGETS) {
+      ruleFail(ps, "expected pump or light");
+      break;
+    }
+    if(out.targets & (1 << target)) {
+      ruleFail(ps, "second rule for this target");
+      break;
+    }
+    if(!ruleAccept(ps, "=")) {
+      ruleFail(ps, "expected =");
+      break;
+    }
+    RuleType t = ruleOr(ps);
+    if(t == RULE_NUMBER) ruleFail(ps, "expected a condition");
+    uint16_t hold;
+    if(ps.error || !ruleHold(ps, hold)) break;
+    ruleSkipSpace(ps);
+    if(*ps.p && *ps.p != ';' && *ps.p != '\n') {
+      ruleFail(ps, "expected ; or the end");
+      break;
+    }
+    ruleEmit(ps, OP_OUT);
+    ruleEmit(ps, target);
+    ruleEmit(ps, hold & 0xFF);
+    ruleEmit(ps, hold >> 8);
+    ruleStack(ps, -1);
+    out.targets |= 1 << target;
+  }
+  if(ps.error) {
+    snprintf(error, errorLen, "col %d: %s", (int)(ps.errorAt - ps.start) + 1, ps.error);
+    return false;
+  }
+  return true;
+}
+
+// Checks code read from flash before it may run: known opcodes with their
+// operands in range, a stack within RULES_STACK and empty after each rule.
+// Everything compileRules() produces passes.
+bool verifyRules(const RuleSet &r) {
+  if(r.codeLen > RULES_CODE_BYTES || !memchr(r.source, '\0', RULES_SOURCE_BYTES)) return false;
+  uint8_t depth = 0, targets = 0;
+  for(uint8_t pc = 0; pc < r.codeLen;) {
+    uint8_t op = r.code[pc++];
+    if(op == OP_VAR) {
+      if(pc + 1 > r.codeLen || r.code[pc] >= RULE_VAR_COUNT) return false;
+      pc += 1;
+      depth++;
+    } else if(op == OP_CONST) {
+      if(pc + 2 > r.codeLen) return false;
+      pc += 2;
+      depth++;
+    } else if(op == OP_NOT) {
+      if(depth < 1) return false;
+    } else if(op == OP_OUT) {
+      if(depth != 1 || pc + 3 > r.codeLen || r.code[pc] >= RULE_TARGETS) return false;
+      if(targets & (1 << r.code[pc])) return false;
+      targets |= 1 << r.code[pc];
+      pc += 3;
+      depth = 0;
+    } else if(op < OP_COUNT) {
+      if(depth < 2) return false;
+      depth--;
+    } else {
+      return false;
+    }
+    if(depth > RULES_STACK) return false;
+  }
+  return depth == 0 && targets == r.targets;
+}
+
+// Runs the rules on vars and sets want[] for each target a rule drives. The
+// code passed compileRules() or verifyRules(), so the stack can neither over-
+// nor underflow and nothing here is bounds checked.
+void evalRules(const RuleSet &r, const int32_t vars[RULE_VAR_COUNT], bool want[RULE_TARGETS]) {
+  const uint8_t *code = r.code;
+  unsigned long now = millis();
+  int32_t stack[RULES_STACK];
+  uint8_t sp = 0;
+
+  for(uint8_t pc = 0; pc < r.codeLen;) {
+    uint8_t op = code[pc++];
+    switch(op) {
+      case OP_VAR:
+        stack[sp++] = vars[code[pc++]];
+        continue;
+      case OP_CONST:
+        stack[sp++] = (int16_t)(code[pc] | code[pc + 1] << 8);
+        pc += 2;
+        continue;
+      case OP_NOT:
+        stack[sp - 1] = !stack[sp - 1];
+        continue;
+      case OP_OUT: {
+        uint8_t target = code[pc];
+        unsigned long holdMs = (code[pc + 1] | code[pc + 2] << 8) * 1000UL;
+        pc += 3;
+        if(!stack[--sp]) {
+          ruleHolding[target] = false;
+          want[target] = false;
+        } else {
+          if(!ruleHolding[target]) {
+            ruleHolding[target] = true;
+            ruleHoldSince[target] = now;
+          }
+          want[target] = now - ruleHoldSince[target] >= holdMs;
+        }
+        continue;
+      }
+    }
+    int32_t b = stack[--sp];
+    int32_t a = stack[sp - 1];
+    bool known = a != RULE_UNKNOWN && b != RULE_UNKNOWN;
+    switch(op) {
+      case OP_LT:  a = known && a < b; break;
+      case OP_LE:  a = known && a <= b; break;
+      case OP_GT:  a = known && a > b; break;
+      case OP_GE:  a = known && a >= b; break;
+      case OP_EQ:  a = known && a == b; break;
+      case OP_NE:  a = known && a != b; break;
+      case OP_AND: a = a && b; break;
+      case OP_OR:  a = a || b; break;
+    }
+    stack[sp - 1] = a;
+  }
+}
+
+// Hold times count from the first automatic pass with the condition true
+void clearRuleHolds() {
+  memset(ruleHolding, 0, sizeof(ruleHolding));
+}
+
+uint32_t ruleSlotAddress(uint16_t slot) {
+  return RULES_FLASH_SECTOR * SPI_FLASH_SEC_SIZE + slot * sizeof(RuleSlot);
+}
+
+uint32_t ruleSlotCrc(const RuleSlot &s) {
+  return crc32((const uint8_t *)&s, offsetof(RuleSlot, crc));
+}
+
+bool ruleSlotUsed(uint16_t slot) {
+  uint32_t seq = 0xFFFFFFFF;
+  ESP.flashRead(ruleSlotAddress(slot), &seq, sizeof(seq));
+  return seq != 0xFFFFFFFF;
+}
+
+// The same slot log as loadConfig(), in RULES_FLASH_SECTOR
+void loadRules() {
+  uint16_t lo = 0, hi = RULES_SLOT_COUNT;
+  while(lo < hi) {
+    uint16_t mid = (lo + hi) / 2;
+    if(ruleSlotUsed(mid)) lo = mid + 1;
+    else hi = mid;
+  }
+  rulesNextSlot = lo;
+
+  RuleSlot s;
+  for(int slot = (int)lo - 1; slot >= 0; slot--) {
+    ESP.flashRead(ruleSlotAddress(slot), (uint32_t *)&s, sizeof(s));
+    if(s.crc == ruleSlotCrc(s) && verifyRules(s.rules)) {
+      rules = s.rules;
+      rulesSeq = s.seq;
+      LOG(LOG_RULES_LOADED, slot, rules.codeLen);
+      return;
+    }
+  }
+  if(lo > 0) rulesNextSlot = RULES_SLOT_COUNT;
+}
+
+void saveRules() {
+  if(rulesNextSlot >= RULES_SLOT_COUNT) {
+    ESP.flashEraseSector(RULES_FLASH_SECTOR);
+    rulesNextSlot = 0;
+  }
+  RuleSlot s;
+  s.seq = ++rulesSeq;
+  s.rules = rules;
+  s.crc = ruleSlotCrc(s);
+  ESP.flashWrite(ruleSlotAddress(rulesNextSlot), (uint32_t *)&s, sizeof(s));
+  rulesNextSlot++;
+}
+
+// One-shot task queued when rules are staged, like applyPendingConfig()
+void applyPendingRules() {
+  if(!rulesPending) return;
+  rulesPending = false;
+  rules = pendingRules;
+  clearRuleHolds();
+  saveRules();
+  LOG(LOG_RULES_APPLIED, rulesSeq, rules.codeLen);
+}
+
+String rulesJson(const RuleSet &r) {
+  String json = "{\"rules\":\"";
+  for(const char *c = r.source; *c; c++) {
+    if(*c == '\n') json += "\\n";
+    else if(*c == '"' || *c == '\\') json += String('\\') + *c;
+    else if((uint8_t)*c >= ' ') json += *c;
+  }
+  json += "\",\"targets\":[";
+  bool first = true;
+  for(uint8_t t = 0; t < RULE_TARGETS; t++) {
+    if(!(r.targets & (1 << t))) continue;
+    json += first ? "\"" : ",\"";
+    json += ruleTargetNames[t];
+    json += "\"";
+    first = false;
+  }
+  json += "],\"codeBytes\":" + String(r.codeLen) + "}";
+  return json;
+}
@@ -0,0 +1,231 @@
+// Cooperative scheduler: periodic and one-shot tasks on a 1 ms timer wheel,
+// with run, miss and jitter counts per task. Sized by the sketch's SCHED_*
+// settings. Task runs are traced, and a full task table logged, when the
+// sketch includes trace_ring.h and log_ring.h first; without them the
+// scheduler stands alone, as on the Uno (code.cpp).
+#pragma once
+
+#ifndef SCHED_JITTER_SUM
+#define SCHED_JITTER_SUM    0       // 1: also sum each task's jitter, for a mean
+#endif
+
+typedef void (*TaskFn)();
+
+// Periodic or one-shot task on the timer wheel. Tasks due in the same
+// wheel slot are chained through next.
+struct Task {
+  const char *name;
+  TaskFn fn;
+  uint32_t periodMs;      // 0 = one-shot, freed after it runs
+  uint32_t dueMs;
+  int8_t next;            // next task in the same slot, -1 ends the chain
+  bool active;
+  bool moved;             // due time set by rescheduleTask() rather than the period
+  bool pending;           // taken off the wheel by runScheduler(), not run yet
+  uint32_t runs;
+  uint32_t misses;        // runs started over SCHED_LATE_MS late, plus skipped periods
+  uint32_t lastStartUs;
+  uint32_t jitterMaxUs;   // worst |start-to-start interval - period|
+#if SCHED_JITTER_SUM
+  uint64_t jitterSumUs;   // for the mean
+#endif
+};
+
+Task tasks[SCHED_MAX_TASKS];
+int8_t wheel[SCHED_WHEEL_SLOTS];    // first task of each 1 ms slot, -1 = empty
+uint32_t wheelMs = 0;               // newest millis() whose slot has been processed
+int8_t runningTask = -1;
+
+// ---------------- Prototypes ----------------
+// Plain C++ needs these; the Arduino IDE generates them only for .ino files
+void schedulerBegin();
+void wheelInsert(int8_t id);
+void wheelRemove(int8_t id);
+int8_t scheduleTask(const char *name, uint32_t periodMs, uint32_t delayMs, TaskFn fn);
+int8_t scheduleEvery(const char *name, uint32_t periodMs, uint32_t delayMs, TaskFn fn);
+int8_t scheduleOnce(const char *name, uint32_t delayMs, TaskFn fn);
+void rescheduleTask(int8_t id, uint32_t delayMs);
+void setTaskPeriod(int8_t id, uint32_t periodMs);
+void runTask(int8_t id);
+const char *taskName(uint8_t id);
+bool otherTaskDue();
+uint32_t runScheduler();
+
+// ---------------- Scheduler ----------------
+void schedulerBegin() {
+  memset(wheel, -1, sizeof(wheel));
+  wheelMs = millis();
+}
+
+// Due times already passed go into the next slot to be processed
+void wheelInsert(int8_t id) {
+  uint32_t at = (int32_t)(tasks[id].dueMs - wheelMs) > 0 ? tasks[id].dueMs : wheelMs + 1;
+  uint8_t slot = at & (SCHED_WHEEL_SLOTS - 1);
+  tasks[id].next = wheel[slot];
+  wheel[slot] = id;
+}
+
+void wheelRemove(int8_t id) {
+  for(uint8_t slot = 0; slot < SCHED_WHEEL_SLOTS; slot++) {
+    for(int8_t *link = &wheel[slot]; *link >= 0; link = &tasks[*link].next) {
+      if(*link == id) {
+        *link = tasks[id].next;
+        return;
+      }
+    }
+  }
+}
+
+// Returns the task id, or -1 if all SCHED_MAX_TASKS are in use
+int8_t scheduleTask(const char *name, uint32_t periodMs, uint32_t delayMs, TaskFn fn) {
+  for(int8_t id = 0; id < SCHED_MAX_TASKS; id++) {
+    Task &t = tasks[id];
+    if(t.active) continue;
+    memset(&t, 0, sizeof(t));
+    t.name = name;
+    t.fn = fn;
+    t.periodMs = periodMs;
+    t.dueMs = millis() + delayMs;
+    t.active = true;
+    wheelInsert(id);
+    return id;
+  }
+#ifdef LOG
+  LOG(LOG_NO_TASK_ROOM, name);
+#else
+  Serial.print("Scheduler: no room for ");
+  Serial.println(name);
+#endif
+  return -1;
+}
+
+// First run delayMs from now, then every periodMs
+int8_t scheduleEvery(const char *name, uint32_t periodMs, uint32_t delayMs, TaskFn fn) {
+  return scheduleTask(name, periodMs, delayMs, fn);
+}
+
+int8_t scheduleOnce(const char *name, uint32_t delayMs, TaskFn fn) {
+  return scheduleTask(name, 0, delayMs, fn);
+}
+
+// Moves the next run to delayMs from now; a periodic task carries on from there.
+// May be called by the task itself, or by another one while it is due in the
+// same pass; off the wheel then, it is linked back once, after its turn.
+void rescheduleTask(int8_t id, uint32_t delayMs) {
+  Task &t = tasks[id];
+  bool linked = id != runningTask && !t.pending;
+  if(linked) wheelRemove(id);
+  t.dueMs = millis() + delayMs;
+  t.moved = true;
+  if(linked) wheelInsert(id);
+}
+
+// Changes the period of a periodic task. Called by the task itself, it
+// already sets the time to the next run; otherwise the run after that.
+void setTaskPeriod(int8_t id, uint32_t periodMs) {
+  tasks[id].periodMs = periodMs;
+}
+
+void runTask(int8_t id) {
+  Task &t = tasks[id];
+  uint32_t startUs = micros();
+  if(millis() - t.dueMs > SCHED_LATE_MS) t.misses++;
+  if(t.runs > 0 && t.periodMs && !t.moved) {
+    int32_t error = (int32_t)(startUs - t.lastStartUs) - (int32_t)(t.periodMs * 1000);
+    uint32_t jitter = error < 0 ? -error : error;
+    if(jitter > t.jitterMaxUs) t.jitterMaxUs = jitter;
+#if SCHED_JITTER_SUM
+    t.jitterSumUs += jitter;
+#endif
+  }
+  t.lastStartUs = startUs;
+  t.runs++;
+  t.moved = false;
+
+  runningTask = id;
+#ifdef TRACE_TASK_BASE
+  traceBegin(TRACE_TASK_BASE + id);
+#endif
+  t.fn();
+#ifdef TRACE_TASK_BASE
+  traceEnd(TRACE_TASK_BASE + id);
+#endif
+  runningTask = -1;
+
+  if(t.moved) {
+    wheelInsert(id);
+  } else if(t.periodMs == 0) {
+    t.active = false;
+  } else {
+    // Next deadline from the schedule, not from when this run happened;
+    // periods that went by entirely while the loop was blocked are misses
+    t.dueMs += t.periodMs;
+    uint32_t behind = millis() - t.dueMs;
+    if((int32_t)behind > 0 && behind >= t.periodMs) {
+      uint32_t skipped = behind / t.periodMs;
+      t.misses += skipped;
+      t.dueMs += skipped * t.periodMs;
+    }
+    wheelInsert(id);
+  }
+}
+
+// Name the task was scheduled under; NULL for a slot never used
+const char *taskName(uint8_t id) {
+  return tasks[id].name;
+}
+
+// True if a task other than the running one is due; a long task checks this
+// to hand the CPU back
+bool otherTaskDue() {
+  uint32_t now = millis();
+  for(int8_t id = 0; id < SCHED_MAX_TASKS; id++) {
+    if(id == runningTask || !tasks[id].active) continue;
+    if((int32_t)(now - tasks[id].dueMs) >= 0) return true;
+  }
+  return false;
+}
+
+// Runs every task that is due, walking the wheel slots from the last pass up
+// to now (at most one revolution), and returns the milliseconds until the next
+// task is due: at least 1, at most SCHED_MAX_IDLE_MS
+uint32_t runScheduler() {
+  uint32_t now = millis();
+  uint32_t steps = now - wheelMs;
+  if(steps > SCHED_WHEEL_SLOTS) steps = SCHED_WHEEL_SLOTS;
+
+  int8_t due[SCHED_MAX_TASKS];
+  uint8_t dueCount = 0;
+  for(uint32_t i = 1; i <= steps; i++) {
+    uint8_t slot = (wheelMs + i) & (SCHED_WHEEL_SLOTS - 1);
+    for(int8_t *link = &wheel[slot]; *link >= 0; ) {
+      int8_t id = *link;
+      if((int32_t)(now - tasks[id].dueMs) >= 0) {
+        *link = tasks[id].next;
+        tasks[id].pending = true;
+        due[dueCount++] = id;
+      } else {
+        link = &tasks[id].next;
+      }
+    }
+  }
+  wheelMs = now;
+  for(uint8_t i = 0; i < dueCount; i++) {
+    int8_t id = due[i];
+    tasks[id].pending = false;
+    // Moved later by a task that ran before it in this pass
+    if((int32_t)(millis() - tasks[id].dueMs) < 0) wheelInsert(id);
+    else runTask(id);
+  }
+
+  // Anything still due now was queued during this pass and waits for the next slot
+  uint32_t wait = SCHED_MAX_IDLE_MS;
+  now = millis();
+  for(int8_t id = 0; id < SCHED_MAX_TASKS; id++) {
+    if(!tasks[id].active) continue;
+    int32_t until = tasks[id].dueMs - now;
+    if(until < 1) until = 1;
+    if((uint32_t)until < wait) wait = until;
+  }
+  return wait;
+}
@@ -0,0 +1,68 @@
+// Switching guard: minimum on and off times and a switches-per-hour limit
+// for the pump and the LED in automatic mode. The limits are the sketch's
+// "Automatic Mode Tuning" settings.
+#pragma once
+
+// Switch times kept per actuator, enough for either hourly limit
+#define GUARD_HISTORY (PUMP_MAX_SWITCHES_PER_HOUR > LIGHT_MAX_SWITCHES_PER_HOUR ? \
+                       PUMP_MAX_SWITCHES_PER_HOUR : LIGHT_MAX_SWITCHES_PER_HOUR)
+static_assert(PUMP_MAX_SWITCHES_PER_HOUR > 0 && LIGHT_MAX_SWITCHES_PER_HOUR > 0 && GUARD_HISTORY <= 255,
+              "switches per hour must be 1-255");
+
+// Switching guard for one actuator. Every switch is noted, manual ones
+// included; only automatic mode asks before switching.
+struct SwitchGuard {
+  unsigned long minOnMs;
+  unsigned long minOffMs;
+  uint8_t maxPerHour;
+  uint8_t switchCount = 0;                        // switch times held, up to GUARD_HISTORY
+  uint8_t nextSwitch = 0;                         // where the next one goes
+  unsigned long switchTimes[GUARD_HISTORY] = {};  // ring of the latest switches
+  unsigned long lastSwitch = 0;
+  unsigned long suppressedDwell = 0;   // transitions blocked by minimum on/off time
+  unsigned long suppressedRate = 0;    // transitions blocked by switches-per-hour limit
+};
+
+SwitchGuard pumpGuard  = { PUMP_MIN_ON_MS,  PUMP_MIN_OFF_MS,  PUMP_MAX_SWITCHES_PER_HOUR };
+SwitchGuard lightGuard = { LIGHT_MIN_ON_MS, LIGHT_MIN_OFF_MS, LIGHT_MAX_SWITCHES_PER_HOUR };
+
+// ---------------- Prototypes ----------------
+// Plain C++ needs these; the Arduino IDE generates them only for .ino files
+bool guardAllowsSwitch(SwitchGuard &guard, bool currentState);
+void guardNoteSwitch(SwitchGuard &guard);
+
+// ---------------- Switching Guard ----------------
+// Returns true if an actuator currently in currentState may switch now.
+// Manual commands bypass this; only automatic mode is rate limited. The hour
+// is a rolling one: the switch maxPerHour back must be at least an hour old.
+bool guardAllowsSwitch(SwitchGuard &guard, bool currentState) {
+  unsigned long now = millis();
+
+  if(guard.switchCount > 0) {
+    unsigned long minDwell = currentState ? guard.minOnMs : guard.minOffMs;
+    if(now - guard.lastSwitch < minDwell) {
+      guard.suppressedDwell++;
+      return false;
+    }
+  }
+
+  if(guard.switchCount >= guard.maxPerHour) {
+    uint8_t back = (guard.nextSwitch + GUARD_HISTORY - guard.maxPerHour) % GUARD_HISTORY;
+    if(now - guard.switchTimes[back] < 3600000UL) {
+      guard.suppressedRate++;
+      return false;
+    }
+  }
+  return true;
+}
+
+// Called by setPump() and setLight() on every change, so automatic mode
+// waits out the minimum time after a manual switch too, and manual switches
+// count toward the hourly limit
+void guardNoteSwitch(SwitchGuard &guard) {
+  unsigned long now = millis();
+  guard.lastSwitch = now;
+  guard.switchTimes[guard.nextSwitch] = now;
+  guard.nextSwitch = (guard.nextSwitch + 1) % GUARD_HISTORY;
+  if(guard.switchCount < GUARD_HISTORY) guard.switchCount++;
+}
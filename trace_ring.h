@@ -0,0 +1,120 @@
+// The trace ring: begin/end/instant events with micros() timestamps, dumped
+// in the format host/trace2json.cpp reads. Built from the sketch's TRACE_*
+// settings and TRACE_NAMES; handler and task names come from routeName()
+// and taskName(), defined further on.
+#pragma once
+
+// One trace event; name indexes the dump's name table: TRACE_NAMES, then handler
+// URIs (sketches with the HTTP server), then task names
+struct TraceEvent {
+  uint32_t us;
+  char phase;       // 'B'egin, 'E'nd or 'i'nstant, as in the Chrome trace format
+  uint8_t name;
+  uint16_t arg;     // instants: the new state
+};
+
+static_assert(sizeof(TraceEvent) == 8, "TraceEvent is dumped as 8 bytes");
+
+typedef void (*TraceSink)(const uint8_t *data, size_t len);
+
+#define TRACE_ID_OF(id, text) id,
+#define TRACE_TEXT_OF(id, text) text,
+enum TraceName : uint8_t { TRACE_NAMES(TRACE_ID_OF) TRACE_HANDLER_BASE };
+#ifdef HTTP_ROUTE_COUNT
+#define TRACE_TASK_BASE   (TRACE_HANDLER_BASE + HTTP_ROUTE_COUNT)
+#else
+#define TRACE_TASK_BASE   TRACE_HANDLER_BASE     // no HTTP handlers
+#endif
+const char *const traceNames[] = { TRACE_NAMES(TRACE_TEXT_OF) };
+
+TraceEvent traceRing[TRACE_EVENTS];
+uint16_t traceHead = 0;     // next slot to write
+uint16_t traceCount = 0;    // events held, at most TRACE_EVENTS
+
+// ---------------- Prototypes ----------------
+// Plain C++ needs these; the Arduino IDE generates them only for .ino files
+void traceRecord(char phase, uint8_t name, uint16_t arg);
+void traceBegin(uint8_t name);
+void traceEnd(uint8_t name);
+void traceInstant(uint8_t name, uint16_t arg);
+const char *traceNameText(uint8_t name);
+void traceWrite(TraceSink sink);
+void traceSerialSink(const uint8_t *data, size_t len);
+
+// Defined with the HTTP server and the scheduler
+#ifdef HTTP_ROUTE_COUNT
+const char *routeName(uint8_t route);
+#endif
+const char *taskName(uint8_t id);
+
+// ---------------- Tracing ----------------
+void traceRecord(char phase, uint8_t name, uint16_t arg) {
+  TraceEvent &e = traceRing[traceHead];
+  e.us = micros();
+  e.phase = phase;
+  e.name = name;
+  e.arg = arg;
+  traceHead = (traceHead + 1) % TRACE_EVENTS;
+  if(traceCount < TRACE_EVENTS) traceCount++;
+}
+
+void traceBegin(uint8_t name) {
+  traceRecord('B', name, 0);
+}
+
+// Closes a span. A short one with nothing recorded inside is taken back out,
+// so idle polls do not push the interesting events out of the ring.
+void traceEnd(uint8_t name) {
+  const TraceEvent &last = traceRing[(traceHead + TRACE_EVENTS - 1) % TRACE_EVENTS];
+  if(traceCount > 0 && last.phase == 'B' && last.name == name && micros() - last.us < TRACE_MIN_SPAN_US) {
+    traceHead = (traceHead + TRACE_EVENTS - 1) % TRACE_EVENTS;
+    traceCount--;
+    return;
+  }
+  traceRecord('E', name, 0);
+}
+
+void traceInstant(uint8_t name, uint16_t arg) {
+  traceRecord('i', name, arg);
+}
+
+const char *traceNameText(uint8_t name) {
+  if(name < TRACE_HANDLER_BASE) return traceNames[name];
+#ifdef HTTP_ROUTE_COUNT
+  if(name < TRACE_TASK_BASE) return routeName(name - TRACE_HANDLER_BASE);
+#endif
+  const char *task = taskName(name - TRACE_TASK_BASE);
+  return task ? task : "";
+}
+
+// Dump: "TRC1", micros() and millis() now, the name count and the first
+// handler and task name ids, the names (length byte + text), the event
+// count, then the events oldest first as they are in RAM (little-endian)
+void traceWrite(TraceSink sink) {
+  uint16_t count = traceCount;
+  uint16_t at = (traceHead + TRACE_EVENTS - count) % TRACE_EVENTS;
+  uint32_t nowUs = micros(), nowMs = millis();
+  uint8_t header[15];
+  memcpy(header, "TRC1", 4);
+  memcpy(header + 4, &nowUs, 4);
+  memcpy(header + 8, &nowMs, 4);
+  header[12] = TRACE_TASK_BASE + SCHED_MAX_TASKS;
+  header[13] = TRACE_HANDLER_BASE;
+  header[14] = TRACE_TASK_BASE;
+  sink(header, sizeof(header));
+  for(uint8_t name = 0; name < header[12]; name++) {
+    const char *text = traceNameText(name);
+    uint8_t len = strlen(text);
+    sink(&len, 1);
+    sink((const uint8_t *)text, len);
+  }
+  sink((const uint8_t *)&count, sizeof(count));
+  for(uint16_t i = 0; i < count; i++) {
+    sink((const uint8_t *)&traceRing[at], sizeof(TraceEvent));
+    at = (at + 1) % TRACE_EVENTS;
+  }
+}
+
+void traceSerialSink(const uint8_t *data, size_t len) {
+  Serial.write(data, len);
+}
@@ -0,0 +1,102 @@
+// Fast WiFi boot: joins with the BSSID, channel and DHCP lease cached in
+// RTC memory by the last connection, and falls back to a full scan and DHCP
+// after WIFI_QUICK_TIMEOUT_MS. Set by the sketch's "Fast WiFi Boot" settings
+// and WLAN_SSID/WLAN_PASS. Needs crc32.h. Logs and traces when the sketch
+// includes log_ring.h and trace_ring.h first; without them it prints to
+// Serial, as in esp2.cpp.
+#pragma once
+
+// Last good connection, kept in RTC memory across resets (lost on power-off).
+// The DHCP lease is reused as a static config so the quick join skips DHCP.
+struct WifiCache {
+  uint32_t crc;
+  uint32_t ip, gateway, subnet, dns;
+  uint8_t bssid[6];
+  uint8_t channel;
+  uint8_t reserved;
+};
+
+WifiCache wifiCache;
+bool wifiQuickJoin = false;         // currently trying the cached BSSID/channel/IP
+bool wifiWasConnected = false;
+unsigned long wifiBeginMs = 0;
+
+// ---------------- Prototypes ----------------
+// Plain C++ needs these; the Arduino IDE generates them only for .ino files
+uint32_t wifiCacheCrc();
+void wifiBeginFast();
+void wifiPoll();
+
+// ---------------- Fast WiFi Boot ----------------
+uint32_t wifiCacheCrc() {
+  return crc32((const uint8_t *)&wifiCache + sizeof(wifiCache.crc), sizeof(wifiCache) - sizeof(wifiCache.crc));
+}
+
+// Starts joining without waiting; wifiPoll() finishes the job from loop()
+void wifiBeginFast() {
+  WiFi.persistent(false);
+  WiFi.mode(WIFI_STA);
+
+  ESP.rtcUserMemoryRead(WIFI_CACHE_RTC_BLOCK, (uint32_t *)&wifiCache, sizeof(wifiCache));
+  wifiQuickJoin = wifiCache.crc == wifiCacheCrc() && wifiCache.channel != 0;
+  if(wifiQuickJoin) {
+    WiFi.config(IPAddress(wifiCache.ip), IPAddress(wifiCache.gateway),
+                IPAddress(wifiCache.subnet), IPAddress(wifiCache.dns));
+    WiFi.begin(WLAN_SSID, WLAN_PASS, wifiCache.channel, wifiCache.bssid, true);
+#ifdef LOG
+    LOG(LOG_WIFI_QUICK);
+#else
+    Serial.println("WiFi: quick join with cached BSSID/channel/IP");
+#endif
+  } else {
+    WiFi.begin(WLAN_SSID, WLAN_PASS);
+#ifdef LOG
+    LOG(LOG_WIFI_FULL);
+#else
+    Serial.println("WiFi: full scan and DHCP");
+#endif
+  }
+  wifiBeginMs = millis();
+}
+
+// Call every loop() pass
+void wifiPoll() {
+  bool connected = WiFi.status() == WL_CONNECTED;
+
+  if(connected && !wifiWasConnected) {
+#ifdef LOG
+    LOG(LOG_WIFI_CONNECTED, millis() - wifiBeginMs, millis(), WiFi.localIP().toString());
+#else
+    Serial.printf("WiFi Connected after %lu ms (boot +%lu ms), IP Address: %s\n",
+                  millis() - wifiBeginMs, millis(), WiFi.localIP().toString().c_str());
+#endif
+    wifiCache.ip = WiFi.localIP();
+    wifiCache.gateway = WiFi.gatewayIP();
+    wifiCache.subnet = WiFi.subnetMask();
+    wifiCache.dns = WiFi.dnsIP();
+    memcpy(wifiCache.bssid, WiFi.BSSID(), sizeof(wifiCache.bssid));
+    wifiCache.channel = WiFi.channel();
+    wifiCache.reserved = 0;
+    wifiCache.crc = wifiCacheCrc();
+    ESP.rtcUserMemoryWrite(WIFI_CACHE_RTC_BLOCK, (uint32_t *)&wifiCache, sizeof(wifiCache));
+    wifiQuickJoin = false;
+  } else if(!connected && wifiQuickJoin && millis() - wifiBeginMs > WIFI_QUICK_TIMEOUT_MS) {
+    // Cached AP or lease is stale - forget it and do a normal join
+#ifdef LOG
+    LOG(LOG_WIFI_FALLBACK);
+#else
+    Serial.println("WiFi: quick join failed, falling back to full scan");
+#endif
+    wifiQuickJoin = false;
+    wifiCache.crc = 0;
+    ESP.rtcUserMemoryWrite(WIFI_CACHE_RTC_BLOCK, (uint32_t *)&wifiCache, sizeof(wifiCache));
+    WiFi.disconnect();
+    WiFi.config(IPAddress(0, 0, 0, 0), IPAddress(0, 0, 0, 0), IPAddress(0, 0, 0, 0));
+    WiFi.begin(WLAN_SSID, WLAN_PASS);
+    wifiBeginMs = millis();
+  }
+#ifdef TRACE_NAMES
+  if(connected != wifiWasConnected) traceInstant(TRACE_WIFI, connected);
+#endif
+  wifiWasConnected = connected;
+}
@@ -0,0 +1,420 @@
+#include <ESP8266WiFi.h>
+#include <ESP8266WebServer.h>
+#include <Wire.h>
+#include "Adafruit_MQTT.h"
+#include "Adafruit_MQTT_Client.h"
+
+// Multi-zone irrigation node: up to 16 soil moisture sensors behind one
+// CD74HC4067 analog multiplexer and up to 16 valves/pumps on one PCA9685
+// I2C PWM expander. Status at /zones, per-zone MQTT feeds "zone-N".
+
+// ---------------- WiFi ----------------
+#define WLAN_SSID       "YOUR_WIFI_SSID"
+#define WLAN_PASS       "YOUR_WIFI_PASSWORD"
+
+// ---------------- Adafruit IO ----------------
+#define AIO_SERVER      "io.adafruit.com"
+#define AIO_SERVERPORT  1883
+#define AIO_USERNAME    "YOUR_ADAFRUIT_USERNAME"
+#define AIO_KEY         "YOUR_ADAFRUIT_KEY"
+
+// ---------------- Web Server ----------------
+ESP8266WebServer server(80);
+
+// ---------------- Zones ----------------
+#define MAX_ZONES                 16      // one mux, one expander
+#define ZONE_COUNT                8       // zones actually wired
+#define ZONE_SCAN_INTERVAL_MS     1000
+#define ZONE_RAW_DRY              800     // capacitive sensor reading in dry soil
+#define ZONE_RAW_WET              350     // ... and in water
+#define ZONE_EMA_SHIFT            2       // EMA alpha = 1/4 per scan
+#define ZONE_THRESHOLD            35      // default: water below 35% moisture
+#define ZONE_HYSTERESIS           10      // stop watering at threshold + 10%
+#define ZONE_LEVEL                4095    // valve drive when open (PCA9685 is 12-bit)
+#define ZONE_MIN_ON_MS            30000UL // valve stays open at least 30 seconds
+#define ZONE_MIN_OFF_MS           60000UL // valve stays closed at least 1 minute
+#define ZONE_MAX_OPEN             4       // valves open at once (supply pressure/current)
+
+// ---------------- Zone Reporting ----------------
+#define ZONE_PUBLISH_INTERVAL_MS  10000
+#define ZONE_PUBLISH_MAX          4       // feeds per publish pass (Adafruit IO: 30/min)
+#define ZONE_REPORT_STEP          2       // moisture change (%) worth reporting
+
+// ---------------- Analog Multiplexer ----------------
+// CD74HC4067: S0-S3 select one of 16 inputs onto A0; EN tied low
+#define MUX_S0 D5          // GPIO14
+#define MUX_S1 D6          // GPIO12
+#define MUX_S2 D7          // GPIO13
+#define MUX_S3 D0          // GPIO16
+#define MUX_ADC A0
+#define MUX_SETTLE_US 5
+
+// ---------------- PWM Expander ----------------
+// PCA9685 at its default address; zone N drives channel N
+#define I2C_SDA D2         // GPIO4
+#define I2C_SCL D1         // GPIO5
+#define I2C_CLOCK_HZ 400000
+#define PCA9685_ADDR      0x40
+#define PCA9685_MODE1     0x00
+#define PCA9685_MODE2     0x01
+#define PCA9685_LED0      0x06    // LED0_ON_L; 4 registers per channel
+#define PCA9685_ALL_OFF_H 0xFD
+#define PCA9685_PRESCALE  0xFE
+#define PCA9685_PRESCALE_1KHZ 5   // 25 MHz / (4096 * 1 kHz) - 1
+
+// ---------------- MQTT ----------------
+WiFiClient client;
+Adafruit_MQTT_Client mqtt(&client, AIO_SERVER, AIO_SERVERPORT, AIO_USERNAME, AIO_KEY);
+
+// Subscriptions (App → NodeMCU): "3=open", "3=closed", "3=auto" (zones count from 1)
+Adafruit_MQTT_Subscribe zoneControlFeed = Adafruit_MQTT_Subscribe(&mqtt, AIO_USERNAME "/feeds/zoneControl");
+
+// ---------------- Variables ----------------
+// Zone state as structure-of-arrays: each scan stage walks one field across
+// all zones, and the per-zone flags are bitmasks (bit N = zone N)
+struct ZoneTable {
+  uint8_t count;
+  uint16_t raw[MAX_ZONES];              // filtered ADC reading, Q4 fixed point
+  uint8_t moisture[MAX_ZONES];          // percent, 0 = dry
+  uint8_t threshold[MAX_ZONES];         // water below this moisture
+  uint16_t level[MAX_ZONES];            // PWM drive while open
+  unsigned long lastSwitch[MAX_ZONES];
+  uint16_t switches[MAX_ZONES];
+  uint8_t reported[MAX_ZONES];          // moisture in the last publish
+  uint16_t open;                        // valve open
+  uint16_t manual;                      // valve forced by a command
+  uint16_t manualOpen;                  // forced state of manual zones
+  uint16_t dirty;                       // expander channels to rewrite
+  uint16_t changed;                     // zones to publish
+};
+
+ZoneTable zones;
+char zoneTopic[MAX_ZONES][48];
+uint8_t muxChannel = 0xFF;              // currently selected mux input
+unsigned long lastScanMs = 0;
+unsigned long lastScanUs = 0;           // duration of the last scanZones()
+const char zoneCapError[] = "Too many valves open";
+
+// ---------------- Prototypes ----------------
+// Plain C++ needs these; the Arduino IDE generates them only for .ino files
+void zonesBegin();
+void selectMuxChannel(uint8_t ch);
+uint8_t moisturePercent(uint16_t raw);
+void scanZones();
+void writeZoneOutputs();
+uint16_t zonesOpenOrForced();
+const char *setZoneMode(uint8_t zone, const String &mode);
+bool parseZoneNumber(const String &text, long &zone);
+void publishZones();
+void handleZones();
+void handleZone();
+void MQTT_connect();
+
+// ---------------- Shared Code ----------------
+// Kept in headers beside the sketches and shared with them, so they are
+// included after this sketch's settings and prototypes.
+#include "fixed_point.h"
+
+void setup() {
+  Serial.begin(115200);
+  zonesBegin();
+
+  Serial.println("Multi-Zone Irrigation Starting...");
+  Serial.printf("Zones: %d, all valves closed\n", zones.count);
+
+  // Join WiFi in the background; zones are controlled from the first scan
+  WiFi.mode(WIFI_STA);
+  WiFi.begin(WLAN_SSID, WLAN_PASS);
+
+  server.on("/zones", HTTP_GET, handleZones);
+  server.on("/zone", HTTP_GET, handleZone);
+  server.begin();
+
+  mqtt.subscribe(&zoneControlFeed);
+}
+
+void loop() {
+  server.handleClient();
+  MQTT_connect();
+  yield();
+
+  Adafruit_MQTT_Subscribe *sub;
+  while(mqtt.connected() && (sub = mqtt.readSubscription())) {
+    if(sub == &zoneControlFeed) {
+      // "<zone>=<mode>"
+      String cmd = String((char *)zoneControlFeed.lastread);
+      int eq = cmd.indexOf('=');
+      long zone;
+      const char *error = "Invalid command";
+      if(eq >= 0 && parseZoneNumber(cmd.substring(0, eq), zone)) error = setZoneMode(zone - 1, cmd.substring(eq + 1));
+      if(error) Serial.printf("Zone command %s refused: %s\n", cmd.c_str(), error);
+    }
+  }
+
+  if(millis() - lastScanMs >= ZONE_SCAN_INTERVAL_MS) {
+    lastScanMs = millis();
+    scanZones();
+  }
+
+  static unsigned long lastPublishMs = 0;
+  static unsigned long lastPingMs = 0;
+  if(mqtt.connected()) {
+    if(millis() - lastPublishMs >= ZONE_PUBLISH_INTERVAL_MS) {
+      lastPublishMs = millis();
+      publishZones();
+    }
+    // Keep the connection alive through quiet periods with nothing to publish
+    if(millis() - lastPingMs >= 60000UL) {
+      lastPingMs = millis();
+      mqtt.ping();
+    }
+  }
+}
+
+// ---------------- Zones ----------------
+void zonesBegin() {
+  pinMode(MUX_S0, OUTPUT);
+  pinMode(MUX_S1, OUTPUT);
+  pinMode(MUX_S2, OUTPUT);
+  pinMode(MUX_S3, OUTPUT);
+  muxChannel = 0xFF;
+
+  memset(&zones, 0, sizeof(zones));
+  zones.count = ZONE_COUNT;
+  for(uint8_t z = 0; z < MAX_ZONES; z++) {
+    zones.threshold[z] = ZONE_THRESHOLD;
+    zones.level[z] = ZONE_LEVEL;
+    snprintf(zoneTopic[z], sizeof(zoneTopic[z]), AIO_USERNAME "/feeds/zone-%d", z + 1);
+  }
+
+  // PCA9685: set the PWM frequency while asleep, then wake with register
+  // auto-increment on so one transfer can cover many channels
+  Wire.begin(I2C_SDA, I2C_SCL);
+  Wire.setClock(I2C_CLOCK_HZ);
+  const uint8_t init[][2] = {
+    { PCA9685_MODE1, 0x10 },                   // sleep
+    { PCA9685_PRESCALE, PCA9685_PRESCALE_1KHZ },
+    { PCA9685_MODE1, 0x20 },                   // wake, auto-increment
+    { PCA9685_MODE2, 0x04 },                   // totem-pole outputs
+    { PCA9685_ALL_OFF_H, 0x10 },               // every channel fully off
+  };
+  for(uint8_t i = 0; i < sizeof(init) / sizeof(init[0]); i++) {
+    Wire.beginTransmission(PCA9685_ADDR);
+    Wire.write(init[i][0]);
+    Wire.write(init[i][1]);
+    Wire.endTransmission();
+    if(i == 2) delayMicroseconds(500);         // oscillator start-up
+  }
+}
+
+// Only the select lines that differ from the current channel are written
+void selectMuxChannel(uint8_t ch) {
+  static const uint8_t selectPins[4] = { MUX_S0, MUX_S1, MUX_S2, MUX_S3 };
+  uint8_t diff = ch ^ muxChannel;
+  for(uint8_t bit = 0; bit < 4; bit++) {
+    if(diff & (1 << bit)) digitalWrite(selectPins[bit], (ch >> bit) & 1);
+  }
+  muxChannel = ch;
+  delayMicroseconds(MUX_SETTLE_US);
+}
+
+// Capacitive sensors read higher when dry
+uint8_t moisturePercent(uint16_t raw) {
+  if(raw >= ZONE_RAW_DRY) return 0;
+  if(raw <= ZONE_RAW_WET) return 100;
+  return (uint8_t)((uint32_t)(ZONE_RAW_DRY - raw) * 100 / (ZONE_RAW_DRY - ZONE_RAW_WET));
+}
+
+// One pass over all zones: read every input, decide every valve, then
+// write all changed outputs in a single I2C transfer
+void scanZones() {
+  unsigned long startUs = micros();
+  unsigned long now = millis();
+
+  for(uint8_t z = 0; z < zones.count; z++) {
+    selectMuxChannel(z);
+    int32_t sample = (int32_t)analogRead(MUX_ADC) << 4;
+    if(zones.raw[z] == 0) zones.raw[z] = sample;
+    else zones.raw[z] += (sample - zones.raw[z]) >> ZONE_EMA_SHIFT;
+  }
+
+  for(uint8_t z = 0; z < zones.count; z++) {
+    uint8_t m = moisturePercent(zones.raw[z] >> 4);
+    zones.moisture[z] = m;
+    if(abs(m - zones.reported[z]) >= ZONE_REPORT_STEP) zones.changed |= 1 << z;
+  }
+
+  uint8_t openCount = __builtin_popcount(zonesOpenOrForced());
+  for(uint8_t z = 0; z < zones.count; z++) {
+    uint16_t bit = 1 << z;
+    bool isOpen = zones.open & bit;
+    bool want;
+    if(zones.manual & bit) want = zones.manualOpen & bit;
+    else if(zones.moisture[z] < zones.threshold[z]) want = true;
+    else if(zones.moisture[z] >= zones.threshold[z] + ZONE_HYSTERESIS) want = false;
+    else want = isOpen;
+    if(want == isOpen) continue;
+
+    // Commands act at once, and setZoneMode() kept them within the supply
+    // limit; automatic switching honours dwell and the supply limit, with
+    // commands later in this pass already counted
+    if(!(zones.manual & bit)) {
+      unsigned long minDwell = isOpen ? ZONE_MIN_ON_MS : ZONE_MIN_OFF_MS;
+      if(zones.switches[z] && now - zones.lastSwitch[z] < minDwell) continue;
+      if(want && openCount >= ZONE_MAX_OPEN) continue;
+    }
+    zones.open ^= bit;
+    openCount = __builtin_popcount(zonesOpenOrForced());
+    zones.lastSwitch[z] = now;
+    zones.switches[z]++;
+    zones.dirty |= bit;
+    zones.changed |= bit;
+  }
+
+  writeZoneOutputs();
+  lastScanUs = micros() - startUs;
+}
+
+// Rewrites the dirty channels as one auto-increment transfer from the
+// lowest to the highest dirty channel (4 bytes per channel, 65 bytes max)
+void writeZoneOutputs() {
+  if(!zones.dirty) return;
+  uint8_t first = __builtin_ctz(zones.dirty);
+  uint8_t last = 31 - __builtin_clz(zones.dirty);
+
+  Wire.beginTransmission(PCA9685_ADDR);
+  Wire.write(PCA9685_LED0 + 4 * first);
+  for(uint8_t ch = first; ch <= last; ch++) {
+    uint16_t level = (zones.open >> ch) & 1 ? zones.level[ch] : 0;
+    uint16_t on = level >= 4095 ? 0x1000 : 0;      // full-on bit
+    uint16_t off = level == 0 ? 0x1000 : level;    // full-off bit
+    Wire.write(on & 0xFF);
+    Wire.write(on >> 8);
+    Wire.write(off & 0xFF);
+    Wire.write(off >> 8);
+  }
+  Wire.endTransmission();
+  zones.dirty = 0;
+}
+
+// Valves open once the next scan applies the commands: zones under a
+// command as it forces them, the others as they are now
+uint16_t zonesOpenOrForced() {
+  return (zones.open & ~zones.manual) | (zones.manual & zones.manualOpen);
+}
+
+// mode: "open"/"closed" force the valve, "auto" hands it back to the scan.
+// Returns NULL, or why the command is refused: forcing a valve open counts
+// against ZONE_MAX_OPEN like the scan's own openings.
+const char *setZoneMode(uint8_t zone, const String &mode) {
+  if(zone >= zones.count) return "Invalid zone";
+  uint16_t bit = 1 << zone;
+  if(mode == "auto") {
+    zones.manual &= ~bit;
+  } else if(mode == "open") {
+    if(__builtin_popcount(zonesOpenOrForced() | bit) > ZONE_MAX_OPEN) return zoneCapError;
+    zones.manual |= bit;
+    zones.manualOpen |= bit;
+  } else if(mode == "closed") {
+    zones.manual |= bit;
+    zones.manualOpen &= ~bit;
+  } else {
+    return "Invalid mode";
+  }
+  Serial.printf("Zone %d: %s\n", zone + 1, mode.c_str());
+  return NULL;
+}
+
+bool parseZoneNumber(const String &text, long &zone) {
+  return parseUnsigned(text.c_str(), zones.count, zone) && zone >= 1;
+}
+
+// ---------------- Zone Reporting ----------------
+// Publishes changed zones, at most ZONE_PUBLISH_MAX per pass, resuming
+// after the last zone published so busy zones cannot starve the rest
+void publishZones() {
+  static uint8_t next = 0;
+  uint8_t sent = 0;
+  char payload[48];
+  for(uint8_t i = 0; i < zones.count && sent < ZONE_PUBLISH_MAX; i++) {
+    uint8_t z = (next + i) % zones.count;
+    uint16_t bit = 1 << z;
+    if(!(zones.changed & bit)) continue;
+    snprintf(payload, sizeof(payload), "{\"moisture\":%d,\"valve\":%d}",
+             zones.moisture[z], (zones.open & bit) ? 1 : 0);
+    if(!mqtt.publish(zoneTopic[z], payload)) break;
+    zones.changed &= ~bit;
+    zones.reported[z] = zones.moisture[z];
+    sent++;
+    next = z + 1;
+  }
+}
+
+// GET /zones: every zone in one response
+void handleZones() {
+  String json;
+  json.reserve(64 + 96 * zones.count);
+  char row[112];
+  snprintf(row, sizeof(row), "{\"open\":%d,\"scanUs\":%lu,\"zones\":[",
+           __builtin_popcount(zones.open), lastScanUs);
+  json += row;
+  for(uint8_t z = 0; z < zones.count; z++) {
+    uint16_t bit = 1 << z;
+    snprintf(row, sizeof(row),
+             "%s{\"zone\":%d,\"moisture\":%d,\"threshold\":%d,\"valve\":%s,\"manual\":%s,\"switches\":%u}",
+             z ? "," : "", z + 1, zones.moisture[z], zones.threshold[z],
+             (zones.open & bit) ? "true" : "false", (zones.manual & bit) ? "true" : "false",
+             zones.switches[z]);
+    json += row;
+  }
+  json += "]}";
+  server.send(200, "application/json", json);
+}
+
+// GET /zone?id=3&mode=open|closed|auto&threshold=40
+void handleZone() {
+  long zone;
+  if(!parseZoneNumber(server.arg("id"), zone)) {
+    server.send(400, "text/plain", "Invalid zone");
+    return;
+  }
+  if(server.hasArg("threshold")) {
+    long threshold;
+    if(!parseUnsigned(server.arg("threshold").c_str(), 100 - ZONE_HYSTERESIS, threshold) || threshold < 1) {
+      server.send(400, "text/plain", "Invalid threshold");
+      return;
+    }
+    zones.threshold[zone - 1] = threshold;
+  }
+  if(server.hasArg("mode")) {
+    const char *error = setZoneMode(zone - 1, server.arg("mode"));
+    if(error) {
+      // The cap is a conflict with the other valves, not a bad request
+      server.send(error == zoneCapError ? 409 : 400, "text/plain", error);
+      return;
+    }
+  }
+  server.send(200, "text/plain", "OK");
+}
+
+// ---------------- MQTT ----------------
+void MQTT_connect() {
+  static unsigned long lastAttempt = 0;
+  int8_t ret;
+  if(mqtt.connected()) return;
+  if(WiFi.status() != WL_CONNECTED) return;
+
+  // Retry every 5 seconds without blocking the zone scan
+  if(lastAttempt != 0 && millis() - lastAttempt < 5000) return;
+  lastAttempt = millis();
+
+  Serial.print("Connecting to MQTT... ");
+  if((ret = mqtt.connect()) != 0){
+    Serial.println(mqtt.connectErrorString(ret));
+    Serial.println("Retrying in 5 seconds...");
+    mqtt.disconnect();
+    return;
+  }
+  Serial.println("MQTT Connected!");
+  zones.changed = (1 << zones.count) - 1;   // resend everything after a reconnect
+}